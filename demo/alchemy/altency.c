@@ -194,6 +194,7 @@ static void display(void *cookie)
 		config.histogram_size = need_histo() ? histogram_size : 0;
 		config.histogram_bucketsize = bucketsize;
 		config.freeze_max = freeze_max;
+		config.histogram_hdr = 0;
 
 		ret = ioctl(devfd, RTTST_RTIOC_TMBENCH_START, &config);
 		if (ret) {
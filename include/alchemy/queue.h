@@ -29,6 +29,8 @@
 /** Creation flags. */
 #define Q_PRIO  0x1	/* Pend by task priority order. */
 #define Q_FIFO  0x0	/* Pend by FIFO order. */
+#define Q_SPSC  0x2	/* Lockless ring, single producer/consumer. */
+#define Q_MPSC  0x4	/* Lockless ring, multiple producers. */
 
 #define Q_UNLIMITED 0	/* No size limit. */
 
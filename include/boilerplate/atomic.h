@@ -62,6 +62,16 @@ static inline void atomic_set(atomic_t *ptr, long v)
 	__sync_add_and_fetch(&(__ptr)->v, __n)
 #endif
 
+#ifndef atomic_long_sub_fetch
+#define atomic_long_sub_fetch(__ptr, __n)	\
+	__sync_sub_and_fetch(&(__ptr)->v, __n)
+#endif
+
+#ifndef atomic_long_add_fetch
+#define atomic_long_add_fetch(__ptr, __n)	\
+	__sync_add_and_fetch(&(__ptr)->v, __n)
+#endif
+
 #ifdef CONFIG_SMP
 #ifndef smp_mb
 #define smp_mb()	__sync_synchronize()
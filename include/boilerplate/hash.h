@@ -20,16 +20,29 @@
 #define _BOILERPLATE_HASH_H
 
 #include <pthread.h>
+#include <boilerplate/atomic.h>
 #include <boilerplate/list.h>
 
 #define HASHSLOTS  (1<<8)
 
+/*
+ * Buckets are guarded by HASH_STRIPES locks, bucket n depending on
+ * stripe n % HASH_STRIPES. Since the bucket count is always a
+ * multiple of HASH_STRIPES, splitting a bucket when the table grows
+ * leaves both halves under the same stripe.
+ */
+#define HASH_STRIPES  (1<<4)
+
+/* Lockless readers a stripe may host at once. */
+#define HASH_STRIPE_READERS  4
+
 struct hashobj {
 	dref_type(const void *) key;
 #ifdef CONFIG_XENO_PSHARED
 	char static_key[16];
 #endif
 	size_t len;
+	unsigned int hash;
 	struct holder link;
 };
 
@@ -37,9 +50,37 @@ struct hash_bucket {
 	struct listobj obj_list;
 };
 
+struct hash_reader {
+	/* Process id. of the reader, zero if the slot is free. */
+	atomic_t id;
+	/* Bumped by the reader when leaving the slot. */
+	volatile unsigned int gen;
+};
+
+struct hash_stripe {
+	pthread_mutex_t lock;
+	/* Odd while the stripe is being updated. */
+	volatile unsigned int seq;
+	/*
+	 * Lockless readers currently scanning the stripe. Each slot
+	 * is tagged with the process id. of its reader, so that the
+	 * slots left over by dead processes can be reclaimed.
+	 */
+	struct hash_reader readers[HASH_STRIPE_READERS];
+	unsigned int count;
+};
+
 struct hash_table {
-	struct hash_bucket table[HASHSLOTS];
+	dref_type(struct hash_bucket *) buckets;
+	unsigned int nr_buckets;
+	/* Buckets being migrated to the new array while growing. */
+	dref_type(struct hash_bucket *) old_buckets;
+	unsigned int old_nr_buckets;
+	unsigned int migrate_pos;
+	struct hash_stripe stripes[HASH_STRIPES];
+	/* Serializes resizing, and walks. */
 	pthread_mutex_t lock;
+	struct hash_bucket table[HASHSLOTS];
 };
 
 struct hash_operations {
@@ -48,9 +89,10 @@ struct hash_operations {
 		       size_t len);
 #ifdef CONFIG_XENO_PSHARED
 	int (*probe)(struct hashobj *oldobj);
-	void *(*alloc)(size_t len);
-	void (*free)(void *key);
 #endif
+	/* Optional in private mode, malloc() is used by default. */
+	void *(*alloc)(size_t len);
+	void (*free)(void *ptr);
 };
 
 typedef int (*hash_walk_op)(struct hash_table *t,
@@ -20,6 +20,7 @@
 #define _COBALT_KERNEL_HEAP_H
 
 #include <linux/string.h>
+#include <linux/cache.h>
 #include <cobalt/kernel/lock.h>
 #include <cobalt/kernel/list.h>
 #include <cobalt/uapi/kernel/types.h>
@@ -31,26 +32,33 @@
  *
  * @par Implementation constraints
  *
- * - Minimum page size is 2 ** XNHEAP_MINLOG2 (must be large enough to
- * hold a pointer).
- *
- * - Maximum page size is 2 ** XNHEAP_MAXLOG2.
+ * - Minimum block size is 2 ** XNHEAP_MINLOG2 (must be large enough to
+ * hold a block index).
  *
  * - Requested block size is rounded up to XNHEAP_MINLOG2.
  *
- * - Requested block size larger than 2 times the XNHEAP_PAGESZ is
- * rounded up to the next page boundary and obtained from the free
- * page list. So we need a bucket for each power of two between
- * XNHEAP_MINLOG2 and XNHEAP_MAXLOG2 inclusive, plus one to honor
- * requests ranging from the maximum page size to twice this size.
+ * - Requested block size up to half the XNHEAP_PAGESZ is rounded up
+ * to the next power of two, and obtained from a page dedicated to
+ * blocks of this size. So we need a bucket for each power of two
+ * between XNHEAP_MINLOG2 and PAGE_SHIFT - 1 inclusive.
+ *
+ * - Larger block sizes are rounded up to the next page boundary and
+ * obtained from the free page ranges, indexed by a two-level
+ * segregated fit scheme: the first level splits range sizes (in
+ * pages) by power of two, the second level splits each power of two
+ * linearly into XNHEAP_SLCOUNT classes.
  */
 #define XNHEAP_PAGESZ	  PAGE_SIZE
 #define XNHEAP_MINLOG2    3
-#define XNHEAP_MAXLOG2    22	/* Holds pagemap.bcount blocks */
 #define XNHEAP_MINALLOCSZ (1 << XNHEAP_MINLOG2)
 #define XNHEAP_MINALIGNSZ (1 << 4) /* i.e. 16 bytes */
-#define XNHEAP_NBUCKETS   (XNHEAP_MAXLOG2 - XNHEAP_MINLOG2 + 2)
+#define XNHEAP_NBUCKETS   (PAGE_SHIFT - XNHEAP_MINLOG2)
 #define XNHEAP_MAXHEAPSZ  (1 << 31) /* i.e. 2Gb */
+#define XNHEAP_SLLOG2	  3
+#define XNHEAP_SLCOUNT	  (1 << XNHEAP_SLLOG2)
+#define XNHEAP_FLCOUNT	  (32 - PAGE_SHIFT - XNHEAP_SLLOG2 + 1)
+#define XNHEAP_NOPAGE	  (~0U)
+#define XNHEAP_NOBLOCK	  0xffff
 
 #define XNHEAP_PFREE   0
 #define XNHEAP_PCONT   1
@@ -59,8 +67,15 @@
 struct xnpagemap {
 	/** PFREE, PCONT, PLIST or log2 */
 	u32 type : 8;
-	/** Number of active blocks */
+	/** Number of active blocks, or range size in pages */
 	u32 bcount : 24;
+	/** Links in the free range or bucket page list */
+	u32 prev;
+	u32 next;
+	/** First free block in page */
+	u16 bfree;
+	/** First block never allocated from page */
+	u16 bnext;
 };
 
 struct xnheap {
@@ -70,17 +85,25 @@ struct xnheap {
 	caddr_t membase;
 	/** Memory limit of page array */
 	caddr_t memlim;
-	/** Number of pages in the freelist */
+	/** Number of pages in the page array */
 	int npages;
-	/** Head of the free page list */
-	caddr_t freelist;
 	/** Address of the page map */
 	struct xnpagemap *pagemap;
 	/** Link to heapq */
 	struct list_head next;
+	/** Bitmap of non-empty first level range lists */
+	u32 flbitmap;
+	/** Bitmaps of non-empty second level range lists */
+	u32 slbitmap[XNHEAP_FLCOUNT];
+	/** Heads of free page range lists */
+	u32 freeq[XNHEAP_FLCOUNT][XNHEAP_SLCOUNT];
+	/** Number of free page ranges */
+	int nranges;
 	/** log2 bucket list */
 	struct xnbucket {
-		caddr_t freelist;
+		/** Pages with free blocks */
+		u32 pagelist;
+		/** Free blocks in those pages */
 		int fcount;
 	} buckets[XNHEAP_NBUCKETS];
 	char name[XNOBJECT_NAME_LEN];
@@ -143,6 +166,66 @@ void xnheap_free(struct xnheap *heap, void *block);
 
 int xnheap_check_block(struct xnheap *heap, void *block);
 
+/*
+ * Object caches keep freed objects of a given size in per-CPU
+ * magazines, so that most allocations and releases of frequently
+ * created objects do not hit the heap lock. Magazines are exchanged
+ * with a depot when a CPU runs out of objects or room, and may all be
+ * returned to the heap on demand when memory runs short.
+ */
+#define XNOBJCACHE_MAGSZ   15
+#define XNOBJCACHE_DEPOTSZ 8
+
+struct xnobjmag {
+	struct list_head next;
+	int nr;
+	void *objs[XNOBJCACHE_MAGSZ];
+};
+
+struct xnobjcache_cpu {
+	/** Magazine lock, only contended by xnobjcache_reclaim() */
+	DECLARE_XNLOCK(lock);
+	/** Magazine allocations are served from */
+	struct xnobjmag *loaded;
+	/** Full or empty magazine, swapped with loaded */
+	struct xnobjmag *prev;
+	unsigned long hits;
+	unsigned long misses;
+} ____cacheline_aligned_in_smp;
+
+struct xnobjcache {
+	/** Backing heap */
+	struct xnheap *heap;
+	/** Object size */
+	u32 objsize;
+	/** Per-CPU magazines, indexed by CPU number */
+	struct xnobjcache_cpu *cpus;
+	/** Depot lock */
+	DECLARE_XNLOCK(lock);
+	/** Full magazines in depot */
+	struct list_head full;
+	/** Empty magazines in depot */
+	struct list_head empty;
+	/** Number of full magazines in depot */
+	int nfull;
+	/** Link to cacheq */
+	struct list_head next;
+	char name[XNOBJECT_NAME_LEN];
+};
+
+int xnobjcache_init(struct xnobjcache *cache, struct xnheap *heap,
+		    u32 objsize, const char *name);
+
+void xnobjcache_destroy(struct xnobjcache *cache);
+
+void *xnobjcache_alloc(struct xnobjcache *cache);
+
+void xnobjcache_free(struct xnobjcache *cache, void *obj);
+
+unsigned long xnobjcache_reclaim(struct xnobjcache *cache);
+
+unsigned long xnobjcache_cached(struct xnobjcache *cache);
+
 static inline char *xnstrdup(const char *s)
 {
 	char *p;
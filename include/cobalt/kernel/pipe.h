@@ -51,6 +51,7 @@ struct xnpipe_mh {
 };
 
 struct xnpipe_state;
+struct vm_area_struct;
 
 struct xnpipe_operations {
 	void (*output)(struct xnpipe_mh *mh, void *xstate);
@@ -59,6 +60,14 @@ struct xnpipe_operations {
 	void (*free_ibuf)(void *buf, void *xstate);
 	void (*free_obuf)(void *buf, void *xstate);
 	void (*release)(void *xstate);
+	/*
+	 * Optional: when present, the output side of the pipe is a
+	 * ring the caller shares with the reader, which maps it
+	 * through the pipe device. read() on the device then returns
+	 * the count of notifications sent by xnpipe_notify() as an
+	 * eventfd does, instead of messages.
+	 */
+	int (*mmap)(struct vm_area_struct *vma, void *xstate);
 };
 
 struct xnpipe_state {
@@ -80,6 +89,7 @@ struct xnpipe_state {
 	wait_queue_head_t syncq;	/* sync waiters */
 	int wcount;			/* number of waiters on this minor */
 	size_t ionrd;
+	unsigned long evcount;		/* pending notifications (mmap mode) */
 };
 
 extern struct xnpipe_state xnpipe_states[];
@@ -111,6 +121,8 @@ ssize_t xnpipe_recv(int minor,
 
 int xnpipe_flush(int minor, int mode);
 
+int xnpipe_notify(int minor);
+
 int xnpipe_pollstate(int minor, unsigned int *mask_r);
 
 static inline unsigned int __xnpipe_pollstate(int minor)
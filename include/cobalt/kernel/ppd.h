@@ -24,6 +24,8 @@
 #include <linux/rbtree.h>
 #include <cobalt/kernel/heap.h>
 
+struct rtdm_fd;
+
 struct cobalt_umm {
 	struct xnheap heap;
 	atomic_t refcount;
@@ -36,6 +38,7 @@ struct cobalt_ppd {
 	atomic_t refcnt;
 	char *exe_path;
 	struct rb_root fds;
+	struct rtdm_fd *fdmap[CONFIG_XENO_OPT_RTDM_FDMAP];
 };
 
 extern struct cobalt_ppd cobalt_kernel_ppd;
@@ -22,6 +22,7 @@
 
 #include <linux/types.h>
 #include <linux/socket.h>
+#include <linux/atomic.h>
 #include <linux/file.h>
 #include <cobalt/kernel/tree.h>
 #include <asm-generic/xenomai/syscall.h>
@@ -31,6 +32,16 @@ struct rtdm_fd;
 struct _rtdm_mmap_request;
 struct xnselector;
 struct cobalt_ppd;
+struct timespec;
+
+/*
+ * Kernel mirror of a user-space struct mmsghdr, as passed to
+ * recvmmsg() and sendmmsg().
+ */
+struct rtdm_mmsghdr {
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
 
 /**
  * @file
@@ -162,6 +173,67 @@ ssize_t rtdm_recvmsg_handler(struct rtdm_fd *fd, struct msghdr *msg, int flags);
  */
 ssize_t rtdm_sendmsg_handler(struct rtdm_fd *fd, const struct msghdr *msg, int flags);
 
+/**
+ * Batched receive message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] msgvec Array of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call
+ * @param[in] vlen Number of entries in @a msgvec
+ * @param[in] flags Message flags as passed by the user, MSG_WAITFORONE
+ * excluded
+ *
+ * The handler should wait for the first message according to @a
+ * flags, then receive as many of the pending messages as @a msgvec
+ * can hold without blocking, storing the byte count of each message
+ * into the @a msg_len field of the corresponding entry. RTDM calls
+ * the handler again if more messages should be waited for. This
+ * handler is optional: if none is provided, RTDM emulates it by
+ * iterating over the receive message handler.
+ *
+ * @return On success, the number of messages received. On failure
+ * return either -ENOSYS, to request that this handler be called
+ * again from the opposite realtime/non-realtime context,
+ * -EOPNOTSUPP, to request that RTDM emulates the batch for this
+ * file descriptor, or another negative error code. An error which
+ * occurs after at least one message was received should end the
+ * batch instead of being returned.
+ *
+ * @see @c recvmmsg() in the Linux manual pages.
+ */
+int rtdm_recvmmsg_handler(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			  unsigned int vlen, int flags);
+
+/**
+ * Batched transmit message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] msgvec Array of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call
+ * @param[in] vlen Number of entries in @a msgvec
+ * @param[in] flags Message flags as passed by the user
+ *
+ * The handler should send the messages from @a msgvec in order,
+ * storing the byte count of each message into the @a msg_len field
+ * of the corresponding entry. This handler is optional: if none is
+ * provided, RTDM emulates it by iterating over the transmit message
+ * handler.
+ *
+ * @return On success, the number of messages transmitted. On failure
+ * return either -ENOSYS, to request that this handler be called
+ * again from the opposite realtime/non-realtime context,
+ * -EOPNOTSUPP, to request that RTDM emulates the batch for this
+ * file descriptor, or another negative error code. An error which
+ * occurs after at least one message was sent should end the batch
+ * instead of being returned.
+ *
+ * @see @c sendmmsg() in the Linux manual pages.
+ */
+int rtdm_sendmmsg_handler(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			  unsigned int vlen, int flags);
+
 /**
  * Select handler
  *
@@ -277,6 +349,22 @@ struct rtdm_fd_ops {
 	/** See rtdm_sendmsg_handler(). */
 	ssize_t (*sendmsg_nrt)(struct rtdm_fd *fd,
 			       const struct msghdr *msg, int flags);
+	/** See rtdm_recvmmsg_handler(). */
+	int (*recvmmsg_rt)(struct rtdm_fd *fd,
+			   struct rtdm_mmsghdr *msgvec,
+			   unsigned int vlen, int flags);
+	/** See rtdm_recvmmsg_handler(). */
+	int (*recvmmsg_nrt)(struct rtdm_fd *fd,
+			    struct rtdm_mmsghdr *msgvec,
+			    unsigned int vlen, int flags);
+	/** See rtdm_sendmmsg_handler(). */
+	int (*sendmmsg_rt)(struct rtdm_fd *fd,
+			   struct rtdm_mmsghdr *msgvec,
+			   unsigned int vlen, int flags);
+	/** See rtdm_sendmmsg_handler(). */
+	int (*sendmmsg_nrt)(struct rtdm_fd *fd,
+			    struct rtdm_mmsghdr *msgvec,
+			    unsigned int vlen, int flags);
 	/** See rtdm_select_handler(). */
 	int (*select)(struct rtdm_fd *fd,
 		      struct xnselector *selector,
@@ -297,7 +385,7 @@ struct rtdm_fd {
 	unsigned int magic;
 	struct rtdm_fd_ops *ops;
 	struct cobalt_ppd *owner;
-	unsigned int refs;
+	atomic_t refs;
 	int minor;
 	int oflags;
 #ifdef CONFIG_XENO_ARCH_SYS3264
@@ -368,6 +456,19 @@ ssize_t rtdm_fd_recvmsg(int ufd, struct msghdr *msg, int flags);
 ssize_t rtdm_fd_sendmsg(int ufd, const struct msghdr *msg,
 			int flags);
 
+int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags, void __user *u_timeout,
+		       int (*get_mmsg)(struct rtdm_mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*put_mmsg)(void __user *u_mmsg, const struct rtdm_mmsghdr *mmsg),
+		       size_t mmsgsz,
+		       int (*get_timespec)(struct timespec *ts, const void __user *u_ts));
+
+int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags,
+		       int (*get_mmsg)(struct rtdm_mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*put_mmsg)(void __user *u_mmsg, const struct rtdm_mmsghdr *mmsg),
+		       size_t mmsgsz);
+
 int rtdm_fd_mmap(int ufd, struct _rtdm_mmap_request *rma,
 		 void * __user *u_addrp);
 
@@ -35,6 +35,15 @@ struct compat_rttst_overall_bench_res {
 #define RTTST_RTIOC_TMBENCH_STOP_COMPAT \
 	_IOWR(RTIOC_TYPE_TESTING, 0x11, struct compat_rttst_overall_bench_res)
 
+struct compat_rttst_hdr_bench_res {
+	compat_uptr_t hdr_avg;
+	compat_uptr_t hdr_min;
+	compat_uptr_t hdr_max;
+};
+
+#define RTTST_RTIOC_TMBENCH_HDR_RES_COMPAT \
+	_IOW(RTIOC_TYPE_TESTING, 0x12, struct compat_rttst_hdr_bench_res)
+
 #endif	/* CONFIG_XENO_ARCH_SYS3264 */
 
 #endif /* !_COBALT_RTDM_TESTING_H */
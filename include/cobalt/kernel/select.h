@@ -40,6 +40,8 @@ struct xnselector {
 	} fds [XNSELECT_MAX_TYPES];
 	struct list_head destroy_link;
 	struct list_head bindings; /* only used by xnselector_destroy */
+	struct list_head ready;	/* ready bindings, in queued mode. */
+	int queued;
 };
 
 #define __NFDBITS__	(8 * sizeof(unsigned long))
@@ -94,6 +96,13 @@ struct xnselect_binding {
 	unsigned int bit_index;
 	struct list_head link;  /* link in selected fds list. */
 	struct list_head slink; /* link in selector list */
+	struct list_head rlink; /* link in selector ready list */
+};
+
+struct xnselect_event {
+	unsigned int bit_index;
+	unsigned int type;
+	int hangup;
 };
 
 void xnselect_init(struct xnselect *select_block);
@@ -130,12 +139,20 @@ void xnselect_destroy(struct xnselect *select_block);
 
 int xnselector_init(struct xnselector *selector);
 
+int xnselector_init_queued(struct xnselector *selector);
+
+void xnselector_unbind(struct xnselector *selector, unsigned int index);
+
 int xnselect(struct xnselector *selector,
 	     fd_set *out_fds[XNSELECT_MAX_TYPES],
 	     fd_set *in_fds[XNSELECT_MAX_TYPES],
 	     int nfds,
 	     xnticks_t timeout, xntmode_t timeout_mode);
 
+int xnselect_collect(struct xnselector *selector,
+		     struct xnselect_event *events, int maxevents,
+		     xnticks_t timeout, xntmode_t timeout_mode);
+
 void xnselector_destroy(struct xnselector *selector);
 
 int xnselect_mount(void);
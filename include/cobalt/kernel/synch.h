@@ -47,6 +47,7 @@
 
 struct xnthread;
 struct xnsynch;
+struct xnsynch_stat;
 
 struct xnsynch {
 	struct list_head link;	/** thread->claimq */
@@ -56,6 +57,9 @@ struct xnsynch {
 	struct xnthread *owner;	/** Thread which owns the resource */
 	atomic_t *fastlock; /** Pointer to fast lock word */
 	void (*cleanup)(struct xnsynch *synch); /* Cleanup handler */
+#ifdef CONFIG_XENO_OPT_STATS_SYNCH
+	struct xnsynch_stat *stat; /** Contention statistics */
+#endif
 };
 
 #define XNSYNCH_WAITQUEUE_INITIALIZER(__name) {		\
@@ -168,6 +172,14 @@ void xnsynch_requeue_sleeper(struct xnthread *thread);
 
 void xnsynch_forget_sleeper(struct xnthread *thread);
 
+#ifdef CONFIG_XENO_OPT_STATS_SYNCH
+void xnsynch_init_proc(void);
+void xnsynch_cleanup_proc(void);
+#else /* !CONFIG_XENO_OPT_STATS_SYNCH */
+static inline void xnsynch_init_proc(void) { }
+static inline void xnsynch_cleanup_proc(void) { }
+#endif /* !CONFIG_XENO_OPT_STATS_SYNCH */
+
 /** @} */
 
 #endif /* !_COBALT_KERNEL_SYNCH_H_ */
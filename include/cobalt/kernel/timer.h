@@ -52,9 +52,11 @@ typedef enum xntmode {
 #define XNTIMER_KGRAVITY  0x00000080
 #define XNTIMER_UGRAVITY  0x00000100
 #define XNTIMER_IGRAVITY  0	/* most conservative */
+#define XNTIMER_COARSE    0x00000200
+#define XNTIMER_WHEELED   0x00000400
 
 #define XNTIMER_GRAVITY_MASK	(XNTIMER_KGRAVITY|XNTIMER_UGRAVITY)
-#define XNTIMER_INIT_MASK	(XNTIMER_GRAVITY_MASK|XNTIMER_NOBLCK)
+#define XNTIMER_INIT_MASK	(XNTIMER_GRAVITY_MASK|XNTIMER_NOBLCK|XNTIMER_COARSE)
 
 /* These flags are available to the real-time interfaces */
 #define XNTIMER_SPARE0  0x01000000
@@ -170,6 +172,68 @@ typedef struct {} xntimerq_it_t;
 #define xntimerq_it_begin(q, i)   ((void) (i), bheap_gethead(q))
 #define xntimerq_it_next(q, i, h) ((void) (i), bheap_next((q),(h)))
 
+#elif defined(CONFIG_XENO_OPT_TIMER_RBTREE)
+
+#include <linux/rbtree.h>
+
+typedef struct {
+	unsigned long long date;
+	int prio;
+	struct rb_node link;
+} xntimerh_t;
+
+#define xntimerh_date(h)	((h)->date)
+#define xntimerh_prio(h)	((h)->prio)
+#define xntimerh_init(h)	do { } while (0)
+
+/*
+ * The leftmost node is cached, so that peeking at the outstanding
+ * timer with the earliest date is O(1), while insertion and removal
+ * remain O(log n), regardless of the number of armed timers.
+ */
+typedef struct {
+	struct rb_root root;
+	xntimerh_t *head;
+} xntimerq_t;
+
+#define xntimerq_init(q)						\
+	({								\
+		xntimerq_t *_q = (q);					\
+		_q->root = RB_ROOT;					\
+		_q->head = NULL;					\
+	})
+
+#define xntimerq_destroy(q)	do { } while (0)
+#define xntimerq_empty(q)	((q)->head == NULL)
+#define xntimerq_head(q)	((q)->head)
+
+#define xntimerq_next(q, h)						\
+	({								\
+		struct rb_node *_node = rb_next(&(h)->link);		\
+		_node ? (container_of(_node, xntimerh_t, link)) : NULL;	\
+	})
+
+#define xntimerq_second(q)						\
+	({								\
+		xntimerq_t *_q = (q);					\
+		_q->head ? xntimerq_next(_q, _q->head) : NULL;		\
+	})
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder);
+
+static inline void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder)
+{
+	if (holder == q->head)
+		q->head = xntimerq_next(q, holder);
+
+	rb_erase(&holder->link, &q->root);
+}
+
+typedef struct { } xntimerq_it_t;
+
+#define xntimerq_it_begin(q,i)	((void) (i), xntimerq_head(q))
+#define xntimerq_it_next(q,i,h) ((void) (i), xntimerq_next((q),(h)))
+
 #else /* CONFIG_XENO_OPT_TIMER_LIST */
 
 typedef struct xntlholder xntimerh_t;
@@ -197,22 +261,6 @@ typedef struct { } xntimerq_it_t;
 
 struct xnsched;
 
-struct xntimerdata {
-	xntimerq_t q;
-};
-
-static inline struct xntimerdata *
-xnclock_percpu_timerdata(struct xnclock *clock, int cpu)
-{
-	return per_cpu_ptr(clock->timerdata, cpu);
-}
-
-static inline struct xntimerdata *
-xnclock_this_timerdata(struct xnclock *clock)
-{
-	return raw_cpu_ptr(clock->timerdata);
-}
-
 struct xntimer {
 #ifdef CONFIG_XENO_OPT_EXTCLOCK
 	struct xnclock *clock;
@@ -236,6 +284,12 @@ struct xntimer {
 	struct xnsched *sched;
 	/** Timeout handler. */
 	void (*handler)(struct xntimer *timer);
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+	/** Link in timer wheel slot (coarse timers). */
+	struct list_head wlink;
+	/** Timer wheel slot number. */
+	int wslot;
+#endif
 #ifdef CONFIG_XENO_OPT_STATS
 #ifdef CONFIG_XENO_OPT_EXTCLOCK
 	struct xnclock *tracker;
@@ -251,6 +305,61 @@ struct xntimer {
 #endif /* CONFIG_XENO_OPT_STATS */
 };
 
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+
+/*
+ * Per-CPU hierarchical timer wheel for coarse timers. The first
+ * level spans XNTWHEEL_L0_SIZE wheel ticks, every other level spans
+ * XNTWHEEL_LN_SIZE times the range of the level below it.
+ */
+#define XNTWHEEL_L0_BITS	8
+#define XNTWHEEL_LN_BITS	6
+#define XNTWHEEL_LEVELS		4
+#define XNTWHEEL_L0_SIZE	(1 << XNTWHEEL_L0_BITS)
+#define XNTWHEEL_LN_SIZE	(1 << XNTWHEEL_LN_BITS)
+#define XNTWHEEL_L0_MASK	(XNTWHEEL_L0_SIZE - 1)
+#define XNTWHEEL_LN_MASK	(XNTWHEEL_LN_SIZE - 1)
+#define XNTWHEEL_SLOTS		\
+	(XNTWHEEL_L0_SIZE + (XNTWHEEL_LEVELS - 1) * XNTWHEEL_LN_SIZE)
+
+struct xntwheel {
+	/** Timer lists, level 0 first. */
+	struct list_head slots[XNTWHEEL_SLOTS];
+	/** Non-empty slots. */
+	DECLARE_BITMAP(pending, XNTWHEEL_SLOTS);
+	/** Next wheel tick to process. */
+	xnticks_t clk;
+	/** Wheel tick the drain timer is armed for. */
+	xnticks_t next;
+	/** log2 of the wheel tick, in clock ticks. */
+	int shift;
+	/** Count of timers in the wheel. */
+	int nr_timers;
+	/** Drain timer, queued to the precise timer queue. */
+	struct xntimer timer;
+};
+
+#endif /* CONFIG_XENO_OPT_TIMER_WHEEL */
+
+struct xntimerdata {
+	xntimerq_t q;
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+	struct xntwheel wheel;
+#endif
+};
+
+static inline struct xntimerdata *
+xnclock_percpu_timerdata(struct xnclock *clock, int cpu)
+{
+	return per_cpu_ptr(clock->timerdata, cpu);
+}
+
+static inline struct xntimerdata *
+xnclock_this_timerdata(struct xnclock *clock)
+{
+	return raw_cpu_ptr(clock->timerdata);
+}
+
 #ifdef CONFIG_XENO_OPT_EXTCLOCK
 
 static inline struct xnclock *xntimer_clock(struct xntimer *timer)
@@ -471,10 +580,57 @@ static inline xnticks_t xntimer_get_timeout_stopped(struct xntimer *timer)
 	return xntimer_get_timeout(timer);
 }
 
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+
+static inline int xntimer_coarse_p(struct xntimer *timer)
+{
+	return (timer->status & XNTIMER_COARSE) != 0;
+}
+
+static inline int xntimer_wheeled_p(struct xntimer *timer)
+{
+	return (timer->status & XNTIMER_WHEELED) != 0;
+}
+
+void xntwheel_init(struct xntwheel *wheel, struct xnclock *clock, int cpu);
+
+void xntwheel_destroy(struct xntwheel *wheel);
+
+int xntwheel_enqueue(struct xntimer *timer, xntimerq_t *q);
+
+void xntwheel_dequeue(struct xntimer *timer, xntimerq_t *q);
+
+#else /* !CONFIG_XENO_OPT_TIMER_WHEEL */
+
+static inline int xntimer_coarse_p(struct xntimer *timer)
+{
+	return 0;
+}
+
+static inline int xntimer_wheeled_p(struct xntimer *timer)
+{
+	return 0;
+}
+
+static inline int xntwheel_enqueue(struct xntimer *timer, xntimerq_t *q)
+{
+	return 0;
+}
+
+static inline void xntwheel_dequeue(struct xntimer *timer, xntimerq_t *q) { }
+
+#endif /* !CONFIG_XENO_OPT_TIMER_WHEEL */
+
 static inline void xntimer_enqueue(struct xntimer *timer,
 				   xntimerq_t *q)
 {
-	xntimerq_insert(q, &timer->aplink);
+	/*
+	 * Coarse timers wait in the timer wheel until their expiry
+	 * date is close enough, only then are they moved to the
+	 * precise queue.
+	 */
+	if (!xntimer_coarse_p(timer) || !xntwheel_enqueue(timer, q))
+		xntimerq_insert(q, &timer->aplink);
 	timer->status &= ~XNTIMER_DEQUEUED;
 	xntimer_account_scheduled(timer);
 }
@@ -482,7 +638,10 @@ static inline void xntimer_enqueue(struct xntimer *timer,
 static inline void xntimer_dequeue(struct xntimer *timer,
 				   xntimerq_t *q)
 {
-	xntimerq_remove(q, &timer->aplink);
+	if (xntimer_wheeled_p(timer))
+		xntwheel_dequeue(timer, q);
+	else
+		xntimerq_remove(q, &timer->aplink);
 	timer->status |= XNTIMER_DEQUEUED;
 }
 
@@ -110,6 +110,8 @@ int rt_print_init(size_t buffer_size, const char *name);
 
 const char *rt_print_buffer_name(void);
 
+int rt_print_buffer_stats(unsigned long *overflows, unsigned long *drops);
+
 void rt_print_flush_buffers(void);
 
 void assert_nrt(void);
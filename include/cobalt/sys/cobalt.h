@@ -41,6 +41,8 @@
 
 #define cobalt_commit_memory(p) __cobalt_commit_memory(p, sizeof(*p))
 
+struct epoll_event;
+
 struct cobalt_tsd_hook {
 	void (*create_tsd)(void);
 	void (*delete_tsd)(void);
@@ -127,6 +129,14 @@ int cobalt_event_destroy(cobalt_event_t *event);
 int cobalt_sem_inquire(sem_t *sem, struct cobalt_sem_info *info,
 		       pid_t *waitlist, size_t waitsz);
 
+int cobalt_epoll_create(int flags);
+
+int cobalt_epoll_ctl(int epfd, int op, int fd,
+		     struct epoll_event *event);
+
+int cobalt_epoll_wait(int epfd, struct epoll_event *events,
+		      int maxevents, const struct timespec *timeout);
+
 int cobalt_sched_weighted_prio(int policy,
 			       const struct sched_param_ex *param_ex);
 
@@ -33,6 +33,8 @@ extern int __cobalt_print_bufcount;
 
 extern int __cobalt_print_syncdelay;
 
+extern int __cobalt_print_binary;
+
 static inline define_config_tunable(main_prio, int, prio)
 {
 	__cobalt_main_prio = prio;
@@ -73,6 +75,16 @@ static inline read_config_tunable(print_sync_delay, int)
 	return __cobalt_print_syncdelay;
 }
 
+static inline define_config_tunable(print_binary, int, binary)
+{
+	__cobalt_print_binary = binary;
+}
+
+static inline read_config_tunable(print_binary, int)
+{
+	return __cobalt_print_binary;
+}
+
 #ifdef __cplusplus
 }
 #endif
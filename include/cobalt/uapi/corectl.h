@@ -46,6 +46,13 @@
 #define _CC_COBALT_START_CORE		7
 #define _CC_COBALT_STOP_CORE		8
 
+#define _CC_COBALT_GET_TIMER_INDEX	9
+#   define _CC_COBALT_TIMER_LIST	0
+#   define _CC_COBALT_TIMER_HEAP	1
+#   define _CC_COBALT_TIMER_RBTREE	2
+
+#define _CC_COBALT_GET_TIMER_CAPACITY	10
+
 enum cobalt_run_states {
 	COBALT_STATE_DISABLED,
 	COBALT_STATE_RUNNING,
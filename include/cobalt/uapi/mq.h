@@ -0,0 +1,149 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_MQ_H
+#define _COBALT_UAPI_MQ_H
+
+#include <cobalt/uapi/kernel/types.h>
+
+/*
+ * Message queues created by a Cobalt process may have their message
+ * pool laid out in the private heap (umm) of that process. In such
+ * a case, threads from the owner process may exchange messages at
+ * the default priority (0) without entering the kernel, unless they
+ * have to wait for room or data. The core only deals with messages
+ * sent at higher priorities, and with blocking and waking up
+ * threads.
+ *
+ * Free and queued messages are tracked by two bounded rings of
+ * message indices. Each cell carries a sequence number telling
+ * producers and consumers whether it is theirs to fill or drain, so
+ * that both sides may run concurrently without locking.
+ *
+ * A push may fail although the ring has room, as long as a popper
+ * from the previous lap did not release its cell. Since that popper
+ * may be a preempted lower priority thread, pushers must never spin
+ * waiting for the cell: user-space hands the slot over to the core
+ * with mq_wake(COBALT_MQ_SEND/COBALT_MQ_FREE) instead, and the core
+ * keeps it on its own lists.
+ */
+
+#define COBALT_MQ_RING_RETRIES	64
+
+/* mq_wake operations. */
+#define COBALT_MQ_WAKE	0	/* Kick waiters. */
+#define COBALT_MQ_SEND	1	/* Queue a message slot. */
+#define COBALT_MQ_FREE	2	/* Release a message slot. */
+
+struct cobalt_mq_cell {
+	atomic_t seq;
+	__u32 index;
+};
+
+struct cobalt_mq_ring {
+	atomic_t head;
+	atomic_t tail;
+	__u32 cells_offset;
+};
+
+struct cobalt_mq_msg {
+	__u32 len;
+	__u32 __pad;
+	char data[0];
+};
+
+struct cobalt_mq_state {
+	__u32 flags;
+#define COBALT_MQ_NOTIFY  0x1
+#define COBALT_MQ_SELECT  0x2
+#define COBALT_MQ_SPILL   0x4
+	__u32 mask;
+	__u32 maxmsg;
+	__u32 maxlen;
+	__u32 msgsize;
+	__u32 data_offset;
+	atomic_t nrqueued;
+	/* Messages held by the core, queued at non-zero priority. */
+	atomic_t nrprio;
+	atomic_t rcv_waiters;
+	atomic_t snd_waiters;
+	struct cobalt_mq_ring queued;
+	struct cobalt_mq_ring avail;
+};
+
+static inline int cobalt_mq_ring_push(struct cobalt_mq_ring *ring,
+				      struct cobalt_mq_cell *cells,
+				      __u32 mask, __u32 index)
+{
+	struct cobalt_mq_cell *cell;
+	__u32 pos, seq;
+	int n;
+
+	for (n = 0; n < COBALT_MQ_RING_RETRIES; n++) {
+		pos = atomic_read(&ring->tail);
+		cell = cells + (pos & mask);
+		seq = atomic_read(&cell->seq);
+		smp_rmb();
+		if ((int)(seq - pos) < 0)
+			return -EAGAIN;	/* Full. */
+		if (seq != pos ||
+		    atomic_cmpxchg(&ring->tail, pos, pos + 1) != pos)
+			continue;
+		cell->index = index;
+		smp_wmb();
+		atomic_set(&cell->seq, pos + 1);
+		return 0;
+	}
+
+	return -EBUSY;
+}
+
+static inline int cobalt_mq_ring_pop(struct cobalt_mq_ring *ring,
+				     struct cobalt_mq_cell *cells,
+				     __u32 mask, __u32 *indexp)
+{
+	struct cobalt_mq_cell *cell;
+	__u32 pos, seq;
+	int n;
+
+	for (n = 0; n < COBALT_MQ_RING_RETRIES; n++) {
+		pos = atomic_read(&ring->head);
+		cell = cells + (pos & mask);
+		seq = atomic_read(&cell->seq);
+		smp_rmb();
+		if ((int)(seq - (pos + 1)) < 0)
+			return -EAGAIN;	/* Empty. */
+		if (seq != pos + 1 ||
+		    atomic_cmpxchg(&ring->head, pos, pos + 1) != pos)
+			continue;
+		*indexp = cell->index;
+		smp_mb();
+		atomic_set(&cell->seq, pos + mask + 1);
+		return 0;
+	}
+
+	return -EBUSY;
+}
+
+static inline int cobalt_mq_ring_empty_p(struct cobalt_mq_ring *ring,
+					 struct cobalt_mq_cell *cells,
+					 __u32 mask)
+{
+	__u32 pos = atomic_read(&ring->head);
+
+	return atomic_read(&cells[pos & mask].seq) != pos + 1;
+}
+
+#endif /* !_COBALT_UAPI_MQ_H */
@@ -117,6 +117,13 @@
 #define sc_cobalt_backtrace			94
 #define sc_cobalt_serialdbg			95
 #define sc_cobalt_extend			96
+#define sc_cobalt_mq_bind			97
+#define sc_cobalt_mq_wake			98
+#define sc_cobalt_recvmmsg			99
+#define sc_cobalt_sendmmsg			100
+#define sc_cobalt_epoll_create			101
+#define sc_cobalt_epoll_ctl			102
+#define sc_cobalt_epoll_wait			103
 
 #define __NR_COBALT_SYSCALLS			128 /* Power of 2 */
 
@@ -63,6 +63,8 @@ int __heapobj_init_private(struct heapobj *hobj, const char *name,
 
 int heapobj_init_array_private(struct heapobj *hobj, const char *name,
 			       size_t size, int elems);
+
+int heapobj_bind_registry_private(void);
 #ifdef __cplusplus
 }
 #endif
@@ -76,6 +78,8 @@ void *malloc_ex(size_t size, void *pool);
 void free_ex(void *pool, void *ptr);
 void *tlsf_malloc(size_t size);
 void tlsf_free(void *ptr);
+int tlsf_malloc_batch(size_t size, void **blocks, int nr);
+void tlsf_free_batch(void **blocks, int nr);
 size_t malloc_usable_size_ex(void *ptr, void *pool);
 
 static inline
@@ -118,15 +122,17 @@ size_t pvheapobj_inquire(struct heapobj *hobj)
 	return get_used_size(hobj->pool);
 }
 
-static inline void *pvmalloc(size_t size)
-{
-	return tlsf_malloc(size);
-}
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-static inline void pvfree(void *ptr)
-{
-	tlsf_free(ptr);
+void *pvmalloc(size_t size);
+
+void pvfree(void *ptr);
+
+#ifdef __cplusplus
 }
+#endif
 
 static inline char *pvstrdup(const char *ptr)
 {
@@ -21,16 +21,19 @@
 
 #include <pthread.h>
 #include <time.h>
-#include <boilerplate/list.h>
 #include <boilerplate/lock.h>
 
+struct timersv;
+
 struct timerobj {
 	struct itimerspec itspec;
 	void (*handler)(struct timerobj *tmobj);
 	timer_t timer;
 	pthread_mutex_t lock;
 	int cancel_state;
-	struct pvholder next;
+	struct timersv *server;
+	int heapidx;
+	unsigned long seq;
 };
 
 static inline int timerobj_lock(struct timerobj *tmobj)
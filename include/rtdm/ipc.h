@@ -20,7 +20,267 @@
 #ifndef _RTDM_IPC_H
 #define _RTDM_IPC_H
 
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+#include <boilerplate/atomic.h>
 #include <rtdm/rtdm.h>
 #include <rtdm/uapi/ipc.h>
 
+/*
+ * Helpers for transferring data over a BUFP ring mapped in the
+ * caller's address space (see BUFP_MMAP). Transfers which would
+ * block on a full or empty ring are handed over to the kernel, via
+ * the regular send(2) and recv(2) calls.
+ */
+
+struct bufp_map {
+	int sockfd;
+	size_t mapsz;
+	struct bufp_ring *ring;
+	char *data;
+};
+
+static inline int bufp_map_ring(int sockfd, struct bufp_map *map)
+{
+	socklen_t optlen = sizeof(map->mapsz);
+	void *p;
+
+	if (getsockopt(sockfd, SOL_BUFP, BUFP_MMAP, &map->mapsz, &optlen))
+		return -1;
+
+	if (map->mapsz == 0) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	p = mmap(NULL, map->mapsz, PROT_READ|PROT_WRITE, MAP_SHARED,
+		 sockfd, 0);
+	if (p == MAP_FAILED)
+		return -1;
+
+	map->sockfd = sockfd;
+	map->ring = p;
+	map->data = (char *)p + map->ring->data_offset;
+
+	return 0;
+}
+
+static inline int bufp_unmap_ring(struct bufp_map *map)
+{
+	return munmap(map->ring, map->mapsz);
+}
+
+static inline ssize_t bufp_ring_write(struct bufp_map *map,
+				      const void *buf, size_t len, int flags)
+{
+	struct bufp_ring *ring = map->ring;
+	__u32 bufsz = ring->bufsz, span, fillsz, wrpos, wroff;
+	size_t wbytes, n;
+	const char *p;
+
+	if (len == 0)
+		return 0;
+
+	if (len > bufsz) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	span = bufp_ring_span(bufsz);
+redo:
+	/*
+	 * Readers may only free more room, so the check still holds
+	 * until we commit.
+	 */
+	wrpos = atomic_read(&ring->wrpos);
+	fillsz = bufp_ring_fill(atomic_read(&ring->rdpos), wrpos, span);
+	if (fillsz > bufsz || fillsz + len > bufsz)
+		/* Wait for room in the kernel, which validates the ring. */
+		return send(map->sockfd, buf, len, flags);
+
+	wroff = wrpos % bufsz;
+
+	for (p = buf, wbytes = len; wbytes > 0; p += n, wbytes -= n) {
+		n = wroff + wbytes > bufsz ? bufsz - wroff : wbytes;
+		memcpy(map->data + wroff, p, n);
+		/* Start over if another writer committed meanwhile. */
+		if (atomic_read(&ring->wrpos) != (int)wrpos)
+			goto redo;
+		wroff = (wroff + n) % bufsz;
+	}
+
+	/* Full barrier, publishes the data before the new position. */
+	if (atomic_cmpxchg(&ring->wrpos, wrpos,
+			   bufp_ring_advance(wrpos, len, span)) != (int)wrpos)
+		goto redo;
+
+	fillsz += len;
+	if (atomic_read(&ring->rdwaiters) > 0 ||
+	    ((fillsz == len || fillsz == bufsz) &&
+	     atomic_read(&ring->polled)))
+		ioctl(map->sockfd, BUFP_RTIOC_KICK);
+
+	return len;
+}
+
+static inline ssize_t bufp_ring_read(struct bufp_map *map,
+				     void *buf, size_t len, int flags)
+{
+	struct bufp_ring *ring = map->ring;
+	__u32 bufsz = ring->bufsz, span, fillsz, rdpos, rdoff;
+	size_t rbytes, n;
+	char *p;
+
+	if (len == 0)
+		return 0;
+
+	if (len > bufsz) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	span = bufp_ring_span(bufsz);
+redo:
+	/*
+	 * Writers may only add more data, so the check still holds
+	 * until we commit.
+	 */
+	rdpos = atomic_read(&ring->rdpos);
+	fillsz = bufp_ring_fill(rdpos, atomic_read(&ring->wrpos), span);
+	if (fillsz > bufsz || fillsz < len)
+		/* Wait for data in the kernel, which validates the ring. */
+		return recv(map->sockfd, buf, len, flags);
+
+	/* Pairs with the commit of the writer. */
+	smp_rmb();
+
+	rdoff = rdpos % bufsz;
+
+	for (p = buf, rbytes = len; rbytes > 0; p += n, rbytes -= n) {
+		n = rdoff + rbytes > bufsz ? bufsz - rdoff : rbytes;
+		memcpy(p, map->data + rdoff, n);
+		rdoff = (rdoff + n) % bufsz;
+	}
+
+	/*
+	 * Full barrier, completes the copy before the room is
+	 * released. Another reader which committed meanwhile may
+	 * have let writers overwrite what we copied, start over.
+	 */
+	if (atomic_cmpxchg(&ring->rdpos, rdpos,
+			   bufp_ring_advance(rdpos, len, span)) != (int)rdpos)
+		goto redo;
+
+	fillsz -= len;
+	if (atomic_read(&ring->wrwaiters) > 0 ||
+	    ((fillsz == 0 || fillsz + len == bufsz) &&
+	     atomic_read(&ring->polled)))
+		ioctl(map->sockfd, BUFP_RTIOC_KICK);
+
+	return len;
+}
+
+/*
+ * Helpers for consuming the datagrams posted to a XDDP ring in
+ * place, from the non real-time endpoint which maps the ring through
+ * /dev/rtpN (see XDDP_MMAP). The reader should drain the ring with
+ * xddp_ring_peek() and xddp_ring_release() until it is empty, before
+ * waiting for more with xddp_ring_wait().
+ */
+
+struct xddp_map {
+	int fd;
+	size_t mapsz;
+	struct xddp_ring *ring;
+	char *data;
+};
+
+static inline int xddp_map_ring(int fd, struct xddp_map *map)
+{
+	size_t pagesz = sysconf(_SC_PAGESIZE);
+	struct xddp_ring *ring;
+	void *p;
+
+	/* Fetch the ring geometry from the state page first. */
+	ring = mmap(NULL, pagesz, PROT_READ, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED)
+		return -1;
+
+	map->mapsz = ring->data_offset + ring->bufsz;
+	munmap(ring, pagesz);
+
+	p = mmap(NULL, map->mapsz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -1;
+
+	map->fd = fd;
+	map->ring = p;
+	map->data = (char *)p + map->ring->data_offset;
+
+	return 0;
+}
+
+static inline int xddp_unmap_ring(struct xddp_map *map)
+{
+	return munmap(map->ring, map->mapsz);
+}
+
+static inline void xddp_ring_release(struct xddp_map *map)
+{
+	struct xddp_ring *ring = map->ring;
+	struct xddp_ring_rec *rec;
+	__u32 size;
+
+	rec = (struct xddp_ring_rec *)(map->data + ring->rdoff);
+	size = rec->size;
+	ring->rdoff = (ring->rdoff + size) % ring->bufsz;
+	/* Give the room back once done with the record. */
+	atomic_sub_fetch(&ring->fillsz, size);
+}
+
+/*
+ * Return the payload of the next datagram in the ring, which stays
+ * valid until xddp_ring_release() is called, or NULL if the ring is
+ * empty.
+ */
+static inline void *xddp_ring_peek(struct xddp_map *map, size_t *lenp)
+{
+	struct xddp_ring *ring = map->ring;
+	struct xddp_ring_rec *rec;
+
+	for (;;) {
+		if (atomic_read(&ring->fillsz) == 0)
+			return NULL;
+
+		smp_rmb();
+		rec = (struct xddp_ring_rec *)(map->data + ring->rdoff);
+		if (rec->len != XDDP_RING_SKIP) {
+			*lenp = rec->len;
+			return rec + 1;
+		}
+
+		xddp_ring_release(map);
+	}
+}
+
+/*
+ * Wait for the ring to go from empty to non-empty. Returns the count
+ * of such transitions since the last call, or -1 with errno set.
+ */
+static inline ssize_t xddp_ring_wait(struct xddp_map *map)
+{
+	__u64 events;
+	ssize_t ret;
+
+	ret = read(map->fd, &events, sizeof(events));
+	if (ret == sizeof(events))
+		return (ssize_t)events;
+
+	if (ret >= 0)
+		errno = EPIPE;	/* Real-time endpoint went away. */
+
+	return -1;
+}
+
 #endif /* !_RTDM_IPC_H */
@@ -460,8 +460,88 @@ struct can_ifreq {
  */
 #define CAN_RAW_RECV_OWN_MSGS   0x4
 
+/**
+ * CAN receive ring
+ *
+ * Sets up an mmap'able receive ring for the socket. From then on,
+ * received frames are stored in the ring instead of the socket
+ * buffer, and recvmsg() fails with -EBUSY. The application maps the
+ * ring by calling mmap() on the socket, with offset 0 and a length
+ * of at most CAN_RING_SIZE(nr_frames). It then reads the frame slots
+ * from @a head up to @a tail, and advances @a head itself. select()
+ * reports the socket as readable while the ring is not empty. A ring
+ * can only be set up once per socket.
+ *
+ * @n
+ * @param [in] level @b SOL_CAN_RAW
+ *
+ * @param [in] optname @b CAN_RAW_RX_RING
+ *
+ * @param [in] optval Pointer to an integer holding the number of frame
+ * slots, a power of two between 2 and @ref CAN_RING_MAX_FRAMES.
+ *
+ * @param [in] optlen Size of int: sizeof(int).
+ *
+ * @coretags{secondary-only}
+ * @n
+ * Specific return values:
+ * - -EFAULT (It was not possible to access user space memory area at the
+ *            specified address.)
+ * - -EINVAL (Invalid length "optlen" or number of slots)
+ * - -EBUSY (A ring was already set up for this socket)
+ * - -ENOMEM (Not enough memory to fulfill the operation)
+ * .
+ */
+#define CAN_RAW_RX_RING		0x5
+
 /** @} */
 
+/**
+ * Header of a receive ring mapped from a CAN socket
+ *
+ * @see CAN_RAW_RX_RING
+ */
+struct can_ring_header {
+	/** Free-running index of the next slot to read, only updated
+	 *  by the application */
+	volatile uint32_t head;
+	/** Free-running index of the next slot to fill, only updated
+	 *  by the driver */
+	volatile uint32_t tail;
+	/** Number of frame slots */
+	uint32_t nr_frames;
+	/** Number of frames dropped because the ring was full */
+	volatile uint32_t dropped;
+};
+
+/**
+ * Frame slot of a receive ring
+ */
+struct can_ring_frame {
+	/** Received frame */
+	can_frame_t frame;
+	/** Interface index of the CAN controller the frame came from */
+	int can_ifindex;
+	int __pad;
+	/** Reception timestamp */
+	nanosecs_abs_t timestamp;
+};
+
+/** Maximum number of slots of a receive ring */
+#define CAN_RING_MAX_FRAMES	65536
+
+/** Offset of the first frame slot in a receive ring */
+#define CAN_RING_HDR_SIZE	64
+
+/** Size of a receive ring of @a nr frame slots */
+#define CAN_RING_SIZE(nr) \
+	(CAN_RING_HDR_SIZE + (nr) * sizeof(struct can_ring_frame))
+
+/** Address of the slot for free-running index @a idx in ring @a hdr */
+#define CAN_RING_FRAME(hdr, idx) \
+	((struct can_ring_frame *)((char *)(hdr) + CAN_RING_HDR_SIZE) + \
+	 ((idx) & ((hdr)->nr_frames - 1)))
+
 /*!
  * @anchor CANIOCTLs @name IOCTLs
  * CAN device IOCTLs
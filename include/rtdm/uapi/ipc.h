@@ -647,8 +647,89 @@ struct sockaddr_ipc {
  * RT/non-RT, kernel space only
  */
 #define XDDP_MONITOR		4
+/**
+ * XDDP mapped ring mode
+ *
+ * When a non-zero size is set before binding, the datagrams sent to
+ * the socket from the real-time domain are laid out in a ring, which
+ * the non real-time endpoint maps in its address space by calling @c
+ * mmap(2) on /dev/rtp@em N. The Linux reader then consumes the
+ * datagrams in place, instead of having the kernel copy them again
+ * via @c read(2) (see struct xddp_ring).
+ *
+ * Real-time senders copy each datagram once to the ring, as a
+ * record made of a struct xddp_ring_rec header followed by the
+ * payload. Datagrams which do not fit in the free space left in the
+ * ring are dropped, and the send call fails with -ENOMEM. MSG_MORE
+ * has no effect in this mode, and MSG_OOB is not supported.
+ *
+ * The non real-time endpoint is only notified when the ring goes
+ * from empty to non-empty. In this mode, @c read(2) on /dev/rtp@em N
+ * blocks until such notification is pending, then returns the count
+ * of pending notifications as an unsigned 64bit value, as an eventfd
+ * does, and @c poll(2) reports POLLIN accordingly. Once woken up, the
+ * reader should consume the ring until it is empty before waiting
+ * again.
+ *
+ * The ring size is rounded up to the next page boundary. Calling @c
+ * getsockopt(2) for this option returns the length of the area which
+ * may be mapped, or zero if the socket has no ring.
+ *
+ * @param [in] level @ref sockopts_xddp "SOL_XDDP"
+ * @param [in] optname @b XDDP_MMAP
+ * @param [in] optval Pointer to a variable of type size_t, containing
+ * the size of the ring to allocate at binding time (setsockopt), or
+ * receiving the length of the mappable area (getsockopt)
+ * @param [in] optlen sizeof(size_t)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen is invalid)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define XDDP_MMAP		5
 /** @} */
 
+/**
+ * Shared state of a XDDP ring, found at the start of the area mapped
+ * from /dev/rtp@em N. The real-time side is the only producer, the
+ * non real-time reader the only consumer.
+ */
+struct xddp_ring {
+	/** Size of the data area. */
+	__u32 bufsz;
+	/** Offset of the data area from the start of the mapping. */
+	__u32 data_offset;
+	/** Offset of the next record to read, owned by the reader. */
+	__u32 rdoff;
+	/** Offset past the last published record, owned by the kernel. */
+	__u32 wroff;
+	/** Count of bytes published for reading, headers included. */
+	atomic_t fillsz;
+	/** Count of datagrams dropped for lack of room. */
+	__u32 dropped;
+};
+
+/**
+ * Header of a record in a XDDP ring.
+ */
+struct xddp_ring_rec {
+	/** Space taken by the record, header and padding included. */
+	__u32 size;
+	/** Length of the payload, or XDDP_RING_SKIP. */
+	__u32 len;
+};
+
+/** Records are aligned on this boundary in the data area. */
+#define XDDP_RING_ALIGN		8
+/** Payload length of records which carry no datagram. */
+#define XDDP_RING_SKIP		((__u32)-1)
+
 /**
  * @anchor XDDP_EVENTS @name XDDP events
  * Specific events occurring on XDDP channels, which can be monitored
@@ -826,15 +907,124 @@ struct sockaddr_ipc {
  *
  * - -EFAULT (Invalid data address given)
  * - -EALREADY (socket already bound)
- * - -EINVAL (@a optlen is invalid or *@a optval is zero)
+ * - -EINVAL (@a optlen is invalid, or *@a optval is zero or larger
+ *   than 1 GiB)
  * .
  *
  * @par Calling context:
  * RT/non-RT
  */
 #define BUFP_BUFSZ		2
+/**
+ * BUFP mapped ring mode
+ *
+ * When enabled before binding, the buffer of a BUFP socket is laid
+ * out in a memory area which may be mapped into the address space of
+ * the readers and writers, along with the ring indices (see struct
+ * bufp_ring). Data can then be transferred by copying directly
+ * to/from the mapped ring, the kernel being involved only for
+ * blocking on a full or empty ring, timeouts and wakeups. The
+ * regular @c send(2) and @c recv(2) calls remain available on the
+ * same ring, and interoperate with the mapped accesses.
+ *
+ * A receiving socket maps its own ring by calling @c mmap(2) on its
+ * descriptor once bound. A sending socket which is not bound to a
+ * mapped ring maps the ring of the port it is connected to instead.
+ * The length of the area to be mapped can be retrieved by calling
+ * @c getsockopt(2) for this option, which returns zero if no mapped
+ * ring is available.
+ *
+ * The ring is meant to convey a byte stream from a single producer
+ * to a single consumer. Transfers on the same side of the ring,
+ * either mapped or through the kernel, are not serialized: each of
+ * them commits by advancing the read (resp. write) position with a
+ * compare-and-swap, and starts over if another transfer committed
+ * first on the same side. As with regular transfers, a writer which
+ * resumes after being preempted by another writer may still overwrite
+ * part of the data the latter committed, before it notices and starts
+ * over.
+ *
+ * @param [in] level @ref sockopts_bufp "SOL_BUFP"
+ * @param [in] optname @b BUFP_MMAP
+ * @param [in] optval Pointer to a variable of type int, non-zero to
+ * enable the mapped ring mode (setsockopt), or to a variable of type
+ * size_t receiving the length of the mappable area (getsockopt)
+ * @param [in] optlen sizeof(int) or sizeof(size_t)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen is invalid)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define BUFP_MMAP		3
 /** @} */
 
+/**
+ * Shared state of a BUFP ring, found at the start of a mapped
+ * area.
+ *
+ * The read and write positions combine the offset in the data area
+ * with a lap count, which serves as the preemption token of each
+ * side: a position runs from zero up to bufp_ring_span() excluded,
+ * the offset being the position modulo the size of the data area.
+ * Since positions count transferred bytes, the fill count is their
+ * distance.
+ */
+struct bufp_ring {
+	/** Size of the data area. */
+	__u32 bufsz;
+	/** Offset of the data area from the start of the mapping. */
+	__u32 data_offset;
+	/** Read position, advanced by readers. */
+	atomic_t rdpos;
+	/** Write position, advanced by writers. */
+	atomic_t wrpos;
+	/** Count of readers waiting in the kernel for data. */
+	atomic_t rdwaiters;
+	/** Count of writers waiting in the kernel for room. */
+	atomic_t wrwaiters;
+	/** Set by the kernel once the ring is monitored via select(). */
+	atomic_t polled;
+};
+
+static inline __u32 bufp_ring_span(__u32 bufsz)
+{
+	/* Two laps at least, so that a full ring is not an empty one. */
+	return (0x80000000U / bufsz) * bufsz;
+}
+
+static inline __u32 bufp_ring_advance(__u32 pos, __u32 len, __u32 span)
+{
+	pos += len;
+
+	return pos >= span ? pos - span : pos;
+}
+
+static inline __u32 bufp_ring_fill(__u32 rdpos, __u32 wrpos, __u32 span)
+{
+	return wrpos >= rdpos ? wrpos - rdpos : wrpos + span - rdpos;
+}
+
+#define RTIOC_TYPE_RTIPC		RTDM_CLASS_RTIPC
+
+/**
+ * Notify the kernel about a change of a mapped BUFP ring.
+ *
+ * Readers and writers updating a mapped ring directly must issue this
+ * request on their socket after committing a transfer, whenever
+ * threads from the other side are waiting in the kernel (see @a
+ * rdwaiters, @a wrwaiters),
+ * or the ring is monitored via select() and just entered or left the
+ * empty or full state. The kernel then wakes up the waiters which can
+ * be served, and updates the select() state of the ring.
+ */
+#define BUFP_RTIOC_KICK		_IO(RTIOC_TYPE_RTIPC, 0x00)
+
 /**
  * @anchor sockopts_socket @name Socket level options
  * Setting and getting supported standard socket level options.
@@ -25,7 +25,7 @@
 
 #include <linux/types.h>
 
-#define RTTST_PROFILE_VER		2
+#define RTTST_PROFILE_VER		3
 
 typedef struct rttst_bench_res {
 	__s32 avg;
@@ -59,8 +59,62 @@ typedef struct rttst_tmbench_config {
 	int histogram_size;
 	int histogram_bucketsize;
 	int freeze_max;
+	int histogram_hdr;
 } rttst_tmbench_config_t;
 
+/*
+ * Log-linear (HDR) latency histogram: values below
+ * RTTST_HDR_SUB_COUNT ns are counted exactly, then each power of
+ * two range is split into RTTST_HDR_SUB_COUNT / 2 buckets of equal
+ * width, which bounds the relative error to 1 / (RTTST_HDR_SUB_COUNT
+ * / 2) over the whole 32bit range in constant space. Negative
+ * samples are accounted as zero in the buckets.
+ */
+#define RTTST_HDR_SUB_BITS		7
+#define RTTST_HDR_SUB_COUNT		(1 << RTTST_HDR_SUB_BITS)
+#define RTTST_HDR_BUCKETS	\
+	((32 - RTTST_HDR_SUB_BITS + 1) * (RTTST_HDR_SUB_COUNT / 2))
+
+struct rttst_hdr_histogram {
+	__u64 samples;
+	__s64 sum;
+	__s32 min;
+	__s32 max;
+	__u64 counts[RTTST_HDR_BUCKETS];
+};
+
+struct rttst_hdr_bench_res {
+	struct rttst_hdr_histogram *hdr_avg;
+	struct rttst_hdr_histogram *hdr_min;
+	struct rttst_hdr_histogram *hdr_max;
+};
+
+static inline unsigned int rttst_hdr_index(__s32 value)
+{
+	unsigned int msb, v;
+
+	if (value < RTTST_HDR_SUB_COUNT)
+		return value < 0 ? 0 : value;
+
+	v = value;
+	msb = 31 - __builtin_clz(v);
+
+	return (msb - RTTST_HDR_SUB_BITS + 2) * (RTTST_HDR_SUB_COUNT / 2) +
+		((v >> (msb - RTTST_HDR_SUB_BITS + 1)) -
+		 (RTTST_HDR_SUB_COUNT / 2));
+}
+
+static inline void rttst_hdr_add(struct rttst_hdr_histogram *h, __s32 value)
+{
+	if (h->samples == 0 || value < h->min)
+		h->min = value;
+	if (h->samples == 0 || value > h->max)
+		h->max = value;
+	h->samples++;
+	h->sum += value;
+	h->counts[rttst_hdr_index(value)]++;
+}
+
 struct rttst_swtest_task {
 	unsigned int index;
 	unsigned int flags;
@@ -112,6 +166,9 @@ struct rttst_swtest_error {
 #define RTTST_RTIOC_TMBENCH_STOP \
 	_IOWR(RTIOC_TYPE_TESTING, 0x11, struct rttst_overall_bench_res)
 
+#define RTTST_RTIOC_TMBENCH_HDR_RES \
+	_IOW(RTIOC_TYPE_TESTING, 0x12, struct rttst_hdr_bench_res)
+
 #define RTTST_RTIOC_SWTEST_SET_TASKS_COUNT \
 	_IOW(RTIOC_TYPE_TESTING, 0x30, __u32)
 
@@ -74,6 +74,11 @@ __COBALT_CALL32emu_THUNK(recvmsg)
 __COBALT_CALL32x_THUNK(recvmsg)
 __COBALT_CALL32emu_THUNK(sendmsg)
 __COBALT_CALL32x_THUNK(sendmsg)
+__COBALT_CALL32emu_THUNK(recvmmsg)
+__COBALT_CALL32x_THUNK(recvmmsg)
+__COBALT_CALL32emu_THUNK(sendmmsg)
+__COBALT_CALL32x_THUNK(sendmmsg)
+__COBALT_CALL32emu_THUNK(epoll_wait)
 __COBALT_CALL32emu_THUNK(mmap)
 __COBALT_CALL32x_THUNK(mmap)
 __COBALT_CALL32emu_THUNK(backtrace)
@@ -483,6 +483,30 @@ void print_core_clock_status(struct xnclock *clock,
 		       xnclock_ticks_to_ns(&nkclock, nktimerlat));
 }
 
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+
+static void print_wheel_status(struct xnclock *clock,
+			       struct xnvfile_regular_iterator *it)
+{
+	struct xntimerdata *tmd;
+	int cpu, nr = 0;
+
+	/* Count of coarse timers parked in the wheels. */
+	for_each_online_cpu(cpu) {
+		tmd = xnclock_percpu_timerdata(clock, cpu);
+		nr += tmd->wheel.nr_timers;
+	}
+
+	xnvfile_printf(it, "%7s: %d\n", "wheel", nr);
+}
+
+#else
+
+static inline void print_wheel_status(struct xnclock *clock,
+				      struct xnvfile_regular_iterator *it) { }
+
+#endif /* !CONFIG_XENO_OPT_TIMER_WHEEL */
+
 static int clock_show(struct xnvfile_regular_iterator *it, void *data)
 {
 	struct xnclock *clock = xnvfile_priv(it->vfile);
@@ -497,6 +521,8 @@ static int clock_show(struct xnvfile_regular_iterator *it, void *data)
 
 	xnclock_print_status(clock, it);
 
+	print_wheel_status(clock, it);
+
 	xnvfile_printf(it, "%7s: %Lu\n", "ticks", xnclock_read_raw(clock));
 
 	return 0;
@@ -621,6 +647,14 @@ int xnclock_register(struct xnclock *clock)
 
 	init_clock_proc(clock);
 
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+	/* The drain timers are tracked like any other timer. */
+	for_each_online_cpu(cpu) {
+		tmd = xnclock_percpu_timerdata(clock, cpu);
+		xntwheel_init(&tmd->wheel, clock, cpu);
+	}
+#endif
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(xnclock_register);
@@ -646,14 +680,17 @@ void xnclock_deregister(struct xnclock *clock)
 
 	secondary_mode_only();
 
-	cleanup_clock_proc(clock);
-
 	for_each_online_cpu(cpu) {
 		tmd = xnclock_percpu_timerdata(clock, cpu);
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+		xntwheel_destroy(&tmd->wheel);
+#endif
 		XENO_BUG_ON(COBALT, !xntimerq_empty(&tmd->q));
 		xntimerq_destroy(&tmd->q);
 	}
 
+	cleanup_clock_proc(clock);
+
 	free_percpu(clock->timerdata);
 }
 EXPORT_SYMBOL_GPL(xnclock_deregister);
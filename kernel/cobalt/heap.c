@@ -29,12 +29,22 @@
  * @ingroup cobalt_core
  * @defgroup cobalt_core_heap Dynamic memory allocation services
  *
- * The implementation of the memory allocator follows the algorithm
- * described in a USENIX 1988 paper called "Design of a General
- * Purpose Memory Allocator for the 4.3BSD Unix Kernel" by Marshall
- * K. McKusick and Michael J. Karels. You can find it at various
- * locations on the net, including
- * http://docs.FreeBSD.org/44doc/papers/kernmalloc.pdf.
+ * The implementation of the memory allocator borrows from two
+ * designs. Small blocks are carved from pages dedicated to a
+ * power-of-two block size, as described in a USENIX 1988 paper
+ * called "Design of a General Purpose Memory Allocator for the
+ * 4.3BSD Unix Kernel" by Marshall K. McKusick and Michael
+ * J. Karels. Unlike the original scheme, each page keeps its own
+ * free block list, so that releasing a page to the free pool does
+ * not require scanning the bucket.
+ *
+ * Free pages are maintained as ranges of contiguous pages, indexed
+ * by a two-level segregated fit scheme after the TLSF allocator
+ * ("TLSF: a New Dynamic Memory Allocator for Real-Time Systems",
+ * M. Masmano, I. Ripoll, A. Crespo and J. Real, ECRTS 2004). Finding
+ * a suitable range and coalescing a released one with its neighbours
+ * are both performed in constant time, regardless of the heap size
+ * and fragmentation level.
  *@{
  */
 struct xnheap cobalt_heap;		/* System heap */
@@ -44,6 +54,10 @@ static LIST_HEAD(heapq);	/* Heap list for v-file dump */
 
 static int nrheaps;
 
+static LIST_HEAD(cacheq);	/* Object cache list for v-file dump */
+
+static int nrcaches;
+
 #ifdef CONFIG_XENO_OPT_VFILE
 
 static struct xnvfile_rev_tag vfile_tag;
@@ -52,11 +66,27 @@ static struct xnvfile_snapshot_ops vfile_ops;
 
 struct vfile_priv {
 	struct xnheap *curr;
+	struct xnobjcache *ccurr;
 };
 
 struct vfile_data {
-	size_t all_mem;
-	size_t free_mem;
+	int is_cache;
+	int first_cache;
+	union {
+		struct {
+			size_t all_mem;
+			size_t free_mem;
+			size_t largest;
+			size_t slack;
+			int nranges;
+		} heap;
+		struct {
+			u32 objsize;
+			int cached;
+			unsigned long hits;
+			unsigned long misses;
+		} cache;
+	};
 	char name[XNOBJECT_NAME_LEN];
 };
 
@@ -71,24 +101,81 @@ static int vfile_rewind(struct xnvfile_snapshot_iterator *it)
 {
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
 
-	if (list_empty(&heapq)) {
-		priv->curr = NULL;
-		return 0;
+	priv->curr = NULL;
+	if (!list_empty(&heapq))
+		priv->curr = list_first_entry(&heapq, struct xnheap, next);
+
+	priv->ccurr = NULL;
+	if (!list_empty(&cacheq))
+		priv->ccurr = list_first_entry(&cacheq,
+					       struct xnobjcache, next);
+
+	return nrheaps + nrcaches;
+}
+
+/*
+ * Fragmentation counters: the largest range of contiguous free
+ * pages, the free space held by partially used block pages, and the
+ * number of free page ranges. Only the top range class is scanned
+ * for the largest range.
+ */
+static void get_frag_stats(struct xnheap *heap, struct vfile_data *p)
+{
+	u32 pg, largest;
+	int fl, sl, n;
+	spl_t s;
+
+	p->heap.slack = 0;
+
+	xnlock_get_irqsave(&heap->lock, s);
+
+	largest = 0;
+	if (heap->flbitmap) {
+		fl = fls(heap->flbitmap) - 1;
+		sl = fls(heap->slbitmap[fl]) - 1;
+		for (pg = heap->freeq[fl][sl]; pg != XNHEAP_NOPAGE;
+		     pg = heap->pagemap[pg].next)
+			if (heap->pagemap[pg].bcount > largest)
+				largest = heap->pagemap[pg].bcount;
 	}
 
-	priv->curr = list_first_entry(&heapq, struct xnheap, next);
+	for (n = 0; n < XNHEAP_NBUCKETS; n++)
+		p->heap.slack += (size_t)heap->buckets[n].fcount <<
+			(n + XNHEAP_MINLOG2);
+
+	p->heap.nranges = heap->nranges;
 
-	return nrheaps;
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	p->heap.largest = (size_t)largest * XNHEAP_PAGESZ;
+}
+
+static void get_cache_stats(struct xnobjcache *cache, struct vfile_data *p)
+{
+	struct xnobjcache_cpu *pc;
+	int cpu;
+
+	p->cache.objsize = cache->objsize;
+	p->cache.cached = xnobjcache_cached(cache);
+	p->cache.hits = 0;
+	p->cache.misses = 0;
+
+	for_each_possible_cpu(cpu) {
+		pc = cache->cpus + cpu;
+		p->cache.hits += pc->hits;
+		p->cache.misses += pc->misses;
+	}
 }
 
 static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
 	struct vfile_data *p = data;
+	struct xnobjcache *cache;
 	struct xnheap *heap;
 
 	if (priv->curr == NULL)
-		return 0;	/* We are done. */
+		goto caches;
 
 	heap = priv->curr;
 	if (list_is_last(&heap->next, &heapq))
@@ -97,10 +184,29 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 		priv->curr = list_entry(heap->next.next,
 					struct xnheap, next);
 
-	p->all_mem = xnheap_get_size(heap);
-	p->free_mem = xnheap_get_free(heap);
+	p->is_cache = 0;
+	p->heap.all_mem = xnheap_get_size(heap);
+	p->heap.free_mem = xnheap_get_free(heap);
+	get_frag_stats(heap, p);
 	knamecpy(p->name, heap->name);
 
+	return 1;
+caches:
+	if (priv->ccurr == NULL)
+		return 0;	/* We are done. */
+
+	cache = priv->ccurr;
+	if (list_is_last(&cache->next, &cacheq))
+		priv->ccurr = NULL;
+	else
+		priv->ccurr = list_entry(cache->next.next,
+					 struct xnobjcache, next);
+
+	p->is_cache = 1;
+	p->first_cache = cache->next.prev == &cacheq;
+	get_cache_stats(cache, p);
+	knamecpy(p->name, cache->name);
+
 	return 1;
 }
 
@@ -108,14 +214,35 @@ static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_data *p = data;
 
-	if (p == NULL)
-		xnvfile_printf(it, "%9s %9s  %s\n",
-			       "TOTAL", "FREE", "NAME");
-	else
-		xnvfile_printf(it, "%9Zu %9Zu  %s\n",
-			       p->all_mem,
-			       p->free_mem,
+	if (p == NULL) {
+		xnvfile_printf(it, "%9s %9s %9s %9s %6s  %s\n",
+			       "TOTAL", "FREE", "LARGEST", "SLACK",
+			       "FRAGS", "NAME");
+		return 0;
+	}
+
+	if (!p->is_cache) {
+		xnvfile_printf(it, "%9Zu %9Zu %9Zu %9Zu %6d  %s\n",
+			       p->heap.all_mem,
+			       p->heap.free_mem,
+			       p->heap.largest,
+			       p->heap.slack,
+			       p->heap.nranges,
 			       p->name);
+		return 0;
+	}
+
+	if (p->first_cache)
+		xnvfile_printf(it, "\n%9s %9s %12s %12s  %s\n",
+			       "OBJSIZE", "CACHED", "HITS", "MISSES", "CACHE");
+
+	xnvfile_printf(it, "%9u %9d %12lu %12lu  %s\n",
+		       p->cache.objsize,
+		       p->cache.cached,
+		       p->cache.hits,
+		       p->cache.misses,
+		       p->name);
+
 	return 0;
 }
 
@@ -137,30 +264,144 @@ void xnheap_cleanup_proc(void)
 
 #endif /* CONFIG_XENO_OPT_VFILE */
 
+/*
+ * Map a range size in pages to its first and second level indices.
+ */
+static inline void map_range(u32 npages, int *fl, int *sl)
+{
+	int log2;
+
+	if (npages < XNHEAP_SLCOUNT) {
+		*fl = 0;
+		*sl = npages;
+		return;
+	}
+
+	log2 = fls(npages) - 1;
+	*fl = log2 - XNHEAP_SLLOG2 + 1;
+	*sl = (npages >> (log2 - XNHEAP_SLLOG2)) - XNHEAP_SLCOUNT;
+}
+
+static inline void link_page(struct xnheap *heap, u32 *head, u32 pg)
+{
+	struct xnpagemap *pm = heap->pagemap;
+
+	pm[pg].prev = XNHEAP_NOPAGE;
+	pm[pg].next = *head;
+	if (*head != XNHEAP_NOPAGE)
+		pm[*head].prev = pg;
+	*head = pg;
+}
+
+static inline void unlink_page(struct xnheap *heap, u32 *head, u32 pg)
+{
+	struct xnpagemap *pm = heap->pagemap;
+
+	if (pm[pg].prev != XNHEAP_NOPAGE)
+		pm[pm[pg].prev].next = pm[pg].next;
+	else
+		*head = pm[pg].next;
+
+	if (pm[pg].next != XNHEAP_NOPAGE)
+		pm[pm[pg].next].prev = pm[pg].prev;
+}
+
+/*
+ * Index a range of free pages. The first and last pages of a free
+ * range both record its size, so that a released range can find its
+ * free neighbours.
+ */
+static void insert_range(struct xnheap *heap, u32 pg, u32 npages)
+{
+	struct xnpagemap *pm = heap->pagemap;
+	int fl, sl;
+
+	pm[pg].type = XNHEAP_PFREE;
+	pm[pg].bcount = npages;
+	pm[pg + npages - 1].type = XNHEAP_PFREE;
+	pm[pg + npages - 1].bcount = npages;
+
+	map_range(npages, &fl, &sl);
+	link_page(heap, &heap->freeq[fl][sl], pg);
+	heap->flbitmap |= 1 << fl;
+	heap->slbitmap[fl] |= 1 << sl;
+	heap->nranges++;
+}
+
+static void remove_range(struct xnheap *heap, u32 pg)
+{
+	int fl, sl;
+
+	map_range(heap->pagemap[pg].bcount, &fl, &sl);
+	unlink_page(heap, &heap->freeq[fl][sl], pg);
+	if (heap->freeq[fl][sl] == XNHEAP_NOPAGE) {
+		heap->slbitmap[fl] &= ~(1 << sl);
+		if (heap->slbitmap[fl] == 0)
+			heap->flbitmap &= ~(1 << fl);
+	}
+	heap->nranges--;
+}
+
+/*
+ * Find a free range of at least npages. The request is rounded up to
+ * the next size class, so that any range from the first non-empty
+ * list found is large enough. If none is, the head of the exact
+ * class list is given a chance.
+ */
+static u32 search_range(struct xnheap *heap, u32 npages)
+{
+	u32 rsize = npages, slmap, flmap, pg;
+	int fl, sl;
+
+	if (rsize >= XNHEAP_SLCOUNT)
+		rsize += (1 << (fls(rsize) - 1 - XNHEAP_SLLOG2)) - 1;
+
+	map_range(rsize, &fl, &sl);
+	if (fl >= XNHEAP_FLCOUNT)
+		goto exact;
+
+	slmap = heap->slbitmap[fl] & (~0U << sl);
+	if (slmap == 0) {
+		flmap = heap->flbitmap & (~0U << (fl + 1));
+		if (flmap == 0)
+			goto exact;
+		fl = __ffs(flmap);
+		slmap = heap->slbitmap[fl];
+	}
+	sl = __ffs(slmap);
+
+	return heap->freeq[fl][sl];
+exact:
+	map_range(npages, &fl, &sl);
+	pg = heap->freeq[fl][sl];
+	if (pg != XNHEAP_NOPAGE && heap->pagemap[pg].bcount >= npages)
+		return pg;
+
+	return XNHEAP_NOPAGE;
+}
+
 static void init_freelist(struct xnheap *heap)
 {
-	caddr_t freepage;
-	int n, lastpgnum;
+	int fl, sl, n;
 
 	heap->used = 0;
-	memset(heap->buckets, 0, sizeof(heap->buckets));
-	lastpgnum = heap->npages - 1;
-
-	/* Mark each page as free in the page map. */
-	for (n = 0, freepage = heap->membase;
-	     n < lastpgnum; n++, freepage += XNHEAP_PAGESZ) {
-		*((caddr_t *)freepage) = freepage + XNHEAP_PAGESZ;
-		heap->pagemap[n].type = XNHEAP_PFREE;
-		heap->pagemap[n].bcount = 0;
+	heap->nranges = 0;
+	heap->flbitmap = 0;
+	memset(heap->slbitmap, 0, sizeof(heap->slbitmap));
+
+	for (fl = 0; fl < XNHEAP_FLCOUNT; fl++)
+		for (sl = 0; sl < XNHEAP_SLCOUNT; sl++)
+			heap->freeq[fl][sl] = XNHEAP_NOPAGE;
+
+	for (n = 0; n < XNHEAP_NBUCKETS; n++) {
+		heap->buckets[n].pagelist = XNHEAP_NOPAGE;
+		heap->buckets[n].fcount = 0;
 	}
 
-	*((caddr_t *) freepage) = NULL;
-	heap->pagemap[lastpgnum].type = XNHEAP_PFREE;
-	heap->pagemap[lastpgnum].bcount = 0;
-	heap->memlim = freepage + XNHEAP_PAGESZ;
+	heap->memlim = heap->membase + heap->npages * XNHEAP_PAGESZ;
 
-	/* The first page starts the free list. */
-	heap->freelist = heap->membase;
+	/* The whole storage area starts as a single free range. */
+	insert_range(heap, 0, heap->npages);
 }
 
 /**
@@ -206,9 +447,10 @@ int xnheap_init(struct xnheap *heap, void *membase, u32 size)
 		return -EINVAL;
 
 	/*
-	 * We need to reserve 4 bytes in a page map for each page
-	 * which is addressable into the storage area.  pmapsize =
-	 * (size / XNHEAP_PAGESZ) * sizeof(struct xnpagemap).
+	 * We need to reserve a page map slot for each page which is
+	 * addressable into the storage area.  pmapsize = (size /
+	 * XNHEAP_PAGESZ) * sizeof(struct xnpagemap). This may be
+	 * large for big heaps, so get it from vmalloc().
 	 */
 	heap->size = size;
 	heap->membase = membase;
@@ -221,8 +463,7 @@ int xnheap_init(struct xnheap *heap, void *membase, u32 size)
 	if (heap->npages < 2)
 		return -EINVAL;
 
-	heap->pagemap = kmalloc(sizeof(struct xnpagemap) * heap->npages,
-				GFP_KERNEL);
+	heap->pagemap = vmalloc(sizeof(struct xnpagemap) * heap->npages);
 	if (heap->pagemap == NULL)
 		return -ENOMEM;
 
@@ -263,7 +504,7 @@ void xnheap_destroy(struct xnheap *heap)
 	nrheaps--;
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
-	kfree(heap->pagemap);
+	vfree(heap->pagemap);
 }
 EXPORT_SYMBOL_GPL(xnheap_destroy);
 
@@ -291,92 +532,114 @@ void xnheap_set_name(struct xnheap *heap, const char *name, ...)
 EXPORT_SYMBOL_GPL(xnheap_set_name);
 
 /*
- * get_free_range() -- Obtain a range of contiguous free pages to
- * fulfill an allocation of 2 ** log2size.  The caller must have
- * acquired the heap lock.
+ * get_free_range() -- Obtain a range of contiguous free pages, which
+ * heading page is typed as requested. The caller must have acquired
+ * the heap lock.
  */
-
-static caddr_t get_free_range(struct xnheap *heap, u32 bsize, int log2size)
+static caddr_t get_free_range(struct xnheap *heap, u32 npages, int type)
 {
-	caddr_t block, eblock, freepage, lastpage, headpage, freehead = NULL;
-	u32 pagenum, pagecont, freecont;
+	struct xnpagemap *pm = heap->pagemap;
+	u32 pg, avail;
 
-	freepage = heap->freelist;
-	while (freepage) {
-		headpage = freepage;
-		freecont = 0;
-		/*
-		 * Search for a range of contiguous pages in the free
-		 * page list. The range must be 'bsize' long.
-		 */
-		do {
-			lastpage = freepage;
-			freepage = *((caddr_t *) freepage);
-			freecont += XNHEAP_PAGESZ;
-		}
-		while (freepage == lastpage + XNHEAP_PAGESZ &&
-		       freecont < bsize);
-
-		if (freecont >= bsize) {
-			/*
-			 * Ok, got it. Just update the free page list,
-			 * then proceed to the next step.
-			 */
-			if (headpage == heap->freelist)
-				heap->freelist = *((caddr_t *)lastpage);
-			else
-				*((caddr_t *)freehead) = *((caddr_t *)lastpage);
+	pg = search_range(heap, npages);
+	if (pg == XNHEAP_NOPAGE)
+		return NULL;
 
-			goto splitpage;
+	avail = pm[pg].bcount;
+	remove_range(heap, pg);
+	if (avail > npages)
+		insert_range(heap, pg + npages, avail - npages);
+
+	/*
+	 * Only the first and last pages of a busy range have to be
+	 * typed for coalescing to work. When debugging, mark the
+	 * inner pages too, so that xnheap_free() catches pointers
+	 * into the middle of a range.
+	 */
+	pm[pg].type = type;
+	pm[pg].bcount = npages;
+	if (npages > 1) {
+		pm[pg + npages - 1].type = XNHEAP_PCONT;
+		if (XENO_DEBUG(COBALT)) {
+			for (avail = 1; avail < npages - 1; avail++)
+				pm[pg + avail].type = XNHEAP_PCONT;
 		}
-		freehead = lastpage;
 	}
 
-	return NULL;
+	return heap->membase + pg * XNHEAP_PAGESZ;
+}
 
-splitpage:
+/*
+ * release_range() -- Return a range of pages to the free pool,
+ * merging it with the free ranges surrounding it if any. The caller
+ * must have acquired the heap lock.
+ */
+static void release_range(struct xnheap *heap, u32 pg, u32 npages)
+{
+	struct xnpagemap *pm = heap->pagemap;
+	u32 next, nsize;
+
+	if (pg > 0 && pm[pg - 1].type == XNHEAP_PFREE) {
+		nsize = pm[pg - 1].bcount;
+		pg -= nsize;
+		remove_range(heap, pg);
+		npages += nsize;
+	}
 
-	/*
-	 * At this point, headpage is valid and points to the first
-	 * page of a range of contiguous free pages larger or equal
-	 * than 'bsize'.
-	 */
-	if (bsize < XNHEAP_PAGESZ) {
-		/*
-		 * If the allocation size is smaller than the page
-		 * size, split the page in smaller blocks of this
-		 * size, building a free list of free blocks.
-		 */
-		for (block = headpage, eblock =
-			     headpage + XNHEAP_PAGESZ - bsize; block < eblock;
-		     block += bsize)
-			*((caddr_t *)block) = block + bsize;
+	next = pg + npages;
+	if (next < heap->npages && pm[next].type == XNHEAP_PFREE) {
+		nsize = pm[next].bcount;
+		remove_range(heap, next);
+		npages += nsize;
+	}
 
-		*((caddr_t *)eblock) = NULL;
-	} else
-		*((caddr_t *)headpage) = NULL;
+	insert_range(heap, pg, npages);
+}
+
+/*
+ * get_free_block() -- Obtain a block of 2 ** log2size bytes from a
+ * page dedicated to this size, grabbing a new page if none has free
+ * blocks. Blocks are carved lazily from fresh pages. The caller must
+ * have acquired the heap lock.
+ */
+static caddr_t get_free_block(struct xnheap *heap, int log2size)
+{
+	struct xnbucket *bucket = &heap->buckets[log2size - XNHEAP_MINLOG2];
+	u32 nblocks = XNHEAP_PAGESZ >> log2size, pg;
+	struct xnpagemap *pm;
+	caddr_t page, block;
+
+	pg = bucket->pagelist;
+	if (pg == XNHEAP_NOPAGE) {
+		page = get_free_range(heap, 1, log2size);
+		if (page == NULL)
+			return NULL;
+		pg = (page - heap->membase) / XNHEAP_PAGESZ;
+		pm = heap->pagemap + pg;
+		pm->bcount = 0;
+		pm->bfree = XNHEAP_NOBLOCK;
+		pm->bnext = 0;
+		link_page(heap, &bucket->pagelist, pg);
+		bucket->fcount += nblocks;
+	} else {
+		pm = heap->pagemap + pg;
+		page = heap->membase + pg * XNHEAP_PAGESZ;
+	}
 
-	pagenum = (headpage - heap->membase) / XNHEAP_PAGESZ;
+	if (pm->bfree != XNHEAP_NOBLOCK) {
+		block = page + (pm->bfree << log2size);
+		pm->bfree = *((u32 *)block);
+	} else
+		block = page + (pm->bnext++ << log2size);
 
-	/*
-	 * Update the page map.  If log2size is non-zero (i.e. bsize
-	 * <= 2 * pagesize), store it in the first page's slot to
-	 * record the exact block size (which is a power of
-	 * two). Otherwise, store the special marker XNHEAP_PLIST,
-	 * indicating the start of a block whose size is a multiple of
-	 * the standard page size, but not necessarily a power of two.
-	 * In any case, the following pages slots are marked as
-	 * 'continued' (PCONT).
-	 */
-	heap->pagemap[pagenum].type = log2size ? : XNHEAP_PLIST;
-	heap->pagemap[pagenum].bcount = 1;
+	pm->bcount++;
+	bucket->fcount--;
 
-	for (pagecont = bsize / XNHEAP_PAGESZ; pagecont > 1; pagecont--) {
-		heap->pagemap[pagenum + pagecont - 1].type = XNHEAP_PCONT;
-		heap->pagemap[pagenum + pagecont - 1].bcount = 0;
-	}
+	/* Drop the page from the bucket once exhausted. */
+	if (pm->bfree == XNHEAP_NOBLOCK && pm->bnext == nblocks)
+		unlink_page(heap, &bucket->pagelist, pg);
 
-	return headpage;
+	return block;
 }
 
 /**
@@ -384,7 +647,8 @@ splitpage:
  * @brief Allocate a memory block from a memory heap.
  *
  * Allocates a contiguous region of memory from an active memory heap.
- * Such allocation is guaranteed to be time-bounded.
+ * Such allocation is guaranteed to be time-bounded, and performed in
+ * constant time regardless of the heap size and fragmentation.
  *
  * @param heap The descriptor address of the heap to get memory from.
  *
@@ -403,9 +667,9 @@ splitpage:
  */
 void *xnheap_alloc(struct xnheap *heap, u32 size)
 {
-	u32 pagenum, bsize;
-	int log2size, ilog;
+	u32 bsize, npages;
 	caddr_t block;
+	int log2size;
 	spl_t s;
 
 	if (size == 0)
@@ -425,50 +689,32 @@ void *xnheap_alloc(struct xnheap *heap, u32 size)
 		size = ALIGN(size, XNHEAP_MINALIGNSZ);
 
 	/*
-	 * It is more space efficient to directly allocate pages from
-	 * the free page list whenever the requested size is greater
-	 * than 2 times the page size. Otherwise, use the bucketed
-	 * memory blocks.
+	 * Blocks up to half a page are obtained from the bucketed
+	 * pages, larger requests are served whole pages directly from
+	 * the free ranges.
 	 */
-	if (likely(size <= XNHEAP_PAGESZ * 2)) {
+	if (likely(size <= XNHEAP_PAGESZ / 2)) {
 		/*
 		 * Find the first power of two greater or equal to the
 		 * rounded size.
 		 */
-		bsize = size < XNHEAP_MINALLOCSZ ? XNHEAP_MINALLOCSZ : size;
-		log2size = order_base_2(bsize);
+		log2size = order_base_2(size);
 		bsize = 1 << log2size;
-		ilog = log2size - XNHEAP_MINLOG2;
 		xnlock_get_irqsave(&heap->lock, s);
-		block = heap->buckets[ilog].freelist;
-		if (block == NULL) {
-			block = get_free_range(heap, bsize, log2size);
-			if (block == NULL)
-				goto out;
-			if (bsize <= XNHEAP_PAGESZ)
-				heap->buckets[ilog].fcount += (XNHEAP_PAGESZ >> log2size) - 1;
-		} else {
-			if (bsize <= XNHEAP_PAGESZ)
-				--heap->buckets[ilog].fcount;
-			XENO_BUG_ON(COBALT, (caddr_t)block < heap->membase ||
-				    (caddr_t)block >= heap->memlim);
-			pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
-			++heap->pagemap[pagenum].bcount;
-		}
-		heap->buckets[ilog].freelist = *((caddr_t *)block);
-		heap->used += bsize;
+		block = get_free_block(heap, log2size);
+		if (block)
+			heap->used += bsize;
 	} else {
 		if (size > heap->size)
 			return NULL;
 
+		npages = DIV_ROUND_UP(size, XNHEAP_PAGESZ);
 		xnlock_get_irqsave(&heap->lock, s);
-
-		/* Directly request a free page range. */
-		block = get_free_range(heap, size, 0);
+		block = get_free_range(heap, npages, XNHEAP_PLIST);
 		if (block)
-			heap->used += size;
+			heap->used += npages * XNHEAP_PAGESZ;
 	}
-out:
+
 	xnlock_put_irqrestore(&heap->lock, s);
 
 	return block;
@@ -479,7 +725,7 @@ EXPORT_SYMBOL_GPL(xnheap_alloc);
  * @fn void xnheap_free(struct xnheap *heap, void *block)
  * @brief Release a block to a memory heap.
  *
- * Releases a memory block to a heap.
+ * Releases a memory block to a heap, in constant time.
  *
  * @param heap The heap descriptor.
  *
@@ -489,9 +735,10 @@ EXPORT_SYMBOL_GPL(xnheap_alloc);
  */
 void xnheap_free(struct xnheap *heap, void *block)
 {
-	caddr_t freepage, lastpage, nextpage, tailpage, freeptr, *tailptr;
-	int log2size, npages, nblocks, xpage, ilog;
-	u32 pagenum, pagecont, boffset, bsize;
+	u32 pagenum, boffset, bsize, nblocks, npages;
+	struct xnbucket *bucket;
+	struct xnpagemap *pm;
+	int log2size, full;
 	spl_t s;
 
 	xnlock_get_irqsave(&heap->lock, s);
@@ -502,8 +749,9 @@ void xnheap_free(struct xnheap *heap, void *block)
 	/* Compute the heading page number in the page map. */
 	pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
 	boffset = ((caddr_t)block - (heap->membase + pagenum * XNHEAP_PAGESZ));
+	pm = heap->pagemap + pagenum;
 
-	switch (heap->pagemap[pagenum].type) {
+	switch (pm->type) {
 	case XNHEAP_PFREE:	/* Unallocated page? */
 	case XNHEAP_PCONT:	/* Not a range heading page? */
 	bad_block:
@@ -512,115 +760,43 @@ void xnheap_free(struct xnheap *heap, void *block)
 		return;
 
 	case XNHEAP_PLIST:
-		npages = 1;
-		while (npages < heap->npages &&
-		       heap->pagemap[pagenum + npages].type == XNHEAP_PCONT)
-			npages++;
-
+		if (boffset != 0)
+			goto bad_block;
+		npages = pm->bcount;
 		bsize = npages * XNHEAP_PAGESZ;
-
-	free_page_list:
-		/* Link all freed pages in a single sub-list. */
-		for (freepage = (caddr_t) block,
-			     tailpage = (caddr_t) block + bsize - XNHEAP_PAGESZ;
-		     freepage < tailpage; freepage += XNHEAP_PAGESZ)
-			*((caddr_t *) freepage) = freepage + XNHEAP_PAGESZ;
-
-	free_pages:
-		/* Mark the released pages as free. */
-		for (pagecont = 0; pagecont < npages; pagecont++)
-			heap->pagemap[pagenum + pagecont].type = XNHEAP_PFREE;
-
-		/*
-		 * Return the sub-list to the free page list, keeping
-		 * an increasing address order to favor coalescence.
-		 */
-		for (nextpage = heap->freelist, lastpage = NULL;
-		     nextpage != NULL && nextpage < (caddr_t) block;
-		     lastpage = nextpage, nextpage = *((caddr_t *)nextpage))
-			;	/* Loop */
-
-		*((caddr_t *)tailpage) = nextpage;
-
-		if (lastpage)
-			*((caddr_t *)lastpage) = (caddr_t)block;
-		else
-			heap->freelist = (caddr_t)block;
+		release_range(heap, pagenum, npages);
 		break;
 
 	default:
-		log2size = heap->pagemap[pagenum].type;
+		log2size = pm->type;
 		bsize = (1 << log2size);
 		if ((boffset & (bsize - 1)) != 0) /* Not a block start? */
 			goto bad_block;
 
-		/*
-		 * Return the page to the free list if we've just
-		 * freed its last busy block. Pages from multi-page
-		 * blocks are always pushed to the free list (bcount
-		 * value for the heading page is always 1).
-		 */
-
-		ilog = log2size - XNHEAP_MINLOG2;
-		if (likely(--heap->pagemap[pagenum].bcount > 0)) {
-			/* Return the block to the bucketed memory space. */
-			*((caddr_t *)block) = heap->buckets[ilog].freelist;
-			heap->buckets[ilog].freelist = block;
-			++heap->buckets[ilog].fcount;
-			break;
-		}
-
-		/*
-		 * In the simplest case, we only have a single block
-		 * to deal with, which spans multiple pages. We just
-		 * need to release it as a list of pages, without
-		 * caring about the consistency of the bucket.
-		 */
-		npages = bsize / XNHEAP_PAGESZ;
-		if (unlikely(npages > 1))
-			goto free_page_list;
-
-		freepage = heap->membase + pagenum * XNHEAP_PAGESZ;
-		block = freepage;
-		tailpage = freepage;
-		nextpage = freepage + XNHEAP_PAGESZ;
+		bucket = &heap->buckets[log2size - XNHEAP_MINLOG2];
 		nblocks = XNHEAP_PAGESZ >> log2size;
-		heap->buckets[ilog].fcount -= (nblocks - 1);
-		XENO_BUG_ON(COBALT, heap->buckets[ilog].fcount < 0);
+		full = pm->bfree == XNHEAP_NOBLOCK && pm->bnext == nblocks;
 
 		/*
-		 * Still easy case: all free blocks are laid on a
-		 * single page we are now releasing. Just clear the
-		 * bucket and bail out.
+		 * Return the page to the free ranges if we've just
+		 * freed its last busy block, dropping all its free
+		 * blocks from the bucket at once.
 		 */
-		if (likely(heap->buckets[ilog].fcount == 0)) {
-			heap->buckets[ilog].freelist = NULL;
-			goto free_pages;
+		if (--pm->bcount == 0) {
+			if (!full)
+				unlink_page(heap, &bucket->pagelist, pagenum);
+			bucket->fcount -= nblocks - 1;
+			XENO_BUG_ON(COBALT, bucket->fcount < 0);
+			release_range(heap, pagenum, 1);
+			break;
 		}
 
-		/*
-		 * Worst case: multiple pages are traversed by the
-		 * bucket list. Scan the list to remove all blocks
-		 * belonging to the freed page. We are done whenever
-		 * all possible blocks from the freed page have been
-		 * traversed, or we hit the end of list, whichever
-		 * comes first.
-		 */
-		for (tailptr = &heap->buckets[ilog].freelist, freeptr = *tailptr, xpage = 1;
-		     freeptr != NULL && nblocks > 0; freeptr = *((caddr_t *) freeptr)) {
-			if (unlikely(freeptr < freepage || freeptr >= nextpage)) {
-				if (unlikely(xpage)) {
-					*tailptr = freeptr;
-					xpage = 0;
-				}
-				tailptr = (caddr_t *)freeptr;
-			} else {
-				--nblocks;
-				xpage = 1;
-			}
-		}
-		*tailptr = freeptr;
-		goto free_pages;
+		/* Return the block to its page's free list. */
+		*((u32 *)block) = pm->bfree;
+		pm->bfree = boffset >> log2size;
+		bucket->fcount++;
+		if (full)
+			link_page(heap, &bucket->pagelist, pagenum);
 	}
 
 	heap->used -= bsize;
@@ -655,4 +831,358 @@ out:
 }
 EXPORT_SYMBOL_GPL(xnheap_check_block);
 
+/**
+ * @fn int xnobjcache_init(struct xnobjcache *cache, struct xnheap *heap, u32 objsize, const char *name)
+ * @brief Initialize an object cache.
+ *
+ * Initializes a cache of fixed-size objects on top of a memory
+ * heap. Each CPU keeps a couple of magazines of free objects, which
+ * are accessed with interrupts off under a per-CPU lock, only ever
+ * contended by xnobjcache_reclaim(). Magazine exchanges with the
+ * depot are serialized by the depot lock, the heap is only hit when
+ * the depot runs dry.
+ *
+ * @param cache The address of a cache descriptor to initialize.
+ *
+ * @param heap The heap objects are obtained from.
+ *
+ * @param objsize The size of cached objects.
+ *
+ * @param name The cache name displayed in statistic outputs.
+ *
+ * @return 0 is returned upon success, or -ENOMEM if the per-CPU
+ * magazine slots cannot be allocated.
+ *
+ * @coretags{secondary-only}
+ */
+int xnobjcache_init(struct xnobjcache *cache, struct xnheap *heap,
+		    u32 objsize, const char *name)
+{
+	int cpu;
+	spl_t s;
+
+	secondary_mode_only();
+
+	cache->cpus = kcalloc(nr_cpu_ids, sizeof(struct xnobjcache_cpu),
+			      GFP_KERNEL);
+	if (cache->cpus == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		xnlock_init(&cache->cpus[cpu].lock);
+
+	cache->heap = heap;
+	cache->objsize = objsize;
+	xnlock_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->full);
+	INIT_LIST_HEAD(&cache->empty);
+	cache->nfull = 0;
+	knamecpy(cache->name, name);
+
+	xnlock_get_irqsave(&nklock, s);
+	list_add_tail(&cache->next, &cacheq);
+	nrcaches++;
+	xnvfile_touch_tag(&vfile_tag);
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnobjcache_init);
+
+static void drain_magazine(struct xnobjcache *cache, struct xnobjmag *mag)
+{
+	while (mag->nr > 0)
+		xnheap_free(cache->heap, mag->objs[--mag->nr]);
+}
+
+static void free_magazine(struct xnobjcache *cache, struct xnobjmag *mag)
+{
+	if (mag) {
+		drain_magazine(cache, mag);
+		xnheap_free(cache->heap, mag);
+	}
+}
+
+/**
+ * @fn void xnobjcache_destroy(struct xnobjcache *cache)
+ * @brief Destroy an object cache.
+ *
+ * Returns all cached objects and magazines to the backing heap. No
+ * object from this cache may be in use anymore.
+ *
+ * @param cache The cache descriptor.
+ *
+ * @coretags{secondary-only}
+ */
+void xnobjcache_destroy(struct xnobjcache *cache)
+{
+	struct xnobjcache_cpu *pc;
+	struct xnobjmag *mag, *tmp;
+	int cpu;
+	spl_t s;
+
+	secondary_mode_only();
+
+	xnlock_get_irqsave(&nklock, s);
+	list_del(&cache->next);
+	nrcaches--;
+	xnvfile_touch_tag(&vfile_tag);
+	xnlock_put_irqrestore(&nklock, s);
+
+	for_each_possible_cpu(cpu) {
+		pc = cache->cpus + cpu;
+		free_magazine(cache, pc->loaded);
+		free_magazine(cache, pc->prev);
+	}
+
+	list_for_each_entry_safe(mag, tmp, &cache->full, next)
+		free_magazine(cache, mag);
+
+	list_for_each_entry_safe(mag, tmp, &cache->empty, next)
+		free_magazine(cache, mag);
+
+	kfree(cache->cpus);
+}
+EXPORT_SYMBOL_GPL(xnobjcache_destroy);
+
+/**
+ * @fn void *xnobjcache_alloc(struct xnobjcache *cache)
+ * @brief Allocate an object from a cache.
+ *
+ * Pulls a free object from the magazines of the current CPU,
+ * refilling them from the depot if needed. Falls back to allocating
+ * from the backing heap when no cached object is available.
+ *
+ * @param cache The cache descriptor.
+ *
+ * @return The address of the allocated object upon success, or NULL
+ * if no memory is available.
+ *
+ * @coretags{unrestricted}
+ */
+void *xnobjcache_alloc(struct xnobjcache *cache)
+{
+	struct xnobjcache_cpu *pc;
+	struct xnobjmag *mag;
+	void *obj;
+	spl_t s;
+
+	splhigh(s);
+
+	pc = cache->cpus + ipipe_processor_id();
+	xnlock_get(&pc->lock);
+	mag = pc->loaded;
+	if (mag && mag->nr > 0)
+		goto hit;
+
+	mag = pc->prev;
+	if (mag && mag->nr > 0) {
+		pc->prev = pc->loaded;
+		pc->loaded = mag;
+		goto hit;
+	}
+
+	/*
+	 * Both magazines are empty (or missing): trade the previous
+	 * one for a full magazine from the depot.
+	 */
+	xnlock_get(&cache->lock);
+	if (list_empty(&cache->full)) {
+		xnlock_put(&cache->lock);
+		pc->misses++;
+		xnlock_put(&pc->lock);
+		splexit(s);
+		return xnheap_alloc(cache->heap, cache->objsize);
+	}
+	mag = list_first_entry(&cache->full, struct xnobjmag, next);
+	list_del(&mag->next);
+	cache->nfull--;
+	if (pc->prev)
+		list_add(&pc->prev->next, &cache->empty);
+	xnlock_put(&cache->lock);
+	pc->prev = pc->loaded;
+	pc->loaded = mag;
+hit:
+	obj = mag->objs[--mag->nr];
+	pc->hits++;
+	xnlock_put(&pc->lock);
+	splexit(s);
+
+	return obj;
+}
+EXPORT_SYMBOL_GPL(xnobjcache_alloc);
+
+/**
+ * @fn void xnobjcache_free(struct xnobjcache *cache, void *obj)
+ * @brief Release an object to a cache.
+ *
+ * Pushes the object to the magazines of the current CPU, handing
+ * over a full magazine to the depot if needed. When the depot is
+ * full, the objects from the outgoing magazine are returned to the
+ * backing heap.
+ *
+ * @param cache The cache descriptor.
+ *
+ * @param obj The object to release, which must have been obtained
+ * from xnobjcache_alloc() on the same cache.
+ *
+ * @coretags{unrestricted}
+ */
+void xnobjcache_free(struct xnobjcache *cache, void *obj)
+{
+	struct xnobjcache_cpu *pc;
+	struct xnobjmag *mag;
+	spl_t s;
+
+	splhigh(s);
+
+	pc = cache->cpus + ipipe_processor_id();
+	xnlock_get(&pc->lock);
+	mag = pc->loaded;
+	if (mag && mag->nr < XNOBJCACHE_MAGSZ)
+		goto put;
+
+	mag = pc->prev;
+	if (mag && mag->nr < XNOBJCACHE_MAGSZ) {
+		pc->prev = pc->loaded;
+		pc->loaded = mag;
+		goto put;
+	}
+
+	/*
+	 * Both magazines are full (or missing): hand the previous
+	 * one over to the depot, loading an empty magazine instead.
+	 */
+	xnlock_get(&cache->lock);
+
+	mag = NULL;
+	if (!list_empty(&cache->empty)) {
+		mag = list_first_entry(&cache->empty, struct xnobjmag, next);
+		list_del(&mag->next);
+	}
+
+	if (pc->prev) {
+		if (cache->nfull < XNOBJCACHE_DEPOTSZ) {
+			list_add(&pc->prev->next, &cache->full);
+			cache->nfull++;
+		} else {
+			drain_magazine(cache, pc->prev);
+			if (mag == NULL)
+				mag = pc->prev;
+			else
+				list_add(&pc->prev->next, &cache->empty);
+		}
+		pc->prev = NULL;
+	}
+
+	xnlock_put(&cache->lock);
+
+	if (mag == NULL) {
+		mag = xnheap_alloc(cache->heap, sizeof(*mag));
+		if (mag == NULL) {
+			xnlock_put(&pc->lock);
+			splexit(s);
+			xnheap_free(cache->heap, obj);
+			return;
+		}
+		mag->nr = 0;
+	}
+
+	pc->prev = pc->loaded;
+	pc->loaded = mag;
+put:
+	mag->objs[mag->nr++] = obj;
+	xnlock_put(&pc->lock);
+	splexit(s);
+}
+EXPORT_SYMBOL_GPL(xnobjcache_free);
+
+/**
+ * @fn unsigned long xnobjcache_reclaim(struct xnobjcache *cache)
+ * @brief Return the cached objects to the backing heap.
+ *
+ * Drains the magazines of all CPUs and the full magazines from the
+ * depot, so that the memory they hold becomes available to other
+ * allocations from the backing heap. Empty magazines are kept.
+ *
+ * @param cache The cache descriptor.
+ *
+ * @return The number of objects returned to the heap.
+ *
+ * @coretags{unrestricted}
+ */
+unsigned long xnobjcache_reclaim(struct xnobjcache *cache)
+{
+	struct xnobjcache_cpu *pc;
+	struct xnobjmag *mag, *tmp;
+	unsigned long nr = 0;
+	int cpu;
+	spl_t s;
+
+	for_each_possible_cpu(cpu) {
+		pc = cache->cpus + cpu;
+		xnlock_get_irqsave(&pc->lock, s);
+		if (pc->loaded) {
+			nr += pc->loaded->nr;
+			drain_magazine(cache, pc->loaded);
+		}
+		if (pc->prev) {
+			nr += pc->prev->nr;
+			drain_magazine(cache, pc->prev);
+		}
+		xnlock_put_irqrestore(&pc->lock, s);
+	}
+
+	xnlock_get_irqsave(&cache->lock, s);
+
+	list_for_each_entry_safe(mag, tmp, &cache->full, next) {
+		nr += mag->nr;
+		drain_magazine(cache, mag);
+		list_move(&mag->next, &cache->empty);
+	}
+	cache->nfull = 0;
+
+	xnlock_put_irqrestore(&cache->lock, s);
+
+	return nr;
+}
+EXPORT_SYMBOL_GPL(xnobjcache_reclaim);
+
+/**
+ * @fn unsigned long xnobjcache_cached(struct xnobjcache *cache)
+ * @brief Count the free objects held by a cache.
+ *
+ * The count is only a snapshot, which may be outdated as soon as
+ * returned.
+ *
+ * @param cache The cache descriptor.
+ *
+ * @return The number of free objects held in the magazines.
+ *
+ * @coretags{unrestricted}
+ */
+unsigned long xnobjcache_cached(struct xnobjcache *cache)
+{
+	struct xnobjcache_cpu *pc;
+	struct xnobjmag *mag;
+	unsigned long nr;
+	int cpu;
+
+	/* Magazines are only released by xnobjcache_destroy(). */
+	nr = cache->nfull * XNOBJCACHE_MAGSZ;
+
+	for_each_possible_cpu(cpu) {
+		pc = cache->cpus + cpu;
+		mag = pc->loaded;
+		if (mag)
+			nr += mag->nr;
+		mag = pc->prev;
+		if (mag)
+			nr += mag->nr;
+	}
+
+	return nr;
+}
+EXPORT_SYMBOL_GPL(xnobjcache_cached);
+
 /** @} */
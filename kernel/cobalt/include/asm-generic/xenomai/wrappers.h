@@ -39,6 +39,14 @@
  *   without side effects on newer wrappers.
  */
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,0,0)
+#define WRITE_ONCE(__x, __val)	({ ACCESS_ONCE(__x) = (__val); })
+#endif /* < 4.0 */
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,19,0)
+#define READ_ONCE(__x)	ACCESS_ONCE(__x)
+#endif /* < 3.19 */
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,17,0)
 #include <linux/netdevice.h>
 
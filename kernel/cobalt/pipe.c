@@ -26,6 +26,7 @@
 #include <linux/termios.h>
 #include <linux/spinlock.h>
 #include <linux/device.h>
+#include <linux/mm.h>
 #include <asm/io.h>
 #include <asm/uaccess.h>
 #include <cobalt/kernel/sched.h>
@@ -338,6 +339,7 @@ int xnpipe_connect(int minor, struct xnpipe_operations *ops, void *xstate)
 	xnsynch_init(&state->synchbase, XNSYNCH_FIFO, NULL);
 	state->xstate = xstate;
 	state->ionrd = 0;
+	state->evcount = 0;
 
 	if (state->status & XNPIPE_USER_CONN) {
 		if (state->status & XNPIPE_USER_WREAD) {
@@ -636,6 +638,56 @@ int xnpipe_flush(int minor, int mode)
 }
 EXPORT_SYMBOL_GPL(xnpipe_flush);
 
+/*
+ * Notify the reader of a pipe in mmap mode that the shared ring has
+ * data. Callers are expected to do this on the empty to non-empty
+ * transitions of the ring only, since the reader consumes the ring
+ * until it is empty each time it wakes up.
+ */
+int xnpipe_notify(int minor)
+{
+	struct xnpipe_state *state;
+	int need_sched = 0;
+	spl_t s;
+
+	if (minor < 0 || minor >= XNPIPE_NDEVS)
+		return -ENODEV;
+
+	state = &xnpipe_states[minor];
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if ((state->status & XNPIPE_KERN_CONN) == 0) {
+		xnlock_put_irqrestore(&nklock, s);
+		return -EBADF;
+	}
+
+	state->evcount++;
+
+	if ((state->status & XNPIPE_USER_CONN) == 0) {
+		xnlock_put_irqrestore(&nklock, s);
+		return 0;
+	}
+
+	if (state->status & XNPIPE_USER_WREAD) {
+		state->status |= XNPIPE_USER_WREAD_READY;
+		need_sched = 1;
+	}
+
+	if (state->asyncq) {	/* Schedule asynch sig. */
+		state->status |= XNPIPE_USER_SIGIO;
+		need_sched = 1;
+	}
+
+	if (need_sched)
+		xnpipe_schedule_request();
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnpipe_notify);
+
 int xnpipe_pollstate(int minor, unsigned int *mask_r)
 {
 	struct xnpipe_state *state;
@@ -785,6 +837,50 @@ static int xnpipe_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/*
+ * In mmap mode, data flows through the shared ring, and read()
+ * collects the pending notifications instead, as a 64bit count.
+ * Must be entered with nklock held, interrupts off.
+ */
+static ssize_t xnpipe_read_events(struct xnpipe_state *state,
+				  struct file *file, char *buf,
+				  size_t count, spl_t s)
+{
+	int sigpending;
+	__u64 events;
+
+	if (count < sizeof(events)) {
+		xnlock_put_irqrestore(&nklock, s);
+		return -EINVAL;
+	}
+
+	if (state->evcount == 0) {
+		if (file->f_flags & O_NONBLOCK) {
+			xnlock_put_irqrestore(&nklock, s);
+			return -EWOULDBLOCK;
+		}
+
+		sigpending = xnpipe_wait(state, XNPIPE_USER_WREAD, s,
+					 state->evcount > 0 ||
+					 (state->status & XNPIPE_KERN_CONN) == 0);
+
+		if (state->evcount == 0) {
+			xnlock_put_irqrestore(&nklock, s);
+			return sigpending ? -ERESTARTSYS : 0;
+		}
+	}
+
+	events = state->evcount;
+	state->evcount = 0;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (__copy_to_user(buf, &events, sizeof(events)))
+		return -EFAULT;
+
+	return sizeof(events);
+}
+
 static ssize_t xnpipe_read(struct file *file,
 			   char *buf, size_t count, loff_t *ppos)
 {
@@ -804,6 +900,9 @@ static ssize_t xnpipe_read(struct file *file,
 		xnlock_put_irqrestore(&nklock, s);
 		return -EPIPE;
 	}
+
+	if (state->ops.mmap)
+		return xnpipe_read_events(state, file, buf, count, s);
 	/*
 	 * Queue probe and proc enqueuing must be seen atomically,
 	 * including from the Xenomai side.
@@ -1088,7 +1187,7 @@ static unsigned xnpipe_poll(struct file *file, poll_table *pt)
 	else
 		r_mask |= POLLHUP;
 
-	if (!list_empty(&state->outq))
+	if (state->ops.mmap ? state->evcount > 0 : !list_empty(&state->outq))
 		r_mask |= (POLLIN | POLLRDNORM);
 	else
 		/*
@@ -1104,6 +1203,32 @@ static unsigned xnpipe_poll(struct file *file, poll_table *pt)
 	return r_mask | w_mask;
 }
 
+static int xnpipe_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xnpipe_state *state = file->private_data;
+	int ret = 0;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if ((state->status & XNPIPE_KERN_CONN) == 0)
+		ret = -EPIPE;
+	else if (state->ops.mmap == NULL)
+		ret = -ENODEV;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (ret)
+		return ret;
+
+	/*
+	 * The extra state cannot vanish while we hold the user
+	 * connection, xnpipe_disconnect() would enter lingering close
+	 * instead.
+	 */
+	return state->ops.mmap(vma, state->xstate);
+}
+
 static struct file_operations xnpipe_fops = {
 	.read = xnpipe_read,
 	.write = xnpipe_write,
@@ -1111,7 +1236,8 @@ static struct file_operations xnpipe_fops = {
 	.unlocked_ioctl = xnpipe_ioctl,
 	.open = xnpipe_open,
 	.release = xnpipe_release,
-	.fasync = xnpipe_fasync
+	.fasync = xnpipe_fasync,
+	.mmap = xnpipe_mmap,
 };
 
 int xnpipe_mount(void)
@@ -33,7 +33,7 @@ pthread_cond_init(struct cobalt_cond_shadow *cnd, const struct cobalt_condattr *
 	struct list_head *condq;
 	spl_t s;
 
-	cond = xnmalloc(sizeof(*cond));
+	cond = xnobjcache_alloc(&cobalt_cond_cache);
 	if (cond == NULL)
 		return -ENOMEM;
 
@@ -81,7 +81,7 @@ fail_register:
 	xnlock_put_irqrestore(&nklock, s);
 	cobalt_umm_free(&sys_ppd->umm, state);
 fail_umm:
-	xnfree(cond);
+	xnobjcache_free(&cobalt_cond_cache, cond);
 
 	return ret;
 }
@@ -420,5 +420,5 @@ void cobalt_cond_reclaim(struct cobalt_resnode *node, spl_t s)
 
 	cobalt_umm_free(&cobalt_ppd_get(cond->attr.pshared)->umm,
 			cond->state);
-	xnfree(cond);
+	xnobjcache_free(&cobalt_cond_cache, cond);
 }
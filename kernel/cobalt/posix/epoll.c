@@ -0,0 +1,407 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <linux/err.h>
+#include <linux/poll.h>
+#include <cobalt/kernel/select.h>
+#include <cobalt/kernel/tree.h>
+#include <rtdm/driver.h>
+#include "internal.h"
+#include "clock.h"
+#include "epoll.h"
+
+/*
+ * Cobalt epoll services
+ *
+ * An epoll descriptor carries a persistent interest set: every file
+ * descriptor added by epoll_ctl() is bound once to a selector in
+ * queued mode, which collects the bindings as they become ready. As
+ * a consequence, epoll_wait() runs in O(number of ready descriptors),
+ * regardless of the size of the interest set.
+ *
+ * Only level-triggered notifications are supported. A descriptor
+ * closed while still in the interest set is reported with POLLHUP
+ * until it is removed by EPOLL_CTL_DEL.
+ */
+
+#define COBALT_EPOLL_EVENTS	(POLLIN | POLLOUT | POLLPRI)
+#define COBALT_EPOLL_BATCH	16
+
+struct cobalt_epoll {
+	struct rtdm_fd fd;
+	struct xnselector *selector;
+	struct rb_root items;
+	rtdm_mutex_t lock;
+};
+
+struct cobalt_epitem {
+	struct xnid id;
+	__u32 events;
+	__u64 data;
+};
+
+static const __u32 epoll_types[XNSELECT_MAX_TYPES] = {
+	[XNSELECT_READ] = POLLIN,
+	[XNSELECT_WRITE] = POLLOUT,
+	[XNSELECT_EXCEPT] = POLLPRI,
+};
+
+static inline struct cobalt_epitem *
+epoll_lookup(struct cobalt_epoll *ep, int fd)
+{
+	struct xnid *id = xnid_fetch(&ep->items, fd);
+
+	return id ? container_of(id, struct cobalt_epitem, id) : NULL;
+}
+
+static void epoll_free_item(void *cookie, struct xnid *id)
+{
+	struct cobalt_epoll *ep = cookie;
+
+	xnid_remove(&ep->items, id);
+	xnfree(container_of(id, struct cobalt_epitem, id));
+}
+
+static void epoll_close(struct rtdm_fd *fd)
+{
+	struct cobalt_epoll *ep = container_of(fd, struct cobalt_epoll, fd);
+
+	/* The selector drops all bindings left when destroyed. */
+	xnselector_destroy(ep->selector);
+	xntree_cleanup(&ep->items, ep, epoll_free_item);
+	rtdm_mutex_destroy(&ep->lock);
+	xnfree(ep);
+}
+
+static struct rtdm_fd_ops epoll_ops = {
+	.close = epoll_close,
+};
+
+COBALT_SYSCALL(epoll_create, lostage, (int flags))
+{
+	struct cobalt_epoll *ep;
+	int ret, ufd;
+
+	if (flags & ~EPOLL_CLOEXEC)
+		return -EINVAL;
+
+	ep = xnmalloc(sizeof(*ep));
+	if (ep == NULL)
+		return -ENOMEM;
+
+	ep->selector = xnmalloc(sizeof(*ep->selector));
+	if (ep->selector == NULL) {
+		ret = -ENOMEM;
+		goto fail_selector;
+	}
+
+	ufd = __rtdm_anon_getfd("[cobalt-epoll]",
+				O_RDWR | (flags & EPOLL_CLOEXEC));
+	if (ufd < 0) {
+		ret = ufd;
+		goto fail_getfd;
+	}
+
+	xnselector_init_queued(ep->selector);
+	xntree_init(&ep->items);
+	rtdm_mutex_init(&ep->lock);
+	ep->fd.oflags = 0;
+
+	ret = rtdm_fd_enter(&ep->fd, ufd, COBALT_EPOLL_MAGIC, &epoll_ops);
+	if (ret < 0)
+		goto fail;
+
+	return ufd;
+fail:
+	rtdm_mutex_destroy(&ep->lock);
+	xnselector_destroy(ep->selector);
+	__rtdm_anon_putfd(ufd);
+	xnfree(ep);
+
+	return ret;
+fail_getfd:
+	xnfree(ep->selector);
+fail_selector:
+	xnfree(ep);
+
+	return ret;
+}
+
+static inline struct cobalt_epoll *epoll_get(int ufd)
+{
+	struct rtdm_fd *fd;
+
+	fd = rtdm_fd_get(ufd, COBALT_EPOLL_MAGIC);
+	if (IS_ERR(fd)) {
+		int err = PTR_ERR(fd);
+		if (err == -EBADF && cobalt_current_process() == NULL)
+			err = -EPERM;
+		return ERR_PTR(err);
+	}
+
+	return container_of(fd, struct cobalt_epoll, fd);
+}
+
+static inline void epoll_put(struct cobalt_epoll *ep)
+{
+	rtdm_fd_put(&ep->fd);
+}
+
+/*
+ * Bind @fd to the selector for every type of event in @events. We
+ * succeed if at least one of them could be bound, since a driver
+ * may not support all of them (e.g. timerfds are never writable).
+ */
+static int epoll_bind(struct cobalt_epoll *ep, int fd, __u32 events)
+{
+	int type, ret, err = 0, bound = 0;
+
+	for (type = 0; type < XNSELECT_MAX_TYPES; type++) {
+		if ((events & epoll_types[type]) == 0)
+			continue;
+		ret = rtdm_fd_select(fd, ep->selector, type);
+		if (ret == 0)
+			bound++;
+		else if (err == 0)
+			err = ret == -ENOENT ? -EBADF : ret;
+	}
+
+	return bound ? 0 : err;
+}
+
+static int epoll_add(struct cobalt_epoll *ep, int fd,
+		     const struct epoll_event *ev)
+{
+	struct cobalt_epitem *item;
+	spl_t s;
+	int ret;
+
+	item = xnmalloc(sizeof(*item));
+	if (item == NULL)
+		return -ENOMEM;
+
+	item->events = ev->events;
+	item->data = ev->data;
+
+	/*
+	 * Enter the item before binding, so that any event collected
+	 * by a waiter can be matched to its item.
+	 */
+	xnlock_get_irqsave(&nklock, s);
+	xnid_enter(&ep->items, &item->id, fd);
+	xnlock_put_irqrestore(&nklock, s);
+
+	ret = epoll_bind(ep, fd, ev->events);
+	if (ret == 0)
+		return 0;
+
+	xnlock_get_irqsave(&nklock, s);
+	xnid_remove(&ep->items, &item->id);
+	xnlock_put_irqrestore(&nklock, s);
+	xnfree(item);
+
+	return ret;
+}
+
+static void epoll_del(struct cobalt_epoll *ep, struct cobalt_epitem *item)
+{
+	spl_t s;
+
+	xnselector_unbind(ep->selector, xnid_key(&item->id));
+	xnlock_get_irqsave(&nklock, s);
+	xnid_remove(&ep->items, &item->id);
+	xnlock_put_irqrestore(&nklock, s);
+	xnfree(item);
+}
+
+static int epoll_mod(struct cobalt_epoll *ep, struct cobalt_epitem *item,
+		     const struct epoll_event *ev)
+{
+	int fd = xnid_key(&item->id), ret;
+	spl_t s;
+
+	xnselector_unbind(ep->selector, fd);
+
+	xnlock_get_irqsave(&nklock, s);
+	item->events = ev->events;
+	item->data = ev->data;
+	xnlock_put_irqrestore(&nklock, s);
+
+	/* Do not leave a deaf item behind if rebinding fails. */
+	ret = epoll_bind(ep, fd, ev->events);
+	if (ret)
+		epoll_del(ep, item);
+
+	return ret;
+}
+
+COBALT_SYSCALL(epoll_ctl, primary,
+	       (int epfd, int op, int fd, struct epoll_event __user *u_event))
+{
+	struct cobalt_epitem *item;
+	struct cobalt_epoll *ep;
+	struct epoll_event ev;
+	int ret;
+
+	switch (op) {
+	case EPOLL_CTL_ADD:
+	case EPOLL_CTL_MOD:
+		ret = cobalt_copy_from_user(&ev, u_event, sizeof(ev));
+		if (ret)
+			return ret;
+		/* Hangups are always reported, no edge-triggering. */
+		if (ev.events & ~(COBALT_EPOLL_EVENTS | POLLERR | POLLHUP))
+			return -EINVAL;
+		if ((ev.events & COBALT_EPOLL_EVENTS) == 0)
+			return -EINVAL;
+		break;
+	case EPOLL_CTL_DEL:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (fd < 0 || fd == epfd)
+		return -EINVAL;
+
+	ep = epoll_get(epfd);
+	if (IS_ERR(ep))
+		return PTR_ERR(ep);
+
+	ret = rtdm_mutex_lock(&ep->lock);
+	if (ret)
+		goto out;
+
+	item = epoll_lookup(ep, fd);
+
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		ret = item ? -EEXIST : epoll_add(ep, fd, &ev);
+		break;
+	case EPOLL_CTL_MOD:
+		ret = item ? epoll_mod(ep, item, &ev) : -ENOENT;
+		break;
+	default:
+		if (item)
+			epoll_del(ep, item);
+		else
+			ret = -ENOENT;
+	}
+
+	rtdm_mutex_unlock(&ep->lock);
+out:
+	epoll_put(ep);
+
+	return ret;
+}
+
+int __cobalt_epoll_wait(int epfd, struct epoll_event __user *u_events,
+			int maxevents, const struct timespec *ts)
+{
+	struct cobalt_epitem *item, *items[COBALT_EPOLL_BATCH];
+	struct xnselect_event rev[COBALT_EPOLL_BATCH];
+	struct epoll_event ev[COBALT_EPOLL_BATCH];
+	xnticks_t timeout = XN_INFINITE;
+	xntmode_t tmode = XN_RELATIVE;
+	struct cobalt_epoll *ep;
+	int ret, n, i, j, nev;
+	spl_t s;
+
+	if (maxevents <= 0)
+		return -EINVAL;
+
+	/*
+	 * The ready list is rotated on each call, so capping the
+	 * batch size does not starve any descriptor.
+	 */
+	if (maxevents > COBALT_EPOLL_BATCH)
+		maxevents = COBALT_EPOLL_BATCH;
+
+	if (ts) {
+		if ((unsigned long)ts->tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+		timeout = ts2ns(ts);
+		if (timeout) {
+			timeout++;
+			tmode = XN_ABSOLUTE;
+		} else
+			timeout = XN_NONBLOCK;
+	}
+
+	ep = epoll_get(epfd);
+	if (IS_ERR(ep))
+		return PTR_ERR(ep);
+
+	do {
+		n = xnselect_collect(ep->selector, rev, maxevents,
+				     timeout, tmode);
+		if (n <= 0) {
+			ret = n;
+			goto out;
+		}
+
+		/*
+		 * Merge the events by descriptor. Events for items
+		 * which were dropped meanwhile are ignored.
+		 */
+		nev = 0;
+		xnlock_get_irqsave(&nklock, s);
+		for (i = 0; i < n; i++) {
+			item = epoll_lookup(ep, rev[i].bit_index);
+			if (item == NULL)
+				continue;
+			for (j = 0; j < nev; j++)
+				if (items[j] == item)
+					break;
+			if (j == nev) {
+				items[nev] = item;
+				ev[nev].events = 0;
+				ev[nev].data = item->data;
+				nev++;
+			}
+			if (rev[i].hangup)
+				ev[j].events |= POLLHUP;
+			else
+				ev[j].events |= epoll_types[rev[i].type] & item->events;
+		}
+		xnlock_put_irqrestore(&nklock, s);
+	} while (nev == 0);
+
+	ret = cobalt_copy_to_user(u_events, ev, nev * sizeof(ev[0]));
+	if (ret == 0)
+		ret = nev;
+out:
+	epoll_put(ep);
+
+	return ret;
+}
+
+COBALT_SYSCALL(epoll_wait, primary,
+	       (int epfd, struct epoll_event __user *u_events,
+		int maxevents, const struct timespec __user *u_ts))
+{
+	struct timespec ts, *tsp = NULL;
+	int ret;
+
+	if (u_ts) {
+		tsp = &ts;
+		ret = cobalt_copy_from_user(&ts, u_ts, sizeof(ts));
+		if (ret)
+			return ret;
+	}
+
+	return __cobalt_epoll_wait(epfd, u_events, maxevents, tsp);
+}
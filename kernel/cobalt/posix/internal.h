@@ -41,6 +41,7 @@
 #define COBALT_EVENT_MAGIC	COBALT_MAGIC(0F)
 #define COBALT_MONITOR_MAGIC	COBALT_MAGIC(10)
 #define COBALT_TIMERFD_MAGIC	COBALT_MAGIC(11)
+#define COBALT_EPOLL_MAGIC	COBALT_MAGIC(12)
 
 #define cobalt_obj_active(h,m,t)	\
 	((h) && ((t *)(h))->magic == (m))
@@ -55,4 +56,12 @@ static inline xnhandle_t cobalt_get_handle_from_user(xnhandle_t *u_h)
 
 int cobalt_init(void);
 
+extern struct xnobjcache cobalt_mutex_cache;
+
+extern struct xnobjcache cobalt_sem_cache;
+
+extern struct xnobjcache cobalt_cond_cache;
+
+extern struct xnobjcache cobalt_timer_cache;
+
 #endif /* !_COBALT_POSIX_INTERNAL_H */
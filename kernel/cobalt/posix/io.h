@@ -54,6 +54,14 @@ COBALT_SYSCALL_DECL(recvmsg,
 COBALT_SYSCALL_DECL(sendmsg,
 		    (int fd, struct msghdr __user *umsg, int flags));
 
+COBALT_SYSCALL_DECL(recvmmsg,
+		    (int fd, struct mmsghdr __user *u_msgvec, unsigned int vlen,
+		     unsigned int flags, struct timespec __user *u_timeout));
+
+COBALT_SYSCALL_DECL(sendmmsg,
+		    (int fd, struct mmsghdr __user *u_msgvec,
+		     unsigned int vlen, unsigned int flags));
+
 COBALT_SYSCALL_DECL(mmap,
 		    (int fd, struct _rtdm_mmap_request __user *u_rma,
 		     void __user * __user *u_addrp));
@@ -21,6 +21,7 @@
 #include <linux/mm.h>
 #include <cobalt/kernel/select.h>
 #include <rtdm/fd.h>
+#include <cobalt/uapi/mq.h>
 #include "internal.h"
 #include "thread.h"
 #include "signal.h"
@@ -32,6 +33,7 @@
 #define COBALT_MSGMAX		65536
 #define COBALT_MSGSIZEMAX	(16*1024*1024)
 #define COBALT_MSGPRIOMAX	32768
+#define COBALT_MQ_UMM_SHARE	8
 
 struct cobalt_mq {
 	unsigned magic;
@@ -45,6 +47,18 @@ struct cobalt_mq {
 	struct list_head queued;
 	struct list_head avail;
 	int nrqueued;
+	/* Default priority messages spilled to mq->queued. */
+	int nrspill;
+
+	/* Message pool mapped to the owner process (fast path). */
+	struct cobalt_mq_state *state;
+	struct cobalt_umm *umm;
+	struct cobalt_mq_cell *qcells;
+	struct cobalt_mq_cell *acells;
+	struct cobalt_msg *msgs;
+	char *data;
+	__u32 mask;
+	__u32 msgsize;
 
 	/* mq_notify */
 	struct siginfo si;
@@ -70,7 +84,9 @@ struct cobalt_msg {
 	struct list_head link;
 	unsigned int prio;
 	size_t len;
-	char data[0];
+	char *data;
+	/* Owned by the core, i.e. not reachable from the rings. */
+	int held;
 };
 
 struct cobalt_mqwait_context {
@@ -85,22 +101,281 @@ static struct mq_attr default_attr = {
 
 static LIST_HEAD(cobalt_mqq);
 
+static inline struct cobalt_mq_msg *mq_msg_slot(struct cobalt_mq *mq, __u32 index)
+{
+	return (struct cobalt_mq_msg *)(mq->data + index * mq->msgsize);
+}
+
+/*
+ * With a mapped pool, the rings live in memory the owner process
+ * may write to, so indices read back from them are checked before
+ * use: out of range indices, and indices of slots the core already
+ * owns are dropped, leaking the slot. The ownership of a slot is
+ * only tracked by the core, under nklock.
+ */
+static struct cobalt_msg *mq_msg_claim(struct cobalt_mq *mq, __u32 index)
+{
+	struct cobalt_msg *msg;
+
+	if (index >= mq->attr.mq_maxmsg)
+		return NULL;
+
+	msg = mq->msgs + index;
+	if (msg->held)
+		return NULL;
+
+	msg->held = 1;
+
+	return msg;
+}
+
+static struct cobalt_msg *mq_msg_pop(struct cobalt_mq *mq,
+				     struct cobalt_mq_ring *ring,
+				     struct cobalt_mq_cell *cells)
+{
+	__u32 index;
+
+	if (cobalt_mq_ring_pop(ring, cells, mq->mask, &index))
+		return NULL;
+
+	return mq_msg_claim(mq, index);
+}
+
+/*
+ * A push may fail even though the ring has room, when a user-space
+ * thread which is past its cmpxchg on the head did not release the
+ * cell yet. The caller must then keep the message on its own lists.
+ */
+static int mq_msg_push(struct cobalt_mq *mq,
+		       struct cobalt_mq_ring *ring,
+		       struct cobalt_mq_cell *cells,
+		       struct cobalt_msg *msg)
+{
+	if (cobalt_mq_ring_push(ring, cells, mq->mask, msg - mq->msgs))
+		return -EAGAIN;
+
+	msg->held = 0;
+
+	return 0;
+}
+
+/*
+ * Free slots the core could not push back to the avail ring are
+ * kept in mq->avail, which is drained first.
+ */
 static inline struct cobalt_msg *mq_msg_alloc(struct cobalt_mq *mq)
 {
 	if (list_empty(&mq->avail))
-		return NULL;
+		return mq->state ?
+			mq_msg_pop(mq, &mq->state->avail, mq->acells) : NULL;
 
 	return list_get_entry(&mq->avail, struct cobalt_msg, link);
 }
 
 static inline void mq_msg_free(struct cobalt_mq *mq, struct cobalt_msg * msg)
 {
-	list_add(&msg->link, &mq->avail); /* For earliest re-use of the block. */
+	if (mq->state == NULL ||
+	    mq_msg_push(mq, &mq->state->avail, mq->acells, msg))
+		list_add(&msg->link, &mq->avail); /* For earliest re-use of the block. */
+}
+
+static inline int mq_avail_p(struct cobalt_mq *mq)
+{
+	if (!list_empty(&mq->avail))
+		return 1;
+
+	return mq->state &&
+		!cobalt_mq_ring_empty_p(&mq->state->avail,
+					mq->acells, mq->mask);
+}
+
+/*
+ * With a mapped pool, messages sent at the default priority go to
+ * the ring user-space may drain directly, others are queued by
+ * priority order to mq->queued, which is served first.
+ *
+ * Default priority messages the core could not push to the ring
+ * are queued at the tail of mq->queued instead, and so are all the
+ * following ones until this spill list drains, so that FIFO order
+ * is kept. COBALT_MQ_SPILL tells fast path senders to defer to the
+ * core meanwhile.
+ */
+static inline int mq_queued_p(struct cobalt_mq *mq)
+{
+	if (!list_empty(&mq->queued))
+		return 1;
+
+	return mq->state &&
+		!cobalt_mq_ring_empty_p(&mq->state->queued,
+					mq->qcells, mq->mask);
+}
+
+static inline int mq_nrqueued(struct cobalt_mq *mq)
+{
+	return mq->state ? atomic_read(&mq->state->nrqueued) : mq->nrqueued;
+}
+
+static void mq_msg_enqueue(struct cobalt_mq *mq, struct cobalt_msg *msg)
+{
+	struct cobalt_mq_state *state = mq->state;
+
+	if (state == NULL) {
+		list_add_priff(msg, &mq->queued, prio, link);
+		mq->nrqueued++;
+		return;
+	}
+
+	atomic_inc(&state->nrqueued);
+
+	if (msg->prio > 0) {
+		list_add_priff(msg, &mq->queued, prio, link);
+		atomic_inc(&state->nrprio);
+		return;
+	}
+
+	mq_msg_slot(mq, msg - mq->msgs)->len = msg->len;
+	if (mq->nrspill == 0 &&
+	    mq_msg_push(mq, &state->queued, mq->qcells, msg) == 0)
+		return;
+
+	list_add_tail(&msg->link, &mq->queued);
+	if (mq->nrspill++ == 0)
+		state->flags |= COBALT_MQ_SPILL;
+}
+
+static struct cobalt_msg *mq_msg_dequeue(struct cobalt_mq *mq)
+{
+	struct cobalt_mq_state *state = mq->state;
+	struct cobalt_msg *msg;
+	__u32 index;
+
+	if (state == NULL) {
+		if (list_empty(&mq->queued))
+			return NULL;
+		mq->nrqueued--;
+		return list_get_entry(&mq->queued, struct cobalt_msg, link);
+	}
+
+	if (!list_empty(&mq->queued)) {
+		msg = list_first_entry(&mq->queued, struct cobalt_msg, link);
+		if (msg->prio > 0) {
+			list_del(&msg->link);
+			atomic_dec(&state->nrprio);
+			goto out;
+		}
+	}
+
+	/* The ring holds the oldest default priority messages. */
+	msg = mq_msg_pop(mq, &state->queued, mq->qcells);
+	if (msg) {
+		index = msg - mq->msgs;
+		msg->len = min_t(size_t, mq_msg_slot(mq, index)->len,
+				 mq->attr.mq_msgsize);
+		msg->prio = 0;
+		goto out;
+	}
+
+	if (list_empty(&mq->queued))
+		return NULL;
+
+	msg = list_get_entry(&mq->queued, struct cobalt_msg, link);
+	if (--mq->nrspill == 0)
+		state->flags &= ~COBALT_MQ_SPILL;
+out:
+	atomic_dec(&state->nrqueued);
+
+	return msg;
+}
+
+/*
+ * Try laying out the message pool in the private heap of the
+ * creating process, so that its threads may exchange messages
+ * without issuing any syscall in the uncontended case. A pool may
+ * not take more than 1/COBALT_MQ_UMM_SHARE of the heap, and may
+ * never bring its free space below one half, which is kept for the
+ * mutexes, semaphores, condvars and events of the process. We fall
+ * back to a kernel-only pool otherwise.
+ */
+static int mq_init_umm(struct cobalt_mq *mq, const struct mq_attr *attr)
+{
+	struct cobalt_mq_state *state;
+	__u32 nr, cellsz, hdrsz, heapsz, i;
+	struct cobalt_ppd *sys_ppd;
+	u64 size;
+
+	sys_ppd = cobalt_ppd_get(0);
+	if (sys_ppd == &cobalt_kernel_ppd)
+		return -EPERM;
+
+	nr = roundup_pow_of_two(attr->mq_maxmsg);
+	cellsz = nr * sizeof(struct cobalt_mq_cell);
+	hdrsz = ALIGN(sizeof(*state) + 2 * cellsz, 8);
+	mq->msgsize = ALIGN(sizeof(struct cobalt_mq_msg) + attr->mq_msgsize, 8);
+	size = hdrsz + (u64)mq->msgsize * attr->mq_maxmsg;
+	heapsz = xnheap_get_size(&sys_ppd->umm.heap);
+	if (size > heapsz / COBALT_MQ_UMM_SHARE ||
+	    size + heapsz / 2 > xnheap_get_free(&sys_ppd->umm.heap))
+		return -ENOSPC;
+
+	mq->msgs = kmalloc(attr->mq_maxmsg * sizeof(*mq->msgs), GFP_KERNEL);
+	if (mq->msgs == NULL)
+		return -ENOMEM;
+
+	state = cobalt_umm_alloc(&sys_ppd->umm, size);
+	if (state == NULL) {
+		kfree(mq->msgs);
+		return -ENOSPC;
+	}
+
+	mq->qcells = (struct cobalt_mq_cell *)(state + 1);
+	mq->acells = mq->qcells + nr;
+	mq->data = (char *)state + hdrsz;
+	mq->mask = nr - 1;
+
+	state->flags = 0;
+	state->mask = mq->mask;
+	state->maxmsg = attr->mq_maxmsg;
+	state->maxlen = attr->mq_msgsize;
+	state->msgsize = mq->msgsize;
+	state->data_offset = hdrsz;
+	atomic_set(&state->nrqueued, 0);
+	atomic_set(&state->nrprio, 0);
+	atomic_set(&state->rcv_waiters, 0);
+	atomic_set(&state->snd_waiters, 0);
+	state->queued.cells_offset = (char *)mq->qcells - (char *)state;
+	atomic_set(&state->queued.head, 0);
+	atomic_set(&state->queued.tail, 0);
+	state->avail.cells_offset = (char *)mq->acells - (char *)state;
+	atomic_set(&state->avail.head, 0);
+	atomic_set(&state->avail.tail, attr->mq_maxmsg);
+
+	for (i = 0; i < nr; i++) {
+		atomic_set(&mq->qcells[i].seq, i);
+		mq->qcells[i].index = 0;
+		if (i < attr->mq_maxmsg) {
+			/* Pre-filled slot, ready for consumption. */
+			atomic_set(&mq->acells[i].seq, i + 1);
+			mq->acells[i].index = i;
+			mq->msgs[i].data = mq_msg_slot(mq, i)->data;
+			mq->msgs[i].held = 0;
+		} else {
+			atomic_set(&mq->acells[i].seq, i);
+			mq->acells[i].index = 0;
+		}
+	}
+
+	atomic_inc(&sys_ppd->umm.refcount);
+	mq->umm = &sys_ppd->umm;
+	smp_wmb();
+	mq->state = state;
+
+	return 0;
 }
 
 static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 {
 	unsigned i, msgsize, memsize;
+	struct cobalt_msg *msg;
 	char *mem;
 
 	if (attr == NULL)
@@ -114,6 +389,12 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 			return -EINVAL;
 	}
 
+	mq->state = NULL;
+	mq->mem = NULL;
+	INIT_LIST_HEAD(&mq->avail);
+	if (mq_init_umm(mq, attr) == 0)
+		goto init_queue;
+
 	msgsize = attr->mq_msgsize + sizeof(struct cobalt_msg);
 
 	/* Align msgsize on natural boundary. */
@@ -131,19 +412,20 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 		return -ENOSPC;
 
 	mq->memsize = memsize;
-	INIT_LIST_HEAD(&mq->queued);
-	mq->nrqueued = 0;
-	xnsynch_init(&mq->receivers, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
-	xnsynch_init(&mq->senders, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
 	mq->mem = mem;
 
 	/* Fill the pool. */
-	INIT_LIST_HEAD(&mq->avail);
 	for (i = 0; i < attr->mq_maxmsg; i++) {
-		struct cobalt_msg *msg = (struct cobalt_msg *) (mem + i * msgsize);
+		msg = (struct cobalt_msg *) (mem + i * msgsize);
+		msg->data = (char *)(msg + 1);
 		mq_msg_free(mq, msg);
 	}
-
+init_queue:
+	INIT_LIST_HEAD(&mq->queued);
+	mq->nrqueued = 0;
+	mq->nrspill = 0;
+	xnsynch_init(&mq->receivers, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
+	xnsynch_init(&mq->senders, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
 	mq->attr = *attr;
 	mq->target = NULL;
 	xnselect_init(&mq->read_select);
@@ -167,7 +449,12 @@ static inline void mq_destroy(struct cobalt_mq *mq)
 	xnselect_destroy(&mq->read_select);
 	xnselect_destroy(&mq->write_select);
 	xnregistry_remove(mq->handle);
-	free_pages_exact(mq->mem, mq->memsize);
+	if (mq->state) {
+		cobalt_umm_free(mq->umm, mq->state);
+		cobalt_umm_destroy(mq->umm);
+		kfree(mq->msgs);
+	} else
+		free_pages_exact(mq->mem, mq->memsize);
 	kfree(mq);
 
 	if (resched)
@@ -232,7 +519,7 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->read_select, binding,
 				selector, type, index,
-				!list_empty(&mq->queued));
+				mq_queued_p(mq));
 		if (err)
 			goto unlock_and_error;
 		break;
@@ -244,11 +531,14 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->write_select, binding,
 				selector, type, index,
-				!list_empty(&mq->avail));
+				mq_avail_p(mq));
 		if (err)
 			goto unlock_and_error;
 		break;
 	}
+	/* Fast path users must now kick us on state changes. */
+	if (mq->state)
+		mq->state->flags |= COBALT_MQ_SELECT;
 	xnlock_put_irqrestore(&nklock, s);
 	return 0;
 
@@ -427,7 +717,7 @@ mq_trysend(struct cobalt_mqd *mqd, size_t len)
 	if (msg == NULL)
 		return ERR_PTR(-EAGAIN);
 
-	if (list_empty(&mq->avail))
+	if (!mq_avail_p(mq))
 		xnselect_signal(&mq->write_select, 0);
 
 	return msg;
@@ -449,13 +739,11 @@ mq_tryrcv(struct cobalt_mqd *mqd, size_t len)
 	if (len < mq->attr.mq_msgsize)
 		return ERR_PTR(-EMSGSIZE);
 
-	if (list_empty(&mq->queued))
+	msg = mq_msg_dequeue(mq);
+	if (msg == NULL)
 		return ERR_PTR(-EAGAIN);
 
-	msg = list_get_entry(&mq->queued, struct cobalt_msg, link);
-	mq->nrqueued--;
-
-	if (list_empty(&mq->queued))
+	if (!mq_queued_p(mq))
 		xnselect_signal(&mq->read_select, 0);
 
 	return msg;
@@ -501,8 +789,26 @@ redo:
 	}
 
 	mq = mqd->mq;
+	if (mq->state) {
+		/*
+		 * Ask fast path receivers to kick us, then look
+		 * again for a slot they might have released in the
+		 * meantime.
+		 */
+		atomic_inc(&mq->state->snd_waiters);
+		smp_mb();
+		msg = mq_trysend(mqd, len);
+		if (msg != ERR_PTR(-EAGAIN)) {
+			atomic_dec(&mq->state->snd_waiters);
+			goto out;
+		}
+	}
+
+	mwc.msg = NULL;
 	xnthread_prepare_wait(&mwc.wc);
 	ret = xnsynch_sleep_on(&mq->senders, to, tmode);
+	if (!(ret & XNRMID) && mq->state)
+		atomic_dec(&mq->state->snd_waiters);
 	if (ret) {
 		if (ret & XNBREAK)
 			msg = ERR_PTR(-EINTR);
@@ -510,6 +816,10 @@ redo:
 			msg = ERR_PTR(-ETIMEDOUT);
 		else if (ret & XNRMID)
 			msg = ERR_PTR(-EBADF);
+	} else if (mwc.msg == NULL) {
+		/* Kicked from the fast path, retry. */
+		xnlock_put_irqrestore(&nklock, s);
+		goto redo;
 	} else
 		msg = mwc.msg;
 out:
@@ -518,71 +828,110 @@ out:
 	return msg;
 }
 
-static void mq_release_msg(struct cobalt_mq *mq, struct cobalt_msg *msg)
+/*
+ * Pass a message to the first thread waiting on @synch. A NULL
+ * message just tells the waiter to look again at the rings.
+ */
+static void mq_handoff(struct xnsynch *synch, struct cobalt_msg *msg)
 {
 	struct cobalt_mqwait_context *mwc;
 	struct xnthread_wait_context *wc;
 	struct xnthread *thread;
 
+	thread = xnsynch_wakeup_one_sleeper(synch);
+	wc = xnthread_get_wait_context(thread);
+	mwc = container_of(wc, struct cobalt_mqwait_context, wc);
+	mwc->msg = msg;
+	xnthread_complete_wait(wc);
+}
+
+static void mq_release_msg(struct cobalt_mq *mq, struct cobalt_msg *msg)
+{
 	/*
 	 * Try passing the free message slot to a waiting sender, link
 	 * it to the free queue otherwise.
 	 */
-	if (xnsynch_pended_p(&mq->senders)) {
-		thread = xnsynch_wakeup_one_sleeper(&mq->senders);
-		wc = xnthread_get_wait_context(thread);
-		mwc = container_of(wc, struct cobalt_mqwait_context, wc);
-		mwc->msg = msg;
-		xnthread_complete_wait(wc);
-	} else {
+	if (xnsynch_pended_p(&mq->senders))
+		mq_handoff(&mq->senders, msg);
+	else {
 		mq_msg_free(mq, msg);
-		if (list_is_singular(&mq->avail))
+		if (mq->state || list_is_singular(&mq->avail))
 			xnselect_signal(&mq->write_select, 1);
 	}
 }
 
-static int
-mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
+static void mq_notify_target(struct cobalt_mq *mq)
 {
-	struct cobalt_mqwait_context *mwc;
-	struct xnthread_wait_context *wc;
 	struct cobalt_sigpending *sigp;
-	struct xnthread *thread;
-	struct cobalt_mq *mq;
-	spl_t s;
 
-	mq = mqd->mq;
+	if (mq->target == NULL)
+		return;
 
-	xnlock_get_irqsave(&nklock, s);
-	/* Can we do pipelined sending? */
-	if (xnsynch_pended_p(&mq->receivers)) {
-		thread = xnsynch_wakeup_one_sleeper(&mq->receivers);
-		wc = xnthread_get_wait_context(thread);
-		mwc = container_of(wc, struct cobalt_mqwait_context, wc);
-		mwc->msg = msg;
-		xnthread_complete_wait(wc);
-	} else {
+	sigp = cobalt_signal_alloc();
+	if (sigp) {
+		cobalt_copy_siginfo(SI_MESGQ, &sigp->si, &mq->si);
+		if (cobalt_signal_send(mq->target, sigp, 0) <= 0)
+			cobalt_signal_free(sigp);
+	}
+	mq->target = NULL;
+	if (mq->state)
+		mq->state->flags &= ~COBALT_MQ_NOTIFY;
+}
+
+/*
+ * Called on behalf of a fast path user which changed the state of
+ * the rings while some thread might depend on it.
+ */
+static void mq_kick(struct cobalt_mq *mq)
+{
+	int queued = mq_queued_p(mq);
+
+	if (queued && xnsynch_pended_p(&mq->receivers))
+		mq_handoff(&mq->receivers, NULL);
+	else if (queued)
+		mq_notify_target(mq);
+
+	if (mq_avail_p(mq) && xnsynch_pended_p(&mq->senders))
+		mq_handoff(&mq->senders, NULL);
+
+	xnselect_signal(&mq->read_select, queued);
+	xnselect_signal(&mq->write_select, mq_avail_p(mq));
+}
+
+/* Must be called with nklock locked irqs off. */
+static void __mq_finish_send(struct cobalt_mq *mq, struct cobalt_msg *msg)
+{
+	/*
+	 * Can we do pipelined sending? Not if fast path senders
+	 * queued messages which the waiting reader did not get yet.
+	 */
+	if (xnsynch_pended_p(&mq->receivers) && !mq_queued_p(mq))
+		mq_handoff(&mq->receivers, msg);
+	else {
 		/* Nope, have to go through the queue. */
-		list_add_priff(msg, &mq->queued, prio, link);
-		mq->nrqueued++;
+		mq_msg_enqueue(mq, msg);
 
 		/*
 		 * If first message and no pending reader, send a
 		 * signal if notification was enabled via mq_notify().
 		 */
-		if (list_is_singular(&mq->queued)) {
+		if (mq_nrqueued(mq) == 1) {
 			xnselect_signal(&mq->read_select, 1);
-			if (mq->target) {
-				sigp = cobalt_signal_alloc();
-				if (sigp) {
-					cobalt_copy_siginfo(SI_MESGQ, &sigp->si, &mq->si);
-					if (cobalt_signal_send(mq->target, sigp, 0) <= 0)
-						cobalt_signal_free(sigp);
-				}
-				mq->target = NULL;
-			}
+			mq_notify_target(mq);
 		}
+
+		if (mq->state && xnsynch_pended_p(&mq->receivers))
+			mq_handoff(&mq->receivers, NULL);
 	}
+}
+
+static int
+mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
+{
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	__mq_finish_send(mqd->mq, msg);
 	xnsched_run();
 	xnlock_put_irqrestore(&nklock, s);
 
@@ -630,11 +979,29 @@ redo:
 	}
 
 	mq = mqd->mq;
+	if (mq->state) {
+		/* Same as mq_timedsend_inner(), for fast path senders. */
+		atomic_inc(&mq->state->rcv_waiters);
+		smp_mb();
+		msg = mq_tryrcv(mqd, len);
+		if (msg != ERR_PTR(-EAGAIN)) {
+			atomic_dec(&mq->state->rcv_waiters);
+			goto out;
+		}
+	}
+
+	mwc.msg = NULL;
 	xnthread_prepare_wait(&mwc.wc);
 	ret = xnsynch_sleep_on(&mq->receivers, to, tmode);
-	if (ret == 0)
+	if (!(ret & XNRMID) && mq->state)
+		atomic_dec(&mq->state->rcv_waiters);
+	if (ret == 0) {
 		msg = mwc.msg;
-	else if (ret & XNRMID)
+		if (msg == NULL) {
+			xnlock_put_irqrestore(&nklock, s);
+			goto redo;
+		}
+	} else if (ret & XNRMID)
 		msg = ERR_PTR(-EBADF);
 	else if (ret & XNTIMEO)
 		msg = ERR_PTR(-ETIMEDOUT);
@@ -668,7 +1035,7 @@ static inline int mq_getattr(struct cobalt_mqd *mqd, struct mq_attr *attr)
 	*attr = mq->attr;
 	xnlock_get_irqsave(&nklock, s);
 	attr->mq_flags = rtdm_fd_flags(&mqd->fd);
-	attr->mq_curmsgs = mq->nrqueued;
+	attr->mq_curmsgs = mq_nrqueued(mq);
 	xnlock_put_irqrestore(&nklock, s);
 
 	return 0;
@@ -697,10 +1064,12 @@ mq_notify(struct cobalt_mqd *mqd, unsigned index, const struct sigevent *evp)
 		goto unlock_and_error;
 	}
 
-	if (evp == NULL || evp->sigev_notify == SIGEV_NONE)
+	if (evp == NULL || evp->sigev_notify == SIGEV_NONE) {
 		/* Here, mq->target == cobalt_current_thread() or NULL. */
 		mq->target = NULL;
-	else {
+		if (mq->state)
+			mq->state->flags &= ~COBALT_MQ_NOTIFY;
+	} else {
 		mq->target = thread;
 		mq->target_qd = index;
 		mq->si.si_signo = evp->sigev_signo;
@@ -715,6 +1084,8 @@ mq_notify(struct cobalt_mqd *mqd, unsigned index, const struct sigevent *evp)
 		 */
 		mq->si.si_pid = current->pid;
 		mq->si.si_uid = get_current_uuid();
+		if (mq->state)
+			mq->state->flags |= COBALT_MQ_NOTIFY;
 	}
 
 	xnlock_put_irqrestore(&nklock, s);
@@ -1004,3 +1375,92 @@ COBALT_SYSCALL(mq_timedreceive, primary,
 
 	return ret ?: cobalt_copy_to_user(u_len, &len, sizeof(*u_len));
 }
+
+COBALT_SYSCALL(mq_bind, current, (mqd_t uqd, __u32 __user *u_offset))
+{
+	struct cobalt_mqd *mqd;
+	struct cobalt_mq *mq;
+	__u32 offset = 0;
+	int ret = 0;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	/*
+	 * Only threads from the process owning the private heap the
+	 * message pool lives in may access it directly.
+	 */
+	mq = mqd->mq;
+	if (mq->state == NULL || mq->umm != &cobalt_ppd_get(0)->umm)
+		ret = -EOPNOTSUPP;
+	else
+		offset = cobalt_umm_offset(mq->umm, mq->state);
+
+	cobalt_mqd_put(mqd);
+
+	return ret ?: cobalt_copy_to_user(u_offset, &offset, sizeof(offset));
+}
+
+/*
+ * Fast path users call us to kick waiters, or to hand over a slot
+ * they could not push to a ring, either as a message sent at the
+ * default priority, or as a free slot.
+ */
+COBALT_SYSCALL(mq_wake, current, (mqd_t uqd, int op, __u32 index))
+{
+	struct cobalt_mqd *mqd;
+	struct cobalt_msg *msg;
+	struct cobalt_mq *mq;
+	int ret = 0;
+	spl_t s;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	mq = mqd->mq;
+	if (mq->state == NULL) {
+		ret = op == COBALT_MQ_WAKE ? 0 : -EOPNOTSUPP;
+		goto out;
+	}
+
+	/* Same as mq_bind, slots only belong to the owner process. */
+	if (op != COBALT_MQ_WAKE && mq->umm != &cobalt_ppd_get(0)->umm) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	xnlock_get_irqsave(&nklock, s);
+
+	switch (op) {
+	case COBALT_MQ_WAKE:
+		mq_kick(mq);
+		break;
+	case COBALT_MQ_SEND:
+	case COBALT_MQ_FREE:
+		msg = mq_msg_claim(mq, index);
+		if (msg == NULL) {
+			ret = -EINVAL;
+			break;
+		}
+		if (op == COBALT_MQ_FREE) {
+			mq_release_msg(mq, msg);
+			break;
+		}
+		msg->len = min_t(size_t, mq_msg_slot(mq, index)->len,
+				 mq->attr.mq_msgsize);
+		msg->prio = 0;
+		__mq_finish_send(mq, msg);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	xnsched_run();
+	xnlock_put_irqrestore(&nklock, s);
+out:
+	cobalt_mqd_put(mqd);
+
+	return ret;
+}
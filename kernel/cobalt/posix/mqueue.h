@@ -71,4 +71,8 @@ COBALT_SYSCALL_DECL(mq_timedreceive,
 COBALT_SYSCALL_DECL(mq_notify,
 		    (mqd_t fd, const struct sigevent *__user evp));
 
+COBALT_SYSCALL_DECL(mq_bind, (mqd_t uqd, __u32 __user *u_offset));
+
+COBALT_SYSCALL_DECL(mq_wake, (mqd_t uqd, int op, __u32 index));
+
 #endif /* !_COBALT_POSIX_MQUEUE_H */
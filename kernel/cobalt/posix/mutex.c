@@ -234,20 +234,20 @@ COBALT_SYSCALL(mutex_init, current,
 	if (cobalt_copy_from_user(&attr, u_attr, sizeof(attr)))
 		return -EFAULT;
 
-	mutex = xnmalloc(sizeof(*mutex));
+	mutex = xnobjcache_alloc(&cobalt_mutex_cache);
 	if (mutex == NULL)
 		return -ENOMEM;
 
 	state = cobalt_umm_alloc(&cobalt_ppd_get(attr.pshared)->umm,
 				 sizeof(*state));
 	if (state == NULL) {
-		xnfree(mutex);
+		xnobjcache_free(&cobalt_mutex_cache, mutex);
 		return -EAGAIN;
 	}
 
 	err = cobalt_mutex_init_inner(&mx, mutex, state, &attr);
 	if (err) {
-		xnfree(mutex);
+		xnobjcache_free(&cobalt_mutex_cache, mutex);
 		cobalt_umm_free(&cobalt_ppd_get(attr.pshared)->umm, state);
 		return err;
 	}
@@ -400,5 +400,5 @@ void cobalt_mutex_reclaim(struct cobalt_resnode *node, spl_t s)
 	xnlock_put_irqrestore(&nklock, s);
 
 	cobalt_umm_free(&cobalt_ppd_get(pshared)->umm, state);
-	xnfree(mutex);
+	xnobjcache_free(&cobalt_mutex_cache, mutex);
 }
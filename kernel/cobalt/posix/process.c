@@ -84,6 +84,14 @@ struct xnthread_personality *cobalt_personalities[NR_PERSONALITIES];
 
 static struct xnsynch yield_sync;
 
+struct xnobjcache cobalt_mutex_cache;
+
+struct xnobjcache cobalt_sem_cache;
+
+struct xnobjcache cobalt_cond_cache;
+
+struct xnobjcache cobalt_timer_cache;
+
 LIST_HEAD(cobalt_thread_list);
 
 struct cobalt_resources cobalt_global_resources = {
@@ -1456,6 +1464,44 @@ struct xnthread_personality cobalt_personality = {
 };
 EXPORT_SYMBOL_GPL(cobalt_personality);
 
+static struct {
+	struct xnobjcache *cache;
+	u32 objsize;
+	const char *name;
+} objcaches[] __initdata = {
+	{ &cobalt_mutex_cache, sizeof(struct cobalt_mutex), "mutex" },
+	{ &cobalt_sem_cache, sizeof(struct cobalt_sem), "sem" },
+	{ &cobalt_cond_cache, sizeof(struct cobalt_cond), "cond" },
+	{ &cobalt_timer_cache, sizeof(struct cobalt_timer), "timer" },
+};
+
+static __init int init_objcaches(void)
+{
+	int n, ret;
+
+	for (n = 0; n < ARRAY_SIZE(objcaches); n++) {
+		ret = xnobjcache_init(objcaches[n].cache, &cobalt_heap,
+				      objcaches[n].objsize, objcaches[n].name);
+		if (ret)
+			goto fail;
+	}
+
+	return 0;
+fail:
+	while (--n >= 0)
+		xnobjcache_destroy(objcaches[n].cache);
+
+	return ret;
+}
+
+static __init void cleanup_objcaches(void)
+{
+	int n;
+
+	for (n = 0; n < ARRAY_SIZE(objcaches); n++)
+		xnobjcache_destroy(objcaches[n].cache);
+}
+
 __init int cobalt_init(void)
 {
 	unsigned int i, size;
@@ -1485,6 +1531,10 @@ __init int cobalt_init(void)
 
 	xnsynch_init(&yield_sync, XNSYNCH_FIFO, NULL);
 
+	ret = init_objcaches();
+	if (ret)
+		goto fail_objcaches;
+
 	ret = cobalt_memdev_init();
 	if (ret)
 		goto fail_memdev;
@@ -1510,6 +1560,8 @@ fail_siginit:
 fail_register:
 	cobalt_memdev_cleanup();
 fail_memdev:
+	cleanup_objcaches();
+fail_objcaches:
 	xnsynch_destroy(&yield_sync);
 	xnarch_cleanup_mayday();
 fail_mayday:
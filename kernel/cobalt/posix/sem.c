@@ -78,7 +78,7 @@ int __cobalt_sem_destroy(xnhandle_t handle)
 	cobalt_umm_free(&cobalt_ppd_get(!!(sem->flags & SEM_PSHARED))->umm,
 			sem->state);
 
-	xnfree(sem);
+	xnobjcache_free(&cobalt_sem_cache, sem);
 
 	return ret;
 fail:
@@ -103,7 +103,7 @@ __cobalt_sem_init(const char *name, struct cobalt_sem_shadow *sm,
 		goto out;
 	}
 
-	sem = xnmalloc(sizeof(*sem));
+	sem = xnobjcache_alloc(&cobalt_sem_cache);
 	if (sem == NULL) {
 		ret = -ENOMEM;
 		goto out;
@@ -169,7 +169,7 @@ err_lock_put:
 	xnlock_put_irqrestore(&nklock, s);
 	cobalt_umm_free(&sys_ppd->umm, state);
 err_free_sem:
-	xnfree(sem);
+	xnobjcache_free(&cobalt_sem_cache, sem);
 out:
 	trace_cobalt_psem_init_failed(name ?: "anon", flags, value, ret);
 
@@ -37,6 +37,7 @@
 #include "timer.h"
 #include "monitor.h"
 #include "clock.h"
+#include "epoll.h"
 #include "event.h"
 #include "timerfd.h"
 #include "io.h"
@@ -417,6 +418,20 @@ static int get_conf_option(int option, void __user *u_buf, size_t u_bufsz)
 	case _CC_COBALT_GET_CORE_STATUS:
 		val = realtime_core_state();
 		break;
+	case _CC_COBALT_GET_TIMER_INDEX:
+		if (IS_ENABLED(CONFIG_XENO_OPT_TIMER_HEAP))
+			val = _CC_COBALT_TIMER_HEAP;
+		else if (IS_ENABLED(CONFIG_XENO_OPT_TIMER_RBTREE))
+			val = _CC_COBALT_TIMER_RBTREE;
+		else
+			val = _CC_COBALT_TIMER_LIST;
+		break;
+	case _CC_COBALT_GET_TIMER_CAPACITY:
+		/* Zero means unlimited. */
+#ifdef CONFIG_XENO_OPT_TIMER_HEAP
+		val = CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY;
+#endif
+		break;
 	default:
 		return -EINVAL;
 	}
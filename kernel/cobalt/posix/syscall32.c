@@ -32,6 +32,7 @@
 #include "signal.h"
 #include "monitor.h"
 #include "event.h"
+#include "epoll.h"
 #include "mqueue.h"
 #include "io.h"
 #include "../debug.h"
@@ -795,6 +796,72 @@ COBALT_SYSCALL32emu(sendmsg, probing,
 	return ret ?: rtdm_fd_sendmsg(fd, &m, flags);
 }
 
+static int get_mmsg32(struct rtdm_mmsghdr *mmsg, void __user *u_mmsg)
+{
+	struct compat_mmsghdr __user *u_cmmsg = u_mmsg;
+
+	return sys32_get_msghdr(&mmsg->msg_hdr, &u_cmmsg->msg_hdr);
+}
+
+static int put_mmsg32(void __user *u_mmsg, const struct rtdm_mmsghdr *mmsg)
+{
+	struct compat_mmsghdr __user *u_cmmsg = u_mmsg;
+
+	if (sys32_put_msghdr(&u_cmmsg->msg_hdr, &mmsg->msg_hdr) ||
+	    !access_wok(&u_cmmsg->msg_len, sizeof(u_cmmsg->msg_len)) ||
+	    __xn_put_user(mmsg->msg_len, &u_cmmsg->msg_len))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int get_timespec32(struct timespec *ts, const void __user *u_ts)
+{
+	return sys32_get_timespec(ts, u_ts);
+}
+
+COBALT_SYSCALL32emu(recvmmsg, probing,
+		    (int fd, struct compat_mmsghdr __user *u_msgvec,
+		     unsigned int vlen, unsigned int flags,
+		     struct compat_timespec __user *u_timeout))
+{
+	return __rtdm_fd_recvmmsg(fd, u_msgvec, vlen, flags, u_timeout,
+				  get_mmsg32, put_mmsg32,
+				  sizeof(struct compat_mmsghdr),
+				  get_timespec32);
+}
+
+COBALT_SYSCALL32emu(sendmmsg, probing,
+		    (int fd, struct compat_mmsghdr __user *u_msgvec,
+		     unsigned int vlen, unsigned int flags))
+{
+	return __rtdm_fd_sendmmsg(fd, u_msgvec, vlen, flags,
+				  get_mmsg32, put_mmsg32,
+				  sizeof(struct compat_mmsghdr));
+}
+
+/*
+ * struct epoll_event is packed on x86_64, so only the timeout needs
+ * conversion.
+ */
+COBALT_SYSCALL32emu(epoll_wait, primary,
+		    (int epfd, struct epoll_event __user *u_events,
+		     int maxevents,
+		     const struct compat_timespec __user *u_ts))
+{
+	struct timespec ts, *tsp = NULL;
+	int ret;
+
+	if (u_ts) {
+		tsp = &ts;
+		ret = sys32_get_timespec(&ts, u_ts);
+		if (ret)
+			return ret;
+	}
+
+	return __cobalt_epoll_wait(epfd, u_events, maxevents, tsp);
+}
+
 COBALT_SYSCALL32emu(mmap, lostage,
 		    (int fd, struct compat_rtdm_mmap_request __user *u_crma,
 		     compat_uptr_t __user *u_caddrp))
@@ -138,7 +138,7 @@ static inline int timer_create(clockid_t clockid,
 	if (cc == NULL)
 		return -EPERM;
 
-	timer = xnmalloc(sizeof(*timer));
+	timer = xnobjcache_alloc(&cobalt_timer_cache);
 	if (timer == NULL)
 		return -ENOMEM;
 
@@ -201,7 +201,7 @@ fail:
 out:
 	xnlock_put_irqrestore(&nklock, s);
 
-	xnfree(timer);
+	xnobjcache_free(&cobalt_timer_cache, timer);
 
 	return ret;
 }
@@ -255,7 +255,7 @@ timer_delete(timer_t timerid)
 
 	timer_cleanup(cc, timer);
 	xnlock_put_irqrestore(&nklock, s);
-	xnfree(timer);
+	xnobjcache_free(&cobalt_timer_cache, timer);
 
 	return ret;
 
@@ -595,7 +595,7 @@ void cobalt_timer_reclaim(struct cobalt_process *p)
 		cobalt_call_extension(timer_cleanup, &timer->extref, ret);
 		timer_cleanup(p, timer);
 		xnlock_put_irqrestore(&nklock, s);
-		xnfree(timer);
+		xnobjcache_free(&cobalt_timer_cache, timer);
 		xnlock_get_irqsave(&nklock, s);
 	}
 out:
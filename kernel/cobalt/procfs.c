@@ -24,6 +24,7 @@
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/timer.h>
 #include <cobalt/kernel/sched.h>
+#include <cobalt/kernel/synch.h>
 #include <xenomai/version.h>
 #include "debug.h"
 
@@ -225,6 +226,7 @@ void xnprocfs_cleanup_tree(void)
 	xnvfile_destroy_regular(&faults_vfile);
 	xnvfile_destroy_regular(&version_vfile);
 	xnvfile_destroy_regular(&latency_vfile);
+	xnsynch_cleanup_proc();
 	xnintr_cleanup_proc();
 	xnheap_cleanup_proc();
 	xnclock_cleanup_proc();
@@ -247,6 +249,7 @@ int __init xnprocfs_init_tree(void)
 	xnclock_init_proc();
 	xnheap_init_proc();
 	xnintr_init_proc();
+	xnsynch_init_proc();
 	xnvfile_init_regular("latency", &latency_vfile, &cobalt_vfroot);
 	xnvfile_init_regular("version", &version_vfile, &cobalt_vfroot);
 	xnvfile_init_regular("faults", &faults_vfile, &cobalt_vfroot);
@@ -83,30 +83,10 @@ nanosecs_abs_t rtdm_clock_read_monotonic(void);
  * @{
  */
 
-/**
- * @brief Initialise and start a real-time task
- *
- * After initialising a task, the task handle remains valid and can be
- * passed to RTDM services until either rtdm_task_destroy() or
- * rtdm_task_join() was invoked.
- *
- * @param[in,out] task Task handle
- * @param[in] name Optional task name
- * @param[in] task_proc Procedure to be executed by the task
- * @param[in] arg Custom argument passed to @c task_proc() on entry
- * @param[in] priority Priority of the task, see also
- * @ref rtdmtaskprio "Task Priority Range"
- * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
- * mode. Waiting for the first and subsequent periodic events is
- * done using rtdm_task_wait_period().
- *
- * @return 0 on success, otherwise negative error code
- *
- * @coretags{secondary-only, might-switch}
- */
-int rtdm_task_init(rtdm_task_t *task, const char *name,
-		   rtdm_task_proc_t task_proc, void *arg,
-		   int priority, nanosecs_rel_t period)
+static int __rtdm_task_init(rtdm_task_t *task, const char *name,
+			    rtdm_task_proc_t task_proc, void *arg,
+			    int priority, nanosecs_rel_t period,
+			    const struct cpumask *affinity)
 {
 	union xnsched_policy_param param;
 	struct xnthread_start_attr sattr;
@@ -116,7 +96,7 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	iattr.name = name;
 	iattr.flags = 0;
 	iattr.personality = &xenomai_personality;
-	iattr.affinity = CPU_MASK_ALL;
+	cpumask_copy(&iattr.affinity, affinity);
 	param.rt.prio = priority;
 
 	err = xnthread_init(task, &iattr, &xnsched_class_rt, &param);
@@ -150,8 +130,71 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	return err;
 }
 
+/**
+ * @brief Initialise and start a real-time task
+ *
+ * After initialising a task, the task handle remains valid and can be
+ * passed to RTDM services until either rtdm_task_destroy() or
+ * rtdm_task_join() was invoked.
+ *
+ * @param[in,out] task Task handle
+ * @param[in] name Optional task name
+ * @param[in] task_proc Procedure to be executed by the task
+ * @param[in] arg Custom argument passed to @c task_proc() on entry
+ * @param[in] priority Priority of the task, see also
+ * @ref rtdmtaskprio "Task Priority Range"
+ * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
+ * mode. Waiting for the first and subsequent periodic events is
+ * done using rtdm_task_wait_period().
+ *
+ * @return 0 on success, otherwise negative error code
+ *
+ * @coretags{secondary-only, might-switch}
+ */
+int rtdm_task_init(rtdm_task_t *task, const char *name,
+		   rtdm_task_proc_t task_proc, void *arg,
+		   int priority, nanosecs_rel_t period)
+{
+	return __rtdm_task_init(task, name, task_proc, arg,
+				priority, period, cpu_all_mask);
+}
+
 EXPORT_SYMBOL_GPL(rtdm_task_init);
 
+/**
+ * @brief Initialise and start a real-time task pinned to a CPU
+ *
+ * Same as rtdm_task_init(), except that the task is bound to a
+ * single CPU for its whole lifetime.
+ *
+ * @param[in,out] task Task handle
+ * @param[in] name Optional task name
+ * @param[in] task_proc Procedure to be executed by the task
+ * @param[in] arg Custom argument passed to @c task_proc() on entry
+ * @param[in] priority Priority of the task, see also
+ * @ref rtdmtaskprio "Task Priority Range"
+ * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
+ * mode.
+ * @param[in] cpu CPU the task should run on, which must be part of
+ * the real-time CPU set.
+ *
+ * @return 0 on success, otherwise negative error code
+ *
+ * @coretags{secondary-only, might-switch}
+ */
+int rtdm_task_init_on_cpu(rtdm_task_t *task, const char *name,
+			  rtdm_task_proc_t task_proc, void *arg,
+			  int priority, nanosecs_rel_t period, int cpu)
+{
+	if (!xnsched_supported_cpu(cpu))
+		return -EINVAL;
+
+	return __rtdm_task_init(task, name, task_proc, arg,
+				priority, period, cpumask_of(cpu));
+}
+
+EXPORT_SYMBOL_GPL(rtdm_task_init_on_cpu);
+
 #ifdef DOXYGEN_CPP /* Only used for doxygen doc generation */
 /**
  * @brief Destroy a real-time task
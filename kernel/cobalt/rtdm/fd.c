@@ -24,6 +24,7 @@
 #include <linux/poll.h>
 #include <linux/kthread.h>
 #include <linux/fdtable.h>
+#include <linux/percpu.h>
 #include <cobalt/kernel/registry.h>
 #include <cobalt/kernel/lock.h>
 #include <cobalt/kernel/ppd.h>
@@ -58,6 +59,62 @@ static void nop_close(struct rtdm_fd *fd)
 {
 }
 
+/*
+ * Descriptors numbered below CONFIG_XENO_OPT_RTDM_FDMAP are indexed
+ * directly in the per-process fdmap[] table, others go to the
+ * per-process rbtree. Updates to either are serialized by
+ * fdtree_lock, but the fdmap is read locklessly: a reader publishes
+ * an odd sequence number in its per-CPU rdseq slot for the duration
+ * of the lookup, with hard irqs off. A closer which unpublished a
+ * descriptor from the map waits for every CPU to leave any read
+ * section it may have been running at that time, before the
+ * reference held by the map is dropped. This guarantees that the
+ * descriptor memory is still valid when a reader grabs a reference
+ * on it.
+ */
+static DEFINE_PER_CPU(unsigned long, fdmap_rdseq);
+
+static inline bool fdmap_p(int ufd)
+{
+	return (unsigned int)ufd < CONFIG_XENO_OPT_RTDM_FDMAP;
+}
+
+static struct rtdm_fd *fdmap_get(struct cobalt_ppd *p, int ufd)
+{
+	unsigned long *rdseq;
+	struct rtdm_fd *fd;
+	spl_t s;
+
+	splhigh(s);
+	rdseq = raw_cpu_ptr(&fdmap_rdseq);
+	++*rdseq;
+	smp_mb();
+	fd = READ_ONCE(p->fdmap[ufd]);
+	if (fd && !atomic_inc_not_zero(&fd->refs))
+		fd = NULL;
+	smp_mb();
+	++*rdseq;
+	splexit(s);
+
+	return fd;
+}
+
+static void fdmap_sync(void)
+{
+	unsigned long snap;
+	int cpu;
+
+	smp_mb();
+
+	for_each_online_cpu(cpu) {
+		snap = READ_ONCE(per_cpu(fdmap_rdseq, cpu));
+		if ((snap & 1) == 0)
+			continue;
+		while (READ_ONCE(per_cpu(fdmap_rdseq, cpu)) == snap)
+			cpu_relax();
+	}
+}
+
 static inline struct rtdm_fd_index *
 fetch_fd_index(struct cobalt_ppd *p, int ufd)
 {
@@ -70,7 +127,12 @@ fetch_fd_index(struct cobalt_ppd *p, int ufd)
 
 static struct rtdm_fd *fetch_fd(struct cobalt_ppd *p, int ufd)
 {
-	struct rtdm_fd_index *idx = fetch_fd_index(p, ufd);
+	struct rtdm_fd_index *idx;
+
+	if (fdmap_p(ufd))
+		return p->fdmap[ufd];
+
+	idx = fetch_fd_index(p, ufd);
 	if (idx == NULL)
 		return NULL;
 
@@ -144,7 +206,7 @@ static inline void set_compat_bit(struct rtdm_fd *fd)
 int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 		  struct rtdm_fd_ops *ops)
 {
-	struct rtdm_fd_index *idx;
+	struct rtdm_fd_index *idx = NULL;
 	struct cobalt_ppd *ppd;
 	spl_t s;
 	int ret;
@@ -154,9 +216,11 @@ int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 	if (magic == 0)
 		return -EINVAL;
 
-	idx = kmalloc(sizeof(*idx), GFP_KERNEL);
-	if (idx == NULL)
-		return -ENOMEM;
+	if (!fdmap_p(ufd)) {
+		idx = kmalloc(sizeof(*idx), GFP_KERNEL);
+		if (idx == NULL)
+			return -ENOMEM;
+	}
 
 	assign_default_dual_handlers(ops->ioctl);
 	assign_default_dual_handlers(ops->read);
@@ -171,9 +235,23 @@ int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 	fd->magic = magic;
 	fd->ops = ops;
 	fd->owner = ppd;
-	fd->refs = 1;
+	atomic_set(&fd->refs, 1);
 	set_compat_bit(fd);
 
+	if (idx == NULL) {
+		xnlock_get_irqsave(&fdtree_lock, s);
+		if (ppd->fdmap[ufd])
+			ret = -EBUSY;
+		else {
+			/* Publish a fully initialized descriptor. */
+			smp_wmb();
+			WRITE_ONCE(ppd->fdmap[ufd], fd);
+			ret = 0;
+		}
+		xnlock_put_irqrestore(&fdtree_lock, s);
+		return ret;
+	}
+
 	idx->fd = fd;
 
 	xnlock_get_irqsave(&fdtree_lock, s);
@@ -207,6 +285,17 @@ struct rtdm_fd *rtdm_fd_get(int ufd, unsigned int magic)
 	struct rtdm_fd *fd;
 	spl_t s;
 
+	if (fdmap_p(ufd)) {
+		fd = fdmap_get(p, ufd);
+		if (fd == NULL)
+			return ERR_PTR(-EBADF);
+		if (magic != 0 && fd->magic != magic) {
+			rtdm_fd_put(fd);
+			return ERR_PTR(-EBADF);
+		}
+		return fd;
+	}
+
 	xnlock_get_irqsave(&fdtree_lock, s);
 	fd = fetch_fd(p, ufd);
 	if (fd == NULL || (magic != 0 && fd->magic != magic)) {
@@ -214,7 +303,7 @@ struct rtdm_fd *rtdm_fd_get(int ufd, unsigned int magic)
 		goto out;
 	}
 
-	++fd->refs;
+	atomic_inc(&fd->refs);
 out:
 	xnlock_put_irqrestore(&fdtree_lock, s);
 
@@ -259,14 +348,11 @@ static void lostage_trigger_close(struct ipipe_work_header *work)
 	up(&rtdm_fd_cleanup_sem);
 }
 
-static void __put_fd(struct rtdm_fd *fd, spl_t s)
+static void __put_fd(struct rtdm_fd *fd)
 {
-	int destroy;
-
-	destroy = --fd->refs == 0;
-	xnlock_put_irqrestore(&fdtree_lock, s);
+	spl_t s;
 
-	if (!destroy)
+	if (!atomic_dec_and_test(&fd->refs))
 		return;
 
 	if (ipipe_root_p)
@@ -299,10 +385,7 @@ static void __put_fd(struct rtdm_fd *fd, spl_t s)
  */
 void rtdm_fd_put(struct rtdm_fd *fd)
 {
-	spl_t s;
-
-	xnlock_get_irqsave(&fdtree_lock, s);
-	__put_fd(fd, s);
+	__put_fd(fd);
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_put);
 
@@ -322,15 +405,8 @@ EXPORT_SYMBOL_GPL(rtdm_fd_put);
  */
 int rtdm_fd_lock(struct rtdm_fd *fd)
 {
-	spl_t s;
-
-	xnlock_get_irqsave(&fdtree_lock, s);
-	if (fd->refs == 0) {
-		xnlock_put_irqrestore(&fdtree_lock, s);
+	if (!atomic_inc_not_zero(&fd->refs))
 		return -EIDRM;
-	}
-	++fd->refs;
-	xnlock_put_irqrestore(&fdtree_lock, s);
 
 	return 0;
 }
@@ -348,12 +424,9 @@ EXPORT_SYMBOL_GPL(rtdm_fd_lock);
  */
 void rtdm_fd_unlock(struct rtdm_fd *fd)
 {
-	spl_t s;
-
-	xnlock_get_irqsave(&fdtree_lock, s);
 	/* Warn if fd was unreferenced. */
-	XENO_WARN_ON(COBALT, fd->refs <= 0);
-	__put_fd(fd, s);
+	XENO_WARN_ON(COBALT, atomic_read(&fd->refs) <= 0);
+	__put_fd(fd);
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_unlock);
 
@@ -566,18 +639,262 @@ out:
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_sendmsg);
 
+/*
+ * Messages are mirrored to kernel memory by small batches, so that
+ * the stack footprint remains bounded regardless of the vector
+ * length passed by the caller.
+ */
+#define RTDM_MMSG_BATCH  8
+
+static int fallback_recvmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			     unsigned int vlen, int flags)
+{
+	unsigned int n;
+	ssize_t ret;
+
+	for (n = 0; n < vlen; n++) {
+		if (ipipe_root_p)
+			ret = fd->ops->recvmsg_nrt(fd, &msgvec[n].msg_hdr, flags);
+		else
+			ret = fd->ops->recvmsg_rt(fd, &msgvec[n].msg_hdr, flags);
+		if (ret < 0)
+			return n > 0 ? n : ret;
+		msgvec[n].msg_len = ret;
+		/* Only wait for the first message. */
+		flags |= MSG_DONTWAIT;
+	}
+
+	return n;
+}
+
+static int fallback_sendmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			     unsigned int vlen, int flags)
+{
+	unsigned int n;
+	ssize_t ret;
+
+	for (n = 0; n < vlen; n++) {
+		if (ipipe_root_p)
+			ret = fd->ops->sendmsg_nrt(fd, &msgvec[n].msg_hdr, flags);
+		else
+			ret = fd->ops->sendmsg_rt(fd, &msgvec[n].msg_hdr, flags);
+		if (ret < 0)
+			return n > 0 ? n : ret;
+		msgvec[n].msg_len = ret;
+	}
+
+	return n;
+}
+
+int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags, void __user *u_timeout,
+		       int (*get_mmsg)(struct rtdm_mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*put_mmsg)(void __user *u_mmsg, const struct rtdm_mmsghdr *mmsg),
+		       size_t mmsgsz,
+		       int (*get_timespec)(struct timespec *ts, const void __user *u_ts))
+{
+	int (*handler)(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+		       unsigned int vlen, int flags);
+	struct rtdm_mmsghdr mmsg[RTDM_MMSG_BATCH];
+	unsigned int datagrams = 0, batch, n;
+	nanosecs_abs_t deadline = 0;
+	struct rtdm_fd *fd;
+	struct timespec ts;
+	int ret, wflags;
+
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	if (u_timeout) {
+		ret = get_timespec(&ts, u_timeout);
+		if (ret)
+			return ret;
+		if (!timespec_valid(&ts))
+			return -EINVAL;
+		deadline = rtdm_clock_read_monotonic() + timespec_to_ns(&ts);
+	}
+
+	fd = rtdm_fd_get(ufd, 0);
+	if (IS_ERR(fd)) {
+		ret = PTR_ERR(fd);
+		goto out;
+	}
+
+	set_compat_bit(fd);
+
+	trace_cobalt_fd_recvmmsg(current, fd, ufd, flags);
+
+	if (ipipe_root_p)
+		handler = fd->ops->recvmmsg_nrt ?: fallback_recvmmsg;
+	else
+		handler = fd->ops->recvmmsg_rt ?: fallback_recvmmsg;
+
+	/*
+	 * Handlers wait for the first message of each batch only,
+	 * MSG_WAITFORONE is dealt with here.
+	 */
+	wflags = flags & ~MSG_WAITFORONE;
+	ret = 0;
+
+	while (datagrams < vlen) {
+		batch = min_t(unsigned int, vlen - datagrams, RTDM_MMSG_BATCH);
+		for (n = 0; n < batch; n++) {
+			ret = get_mmsg(&mmsg[n],
+				       u_msgvec + (datagrams + n) * mmsgsz);
+			if (ret)
+				goto done;
+		}
+
+		ret = handler(fd, mmsg, batch, wflags);
+		if (ret == -EOPNOTSUPP && handler != fallback_recvmmsg) {
+			/* Emulate batches from now on. */
+			handler = fallback_recvmmsg;
+			ret = handler(fd, mmsg, batch, wflags);
+		}
+		if (ret <= 0)
+			break;
+
+		for (n = 0; n < ret; n++) {
+			if (put_mmsg(u_msgvec + datagrams * mmsgsz, &mmsg[n])) {
+				ret = -EFAULT;
+				goto done;
+			}
+			datagrams++;
+		}
+
+		/* Stop if the input was drained in non-blocking mode. */
+		if (ret < batch && (wflags & MSG_DONTWAIT))
+			break;
+
+		if (flags & MSG_WAITFORONE)
+			wflags |= MSG_DONTWAIT;
+
+		if (u_timeout && rtdm_clock_read_monotonic() >= deadline)
+			break;
+	}
+done:
+	if (!XENO_ASSERT(COBALT, !spltest()))
+		splnone();
+
+	rtdm_fd_put(fd);
+
+	if (datagrams > 0)
+		return datagrams;
+out:
+	if (ret < 0)
+		trace_cobalt_fd_recvmmsg_status(current, fd, ufd, ret);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(__rtdm_fd_recvmmsg);
+
+int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags,
+		       int (*get_mmsg)(struct rtdm_mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*put_mmsg)(void __user *u_mmsg, const struct rtdm_mmsghdr *mmsg),
+		       size_t mmsgsz)
+{
+	int (*handler)(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+		       unsigned int vlen, int flags);
+	struct rtdm_mmsghdr mmsg[RTDM_MMSG_BATCH];
+	unsigned int datagrams = 0, batch, n;
+	struct rtdm_fd *fd;
+	int ret;
+
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	fd = rtdm_fd_get(ufd, 0);
+	if (IS_ERR(fd)) {
+		ret = PTR_ERR(fd);
+		goto out;
+	}
+
+	set_compat_bit(fd);
+
+	trace_cobalt_fd_sendmmsg(current, fd, ufd, flags);
+
+	if (ipipe_root_p)
+		handler = fd->ops->sendmmsg_nrt ?: fallback_sendmmsg;
+	else
+		handler = fd->ops->sendmmsg_rt ?: fallback_sendmmsg;
+
+	ret = 0;
+
+	while (datagrams < vlen) {
+		batch = min_t(unsigned int, vlen - datagrams, RTDM_MMSG_BATCH);
+		for (n = 0; n < batch; n++) {
+			ret = get_mmsg(&mmsg[n],
+				       u_msgvec + (datagrams + n) * mmsgsz);
+			if (ret)
+				goto done;
+		}
+
+		ret = handler(fd, mmsg, batch, flags);
+		if (ret == -EOPNOTSUPP && handler != fallback_sendmmsg) {
+			/* Emulate batches from now on. */
+			handler = fallback_sendmmsg;
+			ret = handler(fd, mmsg, batch, flags);
+		}
+		if (ret <= 0)
+			break;
+
+		for (n = 0; n < ret; n++) {
+			if (put_mmsg(u_msgvec + datagrams * mmsgsz, &mmsg[n])) {
+				ret = -EFAULT;
+				goto done;
+			}
+			datagrams++;
+		}
+
+		/* A short batch means that an error ended it. */
+		if (ret < batch)
+			break;
+	}
+done:
+	if (!XENO_ASSERT(COBALT, !spltest()))
+		splnone();
+
+	rtdm_fd_put(fd);
+
+	if (datagrams > 0)
+		return datagrams;
+out:
+	if (ret < 0)
+		trace_cobalt_fd_sendmmsg_status(current, fd, ufd, ret);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(__rtdm_fd_sendmmsg);
+
+/*
+ * Unpublish the descriptor, then drop the reference held by the
+ * index. Called with fdtree_lock held, which is released on exit.
+ */
 static void
-__fd_close(struct cobalt_ppd *p, struct rtdm_fd_index *idx, spl_t s)
+__fd_close(struct cobalt_ppd *p, int ufd, struct rtdm_fd *fd, spl_t s)
 {
-	xnid_remove(&p->fds, &idx->id);
-	__put_fd(idx->fd, s);
+	struct rtdm_fd_index *idx = NULL;
 
-	kfree(idx);
+	if (fdmap_p(ufd))
+		WRITE_ONCE(p->fdmap[ufd], NULL);
+	else {
+		idx = fetch_fd_index(p, ufd);
+		xnid_remove(&p->fds, &idx->id);
+	}
+
+	xnlock_put_irqrestore(&fdtree_lock, s);
+
+	if (idx)
+		kfree(idx);
+	else
+		fdmap_sync();
+
+	__put_fd(fd);
 }
 
 int rtdm_fd_close(int ufd, unsigned int magic)
 {
-	struct rtdm_fd_index *idx;
 	struct cobalt_ppd *ppd;
 	struct rtdm_fd *fd;
 	spl_t s;
@@ -587,20 +904,15 @@ int rtdm_fd_close(int ufd, unsigned int magic)
 	ppd = cobalt_ppd_get(0);
 
 	xnlock_get_irqsave(&fdtree_lock, s);
-	idx = fetch_fd_index(ppd, ufd);
-	if (idx == NULL)
-		goto ebadf;
-
-	fd = idx->fd;
-	if (magic != 0 && fd->magic != magic) {
-ebadf:
+	fd = fetch_fd(ppd, ufd);
+	if (fd == NULL || (magic != 0 && fd->magic != magic)) {
 		xnlock_put_irqrestore(&fdtree_lock, s);
 		return -EBADF;
 	}
 
 	set_compat_bit(fd);
 
-	trace_cobalt_fd_close(current, fd, ufd, fd->refs);
+	trace_cobalt_fd_close(current, fd, ufd, atomic_read(&fd->refs));
 
 	/*
 	 * In dual kernel mode, the linux-side fdtable and the RTDM
@@ -609,7 +921,7 @@ ebadf:
 	 * descriptor was removed from the fdtable if some refs on
 	 * rtdm_fd are still pending.
 	 */
-	__fd_close(ppd, idx, s);
+	__fd_close(ppd, ufd, fd, s);
 	__close_fd(current->files, ufd);
 
 	return 0;
@@ -655,6 +967,9 @@ int rtdm_fd_valid_p(int ufd)
 	struct rtdm_fd *fd;
 	spl_t s;
 
+	if (fdmap_p(ufd))
+		return READ_ONCE(cobalt_ppd_get(0)->fdmap[ufd]) != NULL;
+
 	xnlock_get_irqsave(&fdtree_lock, s);
 	fd = fetch_fd(cobalt_ppd_get(0), ufd);
 	xnlock_put_irqrestore(&fdtree_lock, s);
@@ -711,16 +1026,30 @@ static void destroy_fd(void *cookie, struct xnid *id)
 
 	idx = container_of(id, struct rtdm_fd_index, id);
 	xnlock_get_irqsave(&fdtree_lock, s);
-	__fd_close(p, idx, 0);
+	__fd_close(p, id->key, idx->fd, s);
 }
 
 void rtdm_fd_cleanup(struct cobalt_ppd *p)
 {
+	struct rtdm_fd *fd;
+	int ufd;
+	spl_t s;
+
 	/*
 	 * This is called on behalf of a (userland) task exit handler,
 	 * so we don't have to deal with the regular file descriptors,
 	 * we only have to empty our own index.
 	 */
+	for (ufd = 0; ufd < CONFIG_XENO_OPT_RTDM_FDMAP; ufd++) {
+		xnlock_get_irqsave(&fdtree_lock, s);
+		fd = p->fdmap[ufd];
+		if (fd == NULL) {
+			xnlock_put_irqrestore(&fdtree_lock, s);
+			continue;
+		}
+		__fd_close(p, ufd, fd, s);
+	}
+
 	xntree_cleanup(&p->fds, p, destroy_fd);
 }
 
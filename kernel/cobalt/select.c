@@ -45,6 +45,13 @@
  * - a @a struct @a xnselector structure, the selection structure,  passed by
  * the thread calling the xnselect service, where this service does all its
  * housekeeping.
+ *
+ * A selector may alternatively be initialized in queued mode with
+ * xnselector_init_queued(), for implementing epoll-like services:
+ * bindings are then persistent, and each binding is queued to the
+ * ready list of the selector when its file descriptor becomes ready,
+ * so that xnselect_collect() does not have to scan the whole set of
+ * file descriptors.
  * @{
  */
 
@@ -99,6 +106,9 @@ static inline int xnselect_wakeup(struct xnselector *selector)
  * the @a binding parameter must have been allocated by the caller outside the
  * locking section.
  *
+ * With a selector in queued mode, @a index is only used as a tag
+ * identifying the binding, and is not limited to __FD_SETSIZE.
+ *
  * @retval -EINVAL if @a type or @a index is invalid;
  * @retval 0 otherwise.
  *
@@ -113,7 +123,8 @@ int xnselect_bind(struct xnselect *select_block,
 {
 	atomic_only();
 
-	if (type >= XNSELECT_MAX_TYPES || index > __FD_SETSIZE)
+	if (type >= XNSELECT_MAX_TYPES ||
+	    (!selector->queued && index > __FD_SETSIZE))
 		return -EINVAL;
 
 	binding->selector = selector;
@@ -123,6 +134,17 @@ int xnselect_bind(struct xnselect *select_block,
 
 	list_add_tail(&binding->slink, &selector->bindings);
 	list_add_tail(&binding->link, &select_block->bindings);
+	INIT_LIST_HEAD(&binding->rlink);
+
+	if (selector->queued) {
+		if (state) {
+			list_add_tail(&binding->rlink, &selector->ready);
+			if (xnselect_wakeup(selector))
+				xnsched_run();
+		}
+		return 0;
+	}
+
 	__FD_SET__(index, &selector->fds[type].expected);
 	if (state) {
 		__FD_SET__(index, &selector->fds[type].pending);
@@ -144,6 +166,16 @@ int __xnselect_signal(struct xnselect *select_block, unsigned state)
 
 	list_for_each_entry(binding, &select_block->bindings, link) {
 		selector = binding->selector;
+		if (selector->queued) {
+			if (!state)
+				list_del_init(&binding->rlink);
+			else if (list_empty(&binding->rlink)) {
+				list_add_tail(&binding->rlink, &selector->ready);
+				if (xnselect_wakeup(selector))
+					resched = 1;
+			}
+			continue;
+		}
 		if (state) {
 			if (!__FD_ISSET__(binding->bit_index,
 					&selector->fds[binding->type].pending)) {
@@ -164,7 +196,10 @@ EXPORT_SYMBOL_GPL(__xnselect_signal);
 /**
  * Destroy the @a xnselect structure associated with a file descriptor.
  *
- * Any binding with a @a xnselector block is destroyed.
+ * Any binding with a @a xnselector block is destroyed, except for
+ * selectors in queued mode, which receive the binding back as a
+ * hangup event instead. Such bindings are eventually released by
+ * xnselector_unbind() or xnselector_destroy().
  *
  * @param select_block pointer to the @a xnselect structure associated
  * with a file descriptor
@@ -186,6 +221,14 @@ void xnselect_destroy(struct xnselect *select_block)
 	list_for_each_entry_safe(binding, tmp, &select_block->bindings, link) {
 		list_del(&binding->link);
 		selector = binding->selector;
+		if (selector->queued) {
+			binding->fd = NULL;
+			if (list_empty(&binding->rlink))
+				list_add_tail(&binding->rlink, &selector->ready);
+			if (xnselect_wakeup(selector))
+				resched = 1;
+			continue;
+		}
 		__FD_CLR__(binding->bit_index,
 			 &selector->fds[binding->type].expected);
 		if (!__FD_ISSET__(binding->bit_index,
@@ -289,11 +332,77 @@ int xnselector_init(struct xnselector *selector)
 		__FD_ZERO__(&selector->fds[i].pending);
 	}
 	INIT_LIST_HEAD(&selector->bindings);
+	INIT_LIST_HEAD(&selector->ready);
+	selector->queued = 0;
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(xnselector_init);
 
+/**
+ * Initialize a selector structure in queued mode.
+ *
+ * A selector in queued mode keeps its bindings until they are
+ * explicitly dropped by xnselector_unbind(), and queues them to a
+ * ready list as their file descriptors become ready. Such a selector
+ * must be waited for with xnselect_collect(), not xnselect().
+ *
+ * @param selector The selector structure to be initialized.
+ *
+ * @retval 0
+ *
+ * @coretags{task-unrestricted}
+ */
+int xnselector_init_queued(struct xnselector *selector)
+{
+	xnselector_init(selector);
+	selector->queued = 1;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnselector_init_queued);
+
+/**
+ * Drop the bindings of a file descriptor to a selector.
+ *
+ * All bindings established by xnselect_bind() with @a index to
+ * @a selector are destroyed, including the ones which are pending as
+ * hangup events.
+ *
+ * @param selector the selector block;
+ * @param index the index the file descriptor was bound with.
+ *
+ * @coretags{task-unrestricted}
+ */
+void xnselector_unbind(struct xnselector *selector, unsigned int index)
+{
+	struct xnselect_binding *binding, *tmp;
+	LIST_HEAD(unbound);
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry_safe(binding, tmp, &selector->bindings, slink) {
+		if (binding->bit_index != index)
+			continue;
+		list_del(&binding->slink);
+		if (binding->fd)
+			list_del(&binding->link);
+		list_del(&binding->rlink);
+		if (!selector->queued) {
+			__FD_CLR__(index, &selector->fds[binding->type].expected);
+			__FD_CLR__(index, &selector->fds[binding->type].pending);
+		}
+		list_add_tail(&binding->rlink, &unbound);
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	list_for_each_entry_safe(binding, tmp, &unbound, rlink)
+		xnfree(binding);
+}
+EXPORT_SYMBOL_GPL(xnselector_unbind);
+
 /**
  * Check the state of a number of file descriptors, wait for a state change if
  * no descriptor is ready.
@@ -384,6 +493,82 @@ int xnselect(struct xnselector *selector,
 }
 EXPORT_SYMBOL_GPL(xnselect);
 
+/**
+ * Collect the ready bindings of a selector in queued mode, wait for a
+ * state change if no binding is ready.
+ *
+ * The cost of this service only depends on the number of events
+ * returned, not on the number of bindings. A binding remains queued
+ * as long as its file descriptor is ready; the bindings returned are
+ * moved to the end of the ready list, so that successive calls
+ * eventually report all of them, even when @a maxevents is lower
+ * than the number of ready bindings.
+ *
+ * @param selector the selector, initialized by xnselector_init_queued();
+ * @param events the array receiving the ready bindings; the @a hangup
+ * field of an event is set when its file descriptor was closed;
+ * @param maxevents the size of the @a events array;
+ * @param timeout the timeout, whose meaning depends on @a timeout_mode,
+ * XN_NONBLOCK meaning not to wait at all;
+ * @param timeout_mode the mode of @a timeout.
+ *
+ * @retval -EINVAL if @a selector is not in queued mode, or @a maxevents
+ * is not strictly positive;
+ * @retval -EINTR if the caller was interrupted while waiting;
+ * @retval -EBADF if the selector was destroyed while waiting;
+ * @retval 0 in case of timeout;
+ * @retval the number of events stored to @a events.
+ *
+ * @coretags{primary-only, might-switch}
+ */
+int xnselect_collect(struct xnselector *selector,
+		     struct xnselect_event *events, int maxevents,
+		     xnticks_t timeout, xntmode_t timeout_mode)
+{
+	struct xnselect_binding *binding;
+	LIST_HEAD(collected);
+	int info = 0, n = 0;
+	spl_t s;
+
+	if (!selector->queued || maxevents <= 0)
+		return -EINVAL;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	while (list_empty(&selector->ready)) {
+		if (timeout == XN_NONBLOCK || (info & (XNBREAK|XNTIMEO|XNRMID)))
+			goto out;
+		info = xnsynch_sleep_on(&selector->synchbase,
+					timeout, timeout_mode);
+	}
+
+	while (n < maxevents && !list_empty(&selector->ready)) {
+		binding = list_first_entry(&selector->ready,
+					   struct xnselect_binding, rlink);
+		events[n].bit_index = binding->bit_index;
+		events[n].type = binding->type;
+		events[n].hangup = binding->fd == NULL;
+		list_move_tail(&binding->rlink, &collected);
+		n++;
+	}
+
+	list_splice_tail(&collected, &selector->ready);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (n > 0)
+		return n;
+
+	if (info & XNRMID)
+		return -EBADF;
+
+	if (info & XNBREAK)
+		return -EINTR;
+
+	return 0; /* Timeout */
+}
+EXPORT_SYMBOL_GPL(xnselect_collect);
+
 /**
  * Destroy a selector block.
  *
@@ -423,8 +608,10 @@ static void xnselector_destroy_loop(void *cookie)
 			goto release;
 		list_for_each_entry_safe(binding, tmpb, &selector->bindings, slink) {
 			list_del(&binding->slink);
+			list_del(&binding->rlink);
 			fd = binding->fd;
-			list_del(&binding->link);
+			if (fd)
+				list_del(&binding->link);
 			xnlock_put_irqrestore(&nklock, s);
 			xnfree(binding);
 			xnlock_get_irqsave(&nklock, s);
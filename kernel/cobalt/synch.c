@@ -22,9 +22,281 @@
 #include <cobalt/kernel/synch.h>
 #include <cobalt/kernel/thread.h>
 #include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/vfile.h>
 #include <cobalt/uapi/signal.h>
 #include <trace/events/cobalt-core.h>
 
+#ifdef CONFIG_XENO_OPT_STATS_SYNCH
+
+/*
+ * Wait and hold times are sorted in power-of-two buckets of 1024 ns
+ * units, i.e. bucket #0 counts durations below 1024 ns, bucket #n
+ * counts those within [1024 << (n - 1), 1024 << n), the last one
+ * collecting everything above.
+ */
+#define XNSYNCH_STAT_BUCKETS	16
+
+/*
+ * The owner of the object is the only writer of the acquisition and
+ * hold figures, which are therefore updated locklessly, including
+ * from the fast paths. Everything else is guarded by nklock.
+ */
+struct xnsynch_stat {
+	struct list_head next;	/* in free queue */
+	struct xnsynch *synch;	/* NULL once released */
+	unsigned int id;
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+	/* Owner only. */
+	unsigned long acquired;
+	xnticks_t hold_start;	/* raw clock ticks */
+	xnticks_t hold_total;	/* nanoseconds */
+	xnticks_t hold_max;
+	unsigned long hold_histo[XNSYNCH_STAT_BUCKETS];
+	/* nklock held. */
+	unsigned long contended;
+	unsigned long failed;
+	unsigned long boosts;
+	xnticks_t boost_start;
+	xnticks_t wait_total;
+	xnticks_t wait_max;
+	xnticks_t boost_total;
+	xnticks_t boost_max;
+	unsigned long wait_histo[XNSYNCH_STAT_BUCKETS];
+};
+
+/*
+ * Some synchronization objects may vanish without being formally
+ * destroyed, so statistics live in a static table instead of being
+ * linked to their object. Slots are released when their object is
+ * destroyed or flushed with XNRMID, or taken over when an object is
+ * initialized again at the same address. Released slots are
+ * recycled in FIFO order, which keeps the figures of deleted objects
+ * readable for a while.
+ */
+static struct xnsynch_stat synch_stats[CONFIG_XENO_OPT_STATS_SYNCH_NRSLOTS];
+
+static LIST_HEAD(synch_stat_freeq);
+
+static int synch_stat_nrused;
+
+static unsigned int synch_stat_serial;
+
+static unsigned long synch_stat_dropped;
+
+static struct xnvfile_rev_tag synch_stat_tag;
+
+static void synch_stat_alloc(struct xnsynch *synch)
+{
+	struct xnsynch_stat *stat = synch->stat;
+	struct xnthread *curr;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	/*
+	 * @synch may be re-initialized, or reuse the memory of an
+	 * object which vanished without being destroyed. Its stat
+	 * pointer is garbage otherwise, only trust it if it refers
+	 * to a slot which points back at @synch.
+	 */
+	if (stat >= synch_stats && stat < synch_stats + synch_stat_nrused &&
+	    stat->synch == synch)
+		goto reset;
+
+	stat = NULL;
+	if (synch_stat_nrused < CONFIG_XENO_OPT_STATS_SYNCH_NRSLOTS)
+		stat = synch_stats + synch_stat_nrused++;
+	else if (!list_empty(&synch_stat_freeq)) {
+		stat = list_first_entry(&synch_stat_freeq,
+					struct xnsynch_stat, next);
+		list_del(&stat->next);
+	} else {
+		synch_stat_dropped++;
+		goto out;
+	}
+reset:
+	memset(stat, 0, sizeof(*stat));
+	stat->synch = synch;
+	stat->id = ++synch_stat_serial;
+	curr = xnthread_current();
+	if (curr) {
+		stat->pid = xnthread_host_pid(curr);
+		knamecpy(stat->name, curr->name);
+	} else {
+		stat->pid = task_pid_nr(current);
+		knamecpy(stat->name, current->comm);
+	}
+	xnvfile_touch_tag(&synch_stat_tag);
+out:
+	synch->stat = stat;
+
+	xnlock_put_irqrestore(&nklock, s);
+}
+
+/* nklock held, irqs off. */
+static void synch_stat_free(struct xnsynch *synch)
+{
+	struct xnsynch_stat *stat = synch->stat;
+
+	if (stat == NULL)
+		return;
+
+	synch->stat = NULL;
+	stat->synch = NULL;
+	list_add_tail(&stat->next, &synch_stat_freeq);
+	xnvfile_touch_tag(&synch_stat_tag);
+}
+
+static inline xnticks_t synch_stat_now(struct xnsynch *synch)
+{
+	return synch->stat ? xnclock_read_raw(&nkclock) : 0;
+}
+
+static inline void synch_stat_histo(unsigned long *histo, xnticks_t ns)
+{
+	xnticks_t units = ns >> 10;
+	int n;
+
+	if (units >= 1ULL << (XNSYNCH_STAT_BUCKETS - 2))
+		n = XNSYNCH_STAT_BUCKETS - 1;
+	else
+		n = fls((int)units);
+
+	histo[n]++;
+}
+
+static inline xnticks_t synch_stat_elapsed(xnticks_t start, xnticks_t now)
+{
+	return xnclock_ticks_to_ns(&nkclock, now - start);
+}
+
+/* nklock held, irqs off. */
+static void synch_stat_wait(struct xnsynch_stat *stat, xnticks_t ns)
+{
+	stat->contended++;
+	stat->wait_total += ns;
+	if (ns > stat->wait_max)
+		stat->wait_max = ns;
+	synch_stat_histo(stat->wait_histo, ns);
+}
+
+/*
+ * Account for a successful acquisition by the current thread, which
+ * required it to wait since @a wstart if non-zero. Only contended
+ * acquisitions which do not hold nklock already grab it, the
+ * uncontended fast path is lockless.
+ */
+static void synch_stat_grab(struct xnsynch *synch, xnticks_t wstart,
+			    int locked)
+{
+	struct xnsynch_stat *stat = READ_ONCE(synch->stat);
+	xnticks_t now;
+	spl_t s;
+
+	if (stat == NULL)
+		return;
+
+	now = xnclock_read_raw(&nkclock);
+	stat->acquired++;
+	stat->hold_start = now;
+
+	if (wstart == 0)
+		return;
+
+	if (locked)
+		synch_stat_wait(stat, synch_stat_elapsed(wstart, now));
+	else {
+		xnlock_get_irqsave(&nklock, s);
+		if (synch->stat == stat)
+			synch_stat_wait(stat, synch_stat_elapsed(wstart, now));
+		xnlock_put_irqrestore(&nklock, s);
+	}
+}
+
+/* nklock held, irqs off. */
+static void synch_stat_fail(struct xnsynch *synch, xnticks_t wstart)
+{
+	struct xnsynch_stat *stat = synch->stat;
+	xnticks_t ns;
+
+	if (stat == NULL || wstart == 0)
+		return;
+
+	ns = synch_stat_elapsed(wstart, xnclock_read_raw(&nkclock));
+	stat->failed++;
+	synch_stat_wait(stat, ns);
+}
+
+/* Called by the owner, lockless. */
+static void synch_stat_release(struct xnsynch *synch)
+{
+	struct xnsynch_stat *stat = READ_ONCE(synch->stat);
+	xnticks_t ns;
+
+	if (stat == NULL || stat->hold_start == 0)
+		return;
+
+	ns = synch_stat_elapsed(stat->hold_start, xnclock_read_raw(&nkclock));
+	stat->hold_start = 0;
+	stat->hold_total += ns;
+	if (ns > stat->hold_max)
+		stat->hold_max = ns;
+	synch_stat_histo(stat->hold_histo, ns);
+}
+
+/* nklock held, irqs off. */
+static void synch_stat_boost(struct xnsynch *synch)
+{
+	struct xnsynch_stat *stat = synch->stat;
+
+	if (stat) {
+		stat->boosts++;
+		stat->boost_start = xnclock_read_raw(&nkclock);
+	}
+}
+
+/* nklock held, irqs off. */
+static void synch_stat_unboost(struct xnsynch *synch)
+{
+	struct xnsynch_stat *stat = synch->stat;
+	xnticks_t ns;
+
+	if (stat == NULL || stat->boost_start == 0)
+		return;
+
+	ns = synch_stat_elapsed(stat->boost_start, xnclock_read_raw(&nkclock));
+	stat->boost_start = 0;
+	stat->boost_total += ns;
+	if (ns > stat->boost_max)
+		stat->boost_max = ns;
+}
+
+#else /* !CONFIG_XENO_OPT_STATS_SYNCH */
+
+static inline void synch_stat_alloc(struct xnsynch *synch) { }
+
+static inline void synch_stat_free(struct xnsynch *synch) { }
+
+static inline xnticks_t synch_stat_now(struct xnsynch *synch)
+{
+	return 0;
+}
+
+static inline void synch_stat_grab(struct xnsynch *synch,
+				   xnticks_t wstart, int locked) { }
+
+static inline void synch_stat_fail(struct xnsynch *synch,
+				   xnticks_t wstart) { }
+
+static inline void synch_stat_release(struct xnsynch *synch) { }
+
+static inline void synch_stat_boost(struct xnsynch *synch) { }
+
+static inline void synch_stat_unboost(struct xnsynch *synch) { }
+
+#endif /* !CONFIG_XENO_OPT_STATS_SYNCH */
+
 /**
  * @ingroup cobalt_core
  * @defgroup cobalt_core_synch Thread synchronization services
@@ -93,8 +365,13 @@ void xnsynch_init(struct xnsynch *synch, int flags, atomic_t *fastlock)
 		BUG_ON(fastlock == NULL);
 		synch->fastlock = fastlock;
 		atomic_set(fastlock, XN_NO_HANDLE);
-	} else
+		synch_stat_alloc(synch);
+	} else {
 		synch->fastlock = NULL;
+#ifdef CONFIG_XENO_OPT_STATS_SYNCH
+		synch->stat = NULL;
+#endif
+	}
 }
 EXPORT_SYMBOL_GPL(xnsynch_init);
 
@@ -117,10 +394,15 @@ EXPORT_SYMBOL_GPL(xnsynch_init);
 int xnsynch_destroy(struct xnsynch *synch)
 {
 	int ret;
+	spl_t s;
 	
 	ret = xnsynch_flush(synch, XNRMID);
 	XENO_BUG_ON(COBALT, synch->status & XNSYNCH_CLAIMED);
 
+	xnlock_get_irqsave(&nklock, s);
+	synch_stat_free(synch);
+	xnlock_put_irqrestore(&nklock, s);
+
 	return ret;
 }
 EXPORT_SYMBOL_GPL(xnsynch_destroy);
@@ -426,6 +708,7 @@ int xnsynch_acquire(struct xnsynch *synch, xnticks_t timeout,
 {
 	struct xnthread *curr, *owner;
 	xnhandle_t currh, h, oldh;
+	xnticks_t wstart = 0;
 	atomic_t *lockp;
 	spl_t s;
 
@@ -443,9 +726,13 @@ redo:
 	if (likely(h == XN_NO_HANDLE)) {
 		xnsynch_set_owner(synch, curr);
 		xnthread_get_resource(curr);
+		synch_stat_grab(synch, wstart, 0);
 		return 0;
 	}
 
+	if (wstart == 0)
+		wstart = synch_stat_now(synch);
+
 	xnlock_get_irqsave(&nklock, s);
 
 	/*
@@ -510,8 +797,10 @@ redo:
 
 			if (synch->status & XNSYNCH_CLAIMED)
 				list_del(&synch->link);
-			else
+			else {
 				synch->status |= XNSYNCH_CLAIMED;
+				synch_stat_boost(synch);
+			}
 
 			synch->wprio = curr->wprio;
 			list_add_priff(synch, &owner->claimq, wprio, link);
@@ -553,7 +842,13 @@ block:
 
 	/* Set new ownership for this mutex. */
 	atomic_set(lockp, currh);
+	synch_stat_grab(synch, wstart, 1);
 out:
+	/* Don't touch a deleted object. */
+	if (xnthread_test_info(curr, XNTIMEO | XNBREAK) &&
+	    !xnthread_test_info(curr, XNRMID))
+		synch_stat_fail(synch, wstart);
+
 	xnlock_put_irqrestore(&nklock, s);
 
 	return xnthread_test_info(curr, XNRMID|XNTIMEO|XNBREAK);
@@ -568,6 +863,7 @@ static void clear_boost(struct xnsynch *synch, struct xnthread *owner)
 
 	list_del(&synch->link);
 	synch->status &= ~XNSYNCH_CLAIMED;
+	synch_stat_unboost(synch);
 	wprio = owner->bprio + owner->sched_class->weight;
 
 	if (list_empty(&owner->claimq)) {
@@ -672,6 +968,8 @@ struct xnthread *xnsynch_release(struct xnsynch *synch,
 	if (xnthread_put_resource(thread))
 		return NULL;
 
+	synch_stat_release(synch);
+
 	lockp = xnsynch_fastlock(synch);
 	XENO_BUG_ON(COBALT, lockp == NULL);
 	threadh = thread->handle;
@@ -720,6 +1018,7 @@ void xnsynch_requeue_sleeper(struct xnthread *thread)
 		 * boost the owner.
 		 */
 		synch->status |= XNSYNCH_CLAIMED;
+		synch_stat_boost(synch);
 		list_add_priff(synch, &owner->claimq, wprio, link);
 		if (!xnthread_test_state(owner, XNBOOST)) {
 			owner->bprio = owner->cprio;
@@ -786,7 +1085,8 @@ EXPORT_SYMBOL_GPL(xnsynch_peek_pendq);
  * are pre-defined by the nucleus:
  *
  * - XNRMID should be set to indicate that the synchronization object
- * is about to be destroyed (see xnthread_resume()).
+ * is about to be destroyed (see xnthread_resume()). The contention
+ * statistics attached to the object, if any, are released too.
  *
  * - XNBREAK should be set to indicate that the wait has been forcibly
  * interrupted (see xnthread_unblock()).
@@ -832,6 +1132,9 @@ int xnsynch_flush(struct xnsynch *synch, int reason)
 			clear_boost(synch, synch->owner);
 	}
 
+	if (reason & XNRMID)
+		synch_stat_free(synch);
+
 	xnlock_put_irqrestore(&nklock, s);
 
 	return ret;
@@ -951,4 +1254,182 @@ void xnsynch_detect_claimed_relax(struct xnthread *owner)
 
 #endif /* XENO_DEBUG(MUTEX_RELAXED) */
 
+#ifdef CONFIG_XENO_OPT_STATS_SYNCH
+
+struct vfile_priv {
+	int slot;
+};
+
+struct vfile_data {
+	unsigned int id;
+	pid_t pid;
+	int live;
+	unsigned long acquired;
+	unsigned long contended;
+	unsigned long failed;
+	unsigned long boosts;
+	xnticks_t wait_total;
+	xnticks_t wait_max;
+	xnticks_t hold_total;
+	xnticks_t hold_max;
+	xnticks_t boost_total;
+	xnticks_t boost_max;
+	unsigned long wait_histo[XNSYNCH_STAT_BUCKETS];
+	unsigned long hold_histo[XNSYNCH_STAT_BUCKETS];
+	char name[XNOBJECT_NAME_LEN];
+};
+
+static struct xnvfile_snapshot_ops vfile_ops;
+
+static struct xnvfile_snapshot vfile = {
+	.privsz = sizeof(struct vfile_priv),
+	.datasz = sizeof(struct vfile_data),
+	.tag = &synch_stat_tag,
+	.ops = &vfile_ops,
+};
+
+static int vfile_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->slot = 0;
+
+	return synch_stat_nrused;
+}
+
+static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct vfile_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_data *p = data;
+	struct xnsynch_stat *stat;
+
+	if (priv->slot >= synch_stat_nrused)
+		return 0;	/* We are done. */
+
+	stat = synch_stats + priv->slot++;
+	p->id = stat->id;
+	p->pid = stat->pid;
+	p->live = stat->synch != NULL;
+	p->acquired = stat->acquired;
+	p->contended = stat->contended;
+	p->failed = stat->failed;
+	p->boosts = stat->boosts;
+	p->wait_total = stat->wait_total;
+	p->wait_max = stat->wait_max;
+	p->hold_total = stat->hold_total;
+	p->hold_max = stat->hold_max;
+	p->boost_total = stat->boost_total;
+	p->boost_max = stat->boost_max;
+	memcpy(p->wait_histo, stat->wait_histo, sizeof(p->wait_histo));
+	memcpy(p->hold_histo, stat->hold_histo, sizeof(p->hold_histo));
+	knamecpy(p->name, stat->name);
+
+	return 1;
+}
+
+static void vfile_show_histo(struct xnvfile_snapshot_iterator *it,
+			     unsigned long *histo)
+{
+	int n;
+
+	for (n = 0; n < XNSYNCH_STAT_BUCKETS; n++)
+		xnvfile_printf(it, "%s%lu", n ? "," : " ", histo[n]);
+}
+
+static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct vfile_data *p = data;
+
+	if (p == NULL) {
+		if (synch_stat_dropped)
+			xnvfile_printf(it, "# %lu object(s) not profiled\n",
+				       synch_stat_dropped);
+		xnvfile_printf(it, "%-6s %-6s %1s %10s %10s %8s %8s "
+			       "%12s %10s %12s %10s %12s %10s  "
+			       "%s  %s  %s\n",
+			       "ID", "PID", "S", "ACQUIRED", "CONTENDED",
+			       "FAILED", "BOOSTS", "WAIT-TOTAL", "WAIT-MAX",
+			       "HOLD-TOTAL", "HOLD-MAX", "BOOST-TOTAL",
+			       "BOOST-MAX", "WAIT-HISTO", "HOLD-HISTO",
+			       "NAME");
+		return 0;
+	}
+
+	xnvfile_printf(it, "%-6u %-6d %1s %10lu %10lu %8lu %8lu "
+		       "%12Lu %10Lu %12Lu %10Lu %12Lu %10Lu ",
+		       p->id, p->pid, p->live ? "L" : "D",
+		       p->acquired, p->contended, p->failed, p->boosts,
+		       p->wait_total, p->wait_max,
+		       p->hold_total, p->hold_max,
+		       p->boost_total, p->boost_max);
+	vfile_show_histo(it, p->wait_histo);
+	vfile_show_histo(it, p->hold_histo);
+	xnvfile_printf(it, "  %s\n", p->name);
+
+	return 0;
+}
+
+static ssize_t vfile_store(struct xnvfile_input *input)
+{
+	struct xnsynch_stat *stat;
+	ssize_t ret;
+	long val;
+	spl_t s;
+	int n;
+
+	ret = xnvfile_get_integer(input, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val != 0)
+		return -EINVAL;
+
+	/*
+	 * Clear the counters, keeping the objects identities. The
+	 * timestamps of ongoing holds and boosts are kept too.
+	 */
+	xnlock_get_irqsave(&nklock, s);
+
+	for (n = 0; n < synch_stat_nrused; n++) {
+		stat = synch_stats + n;
+		stat->acquired = 0;
+		stat->contended = 0;
+		stat->failed = 0;
+		stat->boosts = 0;
+		stat->wait_total = 0;
+		stat->wait_max = 0;
+		stat->hold_total = 0;
+		stat->hold_max = 0;
+		stat->boost_total = 0;
+		stat->boost_max = 0;
+		memset(stat->wait_histo, 0, sizeof(stat->wait_histo));
+		memset(stat->hold_histo, 0, sizeof(stat->hold_histo));
+	}
+
+	synch_stat_dropped = 0;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
+static struct xnvfile_snapshot_ops vfile_ops = {
+	.rewind = vfile_rewind,
+	.next = vfile_next,
+	.show = vfile_show,
+	.store = vfile_store,
+};
+
+void xnsynch_init_proc(void)
+{
+	xnvfile_init_snapshot("synch", &vfile, &cobalt_vfroot);
+}
+
+void xnsynch_cleanup_proc(void)
+{
+	xnvfile_destroy_snapshot(&vfile);
+}
+
+#endif /* CONFIG_XENO_OPT_STATS_SYNCH */
+
 /** @} */
@@ -196,8 +196,9 @@ int __xnthread_init(struct xnthread *thread,
 	thread->cookie = NULL;
 
 	gravity = flags & XNUSER ? XNTIMER_UGRAVITY : XNTIMER_KGRAVITY;
+	/* Timeouts are mostly cancelled before they elapse. */
 	xntimer_init(&thread->rtimer, &nkclock, timeout_handler,
-		     sched, gravity);
+		     sched, gravity|XNTIMER_COARSE);
 	xntimer_set_name(&thread->rtimer, thread->name);
 	xntimer_set_priority(&thread->rtimer, XNTIMER_HIPRIO);
 	xntimer_init(&thread->ptimer, &nkclock, periodic_handler,
@@ -49,6 +49,10 @@ int xntimer_heading_p(struct xntimer *timer)
 	xntimerq_t *q;
 	xntimerh_t *h;
 
+	/* Wheeled timers are far from heading the precise queue. */
+	if (xntimer_wheeled_p(timer))
+		return 0;
+
 	q = xntimer_percpu_queue(timer);
 	h = xntimerq_head(q);
 	if (h == &timer->aplink)
@@ -309,6 +313,14 @@ EXPORT_SYMBOL_GPL(xntimer_get_timeout);
  * - XNTIMER_NOBLCK, the timer won't be frozen while GDB takes over
  * control of the application.
  *
+ * - XNTIMER_COARSE, the timer is a long-lived timeout which is
+ * unlikely to elapse, such as a watchdog. If
+ * CONFIG_XENO_OPT_TIMER_WHEEL is enabled, such a timer is parked in a
+ * per-CPU timer wheel in constant time when started, and moved to
+ * the precise timer queue only shortly before it elapses. The
+ * expiry date is unaffected. This flag is ignored for timers started
+ * in XN_REALTIME mode.
+ *
  * A set of clock gravity hints can be passed via the @a flags
  * argument, used for optimizing the built-in heuristics aimed at
  * latency reduction:
@@ -876,4 +888,294 @@ void xntimer_release_hardware(void)
 }
 EXPORT_SYMBOL_GPL(xntimer_release_hardware);
 
+#ifdef CONFIG_XENO_OPT_TIMER_WHEEL
+
+static inline int wheel_slot(struct xntwheel *wheel, xnticks_t expires)
+{
+	xnsticks_t idx = expires - wheel->clk;
+	int level, shift;
+
+	if (idx < XNTWHEEL_L0_SIZE)
+		return expires & XNTWHEEL_L0_MASK;
+
+	for (level = 1; level < XNTWHEEL_LEVELS; level++) {
+		shift = XNTWHEEL_L0_BITS + level * XNTWHEEL_LN_BITS;
+		if (idx < (1LL << shift) || level == XNTWHEEL_LEVELS - 1)
+			break;
+	}
+
+	/*
+	 * Dates beyond the wheel range are parked in the last slot of
+	 * the top level, to be cascaded again until they get closer.
+	 */
+	if (idx >= (1LL << shift))
+		expires = wheel->clk + (1LL << shift) - 1;
+
+	shift -= XNTWHEEL_LN_BITS;
+
+	return XNTWHEEL_L0_SIZE + (level - 1) * XNTWHEEL_LN_SIZE +
+		((expires >> shift) & XNTWHEEL_LN_MASK);
+}
+
+static inline void wheel_add(struct xntwheel *wheel, struct xntimer *timer)
+{
+	xnticks_t expires = xntimerh_date(&timer->aplink) >> wheel->shift;
+	int slot = wheel_slot(wheel, expires);
+
+	list_add_tail(&timer->wlink, &wheel->slots[slot]);
+	__set_bit(slot, wheel->pending);
+	timer->wslot = slot;
+}
+
+/*
+ * Return the next wheel tick which has timers to either expire or
+ * cascade. Bitmap searches are bounded by the size of a level, so
+ * this runs in constant time.
+ */
+static xnticks_t wheel_next_tick(struct xntwheel *wheel)
+{
+	xnticks_t c = wheel->clk, base, tick, next = c + (1ULL << 62);
+	int level, shift, first, idx, i;
+
+	/* Pending slots below the current index belong to the next turn. */
+	base = c & ~(xnticks_t)XNTWHEEL_L0_MASK;
+	idx = c & XNTWHEEL_L0_MASK;
+	i = find_next_bit(wheel->pending, XNTWHEEL_L0_SIZE, idx);
+	if (i < XNTWHEEL_L0_SIZE)
+		next = base + i;
+	else {
+		i = find_next_bit(wheel->pending, idx, 0);
+		if (i < idx)
+			next = base + XNTWHEEL_L0_SIZE + i;
+	}
+
+	/*
+	 * Timers in upper levels have to be cascaded before they
+	 * can expire, which might happen earlier than the next
+	 * expiry found in level 0.
+	 */
+	for (level = 1; level < XNTWHEEL_LEVELS; level++) {
+		shift = XNTWHEEL_L0_BITS + (level - 1) * XNTWHEEL_LN_BITS;
+		first = XNTWHEEL_L0_SIZE + (level - 1) * XNTWHEEL_LN_SIZE;
+		/* Slots of this level are cascaded on this boundary. */
+		base = ((c + (1ULL << shift) - 1) >> shift) << shift;
+		idx = (base >> shift) & XNTWHEEL_LN_MASK;
+		i = find_next_bit(wheel->pending, first + XNTWHEEL_LN_SIZE,
+				  first + idx);
+		if (i < first + XNTWHEEL_LN_SIZE)
+			i -= first;
+		else {
+			i = find_next_bit(wheel->pending, first + idx, first);
+			if (i >= first + idx)
+				continue;
+			i = i - first + XNTWHEEL_LN_SIZE;
+		}
+		tick = base + ((xnticks_t)(i - idx) << shift);
+		if (tick < next)
+			next = tick;
+	}
+
+	return next;
+}
+
+static void wheel_arm(struct xntwheel *wheel)
+{
+	struct xntimer *timer = &wheel->timer;
+	struct xnclock *clock = xntimer_clock(timer);
+	xnticks_t next = wheel_next_tick(wheel);
+	xnsticks_t delay;
+
+	if ((timer->status & XNTIMER_DEQUEUED) == 0 &&
+	    (xnsticks_t)(next - wheel->next) >= 0)
+		return;
+
+	wheel->next = next;
+	delay = (xnsticks_t)((next << wheel->shift) - xnclock_read_raw(clock));
+	xntimer_start(timer, delay > 0 ? xnclock_ticks_to_ns(clock, delay) : 0,
+		      XN_INFINITE, XN_RELATIVE);
+}
+
+static int wheel_cascade(struct xntwheel *wheel, int level, int idx)
+{
+	int slot = XNTWHEEL_L0_SIZE + (level - 1) * XNTWHEEL_LN_SIZE + idx;
+	struct xntimer *timer, *tmp;
+	LIST_HEAD(q);
+
+	if (test_bit(slot, wheel->pending)) {
+		list_splice_init(&wheel->slots[slot], &q);
+		__clear_bit(slot, wheel->pending);
+		list_for_each_entry_safe(timer, tmp, &q, wlink)
+			wheel_add(wheel, timer);
+	}
+
+	return idx;
+}
+
+static void wheel_handler(struct xntimer *wtimer)
+{
+	struct xntwheel *wheel = container_of(wtimer, struct xntwheel, timer);
+	struct xntimerdata *tmd = container_of(wheel, struct xntimerdata, wheel);
+	struct xnclock *clock = xntimer_clock(wtimer);
+	struct xntimer *timer, *tmp;
+	xnticks_t limit, next;
+	int idx, level;
+
+	/*
+	 * Process one wheel tick ahead, which absorbs the gravity
+	 * applied to the drain timer. Moving a timer early to the
+	 * precise queue is harmless.
+	 */
+	limit = (xnclock_read_raw(clock) >> wheel->shift) + 1;
+
+	while ((xnsticks_t)(limit - wheel->clk) > 0) {
+		idx = wheel->clk & XNTWHEEL_L0_MASK;
+		for (level = 1; idx == 0 && level < XNTWHEEL_LEVELS; level++)
+			idx = wheel_cascade(wheel, level,
+				    (wheel->clk >> (XNTWHEEL_L0_BITS +
+				     (level - 1) * XNTWHEEL_LN_BITS)) &
+				    XNTWHEEL_LN_MASK);
+		idx = wheel->clk & XNTWHEEL_L0_MASK;
+		if (test_bit(idx, wheel->pending)) {
+			list_for_each_entry_safe(timer, tmp,
+						 &wheel->slots[idx], wlink) {
+				list_del(&timer->wlink);
+				timer->status &= ~XNTIMER_WHEELED;
+				wheel->nr_timers--;
+				xntimerq_insert(&tmd->q, &timer->aplink);
+			}
+			__clear_bit(idx, wheel->pending);
+		}
+		/*
+		 * Skip the ticks which have nothing to expire or
+		 * cascade, so that catching up after a long delay
+		 * does not iterate over every elapsed tick with
+		 * nklock held.
+		 */
+		wheel->clk++;
+		next = wheel_next_tick(wheel);
+		wheel->clk = (xnsticks_t)(next - limit) < 0 ? next : limit;
+	}
+
+	if (wheel->nr_timers > 0)
+		wheel_arm(wheel);
+}
+
+void xntwheel_init(struct xntwheel *wheel, struct xnclock *clock, int cpu)
+{
+	xnticks_t tick;
+	int n;
+
+	for (n = 0; n < XNTWHEEL_SLOTS; n++)
+		INIT_LIST_HEAD(&wheel->slots[n]);
+
+	bitmap_zero(wheel->pending, XNTWHEEL_SLOTS);
+	wheel->nr_timers = 0;
+	/* Round the wheel tick down to a power of two. */
+	tick = xnclock_ns_to_ticks(clock,
+			CONFIG_XENO_OPT_TIMER_WHEEL_RESOLUTION * 1000ULL);
+	wheel->shift = tick > 1 ? ilog2(tick) : 0;
+
+	xntimer_init(&wheel->timer, clock, wheel_handler,
+		     xnsched_struct(cpu), XNTIMER_IGRAVITY|XNTIMER_NOBLCK);
+	xntimer_set_name(&wheel->timer, "[timer-wheel]");
+	xntimer_set_priority(&wheel->timer, XNTIMER_LOPRIO);
+}
+
+void xntwheel_destroy(struct xntwheel *wheel)
+{
+	xntimer_destroy(&wheel->timer);
+}
+
+int xntwheel_enqueue(struct xntimer *timer, xntimerq_t *q)
+{
+	struct xntimerdata *tmd = container_of(q, struct xntimerdata, q);
+	struct xntwheel *wheel = &tmd->wheel;
+	struct xnclock *clock = xntimer_clock(timer);
+	xnticks_t expires;
+
+	/* Clock adjustments only walk the precise queue. */
+	if (timer->status & XNTIMER_REALTIME)
+		return 0;
+
+	if (wheel->nr_timers == 0)
+		wheel->clk = xnclock_read_raw(clock) >> wheel->shift;
+
+	expires = xntimerh_date(&timer->aplink) >> wheel->shift;
+	if ((xnsticks_t)(expires - wheel->clk) <= 0)
+		return 0;	/* Due soon, go precise. */
+
+	wheel_add(wheel, timer);
+	timer->status |= XNTIMER_WHEELED;
+	wheel->nr_timers++;
+	wheel_arm(wheel);
+
+	return 1;
+}
+EXPORT_SYMBOL_GPL(xntwheel_enqueue);
+
+void xntwheel_dequeue(struct xntimer *timer, xntimerq_t *q)
+{
+	struct xntimerdata *tmd = container_of(q, struct xntimerdata, q);
+	struct xntwheel *wheel = &tmd->wheel;
+	int slot = timer->wslot;
+
+	/*
+	 * The drain timer is left armed, it will find nothing to do
+	 * and won't restart if the wheel is empty.
+	 */
+	list_del(&timer->wlink);
+	if (list_empty(&wheel->slots[slot]))
+		__clear_bit(slot, wheel->pending);
+	timer->status &= ~XNTIMER_WHEELED;
+	wheel->nr_timers--;
+}
+EXPORT_SYMBOL_GPL(xntwheel_dequeue);
+
+#endif /* CONFIG_XENO_OPT_TIMER_WHEEL */
+
+#ifdef CONFIG_XENO_OPT_TIMER_RBTREE
+
+static inline bool xntimerh_is_lt(xntimerh_t *left, xntimerh_t *right)
+{
+	return (xnsticks_t)(left->date - right->date) < 0 ||
+		(left->date == right->date && left->prio > right->prio);
+}
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
+{
+	struct rb_node **new = &q->root.rb_node, *parent = NULL;
+	xntimerh_t *i;
+
+	if (q->head == NULL)
+		q->head = holder;
+	else if (xntimerh_is_lt(holder, q->head)) {
+		/*
+		 * Fast path for the new earliest date: the leftmost
+		 * node has no left child, hang the holder there.
+		 */
+		parent = &q->head->link;
+		new = &parent->rb_left;
+		q->head = holder;
+	} else {
+		/*
+		 * Timers with identical date and priority are queued
+		 * in FIFO order, like the linear queue does.
+		 */
+		while (*new) {
+			i = container_of(*new, xntimerh_t, link);
+			parent = *new;
+			if (xntimerh_is_lt(holder, i))
+				new = &((*new)->rb_left);
+			else
+				new = &((*new)->rb_right);
+		}
+	}
+
+	rb_link_node(&holder->link, parent, new);
+	rb_insert_color(&holder->link, &q->root);
+}
+EXPORT_SYMBOL_GPL(xntimerq_insert);
+
+#endif /* CONFIG_XENO_OPT_TIMER_RBTREE */
+
 /** @} */
@@ -274,6 +274,20 @@ DEFINE_EVENT(fd_request, cobalt_fd_recvmsg,
 	TP_ARGS(task, fd, ufd, flags)
 );
 
+DEFINE_EVENT(fd_request, cobalt_fd_sendmmsg,
+	TP_PROTO(struct task_struct *task,
+		 struct rtdm_fd *fd, int ufd,
+		 unsigned long flags),
+	TP_ARGS(task, fd, ufd, flags)
+);
+
+DEFINE_EVENT(fd_request, cobalt_fd_recvmmsg,
+	TP_PROTO(struct task_struct *task,
+		 struct rtdm_fd *fd, int ufd,
+		 unsigned long flags),
+	TP_ARGS(task, fd, ufd, flags)
+);
+
 #define cobalt_print_protbits(__prot)		\
 	__print_flags(__prot,  "|", 		\
 		      {PROT_EXEC, "exec"},	\
@@ -363,6 +377,20 @@ DEFINE_EVENT(fd_request_status, cobalt_fd_sendmsg_status,
 	TP_ARGS(task, fd, ufd, status)
 );
 
+DEFINE_EVENT(fd_request_status, cobalt_fd_recvmmsg_status,
+	TP_PROTO(struct task_struct *task,
+		 struct rtdm_fd *fd, int ufd,
+		 int status),
+	TP_ARGS(task, fd, ufd, status)
+);
+
+DEFINE_EVENT(fd_request_status, cobalt_fd_sendmmsg_status,
+	TP_PROTO(struct task_struct *task,
+		 struct rtdm_fd *fd, int ufd,
+		 int status),
+	TP_ARGS(task, fd, ufd, status)
+);
+
 DEFINE_EVENT(fd_request_status, cobalt_fd_mmap_status,
 	TP_PROTO(struct task_struct *task,
 		 struct rtdm_fd *fd, int ufd,
@@ -189,6 +189,11 @@ struct rtcan_device *rtcan_dev_alloc(int sizeof_priv, int sizeof_board_priv)
     recv_list_elem->next = NULL;
     dev->free_entries = RTCAN_MAX_RECEIVERS;
 
+    /* Initialize receive filter index */
+    memset(dev->recv_sff_index, 0xff, sizeof(dev->recv_sff_index));
+    memset(dev->recv_eff_hash, 0xff, sizeof(dev->recv_eff_hash));
+    dev->recv_fallback = RTCAN_RECV_NONE;
+
     if (sizeof_priv)
 	dev->priv = (void *)((unsigned long)dev + sizeof(*dev));
     if (sizeof_board_priv)
@@ -43,6 +43,10 @@
  * for reception at the same time using Bind */
 #define RTCAN_MAX_RECEIVERS  CONFIG_XENO_DRIVERS_CAN_MAX_RECEIVERS
 
+#if RTCAN_MAX_RECEIVERS >= RTCAN_RECV_NONE
+#error CONFIG_XENO_DRIVERS_CAN_MAX_RECEIVERS is too large
+#endif
+
 /* Suppress handling of refcount if module support is not enabled
  * or modules cannot be unloaded */
 
@@ -152,6 +156,15 @@ struct rtcan_device {
     /* Indicates the length of the empty list */
     int                             free_entries;
 
+    /* Receive filter index, chaining the entries of the reception list
+     * by index into the receivers array: non-inverted filters covering
+     * the standard ID bits are looked up by the 11 low bits of the CAN
+     * ID, extended frame filters matching a complete ID are hashed,
+     * all others are checked for each frame. */
+    unsigned short                  recv_sff_index[RTCAN_SFF_INDEX_SIZE];
+    unsigned short                  recv_eff_hash[RTCAN_EFF_HASH_SIZE];
+    unsigned short                  recv_fallback;
+
     /* A few statistics counters */
     unsigned int tx_count;
     unsigned int rx_count;
@@ -23,6 +23,8 @@
 #ifndef __RTCAN_LIST_H_
 #define __RTCAN_LIST_H_
 
+#include <linux/hash.h>
+
 #include "rtcan_socket.h"
 
 
@@ -43,9 +45,27 @@ struct rtcan_recv {
 					     */
     struct rtcan_recv       *next;          /* pointer to next list element
 					     */
+    unsigned short          idx_next;       /* next element in the same
+					     *   filter index chain */
 };
 
 
+/* End of a filter index chain */
+#define RTCAN_RECV_NONE         0xffff
+
+/* Direct lookup table size, one chain per standard CAN ID */
+#define RTCAN_SFF_INDEX_SIZE    (CAN_SFF_MASK + 1)
+
+/* Exact-match hash for filters matching a complete extended CAN ID */
+#define RTCAN_EFF_HASH_BITS     6
+#define RTCAN_EFF_HASH_SIZE     (1 << RTCAN_EFF_HASH_BITS)
+
+static inline unsigned int rtcan_eff_hash(uint32_t can_id)
+{
+    return hash_32(can_id & CAN_EFF_MASK, RTCAN_EFF_HASH_BITS);
+}
+
+
 /*
  *  Element in a TX wait queue.
  *
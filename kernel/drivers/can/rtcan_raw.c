@@ -37,6 +37,7 @@
 #include <linux/module.h>
 #include <linux/delay.h>
 #include <linux/stringify.h>
+#include <linux/vmalloc.h>
 
 #include <rtdm/driver.h>
 
@@ -75,6 +76,48 @@ static inline int rtcan_accept_msg(uint32_t can_id, can_filter_t *filter)
 }
 
 
+/*
+ * Store a frame into the mmap'ed receive ring of a socket. The reader
+ * is only woken up when the ring turns non-empty: it publishes its
+ * head before waiting in select(), which re-checks the tail after
+ * clearing the event (see rtcan_raw_ring_rearm()).
+ */
+static void rtcan_rcv_deliver_ring(struct rtcan_socket *sock,
+				   struct rtcan_skb *skb)
+{
+    struct rtcan_rb_frame *frame = &skb->rb_frame;
+    struct can_ring_header *ring = sock->rx_ring;
+    struct can_ring_frame *slot;
+    uint32_t tail = sock->rx_ring_tail;
+    size_t payload_size;
+
+    if (tail - ring->head >= sock->rx_ring_frames) {
+	ring->dropped++;
+	sock->rx_buf_full++;
+	return;
+    }
+
+    slot = (struct can_ring_frame *)((char *)ring + CAN_RING_HDR_SIZE) +
+	(tail & (sock->rx_ring_frames - 1));
+    slot->frame.can_id = frame->can_id;
+    slot->frame.can_dlc = frame->can_dlc & RTCAN_HAS_NO_TIMESTAMP;
+    payload_size = skb->rb_frame_size - (EMPTY_RB_FRAME_SIZE);
+    if (payload_size)
+	memcpy(slot->frame.data, frame->data, payload_size);
+    slot->can_ifindex = frame->can_ifindex;
+    memcpy(&slot->timestamp, (void *)frame + skb->rb_frame_size,
+	   RTCAN_TIMESTAMP_SIZE);
+
+    /* Publish the slot, then check whether the reader may be waiting */
+    smp_wmb();
+    sock->rx_ring_tail = ++tail;
+    ring->tail = tail;
+    smp_mb();
+    if (ring->head == tail - 1)
+	rtdm_event_signal(&sock->rx_ring_event);
+}
+
+
 static void rtcan_rcv_deliver(struct rtcan_recv *recv_listener,
 			      struct rtcan_skb *skb)
 {
@@ -89,6 +132,12 @@ static void rtcan_rcv_deliver(struct rtcan_recv *recv_listener,
 
     sock = recv_listener->sock;
 
+    if (sock->rx_ring) {
+	rtcan_rcv_deliver_ring(sock, skb);
+	rtdm_fd_unlock(fd);
+	return;
+    }
+
     cpy_size = skb->rb_frame_size;
     /* Check if socket wants to receive a timestamp */
     if (test_bit(RTCAN_GET_TIMESTAMP, &sock->flags)) {
@@ -135,6 +184,46 @@ static void rtcan_rcv_deliver(struct rtcan_recv *recv_listener,
 }
 
 
+static inline void rtcan_rcv_chain(struct rtcan_device *dev,
+				   unsigned short idx, struct rtcan_skb *skb,
+				   struct rtcan_socket *skip_sock)
+{
+    struct rtcan_recv *recv_listener;
+    uint32_t can_id = skb->rb_frame.can_id;
+
+    while (idx != RTCAN_RECV_NONE) {
+	recv_listener = &dev->receivers[idx];
+	if (recv_listener->sock != skip_sock &&
+	    rtcan_accept_msg(can_id, &recv_listener->can_filter)) {
+	    recv_listener->match_count++;
+	    rtcan_rcv_deliver(recv_listener, skb);
+	}
+	idx = recv_listener->idx_next;
+    }
+}
+
+
+/*
+ * Hand a frame over to the listeners whose filter accepts it. Only the
+ * index chains which may hold a matching filter are visited: the one
+ * of the standard ID, the exact-match hash chain for extended frames,
+ * and the fallback chain.
+ */
+static void rtcan_rcv_filtered(struct rtcan_device *dev,
+			       struct rtcan_skb *skb,
+			       struct rtcan_socket *skip_sock)
+{
+    uint32_t can_id = skb->rb_frame.can_id;
+
+    rtcan_rcv_chain(dev, dev->recv_sff_index[can_id & CAN_SFF_MASK],
+		    skb, skip_sock);
+    if (can_id & CAN_EFF_FLAG)
+	rtcan_rcv_chain(dev, dev->recv_eff_hash[rtcan_eff_hash(can_id)],
+			skb, skip_sock);
+    rtcan_rcv_chain(dev, dev->recv_fallback, skb, skip_sock);
+}
+
+
 void rtcan_rcv(struct rtcan_device *dev, struct rtcan_skb *skb)
 {
     nanosecs_abs_t timestamp = rtdm_clock_read();
@@ -157,13 +246,7 @@ void rtcan_rcv(struct rtcan_device *dev, struct rtcan_skb *skb)
 	}
     } else {
 	dev->rx_count++;
-	while (recv_listener != NULL) {
-	    if (rtcan_accept_msg(frame->can_id, &recv_listener->can_filter)) {
-		recv_listener->match_count++;
-		rtcan_rcv_deliver(recv_listener, skb);
-	    }
-	    recv_listener = recv_listener->next;
-	}
+	rtcan_rcv_filtered(dev, skb, NULL);
     }
 }
 
@@ -191,22 +274,12 @@ void rtcan_tx_push(struct rtcan_device *dev, struct rtcan_socket *sock,
 void rtcan_loopback(struct rtcan_device *dev)
 {
     nanosecs_abs_t timestamp = rtdm_clock_read();
-    /* Entry in reception list, begin with head */
-    struct rtcan_recv *recv_listener = dev->recv_list;
-    struct rtcan_rb_frame *frame = &dev->tx_skb.rb_frame;
 
     memcpy((void *)&dev->tx_skb.rb_frame + dev->tx_skb.rb_frame_size,
 	   &timestamp, RTCAN_TIMESTAMP_SIZE);
 
-    while (recv_listener != NULL) {
-	dev->rx_count++;
-	if ((dev->tx_socket != recv_listener->sock) &&
-	    rtcan_accept_msg(frame->can_id, &recv_listener->can_filter)) {
-	    recv_listener->match_count++;
-	    rtcan_rcv_deliver(recv_listener, &dev->tx_skb);
-	}
-	recv_listener = recv_listener->next;
-    }
+    dev->rx_count++;
+    rtcan_rcv_filtered(dev, &dev->tx_skb, dev->tx_socket);
     dev->tx_socket = NULL;
 }
 
@@ -397,6 +470,46 @@ static int rtcan_raw_setsockopt(struct rtdm_fd *fd,
 #endif
 	break;
 
+    case CAN_RAW_RX_RING: {
+	struct can_ring_header *ring;
+
+	if (so->optlen != sizeof(int))
+	    return -EINVAL;
+
+	if (rtdm_fd_is_user(fd)) {
+	    if (!rtdm_read_user_ok(fd, so->optval, so->optlen) ||
+		rtdm_copy_from_user(fd, &val, so->optval, so->optlen))
+		return -EFAULT;
+	} else
+	    memcpy(&val, so->optval, so->optlen);
+
+	if (val < 2 || val > CAN_RING_MAX_FRAMES || (val & (val - 1)))
+	    return -EINVAL;
+
+	if (sock->rx_ring)
+	    return -EBUSY;
+
+	ring = vmalloc_user(CAN_RING_SIZE(val));
+	if (ring == NULL)
+	    return -ENOMEM;
+	ring->nr_frames = val;
+
+	/* Get lock for reception lists */
+	rtdm_lock_get_irqsave(&rtcan_recv_list_lock, lock_ctx);
+	if (sock->rx_ring)
+	    ret = -EBUSY;
+	else {
+	    sock->rx_ring_frames = val;
+	    sock->rx_ring_tail = 0;
+	    sock->rx_ring = ring;
+	}
+	rtdm_lock_put_irqrestore(&rtcan_recv_list_lock, lock_ctx);
+
+	if (ret)
+	    vfree(ring);
+	break;
+    }
+
     default:
 	ret = -ENOPROTOOPT;
     }
@@ -552,6 +665,10 @@ ssize_t rtcan_raw_recvmsg(struct rtdm_fd *fd,
     if (flags & ~(MSG_DONTWAIT | MSG_PEEK))
 	return -EINVAL;
 
+    /* Frames are read from the receive ring in this mode */
+    if (sock->rx_ring)
+	return -EBUSY;
+
 
     /* Check if msghdr entries are sane */
 
@@ -965,6 +1082,56 @@ ssize_t rtcan_raw_sendmsg(struct rtdm_fd *fd,
 }
 
 
+/*
+ * Clear the ring event before waiting, then re-check the ring: either
+ * the driver sees the head published by the reader and signals the
+ * next frame, or we see its tail here.
+ */
+static void rtcan_raw_ring_rearm(struct rtcan_socket *sock)
+{
+    struct can_ring_header *ring = sock->rx_ring;
+
+    rtdm_event_clear(&sock->rx_ring_event);
+    smp_mb();
+    if (ring->head != ACCESS_ONCE(sock->rx_ring_tail))
+	rtdm_event_signal(&sock->rx_ring_event);
+}
+
+
+static int rtcan_raw_select(struct rtdm_fd *fd, struct xnselector *selector,
+			    unsigned int type, unsigned int index)
+{
+    struct rtcan_socket *sock = rtdm_fd_to_private(fd);
+
+    if (type != XNSELECT_READ)
+	return -EINVAL;
+
+    if (sock->rx_ring) {
+	rtcan_raw_ring_rearm(sock);
+	return rtdm_event_select(&sock->rx_ring_event, selector,
+				 type, index);
+    }
+
+    return rtdm_sem_select(&sock->recv_sem, selector, type, index);
+}
+
+
+static int rtcan_raw_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+    struct rtcan_socket *sock = rtdm_fd_to_private(fd);
+    size_t len = vma->vm_end - vma->vm_start;
+
+    if (sock->rx_ring == NULL)
+	return -ENXIO;
+
+    if (vma->vm_pgoff != 0 ||
+	len > PAGE_ALIGN(CAN_RING_SIZE(sock->rx_ring_frames)))
+	return -EINVAL;
+
+    return rtdm_mmap_vmem(vma, sock->rx_ring);
+}
+
+
 static struct rtdm_driver rtcan_driver = {
 	.profile_info		= RTDM_PROFILE_INFO(rtcan,
 						    RTDM_CLASS_CAN,
@@ -981,6 +1148,8 @@ static struct rtdm_driver rtcan_driver = {
 		.ioctl_nrt	= rtcan_raw_ioctl,
 		.recvmsg_rt	= rtcan_raw_recvmsg,
 		.sendmsg_rt	= rtcan_raw_sendmsg,
+		.select		= rtcan_raw_select,
+		.mmap		= rtcan_raw_mmap,
 	},
 };
 
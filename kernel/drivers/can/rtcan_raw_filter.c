@@ -68,6 +68,50 @@ static inline void rtcan_raw_mount_filter(can_filter_t *recv_filter,
 }
 
 
+/* Mask bits of a filter matching a single extended CAN ID */
+#define RTCAN_EFF_EXACT_MASK    (CAN_EFF_FLAG | CAN_EFF_MASK)
+
+static unsigned short *rtcan_raw_index_chain(struct rtcan_device *dev,
+					     can_filter_t *filter)
+{
+    /* Inverted filters match almost anything */
+    if (filter->can_mask & CAN_INV_FILTER)
+	return &dev->recv_fallback;
+
+    if ((filter->can_mask & RTCAN_EFF_EXACT_MASK) == RTCAN_EFF_EXACT_MASK &&
+	(filter->can_id & CAN_EFF_FLAG))
+	return &dev->recv_eff_hash[rtcan_eff_hash(filter->can_id)];
+
+    /* Any frame matching has the same 11 low ID bits as the filter */
+    if ((filter->can_mask & CAN_SFF_MASK) == CAN_SFF_MASK)
+	return &dev->recv_sff_index[filter->can_id & CAN_SFF_MASK];
+
+    return &dev->recv_fallback;
+}
+
+
+static inline void rtcan_raw_index_filter(struct rtcan_device *dev,
+					  struct rtcan_recv *recv)
+{
+    unsigned short *chain = rtcan_raw_index_chain(dev, &recv->can_filter);
+
+    recv->idx_next = *chain;
+    *chain = recv - dev->receivers;
+}
+
+
+static inline void rtcan_raw_unindex_filter(struct rtcan_device *dev,
+					    struct rtcan_recv *recv)
+{
+    unsigned short *chain = rtcan_raw_index_chain(dev, &recv->can_filter);
+    unsigned short idx = recv - dev->receivers;
+
+    while (*chain != idx)
+	chain = &dev->receivers[*chain].idx_next;
+    *chain = recv->idx_next;
+}
+
+
 int rtcan_raw_check_filter(struct rtcan_socket *sock, int ifindex,
 			   struct rtcan_filter_list *flist)
 {
@@ -162,6 +206,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 				   &sock->flist->flist[0]);
 	    last->match_count = 0;
 	    last->sock = sock;
+	    rtcan_raw_index_filter(dev, last);
 	    for (j = 1; j < flistlen; j++) {
 		/* Register remaining filters */
 		last = last->next;
@@ -169,6 +214,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 				       &sock->flist->flist[j]);
 		last->sock = sock;
 		last->match_count = 0;
+		rtcan_raw_index_filter(dev, last);
 	    }
 	    /* Decrease free entries counter by length of filter list */
 	    dev->free_entries -= flistlen;
@@ -179,6 +225,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 	    last->can_filter.can_id = last->can_filter.can_mask = 0;
 	    last->sock = sock;
 	    last->match_count = 0;
+	    rtcan_raw_index_filter(dev, last);
 	    /* Decrease free entries counter by 1
 	     * (one filter for all CAN frames) */
 	    dev->free_entries--;
@@ -232,10 +279,14 @@ void rtcan_raw_remove_filter(struct rtcan_socket *sock)
 	    next = first->next;
 	}
 
-	/* Now go to the end of the old filter list */
+	/* Now go to the end of the old filter list, dropping its
+	 * entries from the filter index */
 	last = next;
-	for (j = 1; j < sock->flistlen; j++)
+	rtcan_raw_unindex_filter(dev, last);
+	for (j = 1; j < sock->flistlen; j++) {
 	    last = last->next;
+	    rtcan_raw_unindex_filter(dev, last);
+	}
 
 	/* Detach found first list entry from reception list */
 	if (first)
@@ -28,6 +28,8 @@
  * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <linux/vmalloc.h>
+
 #include "rtcan_socket.h"
 #include "rtcan_list.h"
 
@@ -41,6 +43,7 @@ void rtcan_socket_init(struct rtdm_fd *fd)
 
 
     rtdm_sem_init(&sock->recv_sem, 0);
+    rtdm_event_init(&sock->rx_ring_event, 0);
 
     sock->recv_head = 0;
     sock->recv_tail = 0;
@@ -49,6 +52,9 @@ void rtcan_socket_init(struct rtdm_fd *fd)
     sock->flist = NULL;
     sock->err_mask = 0;
     sock->rx_buf_full = 0;
+    sock->rx_ring = NULL;
+    sock->rx_ring_frames = 0;
+    sock->rx_ring_tail = 0;
     sock->flags = 0;
 #ifdef CONFIG_XENO_DRIVERS_CAN_LOOPBACK
     sock->loopback = 1;
@@ -95,6 +101,7 @@ void rtcan_socket_cleanup(struct rtdm_fd *fd)
     } while (!tx_list_empty);
 
     rtdm_sem_destroy(&sock->recv_sem);
+    rtdm_event_destroy(&sock->rx_ring_event);
 
     rtdm_lock_get_irqsave(&rtcan_recv_list_lock, lock_ctx);
     if (sock->socket_list.next) {
@@ -102,4 +109,8 @@ void rtcan_socket_cleanup(struct rtdm_fd *fd)
 	sock->socket_list.next = NULL;
     }
     rtdm_lock_put_irqrestore(&rtcan_recv_list_lock, lock_ctx);
+
+    /* Pages still mapped by the application are kept until unmapped */
+    if (sock->rx_ring)
+	vfree(sock->rx_ring);
 }
@@ -172,6 +172,13 @@ struct rtcan_socket {
 
     uint32_t            rx_buf_full;
 
+    /* mmap'able receive ring replacing recv_buf once set up. Attached
+     * under rtcan_recv_list_lock, released with the socket. */
+    struct can_ring_header *rx_ring;
+    unsigned int        rx_ring_frames;
+    uint32_t            rx_ring_tail;   /* private copy of rx_ring->tail */
+    rtdm_event_t        rx_ring_event;  /* ring turned non-empty */
+
     struct rtcan_filter_list *flist;
 
 #ifdef CONFIG_XENO_DRIVERS_CAN_LOOPBACK
@@ -22,6 +22,7 @@
 #include <linux/kernel.h>
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/map.h>
 #include <cobalt/kernel/bufd.h>
@@ -31,6 +32,20 @@
 
 #define BUFP_SOCKET_MAGIC 0xa61a61a6
 
+/* Ring positions must span two laps at least. */
+#define BUFP_BUFSZ_MAX    (1U << 30)
+
+/*
+ * Memory backing a mapped ring: the shared ring state on the first
+ * page, followed by the data area. It may outlive the socket, until
+ * the last mapping is dropped.
+ */
+struct bufp_ringmem {
+	void *mem;
+	size_t memsz;
+	atomic_t refcnt;
+};
+
 struct bufp_socket {
 	int magic;
 	struct sockaddr_ipc name;
@@ -38,15 +53,18 @@ struct bufp_socket {
 
 	void *bufmem;
 	size_t bufsz;
+	u32 span;
 	u_long status;
 	xnhandle_t handle;
 	char label[XNOBJECT_NAME_LEN];
 
-	off_t rdoff;
-	off_t wroff;
-	size_t fillsz;
-	u_long wrtoken;
-	u_long rdtoken;
+	/*
+	 * Ring positions, either private to the kernel, or shared
+	 * with user-space in mapped mode.
+	 */
+	struct bufp_ring *ring;
+	struct bufp_ring privring;
+	struct bufp_ringmem *ringmem;
 	rtdm_event_t i_event;
 	rtdm_event_t o_event;
 
@@ -72,6 +90,7 @@ static struct xnmap *portmap;
 #define _BUFP_BINDING   0
 #define _BUFP_BOUND     1
 #define _BUFP_CONNECTED 2
+#define _BUFP_MMAP      3
 
 #ifdef CONFIG_XENO_OPT_VFILE
 
@@ -113,11 +132,9 @@ static int bufp_socket(struct rtdm_fd *fd)
 	sk->peer = nullsa;
 	sk->bufmem = NULL;
 	sk->bufsz = 0;
-	sk->rdoff = 0;
-	sk->wroff = 0;
-	sk->fillsz = 0;
-	sk->rdtoken = 0;
-	sk->wrtoken = 0;
+	memset(&sk->privring, 0, sizeof(sk->privring));
+	sk->ring = &sk->privring;
+	sk->ringmem = NULL;
 	sk->status = 0;
 	sk->handle = 0;
 	sk->rx_timeout = RTDM_TIMEOUT_INFINITE;
@@ -130,6 +147,62 @@ static int bufp_socket(struct rtdm_fd *fd)
 	return 0;
 }
 
+static void __bufp_put_ringmem(struct bufp_ringmem *ringmem)
+{
+	if (atomic_dec_and_test(&ringmem->refcnt)) {
+		free_pages_exact(ringmem->mem, ringmem->memsz);
+		kfree(ringmem);
+	}
+}
+
+static int __bufp_alloc_buffer(struct bufp_socket *sk)
+{
+	struct bufp_ringmem *ringmem;
+	struct bufp_ring *ring;
+
+	sk->span = bufp_ring_span(sk->bufsz);
+
+	if (!test_bit(_BUFP_MMAP, &sk->status)) {
+		sk->bufmem = alloc_pages_exact(sk->bufsz, GFP_KERNEL);
+		return sk->bufmem ? 0 : -ENOMEM;
+	}
+
+	ringmem = kmalloc(sizeof(*ringmem), GFP_KERNEL);
+	if (ringmem == NULL)
+		return -ENOMEM;
+
+	/* Shared ring state on the first page, data next. */
+	ringmem->memsz = PAGE_SIZE + PAGE_ALIGN(sk->bufsz);
+	ringmem->mem = alloc_pages_exact(ringmem->memsz,
+					 GFP_KERNEL | __GFP_ZERO);
+	if (ringmem->mem == NULL) {
+		kfree(ringmem);
+		return -ENOMEM;
+	}
+	atomic_set(&ringmem->refcnt, 1);
+
+	ring = ringmem->mem;
+	ring->bufsz = sk->bufsz;
+	ring->data_offset = PAGE_SIZE;
+	sk->ring = ring;
+	sk->ringmem = ringmem;
+	sk->bufmem = ringmem->mem + PAGE_SIZE;
+
+	return 0;
+}
+
+static void __bufp_free_buffer(struct bufp_socket *sk)
+{
+	if (sk->ringmem) {
+		__bufp_put_ringmem(sk->ringmem);
+		sk->ringmem = NULL;
+		sk->ring = &sk->privring;
+	} else
+		free_pages_exact(sk->bufmem, sk->bufsz);
+
+	sk->bufmem = NULL;
+}
+
 static void bufp_close(struct rtdm_fd *fd)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
@@ -149,24 +222,101 @@ static void bufp_close(struct rtdm_fd *fd)
 		xnregistry_remove(sk->handle);
 
 	if (sk->bufmem)
-		free_pages_exact(sk->bufmem, sk->bufsz);
+		__bufp_free_buffer(sk);
 
 	kfree(sk);
 }
 
+/*
+ * Wake up the leading reader if enough data is available to feed
+ * it. nklock held, irqs off.
+ */
+static int __bufp_wakeup_reader(struct bufp_socket *sk, size_t fillsz)
+{
+	struct bufp_wait_context *bufwc;
+	struct rtipc_wait_context *wc;
+	struct xnthread *waiter;
+
+	waiter = rtipc_peek_wait_head(&sk->i_event);
+	if (waiter == NULL)
+		return 0;
+
+	wc = rtipc_get_wait_context(waiter);
+	XENO_BUG_ON(COBALT, wc == NULL);
+	bufwc = container_of(wc, struct bufp_wait_context, wc);
+	if (bufwc->len > fillsz)
+		return 0;
+
+	/* This call rescheds internally. */
+	rtdm_event_pulse(&sk->i_event);
+
+	return 1;
+}
+
+/*
+ * Wake up the leading writer if enough room is available for
+ * posting its message. nklock held, irqs off.
+ */
+static int __bufp_wakeup_writer(struct bufp_socket *sk, size_t fillsz)
+{
+	struct bufp_wait_context *bufwc;
+	struct rtipc_wait_context *wc;
+	struct xnthread *waiter;
+
+	waiter = rtipc_peek_wait_head(&sk->o_event);
+	if (waiter == NULL)
+		return 0;
+
+	wc = rtipc_get_wait_context(waiter);
+	XENO_BUG_ON(COBALT, wc == NULL);
+	bufwc = container_of(wc, struct bufp_wait_context, wc);
+	if (bufwc->len + fillsz > sk->bufsz)
+		return 0;
+
+	/* This call rescheds internally. */
+	rtdm_event_pulse(&sk->o_event);
+
+	return 1;
+}
+
+/*
+ * Get the fill count of a ring from its positions, which user-space
+ * may have corrupted in mapped mode.
+ */
+static inline ssize_t __bufp_fill(struct bufp_socket *sk,
+				  u32 rdpos, u32 wrpos)
+{
+	u32 fillsz;
+
+	if (unlikely(rdpos >= sk->span || wrpos >= sk->span))
+		return -EPROTO;
+
+	fillsz = bufp_ring_fill(rdpos, wrpos, sk->span);
+	if (unlikely(fillsz > sk->bufsz))
+		return -EPROTO;
+
+	return fillsz;
+}
+
+static inline ssize_t __bufp_get_fillsz(struct bufp_socket *sk)
+{
+	struct bufp_ring *ring = sk->ring;
+
+	return __bufp_fill(sk, atomic_read(&ring->rdpos),
+			   atomic_read(&ring->wrpos));
+}
+
 static ssize_t __bufp_readbuf(struct bufp_socket *sk,
 			      struct xnbufd *bufd,
 			      int flags)
 {
-	struct bufp_wait_context wait, *bufwc;
-	struct rtipc_wait_context *wc;
-	struct xnthread *waiter;
+	struct bufp_ring *ring = sk->ring;
+	struct bufp_wait_context wait;
+	ssize_t len, ret, fillsz;
 	rtdm_toseq_t toseq;
-	ssize_t len, ret;
+	u32 rdpos, rdoff, next;
 	size_t rbytes, n;
 	rtdm_lockctx_t s;
-	u_long rdtoken;
-	off_t rdoff;
 	int resched;
 
 	len = bufd->b_len;
@@ -176,21 +326,29 @@ static ssize_t __bufp_readbuf(struct bufp_socket *sk,
 	cobalt_atomic_enter(s);
 redo:
 	for (;;) {
+		/*
+		 * Sample the read position, which tells us later
+		 * whether we were preempted by another reader.
+		 */
+		rdpos = atomic_read(&ring->rdpos);
+		fillsz = __bufp_fill(sk, rdpos, atomic_read(&ring->wrpos));
+		if (fillsz < 0) {
+			ret = fillsz;
+			break;
+		}
+
 		/*
 		 * We should be able to read a complete message of the
 		 * requested length, or block.
 		 */
-		if (sk->fillsz < len)
+		if (fillsz < len)
 			goto wait;
 
-		/*
-		 * Draw the next read token so that we can later
-		 * detect preemption.
-		 */
-		rdtoken = ++sk->rdtoken;
+		/* Pairs with the commit of the writer. */
+		smp_rmb();
 
 		/* Read from the buffer in a circular way. */
-		rdoff = sk->rdoff;
+		rdoff = rdpos % sk->bufsz;
 		rbytes = len;
 
 		do {
@@ -204,16 +362,15 @@ redo:
 			 */
 			cobalt_atomic_leave(s);
 			ret = xnbufd_copy_from_kmem(bufd, sk->bufmem + rdoff, n);
-			if (ret < 0)
-				return ret;
-
 			cobalt_atomic_enter(s);
+			if (ret < 0)
+				goto out;
 			/*
 			 * In case we were preempted while retrieving
 			 * the message, we have to re-read the whole
 			 * thing.
 			 */
-			if (sk->rdtoken != rdtoken) {
+			if (atomic_read(&ring->rdpos) != rdpos) {
 				xnbufd_reset(bufd);
 				goto redo;
 			}
@@ -222,15 +379,25 @@ redo:
 			rbytes -= n;
 		} while (rbytes > 0);
 
-		sk->fillsz -= len;
-		sk->rdoff = rdoff;
+		/*
+		 * Mapped readers may still commit before us, in
+		 * which case we have to re-read the whole thing as
+		 * well.
+		 */
+		next = bufp_ring_advance(rdpos, len, sk->span);
+		if (atomic_cmpxchg(&ring->rdpos, rdpos, next) != rdpos) {
+			xnbufd_reset(bufd);
+			goto redo;
+		}
+
+		fillsz -= len;
 		ret = len;
 
 		resched = 0;
-		if (sk->fillsz + len == sk->bufsz) /* -> writable */
+		if (fillsz + len == sk->bufsz) /* -> writable */
 			resched |= xnselect_signal(&sk->priv->send_block, POLLOUT);
 
-		if (sk->fillsz == 0) /* -> non-readable */
+		if (fillsz == 0) /* -> non-readable */
 			resched |= xnselect_signal(&sk->priv->recv_block, 0);
 
 		/*
@@ -238,17 +405,7 @@ redo:
 		 * queue, if we freed enough room for the leading one
 		 * to post its message.
 		 */
-		waiter = rtipc_peek_wait_head(&sk->o_event);
-		if (waiter == NULL)
-			goto out;
-
-		wc = rtipc_get_wait_context(waiter);
-		XENO_BUG_ON(COBALT, wc == NULL);
-		bufwc = container_of(wc, struct bufp_wait_context, wc);
-		if (bufwc->len + sk->fillsz <= sk->bufsz)
-			/* This call rescheds internally. */
-			rtdm_event_pulse(&sk->o_event);
-		else if (resched)
+		if (!__bufp_wakeup_writer(sk, fillsz) && resched)
 			xnsched_run();
 		/*
 		 * We cannot fail anymore once some data has been
@@ -270,11 +427,25 @@ redo:
 		 * pathological use of the buffer. We must allow for a
 		 * short read to prevent a deadlock.
 		 */
-		if (sk->fillsz > 0 && rtipc_peek_wait_head(&sk->o_event)) {
-			len = sk->fillsz;
+		if (fillsz > 0 && fillsz < len &&
+		    rtipc_peek_wait_head(&sk->o_event)) {
+			len = fillsz;
 			goto redo;
 		}
 
+		/*
+		 * Tell threads updating a mapped ring that they have
+		 * to kick us, then check again for data which might
+		 * have been posted meanwhile.
+		 */
+		atomic_inc(&ring->rdwaiters);
+		smp_mb();
+		fillsz = __bufp_get_fillsz(sk);
+		if (fillsz < 0 || fillsz >= len) {
+			atomic_dec(&ring->rdwaiters);
+			continue;
+		}
+
 		wait.len = len;
 		wait.sk = sk;
 		rtipc_prepare_wait(&wait.wc);
@@ -284,6 +455,7 @@ redo:
 		 */
 		ret = rtdm_event_timedwait(&sk->i_event,
 					   sk->rx_timeout, &toseq);
+		atomic_dec(&ring->rdwaiters);
 		if (unlikely(ret))
 			break;
 	}
@@ -410,15 +582,13 @@ static ssize_t __bufp_writebuf(struct bufp_socket *rsk,
 			       struct xnbufd *bufd,
 			       int flags)
 {
-	struct bufp_wait_context wait, *bufwc;
-	struct rtipc_wait_context *wc;
-	struct xnthread *waiter;
+	struct bufp_ring *ring = rsk->ring;
+	struct bufp_wait_context wait;
+	ssize_t len, ret, fillsz;
 	rtdm_toseq_t toseq;
+	u32 wrpos, wroff, next;
 	rtdm_lockctx_t s;
-	ssize_t len, ret;
 	size_t wbytes, n;
-	u_long wrtoken;
-	off_t wroff;
 	int resched;
 
 	len = bufd->b_len;
@@ -429,20 +599,25 @@ static ssize_t __bufp_writebuf(struct bufp_socket *rsk,
 redo:
 	for (;;) {
 		/*
-		 * We should be able to write the entire message at
-		 * once or block.
+		 * Sample the write position, which tells us later
+		 * whether we were preempted by another writer.
 		 */
-		if (rsk->fillsz + len > rsk->bufsz)
-			goto wait;
+		wrpos = atomic_read(&ring->wrpos);
+		fillsz = __bufp_fill(rsk, atomic_read(&ring->rdpos), wrpos);
+		if (fillsz < 0) {
+			ret = fillsz;
+			break;
+		}
 
 		/*
-		 * Draw the next write token so that we can later
-		 * detect preemption.
+		 * We should be able to write the entire message at
+		 * once or block.
 		 */
-		wrtoken = ++rsk->wrtoken;
+		if (fillsz + len > rsk->bufsz)
+			goto wait;
 
 		/* Write to the buffer in a circular way. */
-		wroff = rsk->wroff;
+		wroff = wrpos % rsk->bufsz;
 		wbytes = len;
 
 		do {
@@ -456,15 +631,15 @@ redo:
 			 */
 			cobalt_atomic_leave(s);
 			ret = xnbufd_copy_to_kmem(rsk->bufmem + wroff, bufd, n);
-			if (ret < 0)
-				return ret;
 			cobalt_atomic_enter(s);
+			if (ret < 0)
+				goto out;
 			/*
 			 * In case we were preempted while copying the
 			 * message, we have to write the whole thing
 			 * again.
 			 */
-			if (rsk->wrtoken != wrtoken) {
+			if (atomic_read(&ring->wrpos) != wrpos) {
 				xnbufd_reset(bufd);
 				goto redo;
 			}
@@ -473,31 +648,33 @@ redo:
 			wbytes -= n;
 		} while (wbytes > 0);
 
-		rsk->fillsz += len;
-		rsk->wroff = wroff;
+		/*
+		 * Mapped writers may still commit before us, in
+		 * which case we have to write the whole thing again
+		 * as well. The full barrier publishes the data
+		 * before the new position.
+		 */
+		next = bufp_ring_advance(wrpos, len, rsk->span);
+		if (atomic_cmpxchg(&ring->wrpos, wrpos, next) != wrpos) {
+			xnbufd_reset(bufd);
+			goto redo;
+		}
+
+		fillsz += len;
 		ret = len;
 		resched = 0;
 
-		if (rsk->fillsz == len) /* -> readable */
+		if (fillsz == len) /* -> readable */
 			resched |= xnselect_signal(&rsk->priv->recv_block, POLLIN);
 
-		if (rsk->fillsz == rsk->bufsz) /* non-writable */
+		if (fillsz == rsk->bufsz) /* non-writable */
 			resched |= xnselect_signal(&rsk->priv->send_block, 0);
 		/*
 		 * Wake up all threads pending on the input wait
 		 * queue, if we accumulated enough data to feed the
 		 * leading one.
 		 */
-		waiter = rtipc_peek_wait_head(&rsk->i_event);
-		if (waiter == NULL)
-			goto out;
-
-		wc = rtipc_get_wait_context(waiter);
-		XENO_BUG_ON(COBALT, wc == NULL);
-		bufwc = container_of(wc, struct bufp_wait_context, wc);
-		if (bufwc->len <= rsk->fillsz)
-			rtdm_event_pulse(&rsk->i_event);
-		else if (resched)
+		if (!__bufp_wakeup_reader(rsk, fillsz) && resched)
 			xnsched_run();
 		/*
 		 * We cannot fail anymore once some data has been
@@ -511,6 +688,19 @@ redo:
 			break;
 		}
 
+		/*
+		 * Tell threads updating a mapped ring that they have
+		 * to kick us, then check again for room which might
+		 * have been freed meanwhile.
+		 */
+		atomic_inc(&ring->wrwaiters);
+		smp_mb();
+		fillsz = __bufp_get_fillsz(rsk);
+		if (fillsz < 0 || fillsz + len <= rsk->bufsz) {
+			atomic_dec(&ring->wrwaiters);
+			continue;
+		}
+
 		wait.len = len;
 		wait.sk = rsk;
 		rtipc_prepare_wait(&wait.wc);
@@ -520,6 +710,7 @@ redo:
 		 */
 		ret = rtdm_event_timedwait(&rsk->o_event,
 					   sk->tx_timeout, &toseq);
+		atomic_dec(&ring->wrwaiters);
 		if (unlikely(ret))
 			break;
 	}
@@ -704,11 +895,9 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 	if (sk->bufsz == 0)
 		return -ENOBUFS;
 
-	sk->bufmem = alloc_pages_exact(sk->bufsz, GFP_KERNEL);
-	if (sk->bufmem == NULL) {
-		ret = -ENOMEM;
+	ret = __bufp_alloc_buffer(sk);
+	if (ret)
 		goto fail;
-	}
 
 	sk->name = *sa;
 	/* Set default destination if unset at binding time. */
@@ -719,7 +908,7 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 		ret = xnregistry_enter(sk->label, sk,
 				       &sk->handle, &__bufp_pnode.node);
 		if (ret) {
-			free_pages_exact(sk->bufmem, sk->bufsz);
+			__bufp_free_buffer(sk);
 			goto fail;
 		}
 	}
@@ -815,6 +1004,90 @@ set_assoc:
 	return 0;
 }
 
+/*
+ * Find the mapped ring a socket refers to, i.e. its own ring if bound
+ * in mapped mode, or the ring of the port it is connected to
+ * otherwise. In the latter case, the descriptor of the ring owner is
+ * returned locked into *rfdp.
+ */
+static struct bufp_socket *__bufp_grab_ring(struct rtdm_fd *fd,
+					    struct rtdm_fd **rfdp)
+{
+	struct bufp_socket *sk = rtipc_fd_to_state(fd), *rsk;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+
+	*rfdp = NULL;
+
+	if (test_bit(_BUFP_BOUND, &sk->status) && sk->ringmem)
+		return sk;
+
+	if (!test_bit(_BUFP_CONNECTED, &sk->status))
+		return NULL;
+
+	cobalt_atomic_enter(s);
+	rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
+	if (rfd && rtdm_fd_lock(rfd) < 0)
+		rfd = NULL;
+	cobalt_atomic_leave(s);
+	if (rfd == NULL)
+		return NULL;
+
+	rsk = rtipc_fd_to_state(rfd);
+	if (!test_bit(_BUFP_BOUND, &rsk->status) || rsk->ringmem == NULL) {
+		rtdm_fd_unlock(rfd);
+		return NULL;
+	}
+
+	*rfdp = rfd;
+
+	return rsk;
+}
+
+static inline void __bufp_drop_ring(struct rtdm_fd *rfd)
+{
+	if (rfd)
+		rtdm_fd_unlock(rfd);
+}
+
+/*
+ * A mapped ring was updated from user-space: wake up the threads
+ * which can be served, and update the select() state.
+ */
+static int __bufp_kick_ring(struct rtdm_fd *fd)
+{
+	struct bufp_socket *rsk;
+	struct rtdm_fd *rfd;
+	ssize_t fillsz;
+	rtdm_lockctx_t s;
+	int resched;
+
+	rsk = __bufp_grab_ring(fd, &rfd);
+	if (rsk == NULL)
+		return -ENXIO;
+
+	cobalt_atomic_enter(s);
+
+	fillsz = __bufp_get_fillsz(rsk);
+	if (fillsz < 0)
+		goto out;
+
+	resched = xnselect_signal(&rsk->priv->recv_block,
+				  fillsz > 0 ? POLLIN : 0);
+	resched |= xnselect_signal(&rsk->priv->send_block,
+				   fillsz < rsk->bufsz ? POLLOUT : 0);
+	__bufp_wakeup_reader(rsk, fillsz);
+	__bufp_wakeup_writer(rsk, fillsz);
+	if (resched)
+		xnsched_run();
+out:
+	cobalt_atomic_leave(s);
+
+	__bufp_drop_ring(rfd);
+
+	return fillsz < 0 ? fillsz : 0;
+}
+
 static int __bufp_setsockopt(struct bufp_socket *sk,
 			     struct rtdm_fd *fd,
 			     void *arg)
@@ -824,7 +1097,7 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	size_t len;
-	int ret;
+	int ret, val;
 
 	ret = rtipc_get_sockoptin(fd, &sopt, arg);
 	if (ret)
@@ -863,7 +1136,7 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 		ret = rtipc_get_length(fd, &len, sopt.optval, sopt.optlen);
 		if (ret)
 			return ret;
-		if (len == 0)
+		if (len == 0 || len > BUFP_BUFSZ_MAX)
 			return -EINVAL;
 		cobalt_atomic_enter(s);
 		/*
@@ -897,6 +1170,26 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case BUFP_MMAP:
+		if (sopt.optlen < sizeof(val))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &val, sopt.optval, sizeof(val)))
+			return -EFAULT;
+		cobalt_atomic_enter(s);
+		/*
+		 * The buffer layout is decided when binding, so we
+		 * have to do this before.
+		 */
+		if (test_bit(_BUFP_BOUND, &sk->status) ||
+		    test_bit(_BUFP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else if (val)
+			__set_bit(_BUFP_MMAP, &sk->status);
+		else
+			__clear_bit(_BUFP_MMAP, &sk->status);
+		cobalt_atomic_leave(s);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -910,9 +1203,12 @@ static int __bufp_getsockopt(struct bufp_socket *sk,
 {
 	struct _rtdm_getsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct bufp_socket *rsk;
+	struct rtdm_fd *rfd;
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	socklen_t len;
+	size_t mapsz;
 	int ret;
 
 	ret = rtipc_get_sockoptout(fd, &sopt, arg);
@@ -961,6 +1257,13 @@ static int __bufp_getsockopt(struct bufp_socket *sk,
 			return -EFAULT;
 		break;
 
+	case BUFP_MMAP:
+		rsk = __bufp_grab_ring(fd, &rfd);
+		mapsz = rsk ? rsk->ringmem->memsz : 0;
+		__bufp_drop_ring(rfd);
+		ret = rtipc_put_length(fd, sopt.optval, mapsz, len);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1019,6 +1322,10 @@ static int __bufp_ioctl(struct rtdm_fd *fd,
 		ret = -ENOTCONN;
 		break;
 
+	case BUFP_RTIOC_KICK:
+		ret = __bufp_kick_ring(fd);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1042,18 +1349,34 @@ static int bufp_ioctl(struct rtdm_fd *fd,
 	return ret;
 }
 
+/*
+ * Have user-space kick us on state changes of a mapped ring, before
+ * the current state is sampled for select().
+ */
+static inline void __bufp_mark_polled(struct bufp_socket *sk)
+{
+	if (sk->ringmem && !atomic_read(&sk->ring->polled)) {
+		atomic_set(&sk->ring->polled, 1);
+		smp_mb();
+	}
+}
+
 static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
 	struct bufp_socket *sk = priv->state, *rsk;
 	unsigned int mask = 0;
 	struct rtdm_fd *rfd;
+	ssize_t fillsz;
 	spl_t s;
 
 	cobalt_atomic_enter(s);
 
-	if (test_bit(_BUFP_BOUND, &sk->status) && sk->fillsz > 0)
-		mask |= POLLIN;
+	if (test_bit(_BUFP_BOUND, &sk->status)) {
+		__bufp_mark_polled(sk);
+		if (__bufp_get_fillsz(sk) > 0)
+			mask |= POLLIN;
+	}
 
 	/*
 	 * If the socket is connected, POLLOUT means that the peer
@@ -1065,7 +1388,9 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 		rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
 		if (rfd) {
 			rsk = rtipc_fd_to_state(rfd);
-			if (rsk->fillsz < rsk->bufsz)
+			__bufp_mark_polled(rsk);
+			fillsz = __bufp_get_fillsz(rsk);
+			if (fillsz >= 0 && fillsz < rsk->bufsz)
 				mask |= POLLOUT;
 		}
 	} else
@@ -1076,6 +1401,56 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 	return mask;
 }
 
+static void bufp_vm_open(struct vm_area_struct *vma)
+{
+	struct bufp_ringmem *ringmem = vma->vm_private_data;
+
+	atomic_inc(&ringmem->refcnt);
+}
+
+static void bufp_vm_close(struct vm_area_struct *vma)
+{
+	__bufp_put_ringmem(vma->vm_private_data);
+}
+
+static struct vm_operations_struct bufp_vm_ops = {
+	.open = bufp_vm_open,
+	.close = bufp_vm_close,
+};
+
+static int bufp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct bufp_ringmem *ringmem;
+	struct bufp_socket *rsk;
+	struct rtdm_fd *rfd;
+	size_t len;
+	int ret;
+
+	rsk = __bufp_grab_ring(fd, &rfd);
+	if (rsk == NULL)
+		return -ENXIO;
+
+	ringmem = rsk->ringmem;
+	len = vma->vm_end - vma->vm_start;
+	if (vma->vm_pgoff || len > ringmem->memsz) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = rtdm_mmap_kmem(vma, ringmem->mem);
+	if (ret)
+		goto out;
+
+	/* The ring memory lives until the last mapping is dropped. */
+	atomic_inc(&ringmem->refcnt);
+	vma->vm_ops = &bufp_vm_ops;
+	vma->vm_private_data = ringmem;
+out:
+	__bufp_drop_ring(rfd);
+
+	return ret;
+}
+
 static int bufp_init(void)
 {
 	portmap = xnmap_create(CONFIG_XENO_OPT_BUFP_NRPORT, 0, 0);
@@ -1104,5 +1479,6 @@ struct rtipc_protocol bufp_proto_driver = {
 		.write = bufp_write,
 		.ioctl = bufp_ioctl,
 		.pollstate = bufp_pollstate,
+		.mmap = bufp_mmap,
 	}
 };
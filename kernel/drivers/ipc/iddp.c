@@ -23,6 +23,7 @@
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
 #include <linux/poll.h>
+#include <linux/log2.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/bufd.h>
 #include <cobalt/kernel/map.h>
@@ -36,17 +37,51 @@ struct iddp_message {
 	int from;
 	size_t rdoff;
 	size_t len;
+	size_t bsize;
 	char data[];
 };
 
+/*
+ * Message buffers up to half a page are obtained from fixed-size
+ * slabs, one per power of two, matching the heap buckets. The slabs
+ * of the system pool are object caches, so that most allocations
+ * and releases are served from per-CPU magazines without hitting
+ * the heap lock. Whenever the system pool runs short, the cached
+ * buffers are returned to the heap before a sender may stall, so
+ * that memory parked in a size class or on a remote CPU is not
+ * withheld from it. Private pools are bounded and usually small, so
+ * their buffers are not cached at all.
+ */
+#define IDDP_SLAB_MINLOG2  6
+#define IDDP_SLAB_MAXLOG2  (PAGE_SHIFT - 1)
+#define IDDP_SLAB_COUNT    (IDDP_SLAB_MAXLOG2 - IDDP_SLAB_MINLOG2 + 1)
+
+struct iddp_pool {
+	struct xnheap *heap;
+	struct xnobjcache *slabs;
+	rtdm_waitqueue_t waitq;
+	/* Number of senders waiting for a buffer. */
+	int waiters;
+	atomic_long_t used;
+	size_t peak;
+	unsigned long stalls;
+	unsigned long handoffs;
+	int herd;		/* Peak number of waiters. */
+};
+
+struct iddp_wait_context {
+	struct rtipc_wait_context wc;
+	size_t size;
+	struct iddp_message *mbuf;
+};
+
 struct iddp_socket {
 	int magic;
 	struct sockaddr_ipc name;
 	struct sockaddr_ipc peer;
-	struct xnheap *bufpool;
-	struct xnheap privpool;
-	rtdm_waitqueue_t *poolwaitq;
-	rtdm_waitqueue_t privwaitq;
+	struct iddp_pool *bufpool;
+	struct iddp_pool privpool;
+	struct xnheap privheap;
 	size_t poolsz;
 	rtdm_sem_t insem;
 	struct list_head inq;
@@ -55,7 +90,6 @@ struct iddp_socket {
 	char label[XNOBJECT_NAME_LEN];
 	nanosecs_rel_t rx_timeout;
 	nanosecs_rel_t tx_timeout;
-	unsigned long stalls;	/* Buffer stall counter. */
 	struct rtipc_private *priv;
 };
 
@@ -66,7 +100,14 @@ static struct sockaddr_ipc nullsa = {
 
 static struct xnmap *portmap;
 
-static rtdm_waitqueue_t poolwaitq;
+static struct xnobjcache sysslabs[IDDP_SLAB_COUNT];
+
+static struct iddp_pool syspool = {
+	.heap = &cobalt_heap,
+	.slabs = sysslabs,
+};
+
+#define IDDP_MMSG_BATCH  8
 
 #define _IDDP_BINDING   0
 #define _IDDP_BOUND     1
@@ -102,52 +143,209 @@ static struct xnpnode_link __iddp_pnode = {
 
 #endif /* !CONFIG_XENO_OPT_VFILE */
 
-static inline void __iddp_init_mbuf(struct iddp_message *mbuf, size_t len)
+static void __iddp_init_pool(struct iddp_pool *pool, struct xnheap *heap,
+			     struct xnobjcache *slabs)
 {
-	mbuf->rdoff = 0;
-	mbuf->len = len;
-	INIT_LIST_HEAD(&mbuf->next);
+	pool->heap = heap;
+	pool->slabs = slabs;
+	pool->waiters = 0;
+	atomic_long_set(&pool->used, 0);
+	pool->peak = 0;
+	pool->stalls = 0;
+	pool->handoffs = 0;
+	pool->herd = 0;
+	rtdm_waitqueue_init(&pool->waitq);
+}
+
+static inline int __iddp_slab_index(size_t size)
+{
+	int log2 = order_base_2(size);
+
+	if (log2 > IDDP_SLAB_MAXLOG2)
+		return -1;
+
+	return log2 < IDDP_SLAB_MINLOG2 ? 0 : log2 - IDDP_SLAB_MINLOG2;
+}
+
+static size_t __iddp_pool_cached(struct iddp_pool *pool)
+{
+	size_t cached = 0;
+	int n;
+
+	if (pool->slabs == NULL)
+		return 0;
+
+	for (n = 0; n < IDDP_SLAB_COUNT; n++)
+		cached += xnobjcache_cached(pool->slabs + n) <<
+			(n + IDDP_SLAB_MINLOG2);
+
+	return cached;
+}
+
+/*
+ * Give the free buffers held by the slab caches back to the heap,
+ * returns non-zero if any was.
+ */
+static int __iddp_pool_reclaim(struct iddp_pool *pool)
+{
+	unsigned long nr = 0;
+	int n;
+
+	if (pool->slabs == NULL)
+		return 0;
+
+	for (n = 0; n < IDDP_SLAB_COUNT; n++) {
+		if (xnobjcache_cached(pool->slabs + n))
+			nr += xnobjcache_reclaim(pool->slabs + n);
+	}
+
+	return nr > 0;
+}
+
+static struct iddp_message *
+__iddp_pool_get(struct iddp_pool *pool, size_t size)
+{
+	struct iddp_message *mbuf;
+	size_t bsize = size;
+	int n, reclaimed = 0;
+	long used;
+
+	n = pool->slabs ? __iddp_slab_index(size) : -1;
+	if (n >= 0)
+		bsize = 1UL << (n + IDDP_SLAB_MINLOG2);
+retry:
+	if (n >= 0)
+		mbuf = xnobjcache_alloc(pool->slabs + n);
+	else
+		mbuf = xnheap_alloc(pool->heap, size);
+
+	if (mbuf == NULL) {
+		if (!reclaimed && __iddp_pool_reclaim(pool)) {
+			reclaimed = 1;
+			goto retry;
+		}
+		return NULL;
+	}
+
+	mbuf->bsize = bsize;
+	used = atomic_long_add_return(bsize, &pool->used);
+	if (used > pool->peak)	/* Racy, but does not matter. */
+		pool->peak = used;
+
+	return mbuf;
+}
+
+static void __iddp_pool_put(struct iddp_pool *pool, struct iddp_message *mbuf)
+{
+	size_t bsize = mbuf->bsize;
+
+	atomic_long_sub(bsize, &pool->used);
+
+	if (pool->slabs && bsize <= (1UL << IDDP_SLAB_MAXLOG2))
+		xnobjcache_free(pool->slabs + __iddp_slab_index(bsize), mbuf);
+	else
+		xnheap_free(pool->heap, mbuf);
+}
+
+/*
+ * Serve the senders waiting for a buffer by priority order, as long
+ * as the pool can satisfy them. Each waiter is handed its buffer
+ * directly, so that releasing a buffer never wakes up more threads
+ * than it can feed. nklock held, irqs off.
+ */
+static void __iddp_pool_serve(struct iddp_pool *pool)
+{
+	struct iddp_wait_context *iwc;
+	struct rtipc_wait_context *wc;
+	struct xnthread *waiter, *tmp;
+	struct iddp_message *mbuf;
+	int resched = 0;
+
+	rtdm_for_each_waiter_safe(waiter, tmp, &pool->waitq) {
+		wc = rtipc_get_wait_context(waiter);
+		iwc = container_of(wc, struct iddp_wait_context, wc);
+		mbuf = __iddp_pool_get(pool, iwc->size);
+		if (mbuf == NULL)
+			break;
+		iwc->mbuf = mbuf;
+		xnthread_complete_wait(wc);
+		xnsynch_wakeup_this_sleeper(&pool->waitq.wait, waiter);
+		pool->waiters--;
+		pool->handoffs++;
+		resched = 1;
+	}
+
+	if (resched)
+		xnsched_run();
 }
 
 static struct iddp_message *
 __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 		  nanosecs_rel_t timeout, int flags, int *pret)
 {
-	struct iddp_message *mbuf = NULL;
+	struct iddp_pool *pool = sk->bufpool;
+	size_t size = len + sizeof(struct iddp_message);
+	struct iddp_wait_context iwc;
+	struct iddp_message *mbuf;
 	rtdm_toseq_t timeout_seq;
 	rtdm_lockctx_t s;
 	int ret = 0;
 
 	rtdm_toseq_init(&timeout_seq, timeout);
 
-	for (;;) {
-		mbuf = xnheap_alloc(sk->bufpool, len + sizeof(*mbuf));
-		if (mbuf) {
-			__iddp_init_mbuf(mbuf, len);
-			break;
-		}
-		if (flags & MSG_DONTWAIT) {
-			ret = -EAGAIN;
-			break;
-		}
-		/*
-		 * No luck, no buffer free. Wait for a buffer to be
-		 * released and retry. Admittedly, we might create a
-		 * thundering herd effect if many waiters put a lot of
-		 * memory pressure on the pool, but in this case, the
-		 * pool size should be adjusted.
-		 */
-		rtdm_waitqueue_lock(sk->poolwaitq, s);
-		++sk->stalls;
-		ret = rtdm_timedwait_locked(sk->poolwaitq, timeout, &timeout_seq);
-		rtdm_waitqueue_unlock(sk->poolwaitq, s);
-		if (unlikely(ret == -EIDRM))
-			ret = -ECONNRESET;
-		if (ret)
-			break;
+	mbuf = __iddp_pool_get(pool, size);
+	if (likely(mbuf))
+		goto done;
+
+	if (flags & MSG_DONTWAIT) {
+		*pret = -EAGAIN;
+		return NULL;
+	}
+
+	/*
+	 * No luck, no buffer free. Advertise ourselves as a waiter
+	 * before trying again, so that a concurrent release either
+	 * makes the buffer available to our second attempt, or sees
+	 * us waiting and hands a buffer over.
+	 */
+	rtdm_waitqueue_lock(&pool->waitq, s);
+
+	pool->waiters++;
+	smp_mb();
+	mbuf = __iddp_pool_get(pool, size);
+	if (mbuf) {
+		pool->waiters--;
+		goto unlock;
 	}
 
-	*pret = ret;
+	pool->stalls++;
+	if (pool->waiters > pool->herd)
+		pool->herd = pool->waiters;
+
+	iwc.size = size;
+	iwc.mbuf = NULL;
+	rtipc_prepare_wait(&iwc.wc);
+	ret = rtdm_timedwait_condition_locked(&pool->waitq, iwc.mbuf != NULL,
+					      timeout, &timeout_seq);
+	mbuf = iwc.mbuf;
+	if (mbuf)
+		ret = 0;
+	else if (ret == -EIDRM)
+		ret = -ECONNRESET;
+	else
+		pool->waiters--;
+unlock:
+	rtdm_waitqueue_unlock(&pool->waitq, s);
+
+	if (ret) {
+		*pret = ret;
+		return NULL;
+	}
+done:
+	mbuf->rdoff = 0;
+	mbuf->len = len;
+	INIT_LIST_HEAD(&mbuf->next);
+	*pret = 0;
 
 	return mbuf;
 }
@@ -155,8 +353,19 @@ __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 static void __iddp_free_mbuf(struct iddp_socket *sk,
 			     struct iddp_message *mbuf)
 {
-	xnheap_free(sk->bufpool, mbuf);
-	rtdm_waitqueue_broadcast(sk->poolwaitq);
+	struct iddp_pool *pool = sk->bufpool;
+	rtdm_lockctx_t s;
+
+	__iddp_pool_put(pool, mbuf);
+
+	/* Pairs with the barrier in __iddp_alloc_mbuf(). */
+	smp_mb();
+	if (likely(pool->waiters == 0))
+		return;
+
+	rtdm_waitqueue_lock(&pool->waitq, s);
+	__iddp_pool_serve(pool);
+	rtdm_waitqueue_unlock(&pool->waitq, s);
 }
 
 static int iddp_socket(struct rtdm_fd *fd)
@@ -167,18 +376,15 @@ static int iddp_socket(struct rtdm_fd *fd)
 	sk->magic = IDDP_SOCKET_MAGIC;
 	sk->name = nullsa;	/* Unbound */
 	sk->peer = nullsa;
-	sk->bufpool = &cobalt_heap;
-	sk->poolwaitq = &poolwaitq;
+	sk->bufpool = &syspool;
 	sk->poolsz = 0;
 	sk->status = 0;
 	sk->handle = 0;
 	sk->rx_timeout = RTDM_TIMEOUT_INFINITE;
 	sk->tx_timeout = RTDM_TIMEOUT_INFINITE;
-	sk->stalls = 0;
 	*sk->label = 0;
 	INIT_LIST_HEAD(&sk->inq);
 	rtdm_sem_init(&sk->insem, 0);
-	rtdm_waitqueue_init(&sk->privwaitq);
 	sk->priv = priv;
 
 	return 0;
@@ -200,43 +406,145 @@ static void iddp_close(struct rtdm_fd *fd)
 	}
 
 	rtdm_sem_destroy(&sk->insem);
-	rtdm_waitqueue_destroy(&sk->privwaitq);
 
 	if (sk->handle)
 		xnregistry_remove(sk->handle);
 
-	if (sk->bufpool != &cobalt_heap) {
-		poolmem = xnheap_get_membase(&sk->privpool);
-		poolsz = xnheap_get_size(&sk->privpool);
-		xnheap_destroy(&sk->privpool);
+	if (sk->bufpool != &syspool) {
+		rtdm_waitqueue_destroy(&sk->privpool.waitq);
+		poolmem = xnheap_get_membase(&sk->privheap);
+		poolsz = xnheap_get_size(&sk->privheap);
+		xnheap_destroy(&sk->privheap);
 		free_pages_exact(poolmem, poolsz);
-		return;
+		goto out;
 	}
 
-	/* Send unread datagrams back to the system heap. */
+	/* Send unread datagrams back to the system pool. */
 	while (!list_empty(&sk->inq)) {
 		mbuf = list_entry(sk->inq.next, struct iddp_message, next);
 		list_del(&mbuf->next);
-		xnheap_free(&cobalt_heap, mbuf);
+		__iddp_free_mbuf(sk, mbuf);
 	}
-
+out:
 	kfree(sk);
 
 	return;
 }
 
+/*
+ * Write "len" bytes from a message buffer to the vector cells,
+ * advancing the latter.
+ */
+static int __iddp_copy_out(struct rtdm_fd *fd, struct iovec *iov, int iovlen,
+			   const void *data, ssize_t len)
+{
+	ssize_t wrlen, vlen, ret = 0;
+	struct xnbufd bufd;
+	int nvec;
+
+	for (nvec = 0, wrlen = len; nvec < iovlen && wrlen > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = wrlen >= iov[nvec].iov_len ? iov[nvec].iov_len : wrlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, (void *)data, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, (void *)data, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			return ret;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		wrlen -= vlen;
+		data += vlen;
+	}
+
+	return 0;
+}
+
+/*
+ * Move "len" bytes from the vector cells to a message buffer,
+ * advancing the former.
+ */
+static int __iddp_copy_in(struct rtdm_fd *fd, struct iovec *iov, int iovlen,
+			  void *data, ssize_t len)
+{
+	ssize_t rdlen, vlen, ret;
+	struct xnbufd bufd;
+	int nvec;
+
+	for (nvec = 0, rdlen = len; nvec < iovlen && rdlen > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = rdlen >= iov[nvec].iov_len ? iov[nvec].iov_len : rdlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(data, &bufd, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(data, &bufd, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			return ret;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		rdlen -= vlen;
+		data += vlen;
+	}
+
+	return 0;
+}
+
+/*
+ * Queue a list of message buffers to a socket, either at the head
+ * or at the tail of its input queue, posting one unit to the input
+ * semaphore for each of them.
+ */
+static void __iddp_queue_mbufs(struct iddp_socket *rsk,
+			       struct list_head *q, int count, int head)
+{
+	rtdm_lockctx_t s;
+
+	if (count == 0)
+		return;
+
+	cobalt_atomic_enter(s);
+
+	/*
+	 * CAUTION: we must remain atomic from the moment we signal
+	 * POLLIN, until sem_up has happened.
+	 */
+	if (list_empty(&rsk->inq)) /* -> readable */
+		xnselect_signal(&rsk->priv->recv_block, POLLIN);
+
+	if (head)
+		list_splice_init(q, &rsk->inq);
+	else
+		list_splice_tail_init(q, &rsk->inq);
+
+	while (count-- > 0)
+		rtdm_sem_up(&rsk->insem); /* Will resched. */
+
+	cobalt_atomic_leave(s);
+}
+
 static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      struct sockaddr_ipc *saddr)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
 	struct iddp_socket *sk = priv->state;
-	ssize_t maxlen, len, wrlen, vlen;
 	rtdm_toseq_t timeout_seq, *toseq;
-	int nvec, rdoff, ret, dofree;
+	int rdoff, ret, dofree;
 	struct iddp_message *mbuf;
 	nanosecs_rel_t timeout;
-	struct xnbufd bufd;
+	ssize_t maxlen, len;
 	rtdm_lockctx_t s;
 
 	if (!test_bit(_IDDP_BOUND, &sk->status))
@@ -296,27 +604,7 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 
 	cobalt_atomic_leave(s);
 
-	/* Now, write "len" bytes from mbuf->data to the vector cells */
-	for (nvec = 0, wrlen = len; nvec < iovlen && wrlen > 0; nvec++) {
-		if (iov[nvec].iov_len == 0)
-			continue;
-		vlen = wrlen >= iov[nvec].iov_len ? iov[nvec].iov_len : wrlen;
-		if (rtdm_fd_is_user(fd)) {
-			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_from_kmem(&bufd, mbuf->data + rdoff, vlen);
-			xnbufd_unmap_uread(&bufd);
-		} else {
-			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_from_kmem(&bufd, mbuf->data + rdoff, vlen);
-			xnbufd_unmap_kread(&bufd);
-		}
-		if (ret < 0)
-			break;
-		iov[nvec].iov_base += vlen;
-		iov[nvec].iov_len -= vlen;
-		wrlen -= vlen;
-		rdoff += vlen;
-	}
+	ret = __iddp_copy_out(fd, iov, iovlen, mbuf->data + rdoff, len);
 
 	if (dofree)
 		__iddp_free_mbuf(sk, mbuf);
@@ -324,16 +612,9 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 	return ret ?: len;
 }
 
-static ssize_t iddp_recvmsg(struct rtdm_fd *fd,
-			    struct msghdr *msg, int flags)
+static int __iddp_get_recvmsg_args(struct rtdm_fd *fd, struct iovec *iov,
+				   const struct msghdr *msg)
 {
-	struct iovec iov[RTIPC_IOV_MAX];
-	struct sockaddr_ipc saddr;
-	ssize_t ret;
-
-	if (flags & ~MSG_DONTWAIT)
-		return -EINVAL;
-
 	if (msg->msg_name) {
 		if (msg->msg_namelen < sizeof(struct sockaddr_ipc))
 			return -EINVAL;
@@ -344,26 +625,163 @@ static ssize_t iddp_recvmsg(struct rtdm_fd *fd,
 		return -EINVAL;
 
 	/* Copy I/O vector in */
-	ret = rtipc_get_iovec(fd, iov, msg);
-	if (ret)
-		return ret;
-
-	ret = __iddp_recvmsg(fd, iov, msg->msg_iovlen, flags, &saddr);
-	if (ret <= 0)
-		return ret;
+	return rtipc_get_iovec(fd, iov, msg);
+}
 
+static int __iddp_put_recvmsg_args(struct rtdm_fd *fd, const struct iovec *iov,
+				   struct msghdr *msg,
+				   const struct sockaddr_ipc *saddr)
+{
 	/* Copy the updated I/O vector back */
 	if (rtipc_put_iovec(fd, iov, msg))
 		return -EFAULT;
 
 	/* Copy the source address if required. */
 	if (msg->msg_name) {
-		if (rtipc_put_arg(fd, msg->msg_name, &saddr, sizeof(saddr)))
+		if (rtipc_put_arg(fd, msg->msg_name, saddr, sizeof(*saddr)))
 			return -EFAULT;
 		msg->msg_namelen = sizeof(struct sockaddr_ipc);
 	}
 
-	return ret;
+	return 0;
+}
+
+static ssize_t iddp_recvmsg(struct rtdm_fd *fd,
+			    struct msghdr *msg, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct sockaddr_ipc saddr;
+	ssize_t ret;
+
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	ret = __iddp_get_recvmsg_args(fd, iov, msg);
+	if (ret)
+		return ret;
+
+	ret = __iddp_recvmsg(fd, iov, msg->msg_iovlen, flags, &saddr);
+	if (ret <= 0)
+		return ret;
+
+	return __iddp_put_recvmsg_args(fd, iov, msg, &saddr) ?: ret;
+}
+
+/*
+ * A batch pulls as many buffers as it may receive from the input
+ * queue in a single atomic section, then copies them out to the
+ * caller. Buffers which cannot be delivered, or were only partially
+ * read, are pushed back to the head of the queue in order.
+ */
+static int iddp_recvmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			 unsigned int vlen, int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_message *mbufs[IDDP_MMSG_BATCH], *mbuf;
+	struct iddp_socket *sk = priv->state;
+	struct iovec iov[RTIPC_IOV_MAX];
+	int count, done, n, m, partial, ret;
+	struct sockaddr_ipc saddr;
+	rtdm_toseq_t timeout_seq;
+	nanosecs_rel_t timeout;
+	ssize_t maxlen, len;
+	size_t rdoff;
+	rtdm_lockctx_t s;
+	LIST_HEAD(q);
+
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	if (!test_bit(_IDDP_BOUND, &sk->status))
+		return -EAGAIN;
+
+	if (vlen > IDDP_MMSG_BATCH)
+		vlen = IDDP_MMSG_BATCH;
+
+	timeout = (flags & MSG_DONTWAIT) ? RTDM_TIMEOUT_NONE : sk->rx_timeout;
+	rtdm_toseq_init(&timeout_seq, timeout);
+
+	for (;;) {
+		ret = rtdm_sem_timeddown(&sk->insem, timeout, &timeout_seq);
+		if (unlikely(ret)) {
+			if (ret == -EIDRM)
+				return -ECONNRESET;
+			return ret;
+		}
+		/* We may have spurious wakeups. */
+		cobalt_atomic_enter(s);
+		if (!list_empty(&sk->inq))
+			break;
+		cobalt_atomic_leave(s);
+	}
+
+	/*
+	 * We hold one unit from the input semaphore, grab another one
+	 * for each additional buffer we pull without blocking.
+	 */
+	count = 0;
+	do {
+		mbuf = list_first_entry(&sk->inq, struct iddp_message, next);
+		list_del(&mbuf->next);
+		mbufs[count++] = mbuf;
+	} while (count < vlen && !list_empty(&sk->inq) &&
+		 rtdm_sem_timeddown(&sk->insem, RTDM_TIMEOUT_NONE, NULL) == 0);
+
+	if (list_empty(&sk->inq)) /* -> non-readable */
+		xnselect_signal(&priv->recv_block, 0);
+
+	cobalt_atomic_leave(s);
+
+	saddr.sipc_family = AF_RTIPC;
+
+	for (n = 0, done = 0; n < count; n++) {
+		ret = __iddp_get_recvmsg_args(fd, iov, &msgvec[n].msg_hdr);
+		if (ret)
+			break;
+
+		mbuf = mbufs[n];
+		rdoff = mbuf->rdoff;
+		len = mbuf->len - rdoff;
+		maxlen = rtipc_get_iov_flatlen(iov, msgvec[n].msg_hdr.msg_iovlen);
+		partial = maxlen < len;
+		if (partial)
+			len = maxlen;
+
+		ret = __iddp_copy_out(fd, iov, msgvec[n].msg_hdr.msg_iovlen,
+				      mbuf->data + rdoff, len);
+		if (ret == 0) {
+			saddr.sipc_port = mbuf->from;
+			ret = __iddp_put_recvmsg_args(fd, iov,
+						      &msgvec[n].msg_hdr, &saddr);
+		}
+
+		/*
+		 * Buffer is only partially read: repost it and
+		 * stop. The read offset only moves once the data
+		 * has reached the caller.
+		 */
+		if (partial) {
+			if (ret == 0) {
+				mbuf->rdoff += len;
+				msgvec[done++].msg_len = len;
+			}
+			break;
+		}
+
+		__iddp_free_mbuf(sk, mbuf);
+		if (ret) {
+			n++;
+			break;
+		}
+		msgvec[done++].msg_len = len;
+	}
+
+	/* Push back what we did not consume. */
+	for (m = n; m < count; m++)
+		list_add_tail(&mbufs[m]->next, &q);
+	__iddp_queue_mbufs(sk, &q, count - n, 1);
+
+	return done > 0 ? done : ret;
 }
 
 static ssize_t iddp_read(struct rtdm_fd *fd, void *buf, size_t len)
@@ -373,37 +791,56 @@ static ssize_t iddp_read(struct rtdm_fd *fd, void *buf, size_t len)
 	return __iddp_recvmsg(fd, &iov, 1, 0, NULL);
 }
 
-static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
-			      struct iovec *iov, int iovlen, int flags,
-			      const struct sockaddr_ipc *daddr)
+/*
+ * Fetch and lock the socket bound to a destination port. The caller
+ * should drop the lock on the returned descriptor when done.
+ */
+static struct iddp_socket *__iddp_get_peer(const struct sockaddr_ipc *daddr,
+					   struct rtdm_fd **rfdp)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct iddp_socket *sk = priv->state, *rsk;
-	struct iddp_message *mbuf;
-	ssize_t len, rdlen, vlen;
-	int nvec, wroff, ret;
+	struct iddp_socket *rsk;
 	struct rtdm_fd *rfd;
-	struct xnbufd bufd;
 	rtdm_lockctx_t s;
 
-	len = rtipc_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
-		return 0;
-
 	cobalt_atomic_enter(s);
 	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
 	if (rfd && rtdm_fd_lock(rfd) < 0)
 		rfd = NULL;
 	cobalt_atomic_leave(s);
 	if (rfd == NULL)
-		return -ECONNRESET;
+		return ERR_PTR(-ECONNRESET);
 
 	rsk = rtipc_fd_to_state(rfd);
 	if (!test_bit(_IDDP_BOUND, &rsk->status)) {
 		rtdm_fd_unlock(rfd);
-		return -ECONNREFUSED;
+		return ERR_PTR(-ECONNREFUSED);
 	}
 
+	*rfdp = rfd;
+
+	return rsk;
+}
+
+static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
+			      struct iovec *iov, int iovlen, int flags,
+			      const struct sockaddr_ipc *daddr)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state, *rsk;
+	struct iddp_message *mbuf;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+	ssize_t len;
+	int ret;
+
+	len = rtipc_get_iov_flatlen(iov, iovlen);
+	if (len == 0)
+		return 0;
+
+	rsk = __iddp_get_peer(daddr, &rfd);
+	if (IS_ERR(rsk))
+		return PTR_ERR(rsk);
+
 	mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout, flags, &ret);
 	if (unlikely(ret)) {
 		rtdm_fd_unlock(rfd);
@@ -411,27 +848,9 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 	}
 
 	/* Now, move "len" bytes to mbuf->data from the vector cells */
-	for (nvec = 0, rdlen = len, wroff = 0;
-	     nvec < iovlen && rdlen > 0; nvec++) {
-		if (iov[nvec].iov_len == 0)
-			continue;
-		vlen = rdlen >= iov[nvec].iov_len ? iov[nvec].iov_len : rdlen;
-		if (rtdm_fd_is_user(fd)) {
-			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_to_kmem(mbuf->data + wroff, &bufd, vlen);
-			xnbufd_unmap_uread(&bufd);
-		} else {
-			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_to_kmem(mbuf->data + wroff, &bufd, vlen);
-			xnbufd_unmap_kread(&bufd);
-		}
-		if (ret < 0)
-			goto fail;
-		iov[nvec].iov_base += vlen;
-		iov[nvec].iov_len -= vlen;
-		rdlen -= vlen;
-		wroff += vlen;
-	}
+	ret = __iddp_copy_in(fd, iov, iovlen, mbuf->data, len);
+	if (ret)
+		goto fail;
 
 	cobalt_atomic_enter(s);
 
@@ -465,34 +884,28 @@ fail:
 	return ret;
 }
 
-static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
-			    const struct msghdr *msg, int flags)
+static int __iddp_get_sendmsg_args(struct rtdm_fd *fd, struct iovec *iov,
+				   struct sockaddr_ipc *daddr,
+				   const struct msghdr *msg)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct iddp_socket *sk = priv->state;
-	struct iovec iov[RTIPC_IOV_MAX];
-	struct sockaddr_ipc daddr;
-	ssize_t ret;
-
-	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
-		return -EINVAL;
+	struct iddp_socket *sk = rtipc_fd_to_state(fd);
 
 	if (msg->msg_name) {
 		if (msg->msg_namelen != sizeof(struct sockaddr_ipc))
 			return -EINVAL;
 
 		/* Fetch the destination address to send to. */
-		if (rtipc_get_arg(fd, &daddr, msg->msg_name, sizeof(daddr)))
+		if (rtipc_get_arg(fd, daddr, msg->msg_name, sizeof(*daddr)))
 			return -EFAULT;
 
-		if (daddr.sipc_port < 0 ||
-		    daddr.sipc_port >= CONFIG_XENO_OPT_IDDP_NRPORT)
+		if (daddr->sipc_port < 0 ||
+		    daddr->sipc_port >= CONFIG_XENO_OPT_IDDP_NRPORT)
 			return -EINVAL;
 	} else {
 		if (msg->msg_namelen != 0)
 			return -EINVAL;
-		daddr = sk->peer;
-		if (daddr.sipc_port < 0)
+		*daddr = sk->peer;
+		if (daddr->sipc_port < 0)
 			return -EDESTADDRREQ;
 	}
 
@@ -500,7 +913,20 @@ static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
 		return -EINVAL;
 
 	/* Copy I/O vector in */
-	ret = rtipc_get_iovec(fd, iov, msg);
+	return rtipc_get_iovec(fd, iov, msg);
+}
+
+static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
+			    const struct msghdr *msg, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct sockaddr_ipc daddr;
+	ssize_t ret;
+
+	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
+		return -EINVAL;
+
+	ret = __iddp_get_sendmsg_args(fd, iov, &daddr, msg);
 	if (ret)
 		return ret;
 
@@ -512,6 +938,89 @@ static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
 	return rtipc_put_iovec(fd, iov, msg) ?: ret;
 }
 
+/*
+ * A batch resolves the destination port once for all consecutive
+ * messages sent to the same peer, then posts them to its input
+ * queue in a single atomic section. Pending messages are flushed
+ * before waiting for buffer memory, so that the receiver may
+ * release some.
+ */
+static int iddp_sendmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			 unsigned int vlen, int flags)
+{
+	struct iddp_socket *sk = rtipc_fd_to_state(fd), *rsk = NULL;
+	int n, ret = 0, port = -1, queued = 0;
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct rtdm_fd *rfd = NULL;
+	struct iddp_message *mbuf;
+	struct sockaddr_ipc daddr;
+	struct msghdr *msg;
+	ssize_t len;
+	LIST_HEAD(q);
+
+	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
+		return -EINVAL;
+
+	for (n = 0; n < vlen; n++) {
+		msg = &msgvec[n].msg_hdr;
+		ret = __iddp_get_sendmsg_args(fd, iov, &daddr, msg);
+		if (ret)
+			break;
+
+		if (rsk == NULL || daddr.sipc_port != port) {
+			if (rsk) {
+				__iddp_queue_mbufs(rsk, &q, queued,
+						   flags & MSG_OOB);
+				queued = 0;
+				rtdm_fd_unlock(rfd);
+			}
+			rsk = __iddp_get_peer(&daddr, &rfd);
+			if (IS_ERR(rsk)) {
+				ret = PTR_ERR(rsk);
+				rsk = NULL;
+				break;
+			}
+			port = daddr.sipc_port;
+		}
+
+		len = rtipc_get_iov_flatlen(iov, msg->msg_iovlen);
+		if (len > 0) {
+			mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout,
+						 flags | MSG_DONTWAIT, &ret);
+			if (mbuf == NULL && ret == -EAGAIN &&
+			    (flags & MSG_DONTWAIT) == 0) {
+				__iddp_queue_mbufs(rsk, &q, queued,
+						   flags & MSG_OOB);
+				queued = 0;
+				mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout,
+							 flags, &ret);
+			}
+			if (mbuf == NULL)
+				break;
+			ret = __iddp_copy_in(fd, iov, msg->msg_iovlen,
+					     mbuf->data, len);
+			if (ret == 0 && rtipc_put_iovec(fd, iov, msg))
+				ret = -EFAULT;
+			if (ret) {
+				__iddp_free_mbuf(rsk, mbuf);
+				break;
+			}
+			mbuf->from = sk->name.sipc_port;
+			list_add_tail(&mbuf->next, &q);
+			queued++;
+		}
+
+		msgvec[n].msg_len = len;
+	}
+
+	if (rsk) {
+		__iddp_queue_mbufs(rsk, &q, queued, flags & MSG_OOB);
+		rtdm_fd_unlock(rfd);
+	}
+
+	return n > 0 ? n : ret;
+}
+
 static ssize_t iddp_write(struct rtdm_fd *fd,
 			  const void *buf, size_t len)
 {
@@ -573,13 +1082,13 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 			goto fail;
 		}
 
-		ret = xnheap_init(&sk->privpool, poolmem, poolsz);
+		ret = xnheap_init(&sk->privheap, poolmem, poolsz);
 		if (ret) {
 			free_pages_exact(poolmem, poolsz);
 			goto fail;
 		}
-		xnheap_set_name(&sk->privpool, "iddp-pool@%d", port);
-		sk->poolwaitq = &sk->privwaitq;
+		xnheap_set_name(&sk->privheap, "iddp-pool@%d", port);
+		__iddp_init_pool(&sk->privpool, &sk->privheap, NULL);
 		sk->bufpool = &sk->privpool;
 	}
 
@@ -593,7 +1102,9 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 				       &sk->handle, &__iddp_pnode.node);
 		if (ret) {
 			if (poolsz > 0) {
-				xnheap_destroy(&sk->privpool);
+				sk->bufpool = &syspool;
+				rtdm_waitqueue_destroy(&sk->privpool.waitq);
+				xnheap_destroy(&sk->privheap);
 				free_pages_exact(poolmem, poolsz);
 			}
 			goto fail;
@@ -919,20 +1430,155 @@ static int iddp_ioctl(struct rtdm_fd *fd,
 	return ret;
 }
 
+#ifdef CONFIG_XENO_OPT_VFILE
+
+struct iddp_pool_stat {
+	u32 size;
+	long used;
+	size_t cached;
+	size_t peak;
+	unsigned long stalls;
+	unsigned long handoffs;
+	int herd;
+};
+
+static void iddp_get_pool_stat(struct iddp_pool *pool,
+			       struct iddp_pool_stat *st)
+{
+	st->size = xnheap_get_size(pool->heap);
+	st->used = atomic_long_read(&pool->used);
+	st->cached = __iddp_pool_cached(pool);
+	st->peak = pool->peak;
+	st->stalls = pool->stalls;
+	st->handoffs = pool->handoffs;
+	st->herd = pool->herd;
+}
+
+static void iddp_show_pool(struct xnvfile_regular_iterator *it,
+			   struct iddp_pool_stat *st, int port,
+			   const char *label)
+{
+	if (port < 0)
+		xnvfile_printf(it, "%5s", "*");
+	else
+		xnvfile_printf(it, "%5d", port);
+
+	xnvfile_printf(it, " %10u %10ld %10zu %10zu %10lu %10lu %6d  %s\n",
+		       st->size, st->used, st->cached, st->peak,
+		       st->stalls, st->handoffs, st->herd, label);
+}
+
+static int iddp_vfile_show(struct xnvfile_regular_iterator *it, void *data)
+{
+	char label[XNOBJECT_NAME_LEN];
+	struct iddp_pool_stat st;
+	struct iddp_socket *sk;
+	struct rtdm_fd *rfd;
+	spl_t s;
+	int port;
+
+	xnvfile_printf(it, "%5s %10s %10s %10s %10s %10s %10s %6s  %s\n",
+		       "PORT", "POOLSZ", "USED", "CACHED", "PEAK", "STALLS",
+		       "HANDOFFS", "HERD", "LABEL");
+
+	cobalt_atomic_enter(s);
+	iddp_get_pool_stat(&syspool, &st);
+	cobalt_atomic_leave(s);
+	iddp_show_pool(it, &st, -1, "(system)");
+
+	for (port = 0; port < CONFIG_XENO_OPT_IDDP_NRPORT; port++) {
+		cobalt_atomic_enter(s);
+		rfd = xnmap_fetch_nocheck(portmap, port);
+		if (rfd == NULL) {
+			cobalt_atomic_leave(s);
+			continue;
+		}
+		sk = rtipc_fd_to_state(rfd);
+		if (sk->bufpool == &syspool) {
+			cobalt_atomic_leave(s);
+			continue;
+		}
+		iddp_get_pool_stat(sk->bufpool, &st);
+		knamecpy(label, sk->label);
+		cobalt_atomic_leave(s);
+		iddp_show_pool(it, &st, port, label);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops iddp_vfile_ops = {
+	.show = iddp_vfile_show,
+};
+
+static struct xnvfile_regular iddp_vfile = {
+	.ops = &iddp_vfile_ops,
+};
+
+static inline int iddp_init_proc(void)
+{
+	return xnvfile_init_regular("iddp", &iddp_vfile, &rtipc_vfroot);
+}
+
+static inline void iddp_cleanup_proc(void)
+{
+	xnvfile_destroy_regular(&iddp_vfile);
+}
+
+#else /* !CONFIG_XENO_OPT_VFILE */
+
+static inline int iddp_init_proc(void)
+{
+	return 0;
+}
+
+static inline void iddp_cleanup_proc(void) { }
+
+#endif /* !CONFIG_XENO_OPT_VFILE */
+
+static void iddp_destroy_slabs(int count)
+{
+	while (count-- > 0)
+		xnobjcache_destroy(sysslabs + count);
+}
+
 static int iddp_init(void)
 {
+	char name[XNOBJECT_NAME_LEN];
+	int ret, n;
+
 	portmap = xnmap_create(CONFIG_XENO_OPT_IDDP_NRPORT, 0, 0);
 	if (portmap == NULL)
 		return -ENOMEM;
 
-	rtdm_waitqueue_init(&poolwaitq);
+	for (n = 0; n < IDDP_SLAB_COUNT; n++) {
+		ksformat(name, sizeof(name), "iddp-%lu",
+			 1UL << (n + IDDP_SLAB_MINLOG2));
+		ret = xnobjcache_init(sysslabs + n, &cobalt_heap,
+				      1U << (n + IDDP_SLAB_MINLOG2), name);
+		if (ret)
+			goto fail;
+	}
+
+	__iddp_init_pool(&syspool, &cobalt_heap, sysslabs);
+
+	ret = iddp_init_proc();
+	if (ret)
+		goto fail;
 
 	return 0;
+fail:
+	iddp_destroy_slabs(n);
+	xnmap_delete(portmap);
+
+	return ret;
 }
 
 static void iddp_exit(void)
 {
-	rtdm_waitqueue_destroy(&poolwaitq);
+	iddp_cleanup_proc();
+	rtdm_waitqueue_destroy(&syspool.waitq);
+	iddp_destroy_slabs(IDDP_SLAB_COUNT);
 	xnmap_delete(portmap);
 }
 
@@ -982,6 +1628,8 @@ struct rtipc_protocol iddp_proto_driver = {
 		.close = iddp_close,
 		.recvmsg = iddp_recvmsg,
 		.sendmsg = iddp_sendmsg,
+		.recvmmsg = iddp_recvmmsg,
+		.sendmmsg = iddp_sendmmsg,
 		.read = iddp_read,
 		.write = iddp_write,
 		.ioctl = iddp_ioctl,
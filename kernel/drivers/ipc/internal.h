@@ -50,6 +50,12 @@ struct rtipc_protocol {
 				   struct msghdr *msg, int flags);
 		ssize_t (*sendmsg)(struct rtdm_fd *fd,
 				   const struct msghdr *msg, int flags);
+		int (*recvmmsg)(struct rtdm_fd *fd,
+				struct rtdm_mmsghdr *msgvec,
+				unsigned int vlen, int flags);
+		int (*sendmmsg)(struct rtdm_fd *fd,
+				struct rtdm_mmsghdr *msgvec,
+				unsigned int vlen, int flags);
 		ssize_t (*read)(struct rtdm_fd *fd,
 				void *buf, size_t len);
 		ssize_t (*write)(struct rtdm_fd *fd,
@@ -57,6 +63,8 @@ struct rtipc_protocol {
 		int (*ioctl)(struct rtdm_fd *fd,
 			     unsigned int request, void *arg);
 		unsigned int (*pollstate)(struct rtdm_fd *fd);
+		int (*mmap)(struct rtdm_fd *fd,
+			    struct vm_area_struct *vma);
 	} proto_ops;
 };
 
@@ -117,6 +125,9 @@ int rtipc_put_timeval(struct rtdm_fd *fd, void *arg,
 int rtipc_get_length(struct rtdm_fd *fd, size_t *lenp,
 		     const void *arg, size_t arglen);
 
+int rtipc_put_length(struct rtdm_fd *fd, void *arg,
+		     size_t len, size_t arglen);
+
 int rtipc_get_arg(struct rtdm_fd *fd, void *dst, const void *src,
 		  size_t len);
 
@@ -133,6 +144,10 @@ extern struct rtipc_protocol bufp_proto_driver;
 
 extern struct xnptree rtipc_ptree;
 
+#ifdef CONFIG_XENO_OPT_VFILE
+extern struct xnvfile_directory rtipc_vfroot;
+#endif
+
 #define rtipc_wait_context		xnthread_wait_context
 #define rtipc_prepare_wait		xnthread_prepare_wait
 #define rtipc_get_wait_context		xnthread_get_wait_context
@@ -43,6 +43,10 @@ static struct rtipc_protocol *protocols[IPCPROTO_MAX] = {
 
 DEFINE_XNPTREE(rtipc_ptree, "rtipc");
 
+#ifdef CONFIG_XENO_OPT_VFILE
+struct xnvfile_directory rtipc_vfroot;
+#endif
+
 int rtipc_get_arg(struct rtdm_fd *fd, void *dst, const void *src, size_t len)
 {
 	if (!rtdm_fd_is_user(fd)) {
@@ -374,6 +378,24 @@ int rtipc_get_length(struct rtdm_fd *fd, size_t *lenp,
 	return rtdm_safe_copy_from_user(fd, lenp, arg, sizeof(*lenp));
 }
 
+int rtipc_put_length(struct rtdm_fd *fd, void *arg,
+		     size_t len, size_t arglen)
+{
+#ifdef CONFIG_XENO_ARCH_SYS3264
+	if (rtdm_fd_is_compat(fd)) {
+		compat_size_t csz = len;
+		if (arglen != sizeof(csz))
+			return -EINVAL;
+		return rtipc_put_arg(fd, arg, &csz, sizeof(csz));
+	}
+#endif
+
+	if (arglen != sizeof(size_t))
+		return -EINVAL;
+
+	return rtipc_put_arg(fd, arg, &len, sizeof(len));
+}
+
 ssize_t rtipc_get_iov_flatlen(struct iovec *iov, int iovlen)
 {
 	ssize_t len;
@@ -450,6 +472,32 @@ static ssize_t rtipc_sendmsg(struct rtdm_fd *fd,
 	return priv->proto->proto_ops.sendmsg(fd, msg, flags);
 }
 
+/*
+ * Protocols with no batched handler are served by the RTDM core,
+ * which iterates over the regular message handlers instead.
+ */
+static int rtipc_recvmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			  unsigned int vlen, int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+
+	if (priv->proto->proto_ops.recvmmsg == NULL)
+		return -EOPNOTSUPP;
+
+	return priv->proto->proto_ops.recvmmsg(fd, msgvec, vlen, flags);
+}
+
+static int rtipc_sendmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			  unsigned int vlen, int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+
+	if (priv->proto->proto_ops.sendmmsg == NULL)
+		return -EOPNOTSUPP;
+
+	return priv->proto->proto_ops.sendmmsg(fd, msgvec, vlen, flags);
+}
+
 static ssize_t rtipc_read(struct rtdm_fd *fd,
 			  void *buf, size_t len)
 {
@@ -471,6 +519,16 @@ static int rtipc_ioctl(struct rtdm_fd *fd,
 	return priv->proto->proto_ops.ioctl(fd, request, arg);
 }
 
+static int rtipc_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+
+	if (priv->proto->proto_ops.mmap == NULL)
+		return -ENODEV;
+
+	return priv->proto->proto_ops.mmap(fd, vma);
+}
+
 static int rtipc_select(struct rtdm_fd *fd, struct xnselector *selector,
 			unsigned int type, unsigned int index)
 {
@@ -527,6 +585,10 @@ static struct rtdm_driver rtipc_driver = {
 		.recvmsg_nrt	=	NULL,
 		.sendmsg_rt	=	rtipc_sendmsg,
 		.sendmsg_nrt	=	NULL,
+		.recvmmsg_rt	=	rtipc_recvmmsg,
+		.recvmmsg_nrt	=	NULL,
+		.sendmmsg_rt	=	rtipc_sendmmsg,
+		.sendmmsg_nrt	=	NULL,
 		.ioctl_rt	=	rtipc_ioctl,
 		.ioctl_nrt	=	rtipc_ioctl,
 		.read_rt	=	rtipc_read,
@@ -534,6 +596,7 @@ static struct rtdm_driver rtipc_driver = {
 		.write_rt	=	rtipc_write,
 		.write_nrt	=	NULL,
 		.select		=	rtipc_select,
+		.mmap		=	rtipc_mmap,
 	},
 };
 
@@ -549,6 +612,12 @@ int __init __rtipc_init(void)
 	if (!realtime_core_enabled())
 		return 0;
 
+#ifdef CONFIG_XENO_OPT_VFILE
+	ret = xnvfile_init_dir("rtipc", &rtipc_vfroot, &cobalt_vfroot);
+	if (ret)
+		return ret;
+#endif
+
 	for (n = 0; n < IPCPROTO_MAX; n++) {
 		if (protocols[n] && protocols[n]->proto_init) {
 			ret = protocols[n]->proto_init();
@@ -573,6 +642,10 @@ void __exit __rtipc_exit(void)
 		if (protocols[n] && protocols[n]->proto_exit)
 			protocols[n]->proto_exit();
 	}
+
+#ifdef CONFIG_XENO_OPT_VFILE
+	xnvfile_destroy_dir(&rtipc_vfroot);
+#endif
 }
 
 module_init(__rtipc_init);
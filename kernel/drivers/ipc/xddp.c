@@ -20,6 +20,7 @@
 #include <linux/module.h>
 #include <linux/string.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/bufd.h>
 #include <cobalt/kernel/pipe.h>
@@ -34,6 +35,17 @@ struct xddp_message {
 	char data[];
 };
 
+/*
+ * Memory backing a mapped ring: the shared ring state on the first
+ * page, followed by the data area. It may outlive the socket, until
+ * the last mapping is dropped.
+ */
+struct xddp_ringmem {
+	void *mem;
+	size_t memsz;
+	atomic_t refcnt;
+};
+
 struct xddp_socket {
 	int magic;
 	struct sockaddr_ipc name;
@@ -57,6 +69,14 @@ struct xddp_socket {
 	nanosecs_rel_t timeout;	/* connect()/recvmsg() timeout */
 	size_t reqbufsz;	/* Requested streaming buffer size */
 
+	struct xddp_ringmem *ringmem;
+	struct xddp_ring *ring;
+	char *ringbuf;		/* Ring data area */
+	size_t ringsz;		/* Ring data size */
+	u32 ring_head;		/* Next record to reserve */
+	u32 ring_resv;		/* Bytes reserved, not published yet */
+	int ring_writers;	/* Senders copying to the ring */
+
 	int (*monitor)(struct rtdm_fd *fd, int event, long arg);
 	struct rtipc_private *priv;
 };
@@ -196,12 +216,106 @@ static int __xddp_input_handler(struct xnpipe_mh *mh, int retval, void *skarg) /
 	return retval;
 }
 
+static void __xddp_put_ringmem(struct xddp_ringmem *ringmem)
+{
+	if (atomic_dec_and_test(&ringmem->refcnt)) {
+		free_pages_exact(ringmem->mem, ringmem->memsz);
+		kfree(ringmem);
+	}
+}
+
+static int __xddp_alloc_ring(struct xddp_socket *sk)
+{
+	struct xddp_ringmem *ringmem;
+	struct xddp_ring *ring;
+
+	ringmem = kmalloc(sizeof(*ringmem), GFP_KERNEL);
+	if (ringmem == NULL)
+		return -ENOMEM;
+
+	/* Shared ring state on the first page, data next. */
+	sk->ringsz = PAGE_ALIGN(sk->ringsz);
+	ringmem->memsz = PAGE_SIZE + sk->ringsz;
+	ringmem->mem = alloc_pages_exact(ringmem->memsz,
+					 GFP_KERNEL | __GFP_ZERO);
+	if (ringmem->mem == NULL) {
+		kfree(ringmem);
+		return -ENOMEM;
+	}
+	atomic_set(&ringmem->refcnt, 1);
+
+	ring = ringmem->mem;
+	ring->bufsz = sk->ringsz;
+	ring->data_offset = PAGE_SIZE;
+	sk->ring = ring;
+	sk->ringmem = ringmem;
+	sk->ringbuf = ringmem->mem + PAGE_SIZE;
+	sk->ring_head = 0;
+	sk->ring_resv = 0;
+	sk->ring_writers = 0;
+
+	return 0;
+}
+
+static void __xddp_free_ring(struct xddp_socket *sk)
+{
+	if (sk->ringmem) {
+		__xddp_put_ringmem(sk->ringmem);
+		sk->ringmem = NULL;
+		sk->ring = NULL;
+		sk->ringbuf = NULL;
+	}
+}
+
+static void xddp_vm_open(struct vm_area_struct *vma)
+{
+	struct xddp_ringmem *ringmem = vma->vm_private_data;
+
+	atomic_inc(&ringmem->refcnt);
+}
+
+static void xddp_vm_close(struct vm_area_struct *vma)
+{
+	__xddp_put_ringmem(vma->vm_private_data);
+}
+
+static struct vm_operations_struct xddp_vm_ops = {
+	.open = xddp_vm_open,
+	.close = xddp_vm_close,
+};
+
+static int __xddp_mmap_handler(struct vm_area_struct *vma,
+			       void *skarg) /* nklock free */
+{
+	struct xddp_socket *sk = skarg;
+	struct xddp_ringmem *ringmem = sk->ringmem;
+	size_t len;
+	int ret;
+
+	len = vma->vm_end - vma->vm_start;
+	if (vma->vm_pgoff || len > ringmem->memsz)
+		return -EINVAL;
+
+	ret = rtdm_mmap_kmem(vma, ringmem->mem);
+	if (ret)
+		return ret;
+
+	/* The ring memory lives until the last mapping is dropped. */
+	atomic_inc(&ringmem->refcnt);
+	vma->vm_ops = &xddp_vm_ops;
+	vma->vm_private_data = ringmem;
+
+	return 0;
+}
+
 static void __xddp_release_handler(void *skarg) /* nklock free */
 {
 	struct xddp_socket *sk = skarg;
 	void *poolmem;
 	u32 poolsz;
 
+	__xddp_free_ring(sk);
+
 	if (sk->bufpool == &sk->privpool) {
 		poolmem = xnheap_get_membase(&sk->privpool);
 		poolsz = xnheap_get_size(&sk->privpool);
@@ -233,6 +347,10 @@ static int xddp_socket(struct rtdm_fd *fd)
 	sk->timeout = RTDM_TIMEOUT_INFINITE;
 	sk->curbufsz = 0;
 	sk->reqbufsz = 0;
+	sk->ringmem = NULL;
+	sk->ring = NULL;
+	sk->ringbuf = NULL;
+	sk->ringsz = 0;
 	sk->monitor = NULL;
 	rtdm_lock_init(&sk->lock);
 	sk->priv = priv;
@@ -261,19 +379,22 @@ static void xddp_close(struct rtdm_fd *fd)
 	xnpipe_disconnect(sk->minor);
 }
 
-static ssize_t __xddp_recvmsg(struct rtdm_fd *fd,
-			      struct iovec *iov, int iovlen, int flags,
-			      struct sockaddr_ipc *saddr)
+/*
+ * Pull the heading message from the input queue, leaving the
+ * readability state of the socket to our caller.
+ */
+static ssize_t __xddp_pull(struct rtdm_fd *fd,
+			   struct iovec *iov, int iovlen, int flags,
+			   struct sockaddr_ipc *saddr)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct xddp_message *mbuf = NULL; /* Fake GCC */
 	struct xddp_socket *sk = priv->state;
 	ssize_t maxlen, len, wrlen, vlen;
+	struct xddp_message *mbuf;
 	nanosecs_rel_t timeout;
 	struct xnpipe_mh *mh;
 	int nvec, rdoff, ret;
 	struct xnbufd bufd;
-	spl_t s;
 
 	if (!test_bit(_XDDP_BOUND, &sk->status))
 		return -EAGAIN;
@@ -287,13 +408,14 @@ static ssize_t __xddp_recvmsg(struct rtdm_fd *fd,
 	len = xnpipe_recv(sk->minor, &mh, timeout);
 	if (len < 0)
 		return len == -EIDRM ? 0 : len;
+
+	mbuf = container_of(mh, struct xddp_message, mh);
+
 	if (len > maxlen) {
 		ret = -ENOBUFS;
 		goto out;
 	}
 
-	mbuf = container_of(mh, struct xddp_message, mh);
-
 	if (saddr)
 		*saddr = sk->name;
 
@@ -319,27 +441,41 @@ static ssize_t __xddp_recvmsg(struct rtdm_fd *fd,
 		wrlen -= vlen;
 		rdoff += vlen;
 	}
+
+	ret = 0;
 out:
 	xnheap_free(sk->bufpool, mbuf);
+
+	return ret ?: len;
+}
+
+static void __xddp_sync_recv_block(struct rtipc_private *priv)
+{
+	struct xddp_socket *sk = priv->state;
+	spl_t s;
+
 	cobalt_atomic_enter(s);
 	if ((__xnpipe_pollstate(sk->minor) & POLLIN) == 0 &&
 	    xnselect_signal(&priv->recv_block, 0))
 		xnsched_run();
 	cobalt_atomic_leave(s);
-
-	return ret ?: len;
 }
 
-static ssize_t xddp_recvmsg(struct rtdm_fd *fd,
-			    struct msghdr *msg, int flags)
+static ssize_t __xddp_recvmsg(struct rtdm_fd *fd,
+			      struct iovec *iov, int iovlen, int flags,
+			      struct sockaddr_ipc *saddr)
 {
-	struct iovec iov[RTIPC_IOV_MAX];
-	struct sockaddr_ipc saddr;
 	ssize_t ret;
 
-	if (flags & ~MSG_DONTWAIT)
-		return -EINVAL;
+	ret = __xddp_pull(fd, iov, iovlen, flags, saddr);
+	__xddp_sync_recv_block(rtdm_fd_to_private(fd));
+
+	return ret;
+}
 
+static int __xddp_get_recvmsg_args(struct rtdm_fd *fd, struct iovec *iov,
+				   const struct msghdr *msg)
+{
 	if (msg->msg_name) {
 		if (msg->msg_namelen < sizeof(struct sockaddr_ipc))
 			return -EINVAL;
@@ -350,26 +486,90 @@ static ssize_t xddp_recvmsg(struct rtdm_fd *fd,
 		return -EINVAL;
 
 	/* Copy I/O vector in */
-	ret = rtipc_get_iovec(fd, iov, msg);
-	if (ret)
-		return ret;
-
-	ret = __xddp_recvmsg(fd, iov, msg->msg_iovlen, flags, &saddr);
-	if (ret <= 0)
-		return ret;
+	return rtipc_get_iovec(fd, iov, msg);
+}
 
+static int __xddp_put_recvmsg_args(struct rtdm_fd *fd, const struct iovec *iov,
+				   struct msghdr *msg,
+				   const struct sockaddr_ipc *saddr)
+{
 	/* Copy the updated I/O vector back */
 	if (rtipc_put_iovec(fd, iov, msg))
 		return -EFAULT;
 
 	/* Copy the source address if required. */
 	if (msg->msg_name) {
-		if (rtipc_put_arg(fd, msg->msg_name, &saddr, sizeof(saddr)))
+		if (rtipc_put_arg(fd, msg->msg_name, saddr, sizeof(*saddr)))
 			return -EFAULT;
 		msg->msg_namelen = sizeof(struct sockaddr_ipc);
 	}
 
-	return ret;
+	return 0;
+}
+
+static ssize_t xddp_recvmsg(struct rtdm_fd *fd,
+			    struct msghdr *msg, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct sockaddr_ipc saddr;
+	ssize_t ret;
+
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	ret = __xddp_get_recvmsg_args(fd, iov, msg);
+	if (ret)
+		return ret;
+
+	ret = __xddp_recvmsg(fd, iov, msg->msg_iovlen, flags, &saddr);
+	if (ret <= 0)
+		return ret;
+
+	return __xddp_put_recvmsg_args(fd, iov, msg, &saddr) ?: ret;
+}
+
+/*
+ * A batch drains the input queue without blocking once the first
+ * message is in, then updates the readability state of the socket
+ * once for all.
+ */
+static int xddp_recvmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			 unsigned int vlen, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct sockaddr_ipc saddr;
+	struct msghdr *msg;
+	ssize_t ret = 0;
+	int n;
+
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	for (n = 0; n < vlen; n++) {
+		msg = &msgvec[n].msg_hdr;
+		ret = __xddp_get_recvmsg_args(fd, iov, msg);
+		if (ret)
+			break;
+
+		ret = __xddp_pull(fd, iov, msg->msg_iovlen, flags, &saddr);
+		if (ret <= 0) {
+			/* Zero-sized or end-of-file: that message ends it. */
+			if (ret == 0)
+				msgvec[n++].msg_len = 0;
+			break;
+		}
+
+		msgvec[n].msg_len = ret;
+		ret = __xddp_put_recvmsg_args(fd, iov, msg, &saddr);
+		if (ret)
+			break;
+
+		flags |= MSG_DONTWAIT;
+	}
+
+	__xddp_sync_recv_block(rtdm_fd_to_private(fd));
+
+	return n > 0 ? n : ret;
 }
 
 static ssize_t xddp_read(struct rtdm_fd *fd, void *buf, size_t len)
@@ -453,42 +653,206 @@ out:
 	return outbytes;
 }
 
-static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
-			      struct iovec *iov, int iovlen, int flags,
-			      const struct sockaddr_ipc *daddr)
+/*
+ * Fetch and lock the socket bound to a destination port. The caller
+ * should drop the lock on the returned descriptor when done.
+ */
+static struct xddp_socket *__xddp_get_peer(const struct sockaddr_ipc *daddr,
+					   struct rtdm_fd **rfdp)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	ssize_t len, rdlen, wrlen, vlen, ret, sublen;
-	struct xddp_socket *sk = priv->state;
-	struct xddp_message *mbuf;
 	struct xddp_socket *rsk;
 	struct rtdm_fd *rfd;
-	int nvec, to, from;
-	struct xnbufd bufd;
 	rtdm_lockctx_t s;
 
-	len = rtipc_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
-		return 0;
-
-	from = sk->name.sipc_port;
-	to = daddr->sipc_port;
-
 	cobalt_atomic_enter(s);
-	rfd = portmap[to];
+	rfd = portmap[daddr->sipc_port];
 	if (rfd && rtdm_fd_lock(rfd) < 0)
 		rfd = NULL;
 	cobalt_atomic_leave(s);
 
 	if (rfd == NULL)
-		return -ECONNRESET;
+		return ERR_PTR(-ECONNRESET);
 
 	rsk = rtipc_fd_to_state(rfd);
 	if (!test_bit(_XDDP_BOUND, &rsk->status)) {
 		rtdm_fd_unlock(rfd);
-		return -ECONNREFUSED;
+		return ERR_PTR(-ECONNREFUSED);
+	}
+
+	*rfdp = rfd;
+
+	return rsk;
+}
+
+static void __xddp_signal_peer(struct xddp_socket *rsk)
+{
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	if ((__xnpipe_pollstate(rsk->minor) & POLLIN) != 0 &&
+	    xnselect_signal(&rsk->priv->recv_block, POLLIN))
+		xnsched_run();
+	cobalt_atomic_leave(s);
+}
+
+/*
+ * Reserve room for a record of "len" payload bytes in the ring,
+ * padding the end of the data area with a skip record if the record
+ * would not fit contiguously there. rsk->lock held.
+ */
+static int __xddp_ring_reserve(struct xddp_socket *rsk,
+			       size_t len, u32 *offp)
+{
+	struct xddp_ring *ring = rsk->ring;
+	struct xddp_ring_rec *rec;
+	u32 recsz, tail, room;
+	int fillsz;
+
+	if (len > rsk->ringsz - sizeof(*rec))
+		return -EMSGSIZE;
+
+	/* The reader may have corrupted the fill count. */
+	fillsz = atomic_read(&ring->fillsz);
+	if (unlikely(fillsz < 0 || fillsz + rsk->ring_resv > rsk->ringsz))
+		return -EPROTO;
+
+	recsz = ALIGN(sizeof(*rec) + len, XDDP_RING_ALIGN);
+	room = rsk->ringsz - fillsz - rsk->ring_resv;
+	tail = rsk->ringsz - rsk->ring_head;
+	if (recsz > room || (recsz > tail && tail + recsz > room)) {
+		ring->dropped++;
+		return -ENOMEM;
+	}
+
+	if (recsz > tail) {
+		rec = (struct xddp_ring_rec *)(rsk->ringbuf + rsk->ring_head);
+		rec->size = tail;
+		rec->len = XDDP_RING_SKIP;
+		rsk->ring_resv += tail;
+		rsk->ring_head = 0;
+	}
+
+	/* Invisible to the reader until published. */
+	rec = (struct xddp_ring_rec *)(rsk->ringbuf + rsk->ring_head);
+	rec->size = recsz;
+	rec->len = XDDP_RING_SKIP;
+	*offp = rsk->ring_head;
+	rsk->ring_head = (rsk->ring_head + recsz) % rsk->ringsz;
+	rsk->ring_resv += recsz;
+	rsk->ring_writers++;
+
+	return 0;
+}
+
+/*
+ * Complete a record, then publish all the reserved ones once the
+ * last sender copying to the ring is done, so that the reader sees
+ * them in order. Returns non-zero if the ring went from empty to
+ * non-empty. rsk->lock held.
+ */
+static int __xddp_ring_commit(struct xddp_socket *rsk, u32 off, ssize_t len)
+{
+	struct xddp_ring *ring = rsk->ring;
+	struct xddp_ring_rec *rec;
+	u32 resv;
+
+	rec = (struct xddp_ring_rec *)(rsk->ringbuf + off);
+	rec->len = len < 0 ? XDDP_RING_SKIP : len;
+
+	if (--rsk->ring_writers > 0)
+		return 0;
+
+	resv = rsk->ring_resv;
+	rsk->ring_resv = 0;
+	ring->wroff = rsk->ring_head;
+
+	/* Implies a full barrier, the records are visible first. */
+	return atomic_add_return(resv, &ring->fillsz) == resv;
+}
+
+/*
+ * Copy "len" bytes from the vector cells to a record of the mapped
+ * ring of the peer socket. The data is copied without holding the
+ * socket lock, preempting senders reserve their own records
+ * meanwhile.
+ */
+static ssize_t __xddp_ring_push(struct rtdm_fd *fd, struct xddp_socket *rsk,
+				struct iovec *iov, int iovlen, ssize_t len)
+{
+	ssize_t rdlen, wrlen, vlen, ret;
+	struct xnbufd bufd;
+	rtdm_lockctx_t s;
+	int nvec, notify;
+	char *data;
+	u32 off;
+
+	rtdm_lock_get_irqsave(&rsk->lock, s);
+	ret = __xddp_ring_reserve(rsk, len, &off);
+	rtdm_lock_put_irqrestore(&rsk->lock, s);
+	if (ret)
+		return ret;
+
+	data = rsk->ringbuf + off + sizeof(struct xddp_ring_rec);
+
+	for (rdlen = len, wrlen = 0, nvec = 0;
+	     nvec < iovlen && rdlen > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = rdlen >= iov[nvec].iov_len ? iov[nvec].iov_len : rdlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(data + wrlen, &bufd, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(data + wrlen, &bufd, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			break;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		rdlen -= vlen;
+		wrlen += vlen;
+	}
+
+	if (ret >= 0)
+		ret = len;
+
+	/* A failed record is published too, as a skip record. */
+	rtdm_lock_get_irqsave(&rsk->lock, s);
+	notify = __xddp_ring_commit(rsk, off, ret);
+	rtdm_lock_put_irqrestore(&rsk->lock, s);
+
+	if (notify)
+		xnpipe_notify(rsk->minor);
+
+	return ret;
+}
+
+/*
+ * Push "len" bytes from the vector cells to the peer socket,
+ * leaving the readability state of the latter to our caller.
+ */
+static ssize_t __xddp_push(struct rtdm_fd *fd, struct xddp_socket *rsk,
+			   struct iovec *iov, int iovlen, ssize_t len,
+			   int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	ssize_t rdlen, wrlen, vlen, ret, sublen;
+	struct xddp_socket *sk = priv->state;
+	struct xddp_message *mbuf;
+	struct xnbufd bufd;
+	int nvec, from;
+
+	if (rsk->ringmem) {
+		/* A ring is a plain FIFO of datagrams. */
+		if (flags & MSG_OOB)
+			return -EOPNOTSUPP;
+		return __xddp_ring_push(fd, rsk, iov, iovlen, len);
 	}
 
+	from = sk->name.sipc_port;
 	sublen = len;
 	nvec = 0;
 
@@ -515,7 +879,7 @@ static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
 				xnbufd_unmap_kread(&bufd);
 			}
 			if (ret < 0)
-				goto fail_unlock;
+				return ret;
 			wrlen += ret;
 			rdlen -= ret;
 			iov[nvec].iov_base += ret;
@@ -530,16 +894,13 @@ static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
 				goto nostream;
 			}
 		}
-		len = wrlen;
-		goto done;
+		return wrlen;
 	}
 
 nostream:
 	mbuf = xnheap_alloc(rsk->bufpool, sublen + sizeof(*mbuf));
-	if (unlikely(mbuf == NULL)) {
-		ret = -ENOMEM;
-		goto fail_unlock;
-	}
+	if (unlikely(mbuf == NULL))
+		return -ENOMEM;
 
 	/*
 	 * Move "sublen" bytes to mbuf->data from the vector cells
@@ -573,31 +934,39 @@ nostream:
 	if (unlikely(ret < 0)) {
 	fail_freebuf:
 		xnheap_free(rsk->bufpool, mbuf);
-	fail_unlock:
-		rtdm_fd_unlock(rfd);
 		return ret;
 	}
- done:
-	cobalt_atomic_enter(s);
-	if ((__xnpipe_pollstate(rsk->minor) & POLLIN) != 0 &&
-	    xnselect_signal(&rsk->priv->recv_block, POLLIN))
-		xnsched_run();
-	cobalt_atomic_leave(s);
-
-	rtdm_fd_unlock(rfd);
 
 	return len;
 }
 
-static ssize_t xddp_sendmsg(struct rtdm_fd *fd,
-			    const struct msghdr *msg, int flags)
+static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
+			      struct iovec *iov, int iovlen, int flags,
+			      const struct sockaddr_ipc *daddr)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct xddp_socket *sk = priv->state;
-	struct iovec iov[RTIPC_IOV_MAX];
-	struct sockaddr_ipc daddr;
-	ssize_t ret;
+	struct xddp_socket *rsk;
+	struct rtdm_fd *rfd;
+	ssize_t len, ret;
+
+	len = rtipc_get_iov_flatlen(iov, iovlen);
+	if (len == 0)
+		return 0;
 
+	rsk = __xddp_get_peer(daddr, &rfd);
+	if (IS_ERR(rsk))
+		return PTR_ERR(rsk);
+
+	ret = __xddp_push(fd, rsk, iov, iovlen, len, flags);
+	if (ret >= 0)
+		__xddp_signal_peer(rsk);
+
+	rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
+static int __xddp_check_sendflags(int flags)
+{
 	/*
 	 * We accept MSG_DONTWAIT, but do not care about it, since
 	 * writing to the real-time endpoint of a message pipe must be
@@ -613,22 +982,31 @@ static ssize_t xddp_sendmsg(struct rtdm_fd *fd,
 	if ((flags & (MSG_MORE | MSG_OOB)) == (MSG_MORE | MSG_OOB))
 		return -EINVAL;
 
+	return 0;
+}
+
+static int __xddp_get_sendmsg_args(struct rtdm_fd *fd, struct iovec *iov,
+				   struct sockaddr_ipc *daddr,
+				   const struct msghdr *msg)
+{
+	struct xddp_socket *sk = rtipc_fd_to_state(fd);
+
 	if (msg->msg_name) {
 		if (msg->msg_namelen != sizeof(struct sockaddr_ipc))
 			return -EINVAL;
 
 		/* Fetch the destination address to send to. */
-		if (rtipc_get_arg(fd, &daddr, msg->msg_name, sizeof(daddr)))
+		if (rtipc_get_arg(fd, daddr, msg->msg_name, sizeof(*daddr)))
 			return -EFAULT;
 
-		if (daddr.sipc_port < 0 ||
-		    daddr.sipc_port >= CONFIG_XENO_OPT_PIPE_NRDEV)
+		if (daddr->sipc_port < 0 ||
+		    daddr->sipc_port >= CONFIG_XENO_OPT_PIPE_NRDEV)
 			return -EINVAL;
 	} else {
 		if (msg->msg_namelen != 0)
 			return -EINVAL;
-		daddr = sk->peer;
-		if (daddr.sipc_port < 0)
+		*daddr = sk->peer;
+		if (daddr->sipc_port < 0)
 			return -EDESTADDRREQ;
 	}
 
@@ -636,7 +1014,21 @@ static ssize_t xddp_sendmsg(struct rtdm_fd *fd,
 		return -EINVAL;
 
 	/* Copy I/O vector in */
-	ret = rtipc_get_iovec(fd, iov, msg);
+	return rtipc_get_iovec(fd, iov, msg);
+}
+
+static ssize_t xddp_sendmsg(struct rtdm_fd *fd,
+			    const struct msghdr *msg, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct sockaddr_ipc daddr;
+	ssize_t ret;
+
+	ret = __xddp_check_sendflags(flags);
+	if (ret)
+		return ret;
+
+	ret = __xddp_get_sendmsg_args(fd, iov, &daddr, msg);
 	if (ret)
 		return ret;
 
@@ -648,6 +1040,72 @@ static ssize_t xddp_sendmsg(struct rtdm_fd *fd,
 	return rtipc_put_iovec(fd, iov, msg) ?: ret;
 }
 
+/*
+ * A batch resolves the destination port once for all consecutive
+ * messages sent to the same peer, and updates the readability state
+ * of the latter once for all of them.
+ */
+static int xddp_sendmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+			 unsigned int vlen, int flags)
+{
+	struct iovec iov[RTIPC_IOV_MAX];
+	struct xddp_socket *rsk = NULL;
+	struct rtdm_fd *rfd = NULL;
+	struct sockaddr_ipc daddr;
+	int n, port = -1, sent = 0;
+	struct msghdr *msg;
+	ssize_t len, ret;
+
+	ret = __xddp_check_sendflags(flags);
+	if (ret)
+		return ret;
+
+	for (n = 0; n < vlen; n++) {
+		msg = &msgvec[n].msg_hdr;
+		ret = __xddp_get_sendmsg_args(fd, iov, &daddr, msg);
+		if (ret)
+			break;
+
+		len = rtipc_get_iov_flatlen(iov, msg->msg_iovlen);
+		if (len > 0) {
+			if (rsk == NULL || daddr.sipc_port != port) {
+				if (rsk) {
+					if (sent)
+						__xddp_signal_peer(rsk);
+					rtdm_fd_unlock(rfd);
+				}
+				sent = 0;
+				rsk = __xddp_get_peer(&daddr, &rfd);
+				if (IS_ERR(rsk)) {
+					ret = PTR_ERR(rsk);
+					rsk = NULL;
+					break;
+				}
+				port = daddr.sipc_port;
+			}
+			ret = __xddp_push(fd, rsk, iov, msg->msg_iovlen,
+					  len, flags);
+			if (ret < 0)
+				break;
+			sent = 1;
+			if (rtipc_put_iovec(fd, iov, msg)) {
+				ret = -EFAULT;
+				break;
+			}
+		}
+
+		msgvec[n].msg_len = len;
+	}
+
+	if (rsk) {
+		if (sent)
+			__xddp_signal_peer(rsk);
+		rtdm_fd_unlock(rfd);
+	}
+
+	return n > 0 ? n : ret;
+}
+
 static ssize_t xddp_write(struct rtdm_fd *fd,
 			  const void *buf, size_t len)
 {
@@ -687,19 +1145,25 @@ static int __xddp_bind_socket(struct rtipc_private *priv,
 	if (ret)
 		return ret;
 
+	if (sk->ringsz > 0) {
+		ret = __xddp_alloc_ring(sk);
+		if (ret)
+			goto fail;
+	}
+
 	poolsz = sk->poolsz;
 	if (poolsz > 0) {
 		poolsz = xnheap_rounded_size(poolsz + sk->reqbufsz);
 		poolmem = alloc_pages_exact(poolsz, GFP_KERNEL);
 		if (poolmem == NULL) {
 			ret = -ENOMEM;
-			goto fail;
+			goto fail_freering;
 		}
 
 		ret = xnheap_init(&sk->privpool, poolmem, poolsz);
 		if (ret) {
 			free_pages_exact(poolmem, poolsz);
-			goto fail;
+			goto fail_freering;
 		}
 
 		sk->bufpool = &sk->privpool;
@@ -723,6 +1187,7 @@ static int __xddp_bind_socket(struct rtipc_private *priv,
 	ops.free_ibuf = &__xddp_free_handler;
 	ops.free_obuf = &__xddp_free_handler;
 	ops.release = &__xddp_release_handler;
+	ops.mmap = sk->ringmem ? &__xddp_mmap_handler : NULL;
 
 	ret = xnpipe_connect(sa->sipc_port, &ops, sk);
 	if (ret < 0) {
@@ -733,6 +1198,8 @@ static int __xddp_bind_socket(struct rtipc_private *priv,
 			xnheap_destroy(&sk->privpool);
 			free_pages_exact(poolmem, poolsz);
 		}
+	fail_freering:
+		__xddp_free_ring(sk);
 	fail:
 		clear_bit(_XDDP_BINDING, &sk->status);
 		return ret;
@@ -918,6 +1385,26 @@ static int __xddp_setsockopt(struct xddp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case XDDP_MMAP:
+		ret = rtipc_get_length(fd, &len, sopt.optval, sopt.optlen);
+		if (ret)
+			return ret;
+		/* The fill count of a ring is an int. */
+		if (len > INT_MAX - PAGE_SIZE)
+			return -EINVAL;
+		cobalt_atomic_enter(s);
+		/*
+		 * The ring is allocated when binding, so we have to
+		 * do this before.
+		 */
+		if (test_bit(_XDDP_BOUND, &sk->status) ||
+		    test_bit(_XDDP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->ringsz = len;
+		cobalt_atomic_leave(s);
+		break;
+
 	case XDDP_MONITOR:
 		/* Monitoring is available from kernel-space only. */
 		if (rtdm_fd_is_user(fd))
@@ -961,6 +1448,7 @@ static int __xddp_getsockopt(struct xddp_socket *sk,
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	socklen_t len;
+	size_t mapsz;
 	int ret;
 
 	ret = rtipc_get_sockoptout(fd, &sopt, arg);
@@ -1002,6 +1490,11 @@ static int __xddp_getsockopt(struct xddp_socket *sk,
 			return -EFAULT;
 		break;
 
+	case XDDP_MMAP:
+		mapsz = sk->ringmem ? sk->ringmem->memsz : 0;
+		ret = rtipc_put_length(fd, sopt.optval, mapsz, len);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1124,6 +1617,8 @@ struct rtipc_protocol xddp_proto_driver = {
 		.close = xddp_close,
 		.recvmsg = xddp_recvmsg,
 		.sendmsg = xddp_sendmsg,
+		.recvmmsg = xddp_recvmmsg,
+		.sendmmsg = xddp_sendmmsg,
 		.read = xddp_read,
 		.write = xddp_write,
 		.ioctl = xddp_ioctl,
@@ -308,7 +308,8 @@ struct e1000_adapter {
 	struct e1000_ring *tx_ring /* One per active queue */
 						____cacheline_aligned_in_smp;
 
-	struct napi_struct napi;
+	struct rtnet_poll poll;
+	nanosecs_abs_t rx_irq_stamp;	/* time of the last Rx interrupt */
 
 	unsigned int restart_queue;
 	u32 txd_cmd;
@@ -339,7 +340,7 @@ struct e1000_adapter {
 	 * Rx
 	 */
 	bool (*clean_rx) (struct e1000_adapter *adapter,
-			  nanosecs_abs_t *time_stamp)
+			  int *work_done, int work_to_do)
 						____cacheline_aligned_in_smp;
 	void (*alloc_rx_buf) (struct e1000_adapter *adapter,
 			      int cleaned_count, gfp_t gfp);
@@ -662,12 +662,14 @@ map_skb:
 /**
  * e1000_clean_rx_irq - Send received data up the network stack; legacy
  * @adapter: board private structure
+ * @work_done: output parameter for indicating completed work
+ * @work_to_do: how many packets we can clean
  *
  * the return value indicates whether actual cleaning was done, there
  * is no guarantee that everything was cleaned
  **/
 static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
-			       nanosecs_abs_t *time_stamp)
+			       int *work_done, int work_to_do)
 {
 	struct rtnet_device *netdev = adapter->netdev;
 	struct e1000_ring *rx_ring = adapter->rx_ring;
@@ -678,6 +680,11 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 	int cleaned_count = 0;
 	bool data_received = false;
 	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+	nanosecs_abs_t time_stamp;
+
+	/* stamp with the interrupt date, unless polling again */
+	time_stamp = adapter->rx_irq_stamp ? : rtdm_clock_read();
+	adapter->rx_irq_stamp = 0;
 
 	i = rx_ring->next_to_clean;
 	rx_desc = E1000_RX_DESC_EXT(*rx_ring, i);
@@ -687,6 +694,9 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 	while (staterr & E1000_RXD_STAT_DD) {
 		struct rtskb *skb;
 
+		if (*work_done >= work_to_do)
+			break;
+		(*work_done)++;
 		rmb();	/* read descriptor and rx_buffer_info after status DD */
 
 		skb = buffer_info->skb;
@@ -748,8 +758,8 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 					      csum_ip.csum), skb);
 
 		skb->protocol = rt_eth_type_trans(skb, netdev);
-		skb->time_stamp = *time_stamp;
-		rtnetif_rx(skb);
+		skb->time_stamp = time_stamp;
+		rtnetif_receive_skb(skb);
 		data_received = true;
 
 next_desc:
@@ -968,12 +978,16 @@ static int e1000_intr_msi(rtdm_irq_t *irq_handle)
 			rtdm_nrtsig_pend(&adapter->mod_timer_sig);
 	}
 
-	if (!e1000_clean_tx_irq(adapter))
-		/* Ring was not completely cleaned, so fire another interrupt */
-		ew32(ICS, adapter->tx_ring->ims_val);
-
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	if (rtnetif_poll_schedule_prep(&adapter->poll)) {
+		/* mask the device until the poll is complete */
+		ew32(IMC, ~0);
+		adapter->total_tx_bytes = 0;
+		adapter->total_tx_packets = 0;
+		adapter->total_rx_bytes = 0;
+		adapter->total_rx_packets = 0;
+		adapter->rx_irq_stamp = time_stamp;
+		__rtnetif_poll_schedule(&adapter->poll);
+	}
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -1035,12 +1049,16 @@ static int e1000_intr(rtdm_irq_t *irq_handle)
 			rtdm_nrtsig_pend(&adapter->mod_timer_sig);
 	}
 
-	if (!e1000_clean_tx_irq(adapter))
-		/* Ring was not completely cleaned, so fire another interrupt */
-		ew32(ICS, adapter->tx_ring->ims_val);
-
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	if (rtnetif_poll_schedule_prep(&adapter->poll)) {
+		/* mask the device until the poll is complete */
+		ew32(IMC, ~0);
+		adapter->total_tx_bytes = 0;
+		adapter->total_tx_packets = 0;
+		adapter->total_rx_bytes = 0;
+		adapter->total_rx_packets = 0;
+		adapter->rx_irq_stamp = time_stamp;
+		__rtnetif_poll_schedule(&adapter->poll);
+	}
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -1111,8 +1129,8 @@ static int e1000_intr_msix_rx(rtdm_irq_t *irq_handle)
 		adapter->rx_ring->set_itr = 0;
 	}
 
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	adapter->rx_irq_stamp = time_stamp;
+	rtnetif_poll_schedule(&adapter->poll);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -1409,6 +1427,43 @@ static void e1000_irq_enable(struct e1000_adapter *adapter)
 	e1e_flush();
 }
 
+/**
+ * e1000e_poll - Rx and legacy Tx polling callback, run by the stack manager
+ * @poll: poll context of the adapter
+ * @budget: count of how many packets we should handle
+ **/
+static int e1000e_poll(struct rtnet_poll *poll, int budget)
+{
+	struct e1000_adapter *adapter = container_of(poll,
+						     struct e1000_adapter,
+						     poll);
+	struct e1000_hw *hw = &adapter->hw;
+	int tx_cleaned = 1, work_done = 0;
+
+	/* with MSI-X, the Tx ring is cleaned from its own vector */
+	if (!adapter->msix_entries)
+		tx_cleaned = e1000_clean_tx_irq(adapter);
+
+	adapter->clean_rx(adapter, &work_done, budget);
+	rtnetif_poll_received(poll, work_done);
+
+	if (!tx_cleaned)
+		work_done = budget;
+
+	/* If budget not fully consumed, exit the polling mode */
+	if (work_done < budget) {
+		rtnetif_poll_complete(poll);
+		if (!test_bit(__E1000_DOWN, &adapter->state)) {
+			if (adapter->msix_entries)
+				ew32(IMS, adapter->rx_ring->ims_val);
+			else
+				e1000_irq_enable(adapter);
+		}
+	}
+
+	return work_done;
+}
+
 /**
  * e1000e_get_hw_control - get control of the h/w from f/w
  * @adapter: address of board private structure
@@ -2454,6 +2509,7 @@ int e1000e_up(struct e1000_adapter *adapter)
 
 	clear_bit(__E1000_DOWN, &adapter->state);
 
+	rtnetif_poll_enable(&adapter->poll);
 	if (adapter->msix_entries)
 		e1000_configure_msix(adapter);
 	e1000_irq_enable(adapter);
@@ -2515,6 +2571,8 @@ void e1000e_down(struct e1000_adapter *adapter)
 
 	e1000_irq_disable(adapter);
 
+	rtnetif_poll_disable(&adapter->poll);
+
 	del_timer_sync(&adapter->watchdog_timer);
 	del_timer_sync(&adapter->phy_info_timer);
 
@@ -2775,6 +2833,8 @@ static int e1000_open(struct rtnet_device *netdev)
 	/* From here on the code is the same as e1000e_up() */
 	clear_bit(__E1000_DOWN, &adapter->state);
 
+	rtnetif_poll_enable(&adapter->poll);
+
 	e1000_irq_enable(adapter);
 
 	rtnetif_start_queue(netdev);
@@ -3990,6 +4050,8 @@ static int e1000_probe(struct pci_dev *pdev,
 	//netdev->get_stats = e1000_get_stats;
 	netdev->map_rtskb = e1000_map_rtskb;
 	netdev->unmap_rtskb = e1000_unmap_rtskb;
+	rtnetif_poll_add(netdev, &adapter->poll, e1000e_poll,
+			 RTNET_POLL_WEIGHT);
 	strncpy(netdev->name, pci_name(pdev), sizeof(netdev->name) - 1);
 
 	netdev->mem_start = mmio_start;
@@ -4190,6 +4252,7 @@ err_sw_init:
 err_flashmap:
 	iounmap(adapter->hw.hw_addr);
 err_ioremap:
+	rtnetif_poll_del(&adapter->poll);
 	rtdev_free(netdev);
 err_alloc_etherdev:
 	pci_release_selected_regions(pdev,
@@ -4259,6 +4322,7 @@ static void e1000_remove(struct pci_dev *pdev)
 	pci_release_selected_regions(pdev,
 				     pci_select_bars(pdev, IORESOURCE_MEM));
 
+	rtnetif_poll_del(&adapter->poll);
 	rtdev_free(netdev);
 
 	/* AER disable */
@@ -38,6 +38,7 @@
 #include <linux/mdio.h>
 
 #include <rtdev.h>
+#include <stack_mgr.h>
 
 struct igb_adapter;
 
@@ -274,6 +275,9 @@ struct igb_q_vector {
 
 	struct igb_ring_container rx, tx;
 
+	struct rtnet_poll poll;
+	nanosecs_abs_t irq_stamp;	/* time of the last ring interrupt */
+
 	struct rcu_head rcu;	/* to avoid race with update stats on free */
 	char name[IFNAMSIZ + 9];
 
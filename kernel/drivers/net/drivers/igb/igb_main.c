@@ -213,9 +213,9 @@ static int igb_intr_msi(rtdm_irq_t *irq_handle);
 static void igb_nrtsig_watchdog(rtdm_nrtsig_t *sig, void *data);
 static irqreturn_t igb_msix_other(int irq, void *);
 static int igb_msix_ring(rtdm_irq_t *irq_handle);
-static void igb_poll(struct igb_q_vector *);
+static int igb_poll(struct rtnet_poll *, int);
 static bool igb_clean_tx_irq(struct igb_q_vector *);
-static bool igb_clean_rx_irq(struct igb_q_vector *, int);
+static int igb_clean_rx_irq(struct igb_q_vector *, int);
 static int igb_ioctl(struct rtnet_device *, unsigned cmd, void *);
 static void igb_reset_task(struct work_struct *);
 static void igb_vlan_mode(struct rtnet_device *netdev,
@@ -945,6 +945,8 @@ static void igb_reset_q_vector(struct igb_adapter *adapter, int v_idx)
 
 	if (q_vector->rx.ring)
 		adapter->rx_ring[q_vector->rx.ring->queue_index] = NULL;
+
+	rtnetif_poll_del(&q_vector->poll);
 }
 
 static void igb_reset_interrupt_capability(struct igb_adapter *adapter)
@@ -1097,6 +1099,10 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 	if (!q_vector)
 		return -ENOMEM;
 
+	/* initialize poll context */
+	rtnetif_poll_add(adapter->netdev, &q_vector->poll, igb_poll,
+			 RTNET_POLL_WEIGHT);
+
 	/* tie q_vector and adapter together */
 	adapter->q_vector[v_idx] = q_vector;
 	q_vector->adapter = adapter;
@@ -1591,11 +1597,16 @@ int igb_up(struct igb_adapter *adapter)
 {
 	struct e1000_hw *hw = &adapter->hw;
 
+	int i;
+
 	/* hardware has been reset, we need to reload some things */
 	igb_configure(adapter);
 
 	clear_bit(__IGB_DOWN, &adapter->state);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtnetif_poll_enable(&(adapter->q_vector[i]->poll));
+
 	if (adapter->flags & IGB_FLAG_HAS_MSIX)
 		igb_configure_msix(adapter);
 	else
@@ -1623,6 +1634,7 @@ void igb_down(struct igb_adapter *adapter)
 	struct rtnet_device *netdev = adapter->netdev;
 	struct e1000_hw *hw = &adapter->hw;
 	u32 tctl, rctl;
+	int i;
 
 	/* signal that we're down so the interrupt handler does not
 	 * reschedule our watchdog timer
@@ -1646,6 +1658,9 @@ void igb_down(struct igb_adapter *adapter)
 
 	igb_irq_disable(adapter);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtnetif_poll_disable(&(adapter->q_vector[i]->poll));
+
 	adapter->flags &= ~IGB_FLAG_NEED_LINK_UPDATE;
 
 	del_timer_sync(&adapter->watchdog_timer);
@@ -2598,6 +2613,7 @@ static int __igb_open(struct rtnet_device *netdev, bool resuming)
 	struct e1000_hw *hw = &adapter->hw;
 	struct pci_dev *pdev = adapter->pdev;
 	int err;
+	int i;
 
 	/* disallow open during test */
 	if (test_bit(__IGB_TESTING, &adapter->state)) {
@@ -2636,6 +2652,9 @@ static int __igb_open(struct rtnet_device *netdev, bool resuming)
 	/* From here on the code is the same as igb_up() */
 	clear_bit(__IGB_DOWN, &adapter->state);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtnetif_poll_enable(&(adapter->q_vector[i]->poll));
+
 	/* Clear any pending interrupts. */
 	rd32(E1000_ICR);
 
@@ -4493,7 +4512,8 @@ static int igb_msix_ring(rtdm_irq_t *ih)
 	/* Write the ITR value calculated from the previous interrupt. */
 	igb_write_itr(q_vector);
 
-	igb_poll(q_vector);
+	q_vector->irq_stamp = rtdm_clock_read();
+	rtnetif_poll_schedule(&q_vector->poll);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -4516,7 +4536,8 @@ static int igb_intr_msi(rtdm_irq_t *ih)
 
 	igb_other_handler(adapter, icr, false);
 
-	igb_poll(q_vector);
+	q_vector->irq_stamp = rtdm_clock_read();
+	rtnetif_poll_schedule(&q_vector->poll);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -4547,7 +4568,8 @@ static int igb_intr(rtdm_irq_t *ih)
 
 	igb_other_handler(adapter, icr, false);
 
-	igb_poll(q_vector);
+	q_vector->irq_stamp = rtdm_clock_read();
+	rtnetif_poll_schedule(&q_vector->poll);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -4574,19 +4596,39 @@ static void igb_ring_irq_enable(struct igb_q_vector *q_vector)
 }
 
 /**
- *  igb_poll - NAPI Rx polling callback
- *  @napi: napi polling structure
+ *  igb_poll - Rx polling callback, run by the stack manager
+ *  @poll: poll context of the q_vector
  *  @budget: count of how many packets we should handle
  **/
-static void igb_poll(struct igb_q_vector *q_vector)
+static int igb_poll(struct rtnet_poll *poll, int budget)
 {
+	struct igb_q_vector *q_vector = container_of(poll,
+						     struct igb_q_vector,
+						     poll);
+	bool clean_complete = true;
+	int work_done = 0;
+
 	if (q_vector->tx.ring)
-		igb_clean_tx_irq(q_vector);
+		clean_complete = igb_clean_tx_irq(q_vector);
 
-	if (q_vector->rx.ring)
-		igb_clean_rx_irq(q_vector, 64);
+	if (q_vector->rx.ring) {
+		int cleaned = igb_clean_rx_irq(q_vector, budget);
+
+		rtnetif_poll_received(poll, cleaned);
+		work_done += cleaned;
+		if (cleaned >= budget)
+			clean_complete = false;
+	}
+
+	/* If all work not completed, return budget and keep polling */
+	if (!clean_complete)
+		return budget;
 
+	/* If not enough Rx work done, exit the polling mode */
+	rtnetif_poll_complete(poll);
 	igb_ring_irq_enable(q_vector);
+
+	return min(work_done, budget - 1);
 }
 
 /**
@@ -4868,14 +4910,18 @@ static void igb_process_skb_fields(struct igb_ring *rx_ring,
 	skb->protocol = rt_eth_type_trans(skb, rx_ring->netdev);
 }
 
-static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
+static int igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 {
 	struct igb_ring *rx_ring = q_vector->rx.ring;
 	unsigned int total_bytes = 0, total_packets = 0;
 	u16 cleaned_count = igb_desc_unused(rx_ring);
-	nanosecs_abs_t time_stamp = rtdm_clock_read();
+	nanosecs_abs_t time_stamp;
 	struct rtskb *skb;
 
+	/* stamp with the interrupt date, unless polling again */
+	time_stamp = q_vector->irq_stamp ? : rtdm_clock_read();
+	q_vector->irq_stamp = 0;
+
 	while (likely(total_packets < budget)) {
 		union e1000_adv_rx_desc *rx_desc;
 
@@ -4918,7 +4964,7 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 		/* populate checksum, timestamp, VLAN, and protocol */
 		igb_process_skb_fields(rx_ring, rx_desc, skb);
 
-		rtnetif_rx(skb);
+		rtnetif_receive_skb(skb);
 
 		/* reset skb pointer */
 		skb = NULL;
@@ -4935,10 +4981,7 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 	if (cleaned_count)
 		igb_alloc_rx_buffers(rx_ring, cleaned_count);
 
-	if (total_packets)
-		rt_mark_stack_mgr(q_vector->adapter->netdev);
-
-	return total_packets < budget;
+	return total_packets;
 }
 
 static bool igb_alloc_mapped_skb(struct igb_ring *rx_ring,
@@ -113,6 +113,7 @@ struct rtnet_device {
     __u32               broadcast_ip; /* broadcast IP in network order */
 
     rtdm_event_t        *stack_event;
+    struct list_head    poll_list;  /* registered poll contexts */
 
     rtdm_mutex_t        xmit_mutex; /* protects xmit routine        */
     rtdm_lock_t         rtdev_lock; /* management lock              */
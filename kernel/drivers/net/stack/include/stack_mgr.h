@@ -83,6 +83,87 @@ int rt_stack_mgr_init(struct rtnet_mgr *mgr);
 void rt_stack_mgr_delete(struct rtnet_mgr *mgr);
 
 void rtnetif_rx(struct rtskb *skb);
+void rt_stack_mgr_signal(void);
+int rt_stack_mgr_dropped(int cpu, unsigned long *dropped);
+
+
+/***
+ * budgeted receive polling
+ *
+ * The interrupt handler masks the device interrupt and schedules the
+ * poll context on the stack manager of the current CPU. The manager
+ * then calls ->poll() with a budget of frames, which the driver feeds
+ * to rtnetif_receive_skb() without any further wakeup. A driver having
+ * processed less than the budget calls rtnetif_poll_complete() before
+ * unmasking its interrupt, otherwise it remains scheduled and is polled
+ * again after the other pending contexts. Received frames are accounted
+ * for by the driver with rtnetif_poll_received().
+ */
+
+#define RTNET_POLL_SCHED    0   /* queued or disabled */
+
+struct rtnet_poll {
+    struct list_head    entry;      /* in a stack manager poll queue */
+    unsigned long       state;
+    int                 weight;
+    int                 (*poll)(struct rtnet_poll *poll, int budget);
+
+    struct rtnet_device *rtdev;
+    struct list_head    dev_entry;  /* in rtdev->poll_list */
+
+    /* statistics */
+    unsigned long       polls;
+    unsigned long       frames;
+    unsigned long       exhausted;  /* polls consuming the whole budget */
+};
+
+#define RTNET_POLL_WEIGHT   64
+
+void rtnetif_poll_add(struct rtnet_device *rtdev, struct rtnet_poll *poll,
+		      int (*handler)(struct rtnet_poll *poll, int budget),
+		      int weight);
+void rtnetif_poll_del(struct rtnet_poll *poll);
+void rtnetif_poll_enable(struct rtnet_poll *poll);
+void rtnetif_poll_disable(struct rtnet_poll *poll);
+
+void __rtnetif_poll_schedule(struct rtnet_poll *poll);
+void rtnetif_receive_skb(struct rtskb *skb);
+
+/***
+ *  rtnetif_poll_schedule_prep: grab the poll context, to be called from
+ *  the interrupt handler before masking the device interrupt. Returns
+ *  false if the context is already scheduled or disabled.
+ */
+static inline bool rtnetif_poll_schedule_prep(struct rtnet_poll *poll)
+{
+    return !test_and_set_bit(RTNET_POLL_SCHED, &poll->state);
+}
+
+static inline void rtnetif_poll_schedule(struct rtnet_poll *poll)
+{
+    if (rtnetif_poll_schedule_prep(poll))
+	__rtnetif_poll_schedule(poll);
+}
+
+/***
+ *  rtnetif_poll_complete: release the poll context, to be called from
+ *  ->poll() before re-enabling the device interrupt
+ */
+static inline void rtnetif_poll_complete(struct rtnet_poll *poll)
+{
+    smp_mb();
+    clear_bit(RTNET_POLL_SCHED, &poll->state);
+}
+
+/***
+ *  rtnetif_poll_received: account for the frames received by ->poll(),
+ *  which may return its whole budget for other reasons (e.g. pending
+ *  Tx completions) in order to be polled again
+ */
+static inline void rtnetif_poll_received(struct rtnet_poll *poll, int frames)
+{
+    poll->frames += frames;
+}
 
 static inline void rtnetif_tx(struct rtnet_device *rtdev)
 {
@@ -90,7 +171,7 @@ static inline void rtnetif_tx(struct rtnet_device *rtdev)
 
 static inline void rt_mark_stack_mgr(struct rtnet_device *rtdev)
 {
-    rtdm_event_signal(rtdev->stack_event);
+    rt_stack_mgr_signal();
 }
 
 #endif /* __KERNEL__ */
@@ -2260,7 +2260,7 @@ int __init rt_tcp_init(void)
     if (skbs < RT_TCP_RST_POOL_SIZE)
 	printk("rttcp: allocated only %d RST|ACK rtskbs\n", skbs);
     rst_socket.sock.prot.inet.tos = 0;
-    rst_fd->refs = 1;
+    atomic_set(&rst_fd->refs, 1);
     rtdm_lock_init(&rst_socket.socket_lock);
 
     /*
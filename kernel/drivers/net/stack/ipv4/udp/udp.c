@@ -467,6 +467,36 @@ ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct msghdr *msg, int msg_flags)
 
 
 
+/***
+ *  rt_udp_recvmmsg
+ */
+int rt_udp_recvmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+                    unsigned int vlen, int msg_flags)
+{
+    unsigned int        n;
+    ssize_t             ret = 0;
+
+
+    /* peeking more than one datagram would return the same one */
+    if (msg_flags & MSG_PEEK)
+        vlen = 1;
+
+    for (n = 0; n < vlen; n++) {
+        ret = rt_udp_recvmsg(fd, &msgvec[n].msg_hdr, msg_flags);
+        if (ret < 0)
+            break;
+
+        msgvec[n].msg_len = ret;
+
+        /* only wait for the first datagram, then drain the queue */
+        msg_flags |= MSG_DONTWAIT;
+    }
+
+    return (n > 0) ? n : ret;
+}
+
+
+
 /***
  *  struct udpfakehdr
  */
@@ -525,69 +555,64 @@ static int rt_udp_getfrag(const void *p, unsigned char *to,
 
 
 /***
- *  rt_udp_sendmsg
+ *  rt_udp_get_dest - fetch source and destination of a datagram
  */
-ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct msghdr *msg, int msg_flags)
+static int rt_udp_get_dest(struct rtsocket *sock, const struct msghdr *msg,
+                           u32 *saddr, u32 *daddr, u16 *sport, u16 *dport)
 {
-    struct rtsocket     *sock = rtdm_fd_to_private(fd);
-    size_t              len   = rt_iovec_len(msg->msg_iov, msg->msg_iovlen);
-    int                 ulen  = len + sizeof(struct udphdr);
     struct sockaddr_in  *usin;
-    struct udpfakehdr   ufh;
-    struct dest_route   rt;
-    u32                 saddr;
-    u32                 daddr;
-    u16                 dport;
-    int                 err;
     rtdm_lockctx_t      context;
 
 
-    if ((len < 0) || (len > 0xFFFF-sizeof(struct iphdr)-sizeof(struct udphdr)))
-        return -EMSGSIZE;
-
-    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
-        return -EOPNOTSUPP;
-
-    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
-        return -EINVAL;
-
     if ((msg->msg_name) && (msg->msg_namelen==sizeof(struct sockaddr_in))) {
         usin = (struct sockaddr_in*) msg->msg_name;
 
         if ((usin->sin_family != AF_INET) && (usin->sin_family != AF_UNSPEC))
             return -EINVAL;
 
-        daddr = usin->sin_addr.s_addr;
-        dport = usin->sin_port;
+        *daddr = usin->sin_addr.s_addr;
+        *dport = usin->sin_port;
 
         rtdm_lock_get_irqsave(&udp_socket_base_lock, context);
     } else {
         rtdm_lock_get_irqsave(&udp_socket_base_lock, context);
 
         if (sock->prot.inet.state != TCP_ESTABLISHED) {
-	    rtdm_lock_put_irqrestore(&udp_socket_base_lock, context);
+            rtdm_lock_put_irqrestore(&udp_socket_base_lock, context);
             return -ENOTCONN;
-	}
+        }
 
-        daddr = sock->prot.inet.daddr;
-        dport = sock->prot.inet.dport;
+        *daddr = sock->prot.inet.daddr;
+        *dport = sock->prot.inet.dport;
     }
-    saddr         = sock->prot.inet.saddr;
-    ufh.uh.source = sock->prot.inet.sport;
+    *saddr = sock->prot.inet.saddr;
+    *sport = sock->prot.inet.sport;
 
     rtdm_lock_put_irqrestore(&udp_socket_base_lock, context);
 
-    if ((daddr | dport) == 0)
+    if ((*daddr | *dport) == 0)
         return -EINVAL;
 
-    /* get output route */
-    err = rt_ip_route_output(&rt, daddr, saddr);
-    if (err)
-        return err;
+    return 0;
+}
+
+
+
+/***
+ *  rt_udp_xmit - build and send a datagram over a resolved route
+ */
+static int rt_udp_xmit(struct rtsocket *sock, const struct msghdr *msg,
+                       size_t len, u32 saddr, u32 daddr, u16 sport, u16 dport,
+                       struct dest_route *rt, int msg_flags)
+{
+    int                 ulen  = len + sizeof(struct udphdr);
+    struct udpfakehdr   ufh;
+
 
     /* we found a route, remember the routing dest-addr could be the netmask */
-    ufh.saddr     = saddr != INADDR_ANY ? saddr : rt.rtdev->local_ip;
+    ufh.saddr     = saddr != INADDR_ANY ? saddr : rt->rtdev->local_ip;
     ufh.daddr     = daddr;
+    ufh.uh.source = sport;
     ufh.uh.dest   = dport;
     ufh.uh.len    = htons(ulen);
     ufh.uh.check  = 0;
@@ -595,7 +620,46 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct msghdr *msg, int msg_fla
     ufh.iovlen    = msg->msg_iovlen;
     ufh.wcheck    = 0;
 
-    err = rt_ip_build_xmit(sock, rt_udp_getfrag, &ufh, ulen, &rt, msg_flags);
+    return rt_ip_build_xmit(sock, rt_udp_getfrag, &ufh, ulen, rt, msg_flags);
+}
+
+
+
+/***
+ *  rt_udp_sendmsg
+ */
+ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct msghdr *msg, int msg_flags)
+{
+    struct rtsocket     *sock = rtdm_fd_to_private(fd);
+    size_t              len   = rt_iovec_len(msg->msg_iov, msg->msg_iovlen);
+    struct dest_route   rt;
+    u32                 saddr;
+    u32                 daddr;
+    u16                 sport;
+    u16                 dport;
+    int                 err;
+
+
+    if ((len < 0) || (len > 0xFFFF-sizeof(struct iphdr)-sizeof(struct udphdr)))
+        return -EMSGSIZE;
+
+    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
+        return -EOPNOTSUPP;
+
+    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
+        return -EINVAL;
+
+    err = rt_udp_get_dest(sock, msg, &saddr, &daddr, &sport, &dport);
+    if (err)
+        return err;
+
+    /* get output route */
+    err = rt_ip_route_output(&rt, daddr, saddr);
+    if (err)
+        return err;
+
+    err = rt_udp_xmit(sock, msg, len, saddr, daddr, sport, dport, &rt,
+                      msg_flags);
 
     rtdev_dereference(rt.rtdev);
 
@@ -607,6 +671,79 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct msghdr *msg, int msg_fla
 
 
 
+/***
+ *  rt_udp_sendmmsg
+ *
+ *  The output route is looked up once for all consecutive datagrams
+ *  sent to the same destination.
+ */
+int rt_udp_sendmmsg(struct rtdm_fd *fd, struct rtdm_mmsghdr *msgvec,
+                    unsigned int vlen, int msg_flags)
+{
+    struct rtsocket     *sock = rtdm_fd_to_private(fd);
+    struct dest_route   rt;
+    struct msghdr       *msg;
+    size_t              len;
+    u32                 saddr, rt_saddr = 0;
+    u32                 daddr, rt_daddr = 0;
+    u16                 sport;
+    u16                 dport;
+    int                 routed = 0;
+    int                 err = 0;
+    unsigned int        n;
+
+
+    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
+        return -EOPNOTSUPP;
+
+    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
+        return -EINVAL;
+
+    for (n = 0; n < vlen; n++) {
+        msg = &msgvec[n].msg_hdr;
+        len = rt_iovec_len(msg->msg_iov, msg->msg_iovlen);
+
+        if (len > 0xFFFF-sizeof(struct iphdr)-sizeof(struct udphdr)) {
+            err = -EMSGSIZE;
+            break;
+        }
+
+        err = rt_udp_get_dest(sock, msg, &saddr, &daddr, &sport, &dport);
+        if (err)
+            break;
+
+        if (!routed || (daddr != rt_daddr) || (saddr != rt_saddr)) {
+            if (routed) {
+                rtdev_dereference(rt.rtdev);
+                routed = 0;
+            }
+
+            /* get output route */
+            err = rt_ip_route_output(&rt, daddr, saddr);
+            if (err)
+                break;
+
+            routed   = 1;
+            rt_daddr = daddr;
+            rt_saddr = saddr;
+        }
+
+        err = rt_udp_xmit(sock, msg, len, saddr, daddr, sport, dport, &rt,
+                          msg_flags);
+        if (err)
+            break;
+
+        msgvec[n].msg_len = len;
+    }
+
+    if (routed)
+        rtdev_dereference(rt.rtdev);
+
+    return (n > 0) ? n : err;
+}
+
+
+
 /***
  *  rt_udp_check
  */
@@ -720,6 +857,8 @@ static struct rtdm_driver udp_driver = {
         .ioctl_nrt =    rt_udp_ioctl,
         .recvmsg_rt =   rt_udp_recvmsg,
         .sendmsg_rt =   rt_udp_sendmsg,
+        .recvmmsg_rt =  rt_udp_recvmmsg,
+        .sendmmsg_rt =  rt_udp_sendmmsg,
         .select =       rt_socket_select_bind,
     },
 };
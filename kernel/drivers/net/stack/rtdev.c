@@ -286,6 +286,7 @@ struct rtnet_device *rtdev_alloc(unsigned sizeof_priv, unsigned dev_pool_size)
     rtdm_mutex_init(&rtdev->xmit_mutex);
     rtdm_lock_init(&rtdev->rtdev_lock);
     mutex_init(&rtdev->nrt_lock);
+    INIT_LIST_HEAD(&rtdev->poll_list);
 
     atomic_set(&rtdev->refcount, 0);
 
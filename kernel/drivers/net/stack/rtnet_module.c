@@ -253,6 +253,69 @@ static struct xnvfile_regular rtnet_stats_vfile = {
 	.ops = &rtnet_stats_vfile_ops,
 };
 
+static int rtnet_poll_stats_show(struct xnvfile_regular_iterator *it,
+				 void *data)
+{
+	struct rtnet_device *rtdev;
+	struct rtnet_poll *poll;
+	unsigned long avg;
+	int ctx = 0;
+
+	if (it->pos == 0) {
+		xnvfile_printf(it, "Iface   Ctx  Weight      Polls     Frames"
+			       "  Frames/poll  Exhausted\n");
+		return 0;
+	}
+
+	rtdev = __rtdev_get_by_index(it->pos);
+	if (rtdev == NULL || list_empty(&rtdev->poll_list))
+		return VFILE_SEQ_SKIP;
+
+	list_for_each_entry(poll, &rtdev->poll_list, dev_entry) {
+		avg = poll->polls ? poll->frames * 100 / poll->polls : 0;
+		xnvfile_printf(it, "%-6s  %3d  %6d %10lu %10lu %9lu.%02lu %10lu\n",
+			       rtdev->name, ctx++, poll->weight,
+			       poll->polls, poll->frames, avg / 100, avg % 100,
+			       poll->exhausted);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops rtnet_poll_stats_vfile_ops = {
+	.begin = rtnet_stats_begin,
+	.next = rtnet_stats_next,
+	.show = rtnet_poll_stats_show,
+};
+
+static struct xnvfile_regular rtnet_poll_stats_vfile = {
+	.entry = { .lockops = &rtnet_devices_nrt_lock_ops, },
+	.ops = &rtnet_poll_stats_vfile_ops,
+};
+
+static int rtnet_stack_mgr_show(struct xnvfile_regular_iterator *it,
+				void *data)
+{
+	unsigned long dropped;
+	int cpu;
+
+	xnvfile_printf(it, "CPU     Dropped\n");
+
+	for_each_possible_cpu(cpu)
+		if (rt_stack_mgr_dropped(cpu, &dropped) == 0)
+			xnvfile_printf(it, "%3d  %10lu\n", cpu, dropped);
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops rtnet_stack_mgr_vfile_ops = {
+	.show = rtnet_stack_mgr_show,
+};
+
+static struct xnvfile_regular rtnet_stack_mgr_vfile = {
+	.ops = &rtnet_stack_mgr_vfile_ops,
+};
+
 static int rtnet_proc_register(void)
 {
 	int err;
@@ -277,8 +340,24 @@ static int rtnet_proc_register(void)
 	if (err < 0)
 		goto error5;
 
+	err = xnvfile_init_regular("poll_stats", &rtnet_poll_stats_vfile,
+				   &rtnet_proc_root);
+	if (err < 0)
+		goto error6;
+
+	err = xnvfile_init_regular("stack_mgr", &rtnet_stack_mgr_vfile,
+				   &rtnet_proc_root);
+	if (err < 0)
+		goto error7;
+
     return 0;
 
+  error7:
+	xnvfile_destroy_regular(&rtnet_poll_stats_vfile);
+
+  error6:
+	xnvfile_destroy_regular(&rtnet_stats_vfile);
+
   error5:
 	xnvfile_destroy_regular(&rtnet_version_vfile);
 
@@ -300,6 +379,8 @@ static int rtnet_proc_register(void)
 
 static void rtnet_proc_unregister(void)
 {
+	xnvfile_destroy_regular(&rtnet_stack_mgr_vfile);
+	xnvfile_destroy_regular(&rtnet_poll_stats_vfile);
 	xnvfile_destroy_regular(&rtnet_stats_vfile);
 	xnvfile_destroy_regular(&rtnet_version_vfile);
 	xnvfile_destroy_regular(&rtnet_rtskb_vfile);
@@ -22,7 +22,9 @@
  *
  */
 
+#include <linux/delay.h>
 #include <linux/moduleparam.h>
+#include <linux/rculist.h>
 
 #include <rtdev.h>
 #include <rtnet_internal.h>
@@ -32,13 +34,45 @@
 
 static unsigned int stack_mgr_prio = RTNET_DEF_STACK_PRIORITY;
 module_param(stack_mgr_prio, uint, 0444);
-MODULE_PARM_DESC(stack_mgr_prio, "Priority of the stack manager task");
+MODULE_PARM_DESC(stack_mgr_prio, "Priority of the stack manager tasks");
+
+static unsigned int stack_mgr_cpu_prio[NR_CPUS];
+module_param_array(stack_mgr_cpu_prio, uint, NULL, 0444);
+MODULE_PARM_DESC(stack_mgr_cpu_prio, "Per-CPU priorities of the stack "
+		 "manager tasks, 0 meaning stack_mgr_prio");
 
 
 #if (CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE & (CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE-1)) != 0
 #error CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE must be power of 2!
 #endif
-static DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+
+/***
+ *  Each real-time CPU runs its own stack manager task, fed by a FIFO
+ *  which is only written by rtnetif_rx() on that CPU with interrupts
+ *  off, and only read by that task. Single producer, single consumer:
+ *  no lock is needed on either side. A NIC is served by the manager of
+ *  the CPU handling its interrupt, so busy ports can be isolated from
+ *  each other by IRQ affinity.
+ */
+struct rt_stack_rxq {
+    struct rtnet_mgr    mgr;
+    int                 cpu;
+    unsigned long       dropped;
+    DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+    rtdm_lock_t         poll_lock;
+    struct list_head    poll_list;  /* scheduled poll contexts */
+};
+
+static struct rt_stack_rxq *stack_rxqs;
+static struct rt_stack_rxq *stack_rxq_fallback;
+
+/* IRQs off. CPUs without a manager of their own use the fallback one. */
+static inline struct rt_stack_rxq *rt_stack_rxq_current(void)
+{
+    struct rt_stack_rxq *rxq = &stack_rxqs[raw_smp_processor_id()];
+
+    return likely(rxq->cpu >= 0) ? rxq : stack_rxq_fallback;
+}
 
 struct list_head    rt_packets[RTPACKET_HASH_TBL_SIZE];
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
@@ -46,6 +80,52 @@ struct list_head    rt_packets_all;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 DEFINE_RTDM_LOCK(rt_packets_lock);
 
+/***
+ *  The protocol lists are only locked by writers. Readers walk them
+ *  in short, interrupt-free windows tracked by a per-CPU sequence
+ *  (odd while inside), collecting the next entry they can lock before
+ *  leaving the window to run its handler. Removers wait for the
+ *  windows open on other CPUs to close before returning, so that the
+ *  entry cannot be referenced anymore.
+ *
+ *  Each list has a generation count bumped on updates; a reader
+ *  resuming a walk after a handler call stops if the list changed,
+ *  since its position may have been unlinked meanwhile.
+ */
+static DEFINE_PER_CPU(unsigned long, rt_packets_seq);
+
+static unsigned long rt_packets_gen[RTPACKET_HASH_TBL_SIZE + 1];
+#define RTPACKET_ALL_GEN    RTPACKET_HASH_TBL_SIZE
+
+static inline void rt_packets_read_begin(rtdm_lockctx_t *context)
+{
+    rtdm_lock_irqsave(*context);
+    per_cpu(rt_packets_seq, raw_smp_processor_id())++;
+    smp_mb();
+}
+
+static inline void rt_packets_read_end(rtdm_lockctx_t *context)
+{
+    smp_mb();
+    per_cpu(rt_packets_seq, raw_smp_processor_id())++;
+    rtdm_lock_irqrestore(*context);
+}
+
+static void rt_packets_sync(void)
+{
+    unsigned long seq;
+    int cpu;
+
+    smp_mb();
+
+    for_each_online_cpu(cpu) {
+	seq = ACCESS_ONCE(per_cpu(rt_packets_seq, cpu));
+	if (seq & 1)
+	    while (ACCESS_ONCE(per_cpu(rt_packets_seq, cpu)) == seq)
+		cpu_relax();
+    }
+}
+
 
 /***
  *  rtdev_add_pack:         add protocol (Layer 3)
@@ -54,6 +134,7 @@ DEFINE_RTDM_LOCK(rt_packets_lock);
 int __rtdev_add_pack(struct rtpacket_type *pt, struct module *module)
 {
     int                     ret = 0;
+    unsigned int            hash;
     rtdm_lockctx_t          context;
 
     INIT_LIST_HEAD(&pt->list_entry);
@@ -68,13 +149,18 @@ int __rtdev_add_pack(struct rtpacket_type *pt, struct module *module)
 
     if (pt->type == htons(ETH_P_ALL))
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
-	list_add_tail(&pt->list_entry, &rt_packets_all);
+    {
+	list_add_tail_rcu(&pt->list_entry, &rt_packets_all);
+	rt_packets_gen[RTPACKET_ALL_GEN]++;
+    }
 #else /* !CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 	ret = -EINVAL;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
-    else
-	list_add_tail(&pt->list_entry,
-		      &rt_packets[ntohs(pt->type) & RTPACKET_HASH_KEY_MASK]);
+    else {
+	hash = ntohs(pt->type) & RTPACKET_HASH_KEY_MASK;
+	list_add_tail_rcu(&pt->list_entry, &rt_packets[hash]);
+	rt_packets_gen[hash]++;
+    }
 
     rtdm_lock_put_irqrestore(&rt_packets_lock, context);
 
@@ -96,8 +182,14 @@ void rtdev_remove_pack(struct rtpacket_type *pt)
     RTNET_ASSERT(pt != NULL, return;);
 
     rtdm_lock_get_irqsave(&rt_packets_lock, context);
-    list_del(&pt->list_entry);
+    list_del_rcu(&pt->list_entry);
+    if (pt->type == htons(ETH_P_ALL))
+	rt_packets_gen[RTPACKET_ALL_GEN]++;
+    else
+	rt_packets_gen[ntohs(pt->type) & RTPACKET_HASH_KEY_MASK]++;
     rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+
+    rt_packets_sync();
 }
 
 EXPORT_SYMBOL_GPL(rtdev_remove_pack);
@@ -105,24 +197,253 @@ EXPORT_SYMBOL_GPL(rtdev_remove_pack);
 
 /***
  *  rtnetif_rx: will be called from the driver interrupt handler
- *  (IRQs disabled!) and send a message to rtdev-owned stack-manager
+ *  (IRQs disabled!) and queue the packet to the stack manager of the
+ *  current CPU
  *
  *  @skb - the packet
  */
 void rtnetif_rx(struct rtskb *skb)
 {
+    struct rt_stack_rxq *rxq;
+    rtdm_lockctx_t      context;
+    int                 err;
+
     RTNET_ASSERT(skb != NULL, return;);
     RTNET_ASSERT(skb->rtdev != NULL, return;);
 
-    if (unlikely(rtskb_fifo_insert_inirq(&rx.fifo, skb) < 0)) {
-	rtdm_printk("RTnet: dropping packet in %s()\n", __FUNCTION__);
-	kfree_rtskb(skb);
+    rtdm_lock_irqsave(context);
+    rxq = rt_stack_rxq_current();
+    if (likely(rxq != stack_rxq_fallback)) {
+	/* we are the only writer on this CPU while IRQs are off */
+	err = __rtskb_fifo_insert(&rxq->rx.fifo, skb);
+	if (unlikely(err))
+	    rxq->dropped++;
+    } else {
+	/* CPUs without a manager share the fallback FIFO */
+	rtdm_lock_get(&rxq->rx.fifo.write_lock);
+	err = __rtskb_fifo_insert(&rxq->rx.fifo, skb);
+	if (unlikely(err))
+	    rxq->dropped++;
+	rtdm_lock_put(&rxq->rx.fifo.write_lock);
     }
+    rtdm_lock_irqrestore(context);
+
+    if (likely(err == 0))
+	return;
+
+    rtdm_printk("RTnet: dropping packet in %s()\n", __FUNCTION__);
+    kfree_rtskb(skb);
 }
 
 EXPORT_SYMBOL_GPL(rtnetif_rx);
 
 
+/***
+ *  rt_stack_mgr_signal: wake up the stack manager of the current CPU,
+ *  to be called by the driver after feeding rtnetif_rx() from the same
+ *  interrupt handler
+ */
+void rt_stack_mgr_signal(void)
+{
+    struct rt_stack_rxq *rxq;
+    rtdm_lockctx_t      context;
+
+    rtdm_lock_irqsave(context);
+    rxq = rt_stack_rxq_current();
+    rtdm_lock_irqrestore(context);
+
+    rtdm_event_signal(&rxq->mgr.event);
+}
+
+EXPORT_SYMBOL_GPL(rt_stack_mgr_signal);
+
+
+/***
+ *  rt_stack_mgr_dropped: get the number of packets dropped by the stack
+ *  manager of @cpu for lack of room in its FIFO
+ *
+ *  Returns -ENODEV if no stack manager runs on @cpu.
+ */
+int rt_stack_mgr_dropped(int cpu, unsigned long *dropped)
+{
+    if (stack_rxqs == NULL || stack_rxqs[cpu].cpu < 0)
+	return -ENODEV;
+
+    *dropped = stack_rxqs[cpu].dropped;
+
+    return 0;
+}
+
+EXPORT_SYMBOL_GPL(rt_stack_mgr_dropped);
+
+
+/***
+ *  rtnetif_poll_add: register a poll context of @rtdev, which remains
+ *  disabled until rtnetif_poll_enable() is called
+ *
+ *  @rtdev - the device
+ *  @poll - the poll context
+ *  @handler - the driver poll routine
+ *  @weight - the maximum number of frames per call to @handler
+ */
+void rtnetif_poll_add(struct rtnet_device *rtdev, struct rtnet_poll *poll,
+		      int (*handler)(struct rtnet_poll *poll, int budget),
+		      int weight)
+{
+    INIT_LIST_HEAD(&poll->entry);
+    poll->state = 1UL << RTNET_POLL_SCHED;
+    poll->weight = weight;
+    poll->poll = handler;
+    poll->rtdev = rtdev;
+    poll->polls = 0;
+    poll->frames = 0;
+    poll->exhausted = 0;
+
+    mutex_lock(&rtnet_devices_nrt_lock);
+    list_add_tail(&poll->dev_entry, &rtdev->poll_list);
+    mutex_unlock(&rtnet_devices_nrt_lock);
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_poll_add);
+
+
+/***
+ *  rtnetif_poll_del: unregister a disabled poll context
+ */
+void rtnetif_poll_del(struct rtnet_poll *poll)
+{
+    if (poll->rtdev == NULL)
+	return;
+
+    RTNET_ASSERT(test_bit(RTNET_POLL_SCHED, &poll->state) &&
+		 list_empty(&poll->entry), return;);
+
+    mutex_lock(&rtnet_devices_nrt_lock);
+    list_del(&poll->dev_entry);
+    mutex_unlock(&rtnet_devices_nrt_lock);
+
+    poll->rtdev = NULL;
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_poll_del);
+
+
+/***
+ *  rtnetif_poll_enable: allow the poll context to be scheduled
+ */
+void rtnetif_poll_enable(struct rtnet_poll *poll)
+{
+    RTNET_ASSERT(test_bit(RTNET_POLL_SCHED, &poll->state), return;);
+
+    rtnetif_poll_complete(poll);
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_poll_enable);
+
+
+/***
+ *  rtnetif_poll_disable: wait for a pending poll to complete, then
+ *  prevent the context from being scheduled again. To be called from
+ *  non-real-time context, the device interrupt being masked.
+ */
+void rtnetif_poll_disable(struct rtnet_poll *poll)
+{
+    while (test_and_set_bit(RTNET_POLL_SCHED, &poll->state))
+	msleep(1);
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_poll_disable);
+
+
+/***
+ *  __rtnetif_poll_schedule: queue a poll context grabbed by
+ *  rtnetif_poll_schedule_prep() to the stack manager of the current
+ *  CPU, or to the first one if this CPU has none
+ */
+void __rtnetif_poll_schedule(struct rtnet_poll *poll)
+{
+    struct rt_stack_rxq *rxq;
+    rtdm_lockctx_t      context;
+
+    rtdm_lock_irqsave(context);
+    rxq = rt_stack_rxq_current();
+
+    rtdm_lock_get(&rxq->poll_lock);
+    list_add_tail(&poll->entry, &rxq->poll_list);
+    rtdm_lock_put(&rxq->poll_lock);
+    rtdm_lock_irqrestore(context);
+
+    rtdm_event_signal(&rxq->mgr.event);
+}
+
+EXPORT_SYMBOL_GPL(__rtnetif_poll_schedule);
+
+
+/***
+ *  rt_packets_next: find and lock the next protocol entry after @pos
+ *  matching @type (any type if @all is set), to be called from a read
+ *  window
+ */
+static struct rtpacket_type *rt_packets_next(struct list_head *head,
+					     struct list_head *pos,
+					     unsigned short type, int all)
+{
+    struct rtpacket_type *pt_entry;
+
+    for (pos = ACCESS_ONCE(pos->next); pos != head;
+	 pos = ACCESS_ONCE(pos->next)) {
+	smp_read_barrier_depends();
+	pt_entry = list_entry(pos, struct rtpacket_type, list_entry);
+	if ((all || pt_entry->type == type) &&
+	    pt_entry->trylock(pt_entry))
+	    return pt_entry;
+    }
+
+    return NULL;
+}
+
+/***
+ *  rt_packets_walk: hand @rtskb over to the handlers of @head matching
+ *  @type, until one of them accepts it, or to all handlers if @all is
+ *  set. Returns 0 if the packet was accepted, 1 if some handler was
+ *  called, -1 otherwise.
+ */
+static int rt_packets_walk(struct rtskb *rtskb, struct list_head *head,
+			   unsigned long *gen, unsigned short type, int all)
+{
+    struct rtpacket_type    *pt_entry = NULL, *next;
+    rtdm_lockctx_t          context;
+    unsigned long           start_gen;
+    int                     ret = -1, err;
+
+    rt_packets_read_begin(&context);
+    start_gen = ACCESS_ONCE(*gen);
+    next = rt_packets_next(head, head, type, all);
+    rt_packets_read_end(&context);
+
+    while (next) {
+	pt_entry = next;
+	err = pt_entry->handler(rtskb, pt_entry);
+	ret = 1;
+
+	if (!all && likely(!err)) {
+	    pt_entry->unlock(pt_entry);
+	    return 0;
+	}
+
+	/* our position is still locked, thus valid until unlocked */
+	rt_packets_read_begin(&context);
+	next = ACCESS_ONCE(*gen) == start_gen ?
+	    rt_packets_next(head, &pt_entry->list_entry, type, all) : NULL;
+	rt_packets_read_end(&context);
+
+	pt_entry->unlock(pt_entry);
+    }
+
+    return ret;
+}
+
+
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK)
 #define __DELIVER_PREFIX
 #else /* !CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK */
@@ -132,10 +453,7 @@ EXPORT_SYMBOL_GPL(rtnetif_rx);
 __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 {
     unsigned short          hash;
-    struct rtpacket_type    *pt_entry;
-    rtdm_lockctx_t          context;
     struct rtnet_device     *rtdev = rtskb->rtdev;
-    int                     err;
     int                     eth_p_all_hit = 0;
 
 
@@ -143,43 +461,16 @@ __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 
     rtskb->nh.raw = rtskb->data;
 
-    rtdm_lock_get_irqsave(&rt_packets_lock, context);
-
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
-    eth_p_all_hit = 0;
-    list_for_each_entry(pt_entry, &rt_packets_all, list_entry) {
-	if (!pt_entry->trylock(pt_entry))
-	    continue;
-	rtdm_lock_put_irqrestore(&rt_packets_lock, context);
-
-	pt_entry->handler(rtskb, pt_entry);
-
-	rtdm_lock_get_irqsave(&rt_packets_lock, context);
-	pt_entry->unlock(pt_entry);
-	eth_p_all_hit = 1;
-    }
+    eth_p_all_hit = rt_packets_walk(rtskb, &rt_packets_all,
+				    &rt_packets_gen[RTPACKET_ALL_GEN], 0, 1) > 0;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 
     hash = ntohs(rtskb->protocol) & RTPACKET_HASH_KEY_MASK;
 
-    list_for_each_entry(pt_entry, &rt_packets[hash], list_entry)
-	if (pt_entry->type == rtskb->protocol) {
-	    if (!pt_entry->trylock(pt_entry))
-		continue;
-	    rtdm_lock_put_irqrestore(&rt_packets_lock, context);
-
-	    err = pt_entry->handler(rtskb, pt_entry);
-
-	    rtdm_lock_get_irqsave(&rt_packets_lock, context);
-	    pt_entry->unlock(pt_entry);
-
-	    if (likely(!err)) {
-		rtdm_lock_put_irqrestore(&rt_packets_lock, context);
-		return;
-	    }
-	}
-
-    rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+    if (rt_packets_walk(rtskb, &rt_packets[hash], &rt_packets_gen[hash],
+			rtskb->protocol, 0) == 0)
+	return;
 
     /* Don't warn if ETH_P_ALL listener were present or when running in
        promiscuous mode (RTcap). */
@@ -195,18 +486,77 @@ EXPORT_SYMBOL_GPL(rt_stack_deliver);
 #endif /* CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK */
 
 
+/***
+ *  rtnetif_receive_skb: pass a received packet to the stack, to be
+ *  called from the ->poll() handler of a driver
+ *
+ *  @skb - the packet
+ */
+void rtnetif_receive_skb(struct rtskb *skb)
+{
+    RTNET_ASSERT(skb != NULL, return;);
+    RTNET_ASSERT(skb->rtdev != NULL, return;);
+
+    rt_stack_deliver(skb);
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_receive_skb);
+
+
+static inline void rt_stack_rx_drain(struct rt_stack_rxq *rxq)
+{
+    struct rtskb *rtskb;
+
+    /* we are the only reader => no locking required */
+    while ((rtskb = __rtskb_fifo_remove(&rxq->rx.fifo)))
+	rt_stack_deliver(rtskb);
+}
+
+static void rt_stack_run_polls(struct rt_stack_rxq *rxq)
+{
+    struct rtnet_poll   *poll;
+    rtdm_lockctx_t      context;
+    int                 work;
+
+    for (;;) {
+	rtdm_lock_get_irqsave(&rxq->poll_lock, context);
+	if (list_empty(&rxq->poll_list)) {
+	    rtdm_lock_put_irqrestore(&rxq->poll_lock, context);
+	    break;
+	}
+	poll = list_first_entry(&rxq->poll_list, struct rtnet_poll, entry);
+	list_del_init(&poll->entry);
+	rtdm_lock_put_irqrestore(&rxq->poll_lock, context);
+
+	work = poll->poll(poll, poll->weight);
+	poll->polls++;
+
+	/*
+	 * A context which consumed its whole budget still owns the
+	 * SCHED bit, round-robin with the other ones until it drains.
+	 */
+	if (work >= poll->weight) {
+	    poll->exhausted++;
+	    rtdm_lock_get_irqsave(&rxq->poll_lock, context);
+	    list_add_tail(&poll->entry, &rxq->poll_list);
+	    rtdm_lock_put_irqrestore(&rxq->poll_lock, context);
+	}
+
+	/* do not starve devices still feeding rtnetif_rx() */
+	rt_stack_rx_drain(rxq);
+    }
+}
+
 static void rt_stack_mgr_task(void *arg)
 {
-    rtdm_event_t            *mgr_event = &((struct rtnet_mgr *)arg)->event;
-    struct rtskb            *rtskb;
+    struct rt_stack_rxq     *rxq = arg;
 
     while (!rtdm_task_should_stop()) {
-	if (rtdm_event_wait(mgr_event) < 0)
+	if (rtdm_event_wait(&rxq->mgr.event) < 0)
 	    break;
 
-	/* we are the only reader => no locking required */
-	while ((rtskb = __rtskb_fifo_remove(&rx.fifo)))
-	    rt_stack_deliver(rtskb);
+	rt_stack_rx_drain(rxq);
+	rt_stack_run_polls(rxq);
     }
 }
 
@@ -233,16 +583,35 @@ void rt_stack_disconnect (struct rtnet_device *rtdev)
 EXPORT_SYMBOL_GPL(rt_stack_disconnect);
 
 
+static void rt_stack_rxqs_delete(void)
+{
+    struct rt_stack_rxq *rxq;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+	rxq = &stack_rxqs[cpu];
+	if (rxq->cpu >= 0)
+	    rtdm_task_destroy(&rxq->mgr.task);
+	rtdm_event_destroy(&rxq->mgr.event);
+    }
+
+    kfree(stack_rxqs);
+    stack_rxq_fallback = NULL;
+}
+
+
 /***
- *  rt_stack_mgr_init
+ *  rt_stack_mgr_init: set up the per-CPU stack managers. @mgr is the
+ *  handle devices connect to, it does not run a task on its own.
  */
 int rt_stack_mgr_init (struct rtnet_mgr *mgr)
 {
-    int i;
+    struct rt_stack_rxq *rxq;
+    unsigned int prio;
+    char name[32];
+    int i, cpu, ret;
 
 
-    rtskb_fifo_init(&rx.fifo, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
-
     for (i = 0; i < RTPACKET_HASH_TBL_SIZE; i++)
 	INIT_LIST_HEAD(&rt_packets[i]);
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
@@ -251,8 +620,44 @@ int rt_stack_mgr_init (struct rtnet_mgr *mgr)
 
     rtdm_event_init(&mgr->event, 0);
 
-    return rtdm_task_init(&mgr->task, "rtnet-stack", rt_stack_mgr_task, mgr,
-			  stack_mgr_prio, 0);
+    stack_rxqs = kcalloc(nr_cpu_ids, sizeof(*stack_rxqs), GFP_KERNEL);
+    if (stack_rxqs == NULL) {
+	ret = -ENOMEM;
+	goto err_out;
+    }
+
+    for_each_possible_cpu(cpu) {
+	rxq = &stack_rxqs[cpu];
+	rxq->cpu = -1;
+	rtskb_fifo_init(&rxq->rx.fifo, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+	rtdm_lock_init(&rxq->poll_lock);
+	INIT_LIST_HEAD(&rxq->poll_list);
+	rtdm_event_init(&rxq->mgr.event, 0);
+    }
+
+    for_each_online_cpu(cpu) {
+	if (!xnsched_supported_cpu(cpu))
+	    continue;
+	rxq = &stack_rxqs[cpu];
+	prio = stack_mgr_cpu_prio[cpu] ? : stack_mgr_prio;
+	snprintf(name, sizeof(name), "rtnet-stack/%d", cpu);
+	ret = rtdm_task_init_on_cpu(&rxq->mgr.task, name, rt_stack_mgr_task,
+				    rxq, prio, 0, cpu);
+	if (ret) {
+	    rt_stack_rxqs_delete();
+	    goto err_out;
+	}
+	rxq->cpu = cpu;
+	if (stack_rxq_fallback == NULL)
+	    stack_rxq_fallback = rxq;
+    }
+
+    return 0;
+
+err_out:
+    rtdm_event_destroy(&mgr->event);
+
+    return ret;
 }
 
 
@@ -261,6 +666,6 @@ int rt_stack_mgr_init (struct rtnet_mgr *mgr)
  */
 void rt_stack_mgr_delete (struct rtnet_mgr *mgr)
 {
-    rtdm_task_destroy(&mgr->task);
+    rt_stack_rxqs_delete();
     rtdm_event_destroy(&mgr->event);
 }
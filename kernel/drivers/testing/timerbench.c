@@ -41,6 +41,9 @@ struct rt_tmbench_context {
 	int32_t *histogram_avg;
 	int histogram_size;
 	int bucketsize;
+	struct rttst_hdr_histogram *hdr_min;
+	struct rttst_hdr_histogram *hdr_max;
+	struct rttst_hdr_histogram *hdr_avg;
 
 	rtdm_task_t timer_task;
 
@@ -65,6 +68,27 @@ static inline void add_histogram(struct rt_tmbench_context *ctx,
 		  inabs : ctx->histogram_size - 1]++;
 }
 
+static void free_hdr(struct rt_tmbench_context *ctx)
+{
+	kfree(ctx->hdr_min);
+	kfree(ctx->hdr_max);
+	kfree(ctx->hdr_avg);
+	ctx->hdr_min = ctx->hdr_max = ctx->hdr_avg = NULL;
+}
+
+static int alloc_hdr(struct rt_tmbench_context *ctx)
+{
+	ctx->hdr_min = kzalloc(sizeof(*ctx->hdr_min), GFP_KERNEL);
+	ctx->hdr_max = kzalloc(sizeof(*ctx->hdr_max), GFP_KERNEL);
+	ctx->hdr_avg = kzalloc(sizeof(*ctx->hdr_avg), GFP_KERNEL);
+	if (ctx->hdr_min && ctx->hdr_max && ctx->hdr_avg)
+		return 0;
+
+	free_hdr(ctx);
+
+	return -ENOMEM;
+}
+
 static inline long long slldiv(long long s, unsigned d)
 {
 	return s >= 0 ? xnarch_ulldiv(s, d, NULL) : -xnarch_ulldiv(-s, d, NULL);
@@ -91,6 +115,9 @@ static void eval_inner_loop(struct rt_tmbench_context *ctx, __s32 dt)
 	if (!ctx->warmup && ctx->histogram_size)
 		add_histogram(ctx, ctx->histogram_avg, dt);
 
+	if (!ctx->warmup && ctx->hdr_avg)
+		rttst_hdr_add(ctx->hdr_avg, dt);
+
 	/* Evaluate overruns and adjust next release date.
 	   Beware of signedness! */
 	while (dt > 0 && (unsigned long)dt > ctx->period) {
@@ -108,6 +135,11 @@ static void eval_outer_loop(struct rt_tmbench_context *ctx)
 			add_histogram(ctx, ctx->histogram_min, ctx->curr.min);
 		}
 
+		if (ctx->hdr_avg) {
+			rttst_hdr_add(ctx->hdr_max, ctx->curr.max);
+			rttst_hdr_add(ctx->hdr_min, ctx->curr.min);
+		}
+
 		ctx->result.last.min = ctx->curr.min;
 		if (ctx->curr.min < ctx->result.overall.min)
 			ctx->result.overall.min = ctx->curr.min;
@@ -192,6 +224,7 @@ static int rt_tmbench_open(struct rtdm_fd *fd, int oflags)
 	ctx = rtdm_fd_to_private(fd);
 
 	ctx->mode = RTTST_TMBENCH_INVALID;
+	ctx->hdr_min = ctx->hdr_max = ctx->hdr_avg = NULL;
 	sema_init(&ctx->nrt_mutex, 1);
 
 	return 0;
@@ -220,6 +253,8 @@ static void rt_tmbench_close(struct rtdm_fd *fd)
 		ctx->histogram_size = 0;
 	}
 
+	free_hdr(ctx);
+
 	up(&ctx->nrt_mutex);
 }
 
@@ -245,6 +280,11 @@ static int rt_tmbench_start(struct rtdm_fd *fd,
 
 	down(&ctx->nrt_mutex);
 
+	if (ctx->mode >= 0) {
+		up(&ctx->nrt_mutex);
+		return -EBUSY;
+	}
+
 	ctx->period = config->period;
 	ctx->warmup_loops = config->warmup_loops;
 	ctx->samples_per_sec = 1000000000 / ctx->period;
@@ -270,6 +310,20 @@ static int rt_tmbench_start(struct rtdm_fd *fd,
 		ctx->bucketsize = config->histogram_bucketsize;
 	}
 
+	/*
+	 * HDR histograms from the previous run, if any, are dropped
+	 * now; they remain readable after RTTST_RTIOC_TMBENCH_STOP
+	 * until then.
+	 */
+	free_hdr(ctx);
+	if (config->histogram_hdr && alloc_hdr(ctx)) {
+		if (ctx->histogram_size > 0)
+			kfree(ctx->histogram_min);
+		ctx->histogram_size = 0;
+		up(&ctx->nrt_mutex);
+		return -ENOMEM;
+	}
+
 	ctx->result.overall.min = 10000000;
 	ctx->result.overall.max = -10000000;
 	ctx->result.overall.avg = 0;
@@ -392,6 +446,64 @@ static int compat_user_copy_results(struct rt_tmbench_context *ctx,
 
 #endif /* CONFIG_XENO_ARCH_SYS3264 */
 
+static int rt_tmbench_get_hdr(struct rt_tmbench_context *ctx, void *u_res)
+{
+	struct rtdm_fd *fd = rtdm_private_to_fd(ctx);
+	struct rttst_hdr_histogram __user *u_hdr[3];
+	struct rttst_hdr_bench_res res_buf, *res;
+	size_t size = sizeof(*ctx->hdr_avg);
+	int ret = 0;
+
+	down(&ctx->nrt_mutex);
+
+	if (ctx->hdr_avg == NULL) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	if (!rtdm_fd_is_user(fd)) {
+		res = u_res;
+		memcpy(res->hdr_avg, ctx->hdr_avg, size);
+		memcpy(res->hdr_min, ctx->hdr_min, size);
+		memcpy(res->hdr_max, ctx->hdr_max, size);
+		goto out;
+	}
+
+#ifdef CONFIG_XENO_ARCH_SYS3264
+	if (rtdm_fd_is_compat(fd)) {
+		struct compat_rttst_hdr_bench_res cres_buf;
+
+		if (rtdm_safe_copy_from_user(fd, &cres_buf, u_res,
+					     sizeof(cres_buf)) < 0) {
+			ret = -EFAULT;
+			goto out;
+		}
+		u_hdr[0] = compat_ptr(cres_buf.hdr_avg);
+		u_hdr[1] = compat_ptr(cres_buf.hdr_min);
+		u_hdr[2] = compat_ptr(cres_buf.hdr_max);
+	} else
+#endif
+	{
+		if (rtdm_safe_copy_from_user(fd, &res_buf, u_res,
+					     sizeof(res_buf)) < 0) {
+			ret = -EFAULT;
+			goto out;
+		}
+		u_hdr[0] = res_buf.hdr_avg;
+		u_hdr[1] = res_buf.hdr_min;
+		u_hdr[2] = res_buf.hdr_max;
+	}
+
+	if (rtdm_safe_copy_to_user(fd, u_hdr[0], ctx->hdr_avg, size) < 0 ||
+	    rtdm_safe_copy_to_user(fd, u_hdr[1], ctx->hdr_min, size) < 0 ||
+	    rtdm_safe_copy_to_user(fd, u_hdr[2], ctx->hdr_max, size) < 0)
+		ret = -EFAULT;
+out:
+	up(&ctx->nrt_mutex);
+
+	return ret;
+}
+
 static int rt_tmbench_stop(struct rt_tmbench_context *ctx, void *u_res)
 {
 	struct rtdm_fd *fd = rtdm_private_to_fd(ctx);
@@ -452,6 +564,10 @@ static int rt_tmbench_ioctl_nrt(struct rtdm_fd *fd,
 	COMPAT_CASE(RTTST_RTIOC_TMBENCH_STOP):
 		err = rt_tmbench_stop(ctx, arg);
 		break;
+
+	COMPAT_CASE(RTTST_RTIOC_TMBENCH_HDR_RES):
+		err = rt_tmbench_get_hdr(ctx, arg);
+		break;
 	default:
 		err = -EINVAL;
 	}
@@ -50,6 +50,43 @@ static DEFINE_NAME_GENERATOR(buffer_namegen, "buffer",
 
 DEFINE_SYNC_LOOKUP(buffer, RT_BUFFER);
 
+DEFINE_LOOKUP_PRIVATE(buffer, RT_BUFFER);
+
+static inline size_t buffer_fill(struct alchemy_buffer *bcb)
+{
+	return atomic_long_read(&bcb->fillsz);
+}
+
+/* Wake up readers if enough data is there for the leading one. */
+static void wake_readers(struct alchemy_buffer *bcb)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	thobj = syncobj_peek_grant(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size <= buffer_fill(bcb))
+		syncobj_grant_all(&bcb->sobj);
+}
+
+/* Wake up writers if enough room is there for the leading one. */
+static void wake_writers(struct alchemy_buffer *bcb)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	thobj = syncobj_peek_drain(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size + buffer_fill(bcb) <= bcb->bufsz)
+		syncobj_drain(&bcb->sobj);
+}
+
 #ifdef CONFIG_XENO_REGISTRY
 
 static inline
@@ -113,7 +150,7 @@ static int buffer_registry_open(struct fsobj *fsobj, void *priv)
 		return -EIO;
 
 	bufsz = bcb->bufsz;
-	fillsz = bcb->fillsz;
+	fillsz = atomic_long_read(&bcb->fillsz);
 	mode = bcb->mode;
 
 	syncobj_unlock(&bcb->sobj, &syns);
@@ -245,7 +282,10 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name,
 	bcb->bufsz = bufsz;
 	bcb->rdoff = 0;
 	bcb->wroff = 0;
-	bcb->fillsz = 0;
+	atomic_long_set(&bcb->fillsz, 0);
+	atomic_set(&bcb->waiters, 0);
+	bcb->resvsz = 0;
+	bcb->peeksz = 0;
 	if (mode & B_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
@@ -453,7 +493,6 @@ ssize_t rt_buffer_read_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
 	size_t len, rbytes, n;
 	struct syncstate syns;
 	struct service svc;
@@ -489,7 +528,7 @@ redo:
 		 * We should be able to read a complete message of the
 		 * requested length, or block.
 		 */
-		if (bcb->fillsz < len)
+		if (buffer_fill(bcb) < len)
 			goto wait;
 
 		/* Read from the buffer in a circular way. */
@@ -508,8 +547,8 @@ redo:
 			rbytes -= n;
 		} while (rbytes > 0);
 
-		bcb->fillsz -= len;
 		bcb->rdoff = rdoff;
+		atomic_long_sub_fetch(&bcb->fillsz, len);
 		ret = (ssize_t)len;
 
 		/*
@@ -517,13 +556,7 @@ redo:
 		 * drain, if we freed enough room for the leading one
 		 * to post its message.
 		 */
-		thobj = syncobj_peek_drain(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
-
-		wait = threadobj_get_wait(thobj);
-		if (wait->size + bcb->fillsz <= bcb->bufsz)
-			syncobj_drain(&bcb->sobj);
+		wake_writers(bcb);
 
 		goto done;
 	wait:
@@ -539,8 +572,8 @@ redo:
 		 * pathological use of the buffer. We must allow for a
 		 * short read to prevent a deadlock.
 		 */
-		if (bcb->fillsz > 0 && syncobj_count_drain(&bcb->sobj)) {
-			len = bcb->fillsz;
+		if (buffer_fill(bcb) > 0 && syncobj_count_drain(&bcb->sobj)) {
+			len = buffer_fill(bcb);
 			goto redo;
 		}
 
@@ -549,12 +582,23 @@ redo:
 
 		wait->size = len;
 
+		/*
+		 * Zero-copy writers commit data locklessly, tell
+		 * them that we are about to wait, then check again.
+		 */
+		atomic_add_fetch(&bcb->waiters, 1);
+		smp_mb();
+		if (buffer_fill(bcb) >= len) {
+			atomic_sub_fetch(&bcb->waiters, 1);
+			continue;
+		}
+
 		ret = syncobj_wait_grant(&bcb->sobj, abs_timeout, &syns);
-		if (ret) {
-			if (ret == -EIDRM)
-				goto out;
+		if (ret == -EIDRM)
+			goto out;
+		atomic_sub_fetch(&bcb->waiters, 1);
+		if (ret)
 			break;
-		}
 	}
 done:
 	put_alchemy_buffer(bcb, &syns);
@@ -668,7 +712,6 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
 	size_t len, rbytes, n;
 	struct syncstate syns;
 	struct service svc;
@@ -704,7 +747,7 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 		 * We should be able to write the entire message at
 		 * once, or block.
 		 */
-		if (bcb->fillsz + len > bcb->bufsz)
+		if (buffer_fill(bcb) + len > bcb->bufsz)
 			goto wait;
 
 		/* Write to the buffer in a circular way. */
@@ -724,21 +767,15 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 			rbytes -= n;
 		} while (rbytes > 0);
 
-		bcb->fillsz += len;
 		bcb->wroff = wroff;
+		atomic_long_add_fetch(&bcb->fillsz, len);
 		ret = (ssize_t)len;
 
 		/*
 		 * Wake up all threads waiting for input, if we
 		 * accumulated enough data to feed the leading one.
 		 */
-		thobj = syncobj_peek_grant(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
-
-		wait = threadobj_get_wait(thobj);
-		if (wait->size <= bcb->fillsz)
-			syncobj_grant_all(&bcb->sobj);
+		wake_readers(bcb);
 
 		goto done;
 	wait:
@@ -767,15 +804,23 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 		 * the burden: this is an error condition, we just
 		 * have to mitigate its effect, avoiding a deadlock.
 		 */
-		if (bcb->fillsz > 0 && syncobj_count_grant(&bcb->sobj))
+		if (buffer_fill(bcb) > 0 && syncobj_count_grant(&bcb->sobj))
 			syncobj_grant_all(&bcb->sobj);
 
+		/* Same as readers, for zero-copy readers. */
+		atomic_add_fetch(&bcb->waiters, 1);
+		smp_mb();
+		if (buffer_fill(bcb) + len <= bcb->bufsz) {
+			atomic_sub_fetch(&bcb->waiters, 1);
+			continue;
+		}
+
 		ret = syncobj_wait_drain(&bcb->sobj, abs_timeout, &syns);
-		if (ret) {
-			if (ret == -EIDRM)
-				goto out;
+		if (ret == -EIDRM)
+			goto out;
+		atomic_sub_fetch(&bcb->waiters, 1);
+		if (ret)
 			break;
-		}
 	}
 done:
 	put_alchemy_buffer(bcb, &syns);
@@ -788,6 +833,461 @@ out:
 	return ret;
 }
 
+/*
+ * Wait for @len bytes of data (reader), or room (writer) to be
+ * available from a zero-copy call. We get there without holding the
+ * buffer lock.
+ */
+static int wait_buffer(struct alchemy_buffer *bcb, size_t len, int writer,
+		       const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer_wait *wait;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	if (alchemy_poll_mode(abs_timeout))
+		return -EWOULDBLOCK;
+
+	CANCEL_DEFER(svc);
+
+	if (syncobj_lock(&bcb->sobj, &syns)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+	wait->size = len;
+
+	for (;;) {
+		atomic_add_fetch(&bcb->waiters, 1);
+		smp_mb();
+		if (writer ? buffer_fill(bcb) + len <= bcb->bufsz :
+		    buffer_fill(bcb) >= len) {
+			atomic_sub_fetch(&bcb->waiters, 1);
+			break;
+		}
+		if (writer)
+			ret = syncobj_wait_drain(&bcb->sobj, abs_timeout, &syns);
+		else
+			ret = syncobj_wait_grant(&bcb->sobj, abs_timeout, &syns);
+		if (ret == -EIDRM) {
+			threadobj_finish_wait();
+			goto out;
+		}
+		atomic_sub_fetch(&bcb->waiters, 1);
+		if (ret)
+			break;
+	}
+
+	threadobj_finish_wait();
+	syncobj_unlock(&bcb->sobj, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+/* Kick the other side if some task is waiting there. */
+static void kick_buffer(struct alchemy_buffer *bcb, int writer)
+{
+	struct syncstate syns;
+	struct service svc;
+
+	smp_mb();
+	if (atomic_read(&bcb->waiters) == 0)
+		return;
+
+	CANCEL_DEFER(svc);
+
+	if (syncobj_lock(&bcb->sobj, &syns) == 0) {
+		if (writer)
+			wake_readers(bcb);
+		else
+			wake_writers(bcb);
+		syncobj_unlock(&bcb->sobj, &syns);
+	}
+
+	CANCEL_RESTORE(svc);
+}
+
+/**
+ * @fn ssize_t rt_buffer_reserve(RT_BUFFER *bf, void **bufp, size_t len, RTIME timeout)
+ * @brief Reserve buffer space (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_reserve_timed() accepting a
+ * relative timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the reserved space.
+ *
+ * @param len The amount of free space to wait for.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_reserve_until(RT_BUFFER *bf, void **bufp, size_t len, RTIME abs_timeout)
+ * @brief Reserve buffer space (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_reserve_timed() accepting an
+ * absolute timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the reserved space.
+ *
+ * @param len The amount of free space to wait for.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_reserve_timed(RT_BUFFER *bf, void **bufp, size_t len, const struct timespec *abs_timeout)
+ * @brief Reserve space for writing to an IPC buffer in place.
+ *
+ * This routine waits for at least @a len bytes to be free in the
+ * buffer, then returns the address where the caller may write the
+ * next data directly. Data written there is only made visible to
+ * readers by a subsequent call to rt_buffer_commit(). When used in
+ * pair, these services provide a zero-copy interface for sending
+ * data, which does not grab the buffer lock unless some task has to
+ * be waited for, or woken up.
+ *
+ * Since the buffer space wraps around, the reserved area may be
+ * shorter than @a len bytes, in which case the rest of the free space
+ * starts at the beginning of the buffer, and may be obtained by
+ * another reservation once the first part is committed.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the reserved space, upon success.
+ *
+ * @param len The amount of free space to wait for, in bytes.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for enough buffer space to be
+ * available (see note). Passing NULL causes the caller to block
+ * indefinitely. Passing { .tv_sec = 0, .tv_nsec = 0 } causes the
+ * service to return immediately without blocking in case of buffer
+ * space shortage.
+ *
+ * @return The length in bytes of the contiguous space reserved at
+ * *@a bufp is returned upon success, which is at most @a
+ * len. Otherwise:
+ *
+ * - -ETIMEDOUT is returned if @a abs_timeout is reached before
+ * enough buffer space is available.
+ *
+ * - -EWOULDBLOCK is returned if @a abs_timeout is { .tv_sec = 0,
+ * .tv_nsec = 0 } and not enough buffer space is immediately
+ * available on entry to the call.
+ *
+ * - -EINTR is returned if rt_task_unblock() was called for the
+ * current task before enough buffer space became available.
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a len is zero or greater than the actual buffer length.
+ *
+ * - -EBUSY is returned if a reservation is already pending.
+ *
+ * - -EIDRM is returned if @a bf is deleted while the caller was
+ * waiting for buffer space.
+ *
+ * - -EPERM is returned if this service should block, but was not
+ * called from a Xenomai thread.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ *
+ * @note A single task at a time may write to a buffer using the
+ * zero-copy interface, and no other task should write to it using
+ * rt_buffer_write() meanwhile. The same goes for reading with
+ * rt_buffer_peek(). rt_buffer_clear() should not be called while
+ * zero-copy transfers are in progress.
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_reserve_timed(RT_BUFFER *bf, void **bufp, size_t len,
+				const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer *bcb;
+	size_t wroff;
+	int ret = 0;
+
+	if (!threadobj_current_p() && !alchemy_poll_mode(abs_timeout))
+		return -EPERM;
+
+	bcb = find_alchemy_buffer(bf, &ret);
+	if (bcb == NULL)
+		return ret;
+
+	if (len == 0 || len > bcb->bufsz)
+		return -EINVAL;
+
+	if (bcb->resvsz)
+		return -EBUSY;
+
+	if (buffer_fill(bcb) + len > bcb->bufsz) {
+		ret = wait_buffer(bcb, len, 1, abs_timeout);
+		if (ret)
+			return ret;
+	}
+
+	wroff = bcb->wroff;
+	if (wroff + len > bcb->bufsz)
+		len = bcb->bufsz - wroff;
+
+	bcb->resvsz = len;
+	*bufp = __mptr(bcb->buf) + wroff;
+
+	return (ssize_t)len;
+}
+
+/**
+ * @fn int rt_buffer_commit(RT_BUFFER *bf, size_t len)
+ * @brief Commit data written in place to an IPC buffer.
+ *
+ * This routine makes @a len bytes written to the space obtained from
+ * rt_buffer_reserve() available to readers, releasing the
+ * reservation. Readers waiting for input are woken up if enough data
+ * is available for the leading one.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The number of bytes to commit, which may not exceed the
+ * length returned by rt_buffer_reserve(). Zero is a valid value,
+ * cancelling the reservation.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a len is greater than the reserved length.
+ *
+ * @apitags{unrestricted, switch-primary}
+ */
+int rt_buffer_commit(RT_BUFFER *bf, size_t len)
+{
+	struct alchemy_buffer *bcb;
+	int ret = 0;
+
+	bcb = find_alchemy_buffer(bf, &ret);
+	if (bcb == NULL)
+		return ret;
+
+	if (len > bcb->resvsz)
+		return -EINVAL;
+
+	bcb->resvsz = 0;
+	if (len == 0)
+		return 0;
+
+	bcb->wroff = (bcb->wroff + len) % bcb->bufsz;
+	/* Publishes the data written in place. */
+	atomic_long_add_fetch(&bcb->fillsz, len);
+	kick_buffer(bcb, 1);
+
+	return 0;
+}
+
+/**
+ * @fn ssize_t rt_buffer_peek(RT_BUFFER *bf, void **bufp, size_t len, RTIME timeout)
+ * @brief Get a view of buffer data (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_peek_timed() accepting a
+ * relative timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the available data.
+ *
+ * @param len The amount of data to wait for.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_peek_until(RT_BUFFER *bf, void **bufp, size_t len, RTIME abs_timeout)
+ * @brief Get a view of buffer data (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_peek_timed() accepting an
+ * absolute timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the available data.
+ *
+ * @param len The amount of data to wait for.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_peek_timed(RT_BUFFER *bf, void **bufp, size_t len, const struct timespec *abs_timeout)
+ * @brief Get a view of the data pending in an IPC buffer.
+ *
+ * This routine waits for at least @a len bytes of data to be
+ * available from the buffer, then returns the address of the next
+ * data to read, which the caller may access in place. Such data is
+ * consumed by a subsequent call to rt_buffer_release(). When used in
+ * pair, these services provide a zero-copy interface for receiving
+ * data, which does not grab the buffer lock unless some task has to
+ * be waited for, or woken up.
+ *
+ * Since the buffer space wraps around, the view may be shorter than
+ * @a len bytes, in which case the rest of the data starts at the
+ * beginning of the buffer, and may be obtained by another call once
+ * the first part is released.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param bufp A pointer to a memory location which will be written
+ * with the address of the available data, upon success.
+ *
+ * @param len The amount of data to wait for, in bytes.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for enough data to be available
+ * (see note). Passing NULL causes the caller to block
+ * indefinitely. Passing { .tv_sec = 0, .tv_nsec = 0 } causes the
+ * service to return immediately without blocking in case not enough
+ * data is available.
+ *
+ * @return The length in bytes of the contiguous data available at
+ * *@a bufp is returned upon success, which is at most @a
+ * len. Otherwise:
+ *
+ * - -ETIMEDOUT is returned if @a abs_timeout is reached before
+ * enough data is available.
+ *
+ * - -EWOULDBLOCK is returned if @a abs_timeout is { .tv_sec = 0,
+ * .tv_nsec = 0 } and not enough data is immediately available on
+ * entry to the call.
+ *
+ * - -EINTR is returned if rt_task_unblock() was called for the
+ * current task before enough data became available.
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a len is zero or greater than the actual buffer length.
+ *
+ * - -EBUSY is returned if a view is already pending.
+ *
+ * - -EIDRM is returned if @a bf is deleted while the caller was
+ * waiting for data.
+ *
+ * - -EPERM is returned if this service should block, but was not
+ * called from a Xenomai thread.
+ *
+ * @apitags{xthread-nowait, switch-primary}
+ *
+ * @note A single task at a time may read from a buffer using the
+ * zero-copy interface, and no other task should read from it using
+ * rt_buffer_read() meanwhile.
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_peek_timed(RT_BUFFER *bf, void **bufp, size_t len,
+			     const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer *bcb;
+	size_t rdoff;
+	int ret = 0;
+
+	if (!threadobj_current_p() && !alchemy_poll_mode(abs_timeout))
+		return -EPERM;
+
+	bcb = find_alchemy_buffer(bf, &ret);
+	if (bcb == NULL)
+		return ret;
+
+	if (len == 0 || len > bcb->bufsz)
+		return -EINVAL;
+
+	if (bcb->peeksz)
+		return -EBUSY;
+
+	if (buffer_fill(bcb) < len) {
+		ret = wait_buffer(bcb, len, 0, abs_timeout);
+		if (ret)
+			return ret;
+	}
+
+	/* Pairs with the update of fillsz by the writer. */
+	smp_rmb();
+	rdoff = bcb->rdoff;
+	if (rdoff + len > bcb->bufsz)
+		len = bcb->bufsz - rdoff;
+
+	bcb->peeksz = len;
+	*bufp = __mptr(bcb->buf) + rdoff;
+
+	return (ssize_t)len;
+}
+
+/**
+ * @fn int rt_buffer_release(RT_BUFFER *bf, size_t len)
+ * @brief Consume data read in place from an IPC buffer.
+ *
+ * This routine consumes @a len bytes from the data obtained from
+ * rt_buffer_peek(), releasing the view. Writers waiting for buffer
+ * space are woken up if enough room is available for the leading
+ * one.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The number of bytes to consume, which may not exceed
+ * the length returned by rt_buffer_peek(). Zero is a valid value,
+ * leaving the data in the buffer.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a len is greater than the length of the view.
+ *
+ * @apitags{unrestricted, switch-primary}
+ */
+int rt_buffer_release(RT_BUFFER *bf, size_t len)
+{
+	struct alchemy_buffer *bcb;
+	int ret = 0;
+
+	bcb = find_alchemy_buffer(bf, &ret);
+	if (bcb == NULL)
+		return ret;
+
+	if (len > bcb->peeksz)
+		return -EINVAL;
+
+	bcb->peeksz = 0;
+	if (len == 0)
+		return 0;
+
+	bcb->rdoff = (bcb->rdoff + len) % bcb->bufsz;
+	/* Don't let the writer reuse the space before we are done. */
+	smp_mb();
+	atomic_long_sub_fetch(&bcb->fillsz, len);
+	kick_buffer(bcb, 0);
+
+	return 0;
+}
+
 /**
  * @fn int rt_buffer_clear(RT_BUFFER *bf)
  * @brief Clear an IPC buffer.
@@ -817,7 +1317,7 @@ int rt_buffer_clear(RT_BUFFER *bf)
 
 	bcb->wroff = 0;
 	bcb->rdoff = 0;
-	bcb->fillsz = 0;
+	atomic_long_set(&bcb->fillsz, 0);
 	syncobj_drain(&bcb->sobj);
 
 	put_alchemy_buffer(bcb, &syns);
@@ -862,7 +1362,7 @@ int rt_buffer_inquire(RT_BUFFER *bf, RT_BUFFER_INFO *info)
 	info->iwaiters = syncobj_count_grant(&bcb->sobj);
 	info->owaiters = syncobj_count_drain(&bcb->sobj);
 	info->totalmem = bcb->bufsz;
-	info->availmem = bcb->bufsz - bcb->fillsz;
+	info->availmem = bcb->bufsz - buffer_fill(bcb);
 	strcpy(info->name, bcb->name);
 
 	put_alchemy_buffer(bcb, &syns);
@@ -19,6 +19,7 @@
 #ifndef _ALCHEMY_BUFFER_H
 #define _ALCHEMY_BUFFER_H
 
+#include <boilerplate/atomic.h>
 #include <copperplate/registry-obstack.h>
 #include <copperplate/syncobj.h>
 #include <copperplate/cluster.h>
@@ -34,7 +35,12 @@ struct alchemy_buffer {
 	dref_type(void *) buf;
 	size_t rdoff;
 	size_t wroff;
-	size_t fillsz;
+	atomic_long_t fillsz;
+	/* Tasks about to wait, or waiting on either side. */
+	atomic_t waiters;
+	/* Outstanding zero-copy reservation/view. */
+	size_t resvsz;
+	size_t peeksz;
 	struct fsobj fsobj;
 };
 
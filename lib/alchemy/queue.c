@@ -46,6 +46,193 @@ static DEFINE_NAME_GENERATOR(queue_namegen, "queue",
 
 DEFINE_SYNC_LOOKUP(queue, RT_QUEUE);
 
+DEFINE_LOOKUP_PRIVATE(queue, RT_QUEUE);
+
+/*
+ * Q_SPSC/Q_MPSC queues convey message pointers through a bounded
+ * lockless ring, with per-slot sequence numbers telling producers
+ * and the consumer whether a slot is free or filled. The syncobj is
+ * only involved when the consumer has to block on an empty ring,
+ * and when a producer has to wake it up. The consumer advertises
+ * that it is about to sleep via ring->sleeping before checking the
+ * ring a last time, which pairs with producers checking that flag
+ * after publishing a message.
+ */
+static int ring_push(struct alchemy_queue *qcb,
+		     struct alchemy_queue_msg *msg)
+{
+	struct alchemy_queue_ring *ring = &qcb->ring;
+	struct alchemy_queue_slot *slots, *slot;
+	unsigned int pos, seq, old;
+
+	slots = __mptr(ring->slots);
+	pos = atomic_read(&ring->tail);
+
+	for (;;) {
+		slot = slots + (pos & ring->mask);
+		seq = atomic_read(&slot->seq);
+		if (seq == pos) {
+			if (pos - atomic_read(&ring->head) >= qcb->limit)
+				return -ENOMEM;
+			if (qcb->mode & Q_SPSC) {
+				atomic_set(&ring->tail, pos + 1);
+				break;
+			}
+			old = atomic_cmpxchg(&ring->tail, pos, pos + 1);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if ((int)(seq - pos) < 0)
+			return -ENOMEM;
+		else {
+			/* Another producer got this slot. */
+			barrier();
+			pos = atomic_read(&ring->tail);
+		}
+	}
+
+	slot->msg = __moff(msg);
+	smp_wmb();
+	atomic_set(&slot->seq, pos + 1);
+
+	return 0;
+}
+
+static struct alchemy_queue_msg *ring_pop(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_ring *ring = &qcb->ring;
+	struct alchemy_queue_msg *msg;
+	struct alchemy_queue_slot *slot;
+	unsigned int pos;
+
+	pos = atomic_read(&ring->head);
+	slot = (struct alchemy_queue_slot *)__mptr(ring->slots) +
+		(pos & ring->mask);
+	if ((unsigned int)atomic_read(&slot->seq) != pos + 1)
+		return NULL;	/* Empty, or not published yet. */
+
+	smp_rmb();
+	msg = __mptr(slot->msg);
+	smp_mb();
+	atomic_set(&slot->seq, pos + ring->mask + 1);
+	atomic_set(&ring->head, pos + 1);
+
+	return msg;
+}
+
+static inline unsigned int queue_count(struct alchemy_queue *qcb)
+{
+	if (qcb->mode & Q_RING)
+		return (unsigned int)atomic_read(&qcb->ring.tail) -
+			(unsigned int)atomic_read(&qcb->ring.head);
+
+	return qcb->mcount;
+}
+
+/* Wake up the consumer if waiting, return the number of waiters woken. */
+static int ring_kick(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_wait *wait;
+	struct threadobj *waiter;
+	struct syncstate syns;
+	int ret = 0;
+
+	smp_mb();
+	if (atomic_read(&qcb->ring.sleeping) == 0)
+		return 0;
+
+	if (syncobj_lock(&qcb->sobj, &syns))
+		return 0;
+
+	waiter = syncobj_grant_one(&qcb->sobj);
+	if (waiter) {
+		/* Tell the consumer to pull from the ring. */
+		wait = threadobj_get_wait(waiter);
+		wait->msg = NULL;
+		ret = 1;
+	}
+
+	syncobj_unlock(&qcb->sobj, &syns);
+
+	return ret;
+}
+
+static int ring_receive(struct alchemy_queue *qcb,
+			const struct timespec *abs_timeout,
+			struct alchemy_queue_msg **msgp)
+{
+	struct alchemy_queue_wait *wait;
+	struct alchemy_queue_msg *msg;
+	struct syncstate syns;
+	int ret = 0;
+
+	msg = ring_pop(qcb);
+	if (msg)
+		goto out;
+
+	if (alchemy_poll_mode(abs_timeout))
+		return -EWOULDBLOCK;
+
+	if (syncobj_lock(&qcb->sobj, &syns))
+		return -EINVAL;
+
+	wait = threadobj_prepare_wait(struct alchemy_queue_wait);
+
+	for (;;) {
+		atomic_set(&qcb->ring.sleeping, 1);
+		smp_mb();
+		msg = ring_pop(qcb);
+		if (msg)
+			break;
+		wait->msg = NULL;
+		wait->usersz = 0;
+		ret = syncobj_wait_grant(&qcb->sobj, abs_timeout, &syns);
+		if (ret) {
+			if (ret == -EIDRM) {
+				threadobj_finish_wait();
+				return ret;
+			}
+			break;
+		}
+	}
+
+	atomic_set(&qcb->ring.sleeping, 0);
+	threadobj_finish_wait();
+	syncobj_unlock(&qcb->sobj, &syns);
+
+	if (msg == NULL)
+		return ret;
+out:
+	*msgp = msg;
+
+	return 0;
+}
+
+static int ring_init(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_ring *ring = &qcb->ring;
+	struct alchemy_queue_slot *slots;
+	unsigned int nslots, n;
+
+	for (nslots = 1; nslots < qcb->limit; nslots <<= 1)
+		;
+
+	slots = xnmalloc(nslots * sizeof(*slots));
+	if (slots == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < nslots; n++)
+		atomic_set(&slots[n].seq, n);
+
+	atomic_set(&ring->head, 0);
+	atomic_set(&ring->tail, 0);
+	atomic_set(&ring->sleeping, 0);
+	ring->mask = nslots - 1;
+	ring->slots = __moff(slots);
+
+	return 0;
+}
+
 #ifdef CONFIG_XENO_REGISTRY
 
 static int prepare_waiter_cache(struct fsobstack *o,
@@ -93,7 +280,7 @@ static int queue_registry_open(struct fsobj *fsobj, void *priv)
 	usable_mem = heapobj_size(&qcb->hobj);
 	used_mem = heapobj_inquire(&qcb->hobj);
 	limit = qcb->limit;
-	mcount = qcb->mcount;
+	mcount = queue_count(qcb);
 	mode = qcb->mode;
 
 	syncobj_unlock(&qcb->sobj, &syns);
@@ -135,6 +322,8 @@ static void queue_finalize(struct syncobj *sobj)
 	qcb = container_of(sobj, struct alchemy_queue, sobj);
 	registry_destroy_file(&qcb->fsobj);
 	heapobj_destroy(&qcb->hobj);
+	if (qcb->mode & Q_RING)
+		xnfree(__mptr(qcb->ring.slots));
 	xnfree(qcb);
 }
 fnref_register(libalchemy, queue_finalize);
@@ -172,9 +361,22 @@ fnref_register(libalchemy, queue_finalize);
  *
  * - Q_PRIO makes tasks pend in priority order on the queue.
  *
+ * - Q_SPSC makes the queue convey messages through a lockless ring,
+ * for a single sending task and a single receiving task. The
+ * internal lock is only grabbed when the receiver has to wait for
+ * a message, or a sender has to wake it up.
+ *
+ * - Q_MPSC is similar to Q_SPSC, except that multiple tasks may send
+ * to the queue concurrently.
+ *
+ * Lockless queues must be given a message limit, they do not support
+ * Q_URGENT and Q_BROADCAST operations. Only a single task may
+ * receive or flush messages at any point in time.
+ *
  * @return Zero is returned upon success. Otherwise:
  *
- * - -EINVAL is returned if @a mode is invalid or @a poolsize is zero.
+ * - -EINVAL is returned if @a mode is invalid or @a poolsize is zero,
+ * or if Q_SPSC or Q_MPSC is set without a message limit.
  *
  * - -ENOMEM is returned if the system fails to get memory from the
  * main heap in order to create the queue.
@@ -211,7 +413,11 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 	if (threadobj_irq_p())
 		return -EPERM;
 
-	if (poolsize == 0 || (mode & ~Q_PRIO) != 0)
+	if (poolsize == 0 || (mode & ~(Q_PRIO|Q_RING)) != 0)
+		return -EINVAL;
+
+	if ((mode & Q_RING) &&
+	    ((mode & Q_RING) == Q_RING || qlimit == Q_UNLIMITED))
 		return -EINVAL;
 
 	CANCEL_DEFER(svc);
@@ -246,6 +452,12 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 	list_init(&qcb->mq);
 	qcb->mcount = 0;
 
+	if (mode & Q_RING) {
+		ret = ring_init(qcb);
+		if (ret)
+			goto fail_ringalloc;
+	}
+
 	if (mode & Q_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
@@ -278,6 +490,9 @@ fail_register:
 	registry_destroy_file(&qcb->fsobj);
 	syncobj_uninit(&qcb->sobj);
 fail_syncinit:
+	if (mode & Q_RING)
+		xnfree(__mptr(qcb->ring.slots));
+fail_ringalloc:
 	heapobj_destroy(&qcb->hobj);
 fail_bufalloc:
 	xnfree(qcb);
@@ -494,6 +709,9 @@ out:
  * - -EINVAL is returned if @a q is not a message queue descriptor, @a
  * mode is invalid, or @a buf is NULL.
  *
+ * - -EINVAL is returned if @a mode is not Q_NORMAL for a queue
+ * created with Q_SPSC or Q_MPSC.
+ *
  * - -ENOMEM is returned if queuing the message would exceed the limit
  * defined for the queue at creation.
  *
@@ -517,6 +735,26 @@ int rt_queue_send(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	if (qcb->mode & Q_RING) {
+		if (mode || msg->refcount == 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+		msg->refcount--;
+		msg->size = size;
+		ret = ring_push(qcb, msg);
+		if (ret) {
+			msg->refcount++;
+			goto out;
+		}
+		ret = ring_kick(qcb);
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -607,7 +845,8 @@ out:
  * codes is returned:
  *
  * - -EINVAL is returned if @a mode is invalid, or @a q is not a
- * essage queue descriptor.
+ * essage queue descriptor, or @a mode is not Q_NORMAL for a queue
+ * created with Q_SPSC or Q_MPSC.
  *
  * - -ENOMEM is returned if queuing the message would exceed the limit
  * defined for the queue at creation, or if no memory can be obtained
@@ -635,6 +874,30 @@ int rt_queue_write(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	if (qcb->mode & Q_RING) {
+		ret = -EINVAL;
+		if (mode)
+			goto out;
+		ret = -ENOMEM;
+		msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
+		if (msg == NULL)
+			goto out;
+		msg->size = size;
+		msg->refcount = 0;
+		memcpy(msg + 1, buf, size);
+		ret = ring_push(qcb, msg);
+		if (ret) {
+			heapobj_free(&qcb->hobj, msg);
+			goto out;
+		}
+		ret = ring_kick(qcb);
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -805,6 +1068,22 @@ ssize_t rt_queue_receive_timed(RT_QUEUE *queue, void **bufp,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL) {
+		ret = err;
+		goto out;
+	}
+
+	if (qcb->mode & Q_RING) {
+		ret = ring_receive(qcb, abs_timeout, &msg);
+		if (ret == 0) {
+			msg->refcount++;
+			*bufp = msg + 1;
+			ret = (ssize_t)msg->size;
+		}
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &err);
 	if (qcb == NULL) {
 		ret = err;
@@ -962,6 +1241,23 @@ ssize_t rt_queue_read_timed(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL) {
+		ret = err;
+		goto out;
+	}
+
+	if (qcb->mode & Q_RING) {
+		ret = ring_receive(qcb, abs_timeout, &msg);
+		if (ret == 0) {
+			ret = (ssize_t)(msg->size > size ? size : msg->size);
+			if (ret > 0)
+				memcpy(buf, msg + 1, ret);
+			heapobj_free(&qcb->hobj, msg);
+		}
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &err);
 	if (qcb == NULL) {
 		ret = err;
@@ -1039,6 +1335,12 @@ int rt_queue_flush(RT_QUEUE *queue)
 	if (qcb == NULL)
 		goto out;
 
+	if (qcb->mode & Q_RING) {
+		for (ret = 0; (msg = ring_pop(qcb)) != NULL; ret++)
+			heapobj_free(&qcb->hobj, msg);
+		goto done;
+	}
+
 	ret = qcb->mcount;
 	qcb->mcount = 0;
 
@@ -1054,7 +1356,7 @@ int rt_queue_flush(RT_QUEUE *queue)
 			heapobj_free(&qcb->hobj, msg);
 		}
 	}
-
+done:
 	put_alchemy_queue(qcb, &syns);
 out:
 	CANCEL_RESTORE(svc);
@@ -1095,7 +1397,7 @@ int rt_queue_inquire(RT_QUEUE *queue, RT_QUEUE_INFO *info)
 		goto out;
 
 	info->nwaiters = syncobj_count_grant(&qcb->sobj);
-	info->nmessages = qcb->mcount;
+	info->nmessages = queue_count(qcb);
 	info->mode = qcb->mode;
 	info->qlimit = qcb->limit;
 	info->poolsize = heapobj_size(&qcb->hobj);
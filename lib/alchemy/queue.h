@@ -20,12 +20,29 @@
 #define _ALCHEMY_QUEUE_H
 
 #include <boilerplate/list.h>
+#include <boilerplate/atomic.h>
 #include <copperplate/syncobj.h>
 #include <copperplate/registry.h>
 #include <copperplate/cluster.h>
 #include <copperplate/heapobj.h>
 #include <alchemy/queue.h>
 
+#define Q_RING  (Q_SPSC|Q_MPSC)
+
+struct alchemy_queue_slot {
+	atomic_t seq;
+	dref_type(struct alchemy_queue_msg *) msg;
+};
+
+struct alchemy_queue_ring {
+	atomic_t head;
+	atomic_t tail;
+	/* Set while the consumer is about to wait for messages. */
+	atomic_t sleeping;
+	unsigned int mask;
+	dref_type(struct alchemy_queue_slot *) slots;
+};
+
 struct alchemy_queue {
 	unsigned int magic;	/* Must be first. */
 	char name[XNOBJECT_NAME_LEN];
@@ -36,6 +53,7 @@ struct alchemy_queue {
 	struct clusterobj cobj;
 	struct listobj mq;
 	unsigned int mcount;
+	struct alchemy_queue_ring ring;
 	struct fsobj fsobj;
 };
 
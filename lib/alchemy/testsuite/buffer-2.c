@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/buffer.h>
+
+#define BUFSZ  64
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5, 6, 7, 8, 9,
+};
+
+static RT_BUFFER buffer;
+
+static char pattern[BUFSZ * 2];
+
+static void fill_pattern(void)
+{
+	int n;
+
+	for (n = 0; n < BUFSZ * 2; n++)
+		pattern[n] = 'A' + n % 26;
+}
+
+static void peer_task(void *arg)
+{
+	char buf[BUFSZ];
+	ssize_t ret;
+	void *p;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 3);
+
+	/* Wakes up the writer waiting for room. */
+	ret = rt_buffer_read(&buffer, buf, 8, TM_INFINITE);
+	traceobj_assert(&trobj, ret == 8 && memcmp(buf, pattern, 8) == 0);
+
+	traceobj_mark(&trobj, 5);
+
+	ret = rt_buffer_peek(&buffer, &p, 8, TM_INFINITE);
+	traceobj_assert(&trobj, ret == 8 && memcmp(p, pattern + 16, 8) == 0);
+
+	ret = rt_buffer_release(&buffer, 8);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_mark(&trobj, 8);
+
+	traceobj_exit(&trobj);
+}
+
+static void main_task(void *arg)
+{
+	RT_BUFFER_INFO info;
+	char buf[BUFSZ];
+	RT_TASK t_peer;
+	ssize_t ret;
+	void *p;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_buffer_create(&buffer, "BUFFER", BUFSZ, B_FIFO);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_reserve(&buffer, &p, BUFSZ + 1, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_buffer_peek(&buffer, &p, 1, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	/* Regular write, zero-copy read. */
+	ret = rt_buffer_write(&buffer, pattern, 40, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, 40);
+
+	ret = rt_buffer_peek(&buffer, &p, 40, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 40 && memcmp(p, pattern, 40) == 0);
+
+	ret = rt_buffer_peek(&buffer, &p, 40, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EBUSY);
+
+	ret = rt_buffer_release(&buffer, 41);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_buffer_release(&buffer, 40);
+	traceobj_check(&trobj, ret, 0);
+
+	/*
+	 * Zero-copy write wrapping around the end of the buffer:
+	 * the first reservation stops there, the second one gets
+	 * the remainder from the start.
+	 */
+	ret = rt_buffer_reserve(&buffer, &p, 40, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, BUFSZ - 40);
+	memcpy(p, pattern, ret);
+
+	ret = rt_buffer_reserve(&buffer, &p, 40, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EBUSY);
+
+	ret = rt_buffer_commit(&buffer, BUFSZ - 40 + 1);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_buffer_commit(&buffer, BUFSZ - 40);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_reserve(&buffer, &p, 16, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, 16);
+	memcpy(p, pattern + BUFSZ - 40, ret);
+
+	ret = rt_buffer_commit(&buffer, 16);
+	traceobj_check(&trobj, ret, 0);
+
+	/* Reserving beyond the free space. */
+	ret = rt_buffer_reserve(&buffer, &p, BUFSZ - 40 + 1, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	ret = rt_buffer_reserve(&buffer, &p, BUFSZ - 40 + 1, 1000000ULL);
+	traceobj_check(&trobj, ret, -ETIMEDOUT);
+
+	/* Regular read of the wrapped data. */
+	ret = rt_buffer_read(&buffer, buf, 40, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 40 && memcmp(buf, pattern, 40) == 0);
+
+	/* Regular wrapped write, zero-copy read in two parts. */
+	ret = rt_buffer_write(&buffer, pattern, 60, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, 60);
+
+	ret = rt_buffer_peek(&buffer, &p, 60, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == BUFSZ - 16 &&
+			memcmp(p, pattern, BUFSZ - 16) == 0);
+
+	ret = rt_buffer_release(&buffer, BUFSZ - 16);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_peek(&buffer, &p, 12, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 12 &&
+			memcmp(p, pattern + BUFSZ - 16, 12) == 0);
+
+	ret = rt_buffer_release(&buffer, 12);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_inquire(&buffer, &info);
+	traceobj_check(&trobj, ret, 0);
+	traceobj_assert(&trobj, info.availmem == BUFSZ);
+
+	traceobj_mark(&trobj, 2);
+
+	/* Zero-copy and regular transfers wake up each other. */
+	ret = rt_buffer_write(&buffer, pattern, BUFSZ, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, BUFSZ);
+
+	ret = rt_task_spawn(&t_peer, "peer_task", 0,  10, 0, peer_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_reserve(&buffer, &p, 8, TM_INFINITE);
+	traceobj_check(&trobj, ret, 8);
+
+	traceobj_mark(&trobj, 4);
+
+	memcpy(p, pattern, ret);
+	ret = rt_buffer_commit(&buffer, 8);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_read(&buffer, buf, BUFSZ, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == BUFSZ &&
+			memcmp(buf, pattern + 8, BUFSZ - 8) == 0 &&
+			memcmp(buf + BUFSZ - 8, pattern, 8) == 0);
+
+	rt_task_sleep(10000000ULL);
+
+	traceobj_mark(&trobj, 6);
+
+	ret = rt_buffer_write(&buffer, pattern + 16, 8, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, 8);
+
+	traceobj_mark(&trobj, 7);
+
+	rt_task_sleep(10000000ULL);
+
+	traceobj_mark(&trobj, 9);
+
+	ret = rt_buffer_inquire(&buffer, &info);
+	traceobj_check(&trobj, ret, 0);
+	traceobj_assert(&trobj, info.availmem == BUFSZ);
+
+	ret = rt_buffer_delete(&buffer);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	RT_TASK t_main;
+	int ret;
+
+	fill_pattern();
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  50, 0, main_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
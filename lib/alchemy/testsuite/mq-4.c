@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/queue.h>
+
+#define NMESSAGES  3
+#define NROUNDS    10
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5, 6, 7, 8, 9,
+};
+
+static RT_QUEUE q;
+
+static void check_ring(int mode)
+{
+	int ret, msg, n;
+
+	ret = rt_queue_create(&q, "QUEUE", (NMESSAGES + 1) * 64,
+			      NMESSAGES, mode);
+	traceobj_check(&trobj, ret, 0);
+
+	/* Empty. */
+	ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	/* Full, the limit applies although the ring is larger. */
+	for (msg = 0; msg < NMESSAGES; msg++) {
+		ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+	traceobj_check(&trobj, ret, -ENOMEM);
+
+	for (n = 0; n < NMESSAGES; n++) {
+		ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+		traceobj_assert(&trobj, ret == sizeof(msg) && msg == n);
+	}
+
+	ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	/* Ordering is preserved across ring wraparounds. */
+	for (n = 0; n < NROUNDS * 2; n += 2) {
+		msg = n;
+		ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+		traceobj_check(&trobj, ret, 0);
+		msg = n + 1;
+		ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+		traceobj_check(&trobj, ret, 0);
+		ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+		traceobj_assert(&trobj, ret == sizeof(msg) && msg == n);
+		ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+		traceobj_assert(&trobj, ret == sizeof(msg) && msg == n + 1);
+	}
+
+	/* Rings cannot prepend nor broadcast messages. */
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_URGENT);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_BROADCAST);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_queue_flush(&q);
+	traceobj_check(&trobj, ret, 1);
+
+	ret = rt_queue_delete(&q);
+	traceobj_check(&trobj, ret, 0);
+}
+
+static void peer_task(void *arg)
+{
+	int ret, msg = 0xdeadbeef;
+	void *buf;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 5);
+
+	/* Wakes up the receiver waiting on the empty ring. */
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+	traceobj_check(&trobj, ret, 1);
+
+	traceobj_mark(&trobj, 7);
+
+	buf = rt_queue_alloc(&q, sizeof(msg));
+	traceobj_assert(&trobj, buf != NULL);
+	*(int *)buf = ~msg;
+	ret = rt_queue_send(&q, buf, sizeof(msg), Q_NORMAL);
+	traceobj_check(&trobj, ret, 1);
+
+	traceobj_exit(&trobj);
+}
+
+static void main_task(void *arg)
+{
+	RT_TASK t_peer;
+	RT_QUEUE_INFO info;
+	int ret, msg;
+	void *buf;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_queue_create(&q, "QUEUE", 64, Q_UNLIMITED, Q_SPSC);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_create(&q, "QUEUE", 64, NMESSAGES, Q_SPSC|Q_MPSC);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	traceobj_mark(&trobj, 2);
+
+	check_ring(Q_SPSC);
+
+	traceobj_mark(&trobj, 3);
+
+	check_ring(Q_MPSC|Q_PRIO);
+
+	traceobj_mark(&trobj, 4);
+
+	/*
+	 * The receiver falls back to waiting on the queue when the
+	 * ring is empty, senders wake it up from there.
+	 */
+	ret = rt_queue_create(&q, "QUEUE", (NMESSAGES + 1) * 64,
+			      NMESSAGES, Q_SPSC);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_task_spawn(&t_peer, "peer_task", 0,  10, 0, peer_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_queue_read(&q, &msg, sizeof(msg), TM_INFINITE);
+	traceobj_assert(&trobj, ret == sizeof(msg) && msg == 0xdeadbeef);
+
+	traceobj_mark(&trobj, 6);
+
+	ret = rt_queue_receive(&q, &buf, TM_INFINITE);
+	traceobj_assert(&trobj, ret == sizeof(msg) && *(int *)buf == ~0xdeadbeef);
+
+	traceobj_mark(&trobj, 8);
+
+	ret = rt_queue_free(&q, buf);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_queue_inquire(&q, &info);
+	traceobj_check(&trobj, ret, 0);
+	traceobj_assert(&trobj, info.nmessages == 0);
+
+	ret = rt_queue_read(&q, &msg, sizeof(msg), 1000000ULL);
+	traceobj_check(&trobj, ret, -ETIMEDOUT);
+
+	traceobj_mark(&trobj, 9);
+
+	ret = rt_queue_delete(&q);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	RT_TASK t_main;
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  50, 0, main_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
@@ -16,10 +16,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <errno.h>
+#include <time.h>
 #include "boilerplate/lock.h"
 #include "boilerplate/hash.h"
+#include "boilerplate/setup.h"
 #include "boilerplate/debug.h"
 
 /*
@@ -91,31 +95,412 @@ unsigned int __hash_key(const void *key, size_t length, unsigned int c)
 	return c;
 }
 
+/* Average chain length triggering a table expansion. */
+#define HASH_LOAD_FACTOR	2
+#define HASH_MAX_BUCKETS	(1<<20)
+/* Old buckets migrated by each insertion while growing. */
+#define HASH_MIGRATE_STEP	8
+/* Lockless lookup attempts before falling back to locking. */
+#define HASH_READ_RETRIES	3
+
+static inline void *alloc_buckets(const struct hash_operations *hops,
+				  size_t size);
+
+static inline void free_buckets(const struct hash_operations *hops,
+				void *p);
+
 void __hash_init(void *heap, struct hash_table *t)
 {
 	pthread_mutexattr_t mattr;
+	struct hash_stripe *s;
 	int n;
 
 	for (n = 0; n < HASHSLOTS; n++)
 		__list_init(heap, &t->table[n].obj_list);
 
+	t->buckets = __moff(t->table);
+	t->nr_buckets = HASHSLOTS;
+	t->old_nr_buckets = 0;
+	t->migrate_pos = 0;
+
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
 	pthread_mutexattr_setpshared(&mattr, mutex_scope_attribute);
 	__RT(pthread_mutex_init(&t->lock, &mattr));
+	for (n = 0; n < HASH_STRIPES; n++) {
+		s = &t->stripes[n];
+		__RT(pthread_mutex_init(&s->lock, &mattr));
+		s->seq = 0;
+		memset(s->readers, 0, sizeof(s->readers));
+		s->count = 0;
+	}
 	pthread_mutexattr_destroy(&mattr);
 }
 
+/*
+ * Bucket arrays grown past the initial one are not released, since
+ * their allocator is only known from the hash operations. Tables are
+ * only destroyed before being used anyway.
+ */
 void hash_destroy(struct hash_table *t)
 {
+	int n;
+
+	for (n = 0; n < HASH_STRIPES; n++)
+		__RT(pthread_mutex_destroy(&t->stripes[n].lock));
+
 	__RT(pthread_mutex_destroy(&t->lock));
 }
 
-static struct hash_bucket *do_hash(struct hash_table *t,
-				   const void *key, size_t len)
+static inline struct hash_stripe *get_stripe(struct hash_table *t,
+					     unsigned int hash)
 {
-	unsigned int hash = __hash_key(key, len, 0);
-	return &t->table[hash & (HASHSLOTS-1)];
+	return &t->stripes[hash & (HASH_STRIPES-1)];
+}
+
+/*
+ * Return the bucket hosting @hash. Caller must hold the stripe lock,
+ * or be in a read section of the stripe.
+ */
+static struct hash_bucket *get_bucket(struct hash_table *t,
+				      unsigned int hash)
+{
+	struct hash_bucket *buckets;
+	unsigned int n;
+
+	if (t->old_nr_buckets) {
+		n = hash & (t->old_nr_buckets - 1);
+		if (n >= t->migrate_pos) {
+			buckets = __mptr(t->old_buckets);
+			return &buckets[n];
+		}
+	}
+
+	buckets = __mptr(t->buckets);
+
+	return &buckets[hash & (t->nr_buckets - 1)];
+}
+
+static inline void stripe_write_begin(struct hash_stripe *s)
+{
+	s->seq++;
+	smp_wmb();
+}
+
+static inline void stripe_write_end(struct hash_stripe *s)
+{
+	smp_wmb();
+	s->seq++;
+}
+
+#ifdef CONFIG_XENO_PSHARED
+
+static inline int get_reader_id(void)
+{
+	return __node_id;
+}
+
+/* A reader from a dead process would hold its slot forever. */
+static inline int reader_alive(int id)
+{
+	return __STD(kill(id, 0)) == 0 || errno != ESRCH;
+}
+
+#else /* !CONFIG_XENO_PSHARED */
+
+static inline int get_reader_id(void)
+{
+	return 1;
+}
+
+/* Readers may not go away in the middle of a lookup. */
+static inline int reader_alive(int id)
+{
+	return 1;
+}
+
+#endif /* !CONFIG_XENO_PSHARED */
+
+static struct hash_reader *enter_reader(struct hash_stripe *s)
+{
+	struct hash_reader *r;
+	int n, id;
+
+	id = get_reader_id();
+	if (id == 0)
+		return NULL;
+
+	for (n = 0; n < HASH_STRIPE_READERS; n++) {
+		r = &s->readers[n];
+		/* Full barrier, orders the claim with reading seq. */
+		if (atomic_read(&r->id) == 0 &&
+		    atomic_cmpxchg(&r->id, 0, id) == 0)
+			return r;
+	}
+
+	return NULL;
+}
+
+static void leave_reader(struct hash_reader *r)
+{
+	r->gen++;
+	smp_mb();
+	atomic_set(&r->id, 0);
+}
+
+/*
+ * Wait for the lockless readers which might still hold references
+ * to objects unlinked from the stripe. A reader is done once its
+ * slot is released, or its generation has changed. We only give up
+ * on a reader when its process is gone, in which case we also
+ * reclaim its slot.
+ */
+static void stripe_drain(struct hash_stripe *s)
+{
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000 };
+	struct hash_reader *r;
+	unsigned int gen;
+	int n, id;
+
+	smp_mb();
+
+	for (n = 0; n < HASH_STRIPE_READERS; n++) {
+		r = &s->readers[n];
+		id = atomic_read(&r->id);
+		if (id == 0)
+			continue;
+		gen = r->gen;
+		smp_rmb();
+		while (atomic_read(&r->id) == id && r->gen == gen) {
+			if (!reader_alive(id)) {
+				atomic_cmpxchg(&r->id, id, 0);
+				break;
+			}
+			__RT(clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL));
+		}
+	}
+}
+
+static unsigned int hash_count(struct hash_table *t)
+{
+	unsigned int count = 0;
+	int n;
+
+	for (n = 0; n < HASH_STRIPES; n++)
+		count += t->stripes[n].count;
+
+	return count;
+}
+
+/* Called with t->lock held. */
+static void start_resize(struct hash_table *t,
+			 struct hash_bucket *buckets, unsigned int nr)
+{
+	int n;
+
+	for (n = 0; n < HASH_STRIPES; n++) {
+		write_lock_nocancel(&t->stripes[n].lock);
+		stripe_write_begin(&t->stripes[n]);
+	}
+
+	t->old_buckets = t->buckets;
+	t->old_nr_buckets = t->nr_buckets;
+	t->migrate_pos = 0;
+	t->buckets = __moff(buckets);
+	t->nr_buckets = nr;
+
+	for (n = 0; n < HASH_STRIPES; n++) {
+		stripe_write_end(&t->stripes[n]);
+		write_unlock(&t->stripes[n].lock);
+	}
+}
+
+/*
+ * Called with t->lock held. Returns the old bucket array once all
+ * objects have moved to the new one, which the caller should release
+ * after draining the readers.
+ */
+static struct hash_bucket *migrate_buckets(struct hash_table *t)
+{
+	struct hash_bucket *old, *bucket;
+	struct hashobj *obj, *tmp;
+	struct hash_stripe *s;
+	unsigned int pos;
+	int n;
+
+	old = __mptr(t->old_buckets);
+
+	for (n = 0; n < HASH_MIGRATE_STEP; n++) {
+		pos = t->migrate_pos;
+		if (pos >= t->old_nr_buckets)
+			break;
+
+		s = get_stripe(t, pos);
+		write_lock_nocancel(&s->lock);
+		stripe_write_begin(s);
+
+		if (!list_empty(&old[pos].obj_list)) {
+			list_for_each_entry_safe(obj, tmp,
+						 &old[pos].obj_list, link) {
+				list_remove(&obj->link);
+				bucket = __mptr(t->buckets);
+				bucket += obj->hash & (t->nr_buckets - 1);
+				list_append(&obj->link, &bucket->obj_list);
+			}
+		}
+		t->migrate_pos = pos + 1;
+
+		stripe_write_end(s);
+		write_unlock(&s->lock);
+	}
+
+	if (t->migrate_pos < t->old_nr_buckets)
+		return NULL;
+
+	t->old_nr_buckets = 0;
+
+	return old;
+}
+
+static inline int should_grow(struct hash_table *t)
+{
+	return hash_count(t) > t->nr_buckets * HASH_LOAD_FACTOR &&
+		t->nr_buckets < HASH_MAX_BUCKETS;
+}
+
+/*
+ * Grow the table incrementally: each insertion migrates a few
+ * buckets from the old array, so that no caller ever pays for
+ * rehashing the whole table. Bucket arrays are obtained and released
+ * with no lock held, from the allocator of the hash operations.
+ */
+static void maybe_resize(struct hash_table *t,
+			 const struct hash_operations *hops)
+{
+	struct hash_bucket *buckets = NULL, *old = NULL;
+	unsigned int nr = 0, n;
+
+	if (t->old_nr_buckets == 0) {
+		if (!should_grow(t))
+			return;
+		nr = t->nr_buckets * 2;
+		buckets = alloc_buckets(hops, nr * sizeof(*buckets));
+		if (buckets == NULL)
+			return;	/* Keep going with longer chains. */
+		for (n = 0; n < nr; n++)
+			list_init(&buckets[n].obj_list);
+	}
+
+	/* Someone else is resizing or walking, let it be. */
+	if (write_trylock_nocancel(&t->lock))
+		goto out;
+
+	if (t->old_nr_buckets)
+		old = migrate_buckets(t);
+	else if (buckets && t->nr_buckets * 2 == nr && should_grow(t)) {
+		start_resize(t, buckets, nr);
+		buckets = NULL;
+	}
+
+	write_unlock(&t->lock);
+
+	/*
+	 * All objects moved to the new array, make sure no reader
+	 * is still scanning the old one before releasing it.
+	 */
+	if (old) {
+		for (n = 0; n < HASH_STRIPES; n++)
+			stripe_drain(&t->stripes[n]);
+		if (old != t->table)
+			free_buckets(hops, old);
+	}
+out:
+	if (buckets)
+		free_buckets(hops, buckets);
+}
+
+static inline int match_obj(struct hashobj *obj,
+			    const void *key, size_t len, unsigned int hash,
+			    const struct hash_operations *hops)
+{
+	return obj->hash == hash && obj->len == len &&
+		hops->compare(__mptr(obj->key), key, len) == 0;
+}
+
+/* Called with the stripe lock held. */
+static struct hashobj *find_obj(struct hash_table *t,
+				const void *key, size_t len, unsigned int hash,
+				const struct hash_operations *hops)
+{
+	struct hash_bucket *bucket;
+	struct hashobj *obj;
+
+	bucket = get_bucket(t, hash);
+	if (!list_empty(&bucket->obj_list)) {
+		list_for_each_entry(obj, &bucket->obj_list, link) {
+			if (match_obj(obj, key, len, hash, hops))
+				return obj;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Lockless lookup, validated against concurrent updates by the stripe
+ * sequence count. Writers wait for lockless readers to leave the
+ * stripe before releasing any memory the latter might be scanning.
+ * Returns -EAGAIN if the caller should look up under lock instead,
+ * including when all reader slots of the stripe are busy.
+ */
+static int find_obj_nolock(struct hash_table *t,
+			   const void *key, size_t len, unsigned int hash,
+			   const struct hash_operations *hops,
+			   struct hashobj **objp)
+{
+	struct hash_stripe *s = get_stripe(t, hash);
+	struct hash_bucket *bucket;
+	struct holder *pos, *head;
+	struct hash_reader *r;
+	struct hashobj *obj;
+	unsigned int seq;
+	int ret = -EAGAIN, n;
+
+	r = enter_reader(s);
+	if (r == NULL)
+		return -EAGAIN;
+
+	for (n = 0; n < HASH_READ_RETRIES; n++) {
+		seq = s->seq;
+		if (seq & 1)
+			break;	/* Don't spin on a preempted writer. */
+		smp_rmb();
+		bucket = get_bucket(t, hash);
+		head = &bucket->obj_list.head;
+		obj = NULL;
+		for (pos = __mptr(head->next); pos != head;
+		     pos = __mptr(pos->next)) {
+			smp_rmb();
+			if (s->seq != seq)
+				goto retry;
+			obj = container_of(pos, struct hashobj, link);
+			if (match_obj(obj, key, len, hash, hops))
+				break;
+			obj = NULL;
+		}
+		smp_rmb();
+		if (s->seq == seq) {
+			*objp = obj;
+			ret = 0;
+			break;
+		}
+	retry:
+		;
+	}
+
+	leave_reader(r);
+
+	return ret;
 }
 
 int __hash_enter(struct hash_table *t,
@@ -125,7 +510,7 @@ int __hash_enter(struct hash_table *t,
 		 int nodup)
 {
 	struct hash_bucket *bucket;
-	struct hashobj *obj;
+	struct hash_stripe *s;
 	int ret;
 
 	holder_init(&newobj->link);
@@ -133,25 +518,26 @@ int __hash_enter(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
-	write_lock_nocancel(&t->lock);
+	newobj->hash = __hash_key(key, len, 0);
+	s = get_stripe(t, newobj->hash);
+	write_lock_nocancel(&s->lock);
 
-	if (nodup && !list_empty(&bucket->obj_list)) {
-		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
-				continue;
-			if (hops->compare(__mptr(obj->key), __mptr(newobj->key),
-					  obj->len) == 0) {
-				drop_key(newobj, hops);
-				ret = -EEXIST;
-				goto out;
-			}
-		}
+	if (nodup && find_obj(t, key, len, newobj->hash, hops)) {
+		drop_key(newobj, hops);
+		ret = -EEXIST;
+		goto out;
 	}
 
+	bucket = get_bucket(t, newobj->hash);
+	stripe_write_begin(s);
 	list_append(&newobj->link, &bucket->obj_list);
+	s->count++;
+	stripe_write_end(s);
 out:
-	write_unlock(&t->lock);
+	write_unlock(&s->lock);
+
+	if (ret == 0)
+		maybe_resize(t, hops);
 
 	return ret;
 }
@@ -160,25 +546,34 @@ int hash_remove(struct hash_table *t, struct hashobj *delobj,
 		const struct hash_operations *hops)
 {
 	struct hash_bucket *bucket;
+	struct hash_stripe *s;
 	struct hashobj *obj;
 	int ret = -ESRCH;
 
-	bucket = do_hash(t, __mptr(delobj->key), delobj->len);
+	s = get_stripe(t, delobj->hash);
 
-	write_lock_nocancel(&t->lock);
+	write_lock_nocancel(&s->lock);
 
+	bucket = get_bucket(t, delobj->hash);
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
 			if (obj == delobj) {
+				stripe_write_begin(s);
 				list_remove_init(&obj->link);
-				drop_key(obj, hops);
+				s->count--;
+				stripe_write_end(s);
 				ret = 0;
-				goto out;
+				break;
 			}
 		}
 	}
-out:
-	write_unlock(&t->lock);
+
+	write_unlock(&s->lock);
+
+	if (ret == 0) {
+		stripe_drain(s);
+		drop_key(delobj, hops);
+	}
 
 	return __bt(ret);
 }
@@ -186,52 +581,75 @@ out:
 struct hashobj *hash_search(struct hash_table *t, const void *key,
 			    size_t len, const struct hash_operations *hops)
 {
-	struct hash_bucket *bucket;
+	unsigned int hash = __hash_key(key, len, 0);
+	struct hash_stripe *s;
 	struct hashobj *obj;
 
-	bucket = do_hash(t, key, len);
+	if (find_obj_nolock(t, key, len, hash, hops, &obj) == 0)
+		return obj;
 
-	read_lock_nocancel(&t->lock);
+	s = get_stripe(t, hash);
+	read_lock_nocancel(&s->lock);
+	obj = find_obj(t, key, len, hash, hops);
+	read_unlock(&s->lock);
 
-	if (!list_empty(&bucket->obj_list)) {
-		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != len)
-				continue;
-			if (hops->compare(__mptr(obj->key), key, len) == 0)
-				goto out;
-		}
+	return obj;
+}
+
+static int walk_bucket(struct hash_table *t, struct hash_bucket *buckets,
+		       unsigned int n, hash_walk_op walk, void *arg)
+{
+	struct hash_stripe *s = get_stripe(t, n);
+	struct hash_bucket *bucket = &buckets[n];
+	struct hashobj *obj, *tmp;
+	int ret;
+
+	read_lock_nocancel(&s->lock);
+
+	if (list_empty(&bucket->obj_list))
+		goto out;
+
+	list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
+		read_unlock(&s->lock);
+		ret = walk(t, obj, arg);
+		if (ret)
+			return ret;
+		read_lock_nocancel(&s->lock);
 	}
-	obj = NULL;
 out:
-	read_unlock(&t->lock);
+	read_unlock(&s->lock);
 
-	return obj;
+	return 0;
 }
 
 int hash_walk(struct hash_table *t, hash_walk_op walk, void *arg)
 {
-	struct hash_bucket *bucket;
-	struct hashobj *obj, *tmp;
-	int ret, n;
+	struct hash_bucket *buckets;
+	unsigned int n;
+	int ret = 0;
 
+	/* Holding t->lock prevents the table from being resized. */
 	read_lock_nocancel(&t->lock);
 
-	for (n = 0; n < HASHSLOTS; n++) {
-		bucket = &t->table[n];
-		if (list_empty(&bucket->obj_list))
-			continue;
-		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			read_unlock(&t->lock);
-			ret = walk(t, obj, arg);
+	if (t->old_nr_buckets) {
+		buckets = __mptr(t->old_buckets);
+		for (n = t->migrate_pos; n < t->old_nr_buckets; n++) {
+			ret = walk_bucket(t, buckets, n, walk, arg);
 			if (ret)
-				return __bt(ret);
-			read_lock_nocancel(&t->lock);
+				goto out;
 		}
 	}
 
+	buckets = __mptr(t->buckets);
+	for (n = 0; n < t->nr_buckets; n++) {
+		ret = walk_bucket(t, buckets, n, walk, arg);
+		if (ret)
+			break;
+	}
+out:
 	read_unlock(&t->lock);
 
-	return 0;
+	return __bt(ret);
 }
 
 #ifdef CONFIG_XENO_PSHARED
@@ -268,6 +686,34 @@ static inline void drop_key(struct hashobj *obj,
 		hops->free((void *)key);
 }
 
+static inline void *alloc_buckets(const struct hash_operations *hops,
+				  size_t size)
+{
+	return hops->alloc(size);
+}
+
+static inline void free_buckets(const struct hash_operations *hops,
+				void *p)
+{
+	hops->free(p);
+}
+
+/*
+ * Unlink a stale object found in @s, whose lock is held by the
+ * caller. Lockless readers never wait for the stripe lock, so we may
+ * drain them with the lock held.
+ */
+static void drop_stale_obj(struct hash_stripe *s, struct hashobj *obj,
+			   const struct hash_operations *hops)
+{
+	stripe_write_begin(s);
+	list_remove_init(&obj->link);
+	s->count--;
+	stripe_write_end(s);
+	stripe_drain(s);
+	drop_key(obj, hops);
+}
+
 int __hash_enter_probe(struct hash_table *t,
 		       const void *key, size_t len,
 		       struct hashobj *newobj,
@@ -276,6 +722,7 @@ int __hash_enter_probe(struct hash_table *t,
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
+	struct hash_stripe *s;
 	int ret;
 
 	holder_init(&newobj->link);
@@ -283,34 +730,38 @@ int __hash_enter_probe(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
-	push_cleanup_lock(&t->lock);
-	write_lock(&t->lock);
+	newobj->hash = __hash_key(key, len, 0);
+	s = get_stripe(t, newobj->hash);
+	push_cleanup_lock(&s->lock);
+	write_lock(&s->lock);
 
+	bucket = get_bucket(t, newobj->hash);
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (!match_obj(obj, key, len, newobj->hash, hops))
 				continue;
-			if (hops->compare(__mptr(obj->key),
-					  __mptr(newobj->key), obj->len) == 0) {
-				if (hops->probe(obj)) {
-					if (nodup) {
-						drop_key(newobj, hops);
-						ret = -EEXIST;
-						goto out;
-					}
-					continue;
+			if (hops->probe(obj)) {
+				if (nodup) {
+					drop_key(newobj, hops);
+					ret = -EEXIST;
+					goto out;
 				}
-				list_remove_init(&obj->link);
-				drop_key(obj, hops);
+				continue;
 			}
+			drop_stale_obj(s, obj, hops);
 		}
 	}
 
+	stripe_write_begin(s);
 	list_append(&newobj->link, &bucket->obj_list);
+	s->count++;
+	stripe_write_end(s);
 out:
-	write_unlock(&t->lock);
-	pop_cleanup_lock(&t->lock);
+	write_unlock(&s->lock);
+	pop_cleanup_lock(&s->lock);
+
+	if (ret == 0)
+		maybe_resize(t, hops);
 
 	return ret;
 }
@@ -319,32 +770,40 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 				  const void *key, size_t len,
 				  const struct hash_operations *hops)
 {
+	unsigned int hash = __hash_key(key, len, 0);
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
-
-	bucket = do_hash(t, key, len);
-
-	push_cleanup_lock(&t->lock);
-	write_lock(&t->lock);
-
+	struct hash_stripe *s;
+
+	/*
+	 * Fast path: the first match is alive, which is the common
+	 * case. Otherwise, go for the locked path which cleans up
+	 * the dead instances.
+	 */
+	if (find_obj_nolock(t, key, len, hash, hops, &obj) == 0 &&
+	    (obj == NULL || hops->probe(obj)))
+		return obj;
+
+	s = get_stripe(t, hash);
+	push_cleanup_lock(&s->lock);
+	write_lock(&s->lock);
+
+	bucket = get_bucket(t, hash);
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (!match_obj(obj, key, len, hash, hops))
+				continue;
+			if (!hops->probe(obj)) {
+				drop_stale_obj(s, obj, hops);
 				continue;
-			if (hops->compare(__mptr(obj->key), key, len) == 0) {
-				if (!hops->probe(obj)) {
-					list_remove_init(&obj->link);
-					drop_key(obj, hops);
-					continue;
-				}
-				goto out;
 			}
+			goto out;
 		}
 	}
 	obj = NULL;
 out:
-	write_unlock(&t->lock);
-	pop_cleanup_lock(&t->lock);
+	write_unlock(&s->lock);
+	pop_cleanup_lock(&s->lock);
 
 	return obj;
 }
@@ -501,4 +960,19 @@ static inline void drop_key(struct hashobj *obj,
 			    const struct hash_operations *hops)
 { }
 
+static inline void *alloc_buckets(const struct hash_operations *hops,
+				  size_t size)
+{
+	return hops->alloc ? hops->alloc(size) : malloc(size);
+}
+
+static inline void free_buckets(const struct hash_operations *hops,
+				void *p)
+{
+	if (hops->free)
+		hops->free(p);
+	else
+		free(p);
+}
+
 #endif /* !CONFIG_XENO_PSHARED */
@@ -656,6 +656,44 @@ void tlsf_free(void *ptr)
 
 }
 
+/******************************************************************/
+int tlsf_malloc_batch(size_t size, void **blocks, int nr)
+{
+/******************************************************************/
+    int n;
+
+    if (!mp) {
+	return 0;
+    }
+
+    TLSF_ACQUIRE_LOCK(&((tlsf_t *)mp)->lock);
+
+    for (n = 0; n < nr; n++) {
+	blocks[n] = malloc_ex(size, mp);
+	if (!blocks[n])
+	    break;
+    }
+
+    TLSF_RELEASE_LOCK(&((tlsf_t *)mp)->lock);
+
+    return n;
+}
+
+/******************************************************************/
+void tlsf_free_batch(void **blocks, int nr)
+{
+/******************************************************************/
+    int n;
+
+    TLSF_ACQUIRE_LOCK(&((tlsf_t *)mp)->lock);
+
+    for (n = 0; n < nr; n++)
+	free_ex(blocks[n], mp);
+
+    TLSF_RELEASE_LOCK(&((tlsf_t *)mp)->lock);
+
+}
+
 /******************************************************************/
 void *tlsf_realloc(void *ptr, size_t size)
 {
@@ -35,6 +35,8 @@ extern void *tlsf_malloc(size_t size);
 extern void tlsf_free(void *ptr);
 extern void *tlsf_realloc(void *ptr, size_t size);
 extern void *tlsf_calloc(size_t nelem, size_t elem_size);
+extern int tlsf_malloc_batch(size_t size, void **blocks, int nr);
+extern void tlsf_free_batch(void **blocks, int nr);
 size_t malloc_usable_size_ex(void *ptr, void *pool);
 
 #endif
@@ -73,6 +73,11 @@ static const struct option cobalt_options[] = {
 		.name = "print-sync-delay",
 		.has_arg = required_argument,
 	},
+	{
+#define print_binary_opt	4
+		.name = "print-binary",
+		.has_arg = no_argument,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -132,6 +137,7 @@ static void cobalt_fork_handler(void)
 	cobalt_unmap_umm();
 	cobalt_clear_tsd();
 	cobalt_print_init_atfork();
+	cobalt_mq_init_atfork();
 	if (cobalt_init())
 		exit(EXIT_FAILURE);
 }
@@ -278,6 +284,9 @@ static int cobalt_parse_option(int optnum, const char *optarg)
 			return ret;
 		__cobalt_print_syncdelay = value;
 		break;
+	case print_binary_opt:
+		__cobalt_print_binary = 1;
+		break;
 	default:
 		/* Paranoid, can't happen. */
 		return -EINVAL;
@@ -292,6 +301,7 @@ static void cobalt_help(void)
         fprintf(stderr, "--print-buffer-size=<bytes>	size of a print relay buffer (16k)\n");
         fprintf(stderr, "--print-buffer-count=<num>	number of print relay buffers (4)\n");
         fprintf(stderr, "--print-buffer-syncdelay=<ms>	max delay of output synchronization (100 ms)\n");
+        fprintf(stderr, "--print-binary			defer formatting of rt_printf() output to the printer thread\n");
 }
 
 static struct setup_descriptor cobalt_interface = {
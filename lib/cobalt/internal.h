@@ -51,6 +51,10 @@ void cobalt_print_init(void);
 
 void cobalt_print_init_atfork(void);
 
+void cobalt_mq_init_atfork(void);
+
+void cobalt_mq_fastunbind(int q);
+
 void cobalt_ticks_init(unsigned long long freq);
 
 void cobalt_mutex_init(void);
@@ -68,4 +72,6 @@ void cobalt_check_features(struct cobalt_featinfo *finfo);
 
 extern struct sigaction __cobalt_orig_sigdebug;
 
+extern int __cobalt_control_bind;
+
 #endif /* _LIB_COBALT_INTERNAL_H */
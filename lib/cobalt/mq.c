@@ -21,9 +21,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <string.h>
 #include <mqueue.h>
 #include <asm/xenomai/syscall.h>
 #include "internal.h"
+#include <cobalt/uapi/mq.h>
 
 /**
  * @ingroup cobalt_api
@@ -36,9 +38,184 @@
  * maximum number of messages are fixed when it is created with
  * mq_open().
  *
+ * When room permits, the message pool of a queue is laid out in the
+ * private memory heap of the creating process. Threads from that
+ * process may then send and receive messages at the default priority
+ * (i.e. zero) without issuing any system call, unless they have to
+ * wait for room or data, or wake up a waiter.
+ *
  *@{
  */
 
+#define MQ_FASTMAP_SIZE  1024
+
+/*
+ * Fast path state of the queues this process created, indexed by
+ * descriptor.
+ */
+static struct mq_fastmap {
+	struct cobalt_mq_state *state;
+	int accmode;
+} mq_fastmap[MQ_FASTMAP_SIZE];
+
+static void mq_fastbind(mqd_t q, int oflags)
+{
+	struct mq_fastmap *e;
+	__u32 offset;
+	int ret;
+
+	if ((unsigned int)q >= MQ_FASTMAP_SIZE)
+		return;
+
+	e = mq_fastmap + q;
+	ret = XENOMAI_SYSCALL2(sc_cobalt_mq_bind, q, &offset);
+	if (ret) {
+		e->state = NULL;
+		return;
+	}
+
+	e->accmode = oflags & O_ACCMODE;
+	smp_wmb();
+	e->state = cobalt_umm_private + offset;
+}
+
+/*
+ * The pool may be freed as soon as the descriptor is closed, which
+ * close() may do as well as mq_close().
+ */
+void cobalt_mq_fastunbind(int q)
+{
+	if ((unsigned int)q < MQ_FASTMAP_SIZE)
+		mq_fastmap[q].state = NULL;
+}
+
+void cobalt_mq_init_atfork(void)
+{
+	memset(mq_fastmap, 0, sizeof(mq_fastmap));
+}
+
+static inline
+struct cobalt_mq_state *mq_get_state(mqd_t q, int denied_accmode)
+{
+	struct mq_fastmap *e;
+
+	if ((unsigned int)q >= MQ_FASTMAP_SIZE)
+		return NULL;
+
+	e = mq_fastmap + q;
+	if (e->state == NULL || e->accmode == denied_accmode)
+		return NULL;
+
+	return e->state;
+}
+
+static inline struct cobalt_mq_cell *
+mq_get_cells(struct cobalt_mq_state *state, struct cobalt_mq_ring *ring)
+{
+	return (void *)state + ring->cells_offset;
+}
+
+static inline struct cobalt_mq_msg *
+mq_get_msg(struct cobalt_mq_state *state, __u32 index)
+{
+	return (void *)state + state->data_offset + index * state->msgsize;
+}
+
+static inline void mq_kick(mqd_t q, atomic_t *waiters,
+			   struct cobalt_mq_state *state)
+{
+	smp_mb();
+	if (atomic_read(waiters) || state->flags)
+		XENOMAI_SYSCALL3(sc_cobalt_mq_wake, q, COBALT_MQ_WAKE, 0);
+}
+
+/*
+ * Both fast paths return -EAGAIN whenever the request has to be
+ * handled by the kernel, including to report errors. Once they
+ * hold a slot, they never spin on a ring which looks full, but
+ * hand the slot over to the kernel instead (see cobalt/uapi/mq.h).
+ */
+static int mq_fastsend(mqd_t q, const char *buffer, size_t len, unsigned prio)
+{
+	struct cobalt_mq_state *state;
+	struct cobalt_mq_msg *msg;
+	__u32 index;
+
+	/*
+	 * Default priority messages the kernel had to keep on its
+	 * own list must be received before ours.
+	 */
+	state = mq_get_state(q, O_RDONLY);
+	if (state == NULL || prio > 0 || len > state->maxlen ||
+	    (state->flags & COBALT_MQ_SPILL))
+		return -EAGAIN;
+
+	if (cobalt_mq_ring_pop(&state->avail,
+			       mq_get_cells(state, &state->avail),
+			       state->mask, &index))
+		return -EAGAIN;
+
+	msg = mq_get_msg(state, index);
+	memcpy(msg->data, buffer, len);
+	msg->len = len;
+	atomic_add_fetch(&state->nrqueued, 1);
+
+	if (cobalt_mq_ring_push(&state->queued,
+				mq_get_cells(state, &state->queued),
+				state->mask, index)) {
+		atomic_sub_fetch(&state->nrqueued, 1);
+		return XENOMAI_SYSCALL3(sc_cobalt_mq_wake, q,
+					COBALT_MQ_SEND, index);
+	}
+
+	mq_kick(q, &state->rcv_waiters, state);
+
+	return 0;
+}
+
+static ssize_t mq_fastreceive(mqd_t q, char *buffer, size_t len,
+			      unsigned *prio)
+{
+	struct cobalt_mq_state *state;
+	struct cobalt_mq_msg *msg;
+	__u32 index;
+	size_t rlen;
+
+	/*
+	 * Messages with non-zero priority are held by the kernel, and
+	 * must be received first.
+	 */
+	state = mq_get_state(q, O_WRONLY);
+	if (state == NULL || len < state->maxlen ||
+	    atomic_read(&state->nrprio))
+		return -EAGAIN;
+
+	if (cobalt_mq_ring_pop(&state->queued,
+			       mq_get_cells(state, &state->queued),
+			       state->mask, &index))
+		return -EAGAIN;
+
+	atomic_sub_fetch(&state->nrqueued, 1);
+	msg = mq_get_msg(state, index);
+	rlen = msg->len;
+	if (rlen > state->maxlen)
+		rlen = state->maxlen;
+	memcpy(buffer, msg->data, rlen);
+
+	/* The message was received, only the slot may leak. */
+	if (cobalt_mq_ring_push(&state->avail,
+				mq_get_cells(state, &state->avail),
+				state->mask, index))
+		XENOMAI_SYSCALL3(sc_cobalt_mq_wake, q, COBALT_MQ_FREE, index);
+	else
+		mq_kick(q, &state->snd_waiters, state);
+
+	if (prio)
+		*prio = 0;
+
+	return rlen;
+}
+
 /**
  * @brief Open a message queue
  *
@@ -120,6 +297,8 @@ COBALT_IMPL(mqd_t, mq_open, (const char *name, int oflags, ...))
 		return (mqd_t)-1;
 	}
 
+	mq_fastbind(fd, oflags);
+
 	return (mqd_t)fd;
 }
 
@@ -147,6 +326,8 @@ COBALT_IMPL(int, mq_close, (mqd_t mqd))
 {
 	int err;
 
+	cobalt_mq_fastunbind(mqd);
+
 	err = XENOMAI_SYSCALL1(sc_cobalt_mq_close, mqd);
 	if (err) {
 		errno = -err;
@@ -329,13 +510,17 @@ COBALT_IMPL(int, mq_send, (mqd_t q, const char *buffer, size_t len, unsigned pri
 {
 	int err, oldtype;
 
+	err = mq_fastsend(q, buffer, len, prio);
+	if (err != -EAGAIN)
+		goto out;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
 			       q, buffer, len, prio, NULL);
 
 	pthread_setcanceltype(oldtype, NULL);
-
+out:
 	if (!err)
 		return 0;
 
@@ -389,13 +574,17 @@ COBALT_IMPL(int, mq_timedsend, (mqd_t q,
 	if (timeout == NULL)
 		return -EFAULT;
 
+	err = mq_fastsend(q, buffer, len, prio);
+	if (err != -EAGAIN)
+		goto out;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
 			       q, buffer, len, prio, timeout);
 
 	pthread_setcanceltype(oldtype, NULL);
-
+out:
 	if (!err)
 		return 0;
 
@@ -445,9 +634,14 @@ COBALT_IMPL(int, mq_timedsend, (mqd_t q,
  */
 COBALT_IMPL(ssize_t, mq_receive, (mqd_t q, char *buffer, size_t len, unsigned *prio))
 {
-	ssize_t rlen = (ssize_t) len;
+	ssize_t rlen;
 	int err, oldtype;
 
+	rlen = mq_fastreceive(q, buffer, len, prio);
+	if (rlen >= 0)
+		return rlen;
+
+	rlen = (ssize_t) len;
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
@@ -507,12 +701,17 @@ COBALT_IMPL(ssize_t, mq_timedreceive, (mqd_t q,
 				       unsigned *__restrict__ prio,
 				       const struct timespec * __restrict__ timeout))
 {
-	ssize_t rlen = (ssize_t) len;
+	ssize_t rlen;
 	int err, oldtype;
 
 	if (timeout == NULL)
 		return -EFAULT;
 
+	rlen = mq_fastreceive(q, buffer, len, prio);
+	if (rlen >= 0)
+		return rlen;
+
+	rlen = (ssize_t) len;
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
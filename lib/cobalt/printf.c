@@ -16,16 +16,21 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <poll.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <sys/eventfd.h>
 #include <boilerplate/atomic.h>
 #include <boilerplate/compiler.h>
 #include <cobalt/tunables.h>
@@ -38,19 +43,67 @@
 
 #define RT_PRINT_LINE_BREAK		256
 
+/* Fill level (percent) beyond which the printer thread is kicked. */
+#define RT_PRINT_WATERMARK		50
+
 #define RT_PRINT_SYSLOG_STREAM		NULL
 
 #define RT_PRINT_MODE_FORMAT		0
 #define RT_PRINT_MODE_FWRITE		1
+#define RT_PRINT_MODE_BINARY		2
+
+/* Longest conversion specification binary mode may defer. */
+#define RT_PRINT_SPEC_MAX		32
+/*
+ * Size of the output line rendered from a binary entry. Calls which
+ * might produce longer output are formatted in place instead.
+ */
+#define RT_PRINT_RENDER_SIZE		1024
 
 struct entry_head {
 	FILE *dest;
 	uint32_t seq_no;
 	int priority;
 	size_t len;
+	/*
+	 * Non-zero for binary entries, data[] then starts with a copy
+	 * of the format string, null byte included, followed by the
+	 * packed arguments to be formatted by the printer thread.
+	 */
+	size_t fmt_len;
 	char data[0];
 } __attribute__((packed));
 
+enum print_arg_type {
+	PA_NONE,
+	PA_INT,
+	PA_LONG,
+	PA_LLONG,
+	PA_SIZE,
+	PA_PTRDIFF,
+	PA_INTMAX,
+	PA_DOUBLE,
+	PA_LDOUBLE,
+	PA_POINTER,
+	PA_STRING,
+};
+
+struct print_spec {
+	/* Length of the specification, leading '%' included. */
+	int len;
+	enum print_arg_type type;
+	int star_width;
+	int star_prec;
+	/* Literal width, 0 if unspecified. */
+	int width;
+	/* Literal precision, -1 if unspecified. */
+	int prec;
+	/* Conversion character. */
+	int conv;
+	/* Digits may be grouped or localized. */
+	int grouped;
+};
+
 struct print_buffer {
 	off_t write_pos;
 
@@ -61,6 +114,10 @@ struct print_buffer {
 
 	char name[32];
 
+	/* Entries truncated, and entries lost for lack of space. */
+	unsigned long overflows;
+	unsigned long drops;
+
 	/*
 	 * Keep read_pos separated from write_pos to optimise write
 	 * caching on SMP.
@@ -68,12 +125,19 @@ struct print_buffer {
 	off_t read_pos;
 };
 
+struct print_heap_node {
+	uint32_t seq_no;
+	struct print_buffer *buffer;
+};
+
 int __cobalt_print_bufsz = RT_PRINT_DEFAULT_BUFFER;
 
 int __cobalt_print_bufcount = RT_PRINT_DEFAULT_BUFFERS_COUNT;
 
 int __cobalt_print_syncdelay = RT_PRINT_DEFAULT_SYNCDELAY;
 
+int __cobalt_print_binary;
+
 static struct print_buffer *first_buffer;
 static int buffers;
 static uint32_t seq_no;
@@ -87,10 +151,462 @@ static atomic_long_t *pool_bitmap;
 static unsigned pool_bitmap_len;
 static unsigned pool_buf_size;
 static unsigned long pool_start, pool_len;
+static struct print_heap_node *print_heap;
+static int print_heap_size;
+static int printer_efd = -1;
+static atomic_t printer_kicked;
+static sem_t printer_kick_sem;
+static int printer_relay_ready;
 
 static void release_buffer(struct print_buffer *buffer);
 static void print_buffers(void);
 
+/* *** Binary entries *** */
+
+/*
+ * Parse the conversion specification @p points at, leading '%'
+ * included. Returns -1 for conversions we can't defer to the printer
+ * thread: positional arguments, %n and %m which depend on the
+ * caller's context, and wide characters.
+ */
+static int parse_spec(const char *p, struct print_spec *spec)
+{
+	const char *s = p + 1;
+	int lmod = 0;
+
+	spec->star_width = 0;
+	spec->star_prec = 0;
+	spec->width = 0;
+	spec->prec = -1;
+	spec->grouped = 0;
+
+	while (*s && strchr("-+ #0'I", *s)) {
+		if (*s == '\'' || *s == 'I')
+			spec->grouped = 1;
+		s++;
+	}
+
+	if (*s == '*') {
+		spec->star_width = 1;
+		s++;
+	}
+	while (isdigit(*s)) {
+		if (spec->width < RT_PRINT_RENDER_SIZE)
+			spec->width = spec->width * 10 + *s - '0';
+		s++;
+	}
+	if (*s == '$')
+		return -1;
+
+	if (*s == '.') {
+		s++;
+		if (*s == '*') {
+			spec->star_prec = 1;
+			s++;
+		} else {
+			spec->prec = 0;
+			while (isdigit(*s)) {
+				if (spec->prec < RT_PRINT_RENDER_SIZE)
+					spec->prec = spec->prec * 10 + *s - '0';
+				s++;
+			}
+		}
+	}
+
+	switch (*s) {
+	case 'h':
+		lmod = 'h';
+		if (*++s == 'h')
+			s++;
+		break;
+	case 'l':
+		lmod = 'l';
+		if (*++s == 'l') {
+			lmod = 'q';
+			s++;
+		}
+		break;
+	case 'q':
+	case 'L':
+	case 'j':
+	case 't':
+		lmod = *s++;
+		break;
+	case 'z':
+	case 'Z':
+		lmod = 'z';
+		s++;
+		break;
+	}
+
+	switch (*s) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		switch (lmod) {
+		case 'l':
+			spec->type = PA_LONG;
+			break;
+		case 'q':
+		case 'L':
+			spec->type = PA_LLONG;
+			break;
+		case 'j':
+			spec->type = PA_INTMAX;
+			break;
+		case 'z':
+			spec->type = PA_SIZE;
+			break;
+		case 't':
+			spec->type = PA_PTRDIFF;
+			break;
+		default:
+			spec->type = PA_INT;
+		}
+		break;
+	case 'c':
+		if (lmod == 'l')
+			return -1;
+		spec->type = PA_INT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->type = lmod == 'L' ? PA_LDOUBLE : PA_DOUBLE;
+		break;
+	case 's':
+		if (lmod == 'l')
+			return -1;
+		spec->type = PA_STRING;
+		break;
+	case 'p':
+		spec->type = PA_POINTER;
+		break;
+	case '%':
+		if (s != p + 1)
+			return -1;
+		spec->type = PA_NONE;
+		break;
+	default:
+		return -1;
+	}
+
+	spec->conv = *s;
+	spec->len = s + 1 - p;
+
+	return spec->len < RT_PRINT_SPEC_MAX ? 0 : -1;
+}
+
+/*
+ * Upper bound of the output of a numeric conversion, width aside.
+ * Fixed-point conversions of large floating-point values are not
+ * worth bounding precisely, @small tells whether the integral part
+ * has at most 15 digits.
+ */
+static int spec_bound(const struct print_spec *spec, int small)
+{
+	int prec = spec->prec, bound;
+
+	switch (spec->type) {
+	case PA_DOUBLE:
+	case PA_LDOUBLE:
+		if (prec < 0)
+			prec = 6;
+		if (spec->conv == 'f' || spec->conv == 'F')
+			bound = (small ? 16 : RT_PRINT_RENDER_SIZE) + prec + 2;
+		else
+			bound = prec + 40;
+		break;
+	case PA_POINTER:
+		return 24;
+	default:
+		if (spec->conv == 'c')
+			return 1;
+		bound = (prec < 0 ? 0 : prec) + 24;
+	}
+
+	/* Room for separators, or multibyte digits. */
+	return spec->grouped ? bound * 4 : bound;
+}
+
+#define pack_arg(__type)						\
+	do {								\
+		__type __v = va_arg(args, __type);			\
+		if (pos + (int)sizeof(__v) > room)			\
+			return -1;					\
+		memcpy(data + pos, &__v, sizeof(__v));			\
+		pos += sizeof(__v);					\
+	} while (0)
+
+/*
+ * Store the arguments referred to by @format into @data, strings
+ * being copied inline. Returns the number of bytes used, or -1 if
+ * the format cannot be deferred, might produce more output than
+ * render_args() may hold, or @room is too short.
+ */
+static int pack_args(char *data, int room, const char *format, va_list args)
+{
+	const char *p, *str, *text = format;
+	int pos = 0, olen = 0, n, bound;
+	struct print_spec spec;
+	long double ld;
+	double d;
+
+	for (p = strchr(format, '%'); p; p = strchr(p + spec.len, '%')) {
+		if (parse_spec(p, &spec))
+			return -1;
+
+		if (spec.star_width) {
+			pack_arg(int);
+			memcpy(&n, data + pos - sizeof(n), sizeof(n));
+			if (n <= -RT_PRINT_RENDER_SIZE ||
+			    n >= RT_PRINT_RENDER_SIZE)
+				return -1;
+			spec.width = n < 0 ? -n : n;
+		}
+		if (spec.star_prec) {
+			pack_arg(int);
+			memcpy(&n, data + pos - sizeof(n), sizeof(n));
+			spec.prec = n < 0 ? -1 : n;
+			if (spec.prec >= RT_PRINT_RENDER_SIZE &&
+			    spec.type != PA_STRING)
+				return -1;
+		}
+
+		bound = -1;
+
+		switch (spec.type) {
+		case PA_NONE:
+			bound = 1;
+			break;
+		case PA_INT:
+			pack_arg(int);
+			break;
+		case PA_LONG:
+			pack_arg(long);
+			break;
+		case PA_LLONG:
+			pack_arg(long long);
+			break;
+		case PA_SIZE:
+			pack_arg(size_t);
+			break;
+		case PA_PTRDIFF:
+			pack_arg(ptrdiff_t);
+			break;
+		case PA_INTMAX:
+			pack_arg(intmax_t);
+			break;
+		case PA_DOUBLE:
+			pack_arg(double);
+			memcpy(&d, data + pos - sizeof(d), sizeof(d));
+			bound = spec_bound(&spec, d > -1e15 && d < 1e15);
+			break;
+		case PA_LDOUBLE:
+			pack_arg(long double);
+			memcpy(&ld, data + pos - sizeof(ld), sizeof(ld));
+			bound = spec_bound(&spec, ld > -1e15L && ld < 1e15L);
+			break;
+		case PA_POINTER:
+			pack_arg(void *);
+			break;
+		case PA_STRING:
+			str = va_arg(args, const char *);
+			if (str == NULL)
+				str = "(null)";
+			n = spec.prec >= 0 ? strnlen(str, spec.prec) : strlen(str);
+			if (pos + n + 1 > room)
+				return -1;
+			memcpy(data + pos, str, n);
+			data[pos + n] = '\0';
+			pos += n + 1;
+			bound = n;
+			break;
+		}
+
+		if (bound < 0)
+			bound = spec_bound(&spec, 1);
+
+		olen += p - text + (bound > spec.width ? bound : spec.width);
+		if (olen >= RT_PRINT_RENDER_SIZE)
+			return -1;
+		text = p + spec.len;
+	}
+
+	if (olen + strlen(text) >= RT_PRINT_RENDER_SIZE)
+		return -1;
+
+	return pos;
+}
+
+#define render_arg(__type, __val)					\
+	do {								\
+		if (spec.star_width && spec.star_prec)			\
+			n = snprintf(out + pos, size - pos, fmt,	\
+				     width, prec, (__type)(__val));	\
+		else if (spec.star_width)				\
+			n = snprintf(out + pos, size - pos, fmt,	\
+				     width, (__type)(__val));		\
+		else if (spec.star_prec)				\
+			n = snprintf(out + pos, size - pos, fmt,	\
+				     prec, (__type)(__val));		\
+		else							\
+			n = snprintf(out + pos, size - pos, fmt,	\
+				     (__type)(__val));			\
+	} while (0)
+
+#define unpack_arg(__type)						\
+	do {								\
+		__type __v;						\
+		memcpy(&__v, data, sizeof(__v));			\
+		data += sizeof(__v);					\
+		render_arg(__type, __v);				\
+	} while (0)
+
+/*
+ * Format a binary entry into @out, which is always null-terminated.
+ * Returns the length of the output, truncated to @size - 1.
+ */
+static int render_args(char *out, int size, const char *format,
+		       const char *data)
+{
+	int pos = 0, n = 0, width = 0, prec = 0;
+	char fmt[RT_PRINT_SPEC_MAX];
+	struct print_spec spec;
+	const char *p = format;
+
+	while (*p && pos < size - 1) {
+		if (*p != '%') {
+			out[pos++] = *p++;
+			continue;
+		}
+
+		/* The writer validated the format already. */
+		parse_spec(p, &spec);
+		if (spec.type == PA_NONE) {
+			out[pos++] = '%';
+			p += spec.len;
+			continue;
+		}
+
+		memcpy(fmt, p, spec.len);
+		fmt[spec.len] = '\0';
+		p += spec.len;
+
+		if (spec.star_width) {
+			memcpy(&width, data, sizeof(width));
+			data += sizeof(width);
+		}
+		if (spec.star_prec) {
+			memcpy(&prec, data, sizeof(prec));
+			data += sizeof(prec);
+		}
+
+		switch (spec.type) {
+		case PA_NONE:
+			break;
+		case PA_INT:
+			unpack_arg(int);
+			break;
+		case PA_LONG:
+			unpack_arg(long);
+			break;
+		case PA_LLONG:
+			unpack_arg(long long);
+			break;
+		case PA_SIZE:
+			unpack_arg(size_t);
+			break;
+		case PA_PTRDIFF:
+			unpack_arg(ptrdiff_t);
+			break;
+		case PA_INTMAX:
+			unpack_arg(intmax_t);
+			break;
+		case PA_DOUBLE:
+			unpack_arg(double);
+			break;
+		case PA_LDOUBLE:
+			unpack_arg(long double);
+			break;
+		case PA_POINTER:
+			unpack_arg(void *);
+			break;
+		case PA_STRING:
+			render_arg(const char *, data);
+			data += strlen(data) + 1;
+			break;
+		}
+
+		if (n < 0)
+			break;
+		pos += n;
+		if (pos >= size)
+			pos = size - 1;
+	}
+
+	out[pos] = '\0';
+
+	return pos;
+}
+
+/* *** Printer wakeup *** */
+
+/*
+ * The printer thread waits on an eventfd, which only non-RT callers
+ * may signal without switching mode. Threads running in primary mode
+ * post a Cobalt semaphore instead, which a relay thread of the weak
+ * scheduling class turns into an eventfd signal once relaxed.
+ */
+static void kick_printer(void)
+{
+	uint64_t one = 1;
+	ssize_t ret;
+
+	if (atomic_read(&printer_kicked) ||
+	    atomic_cmpxchg(&printer_kicked, 0, 1) != 0)
+		return;
+
+	if (cobalt_get_current() == XN_NO_HANDLE ||
+	    (cobalt_get_current_mode() & XNRELAX)) {
+		ret = write(printer_efd, &one, sizeof(one));
+		(void)ret;
+	} else if (printer_relay_ready)
+		__COBALT(sem_post(&printer_kick_sem));
+}
+
+static void *printer_relay(void *arg)
+{
+	uint64_t one = 1;
+	ssize_t ret;
+
+	for (;;) {
+		if (__COBALT(sem_wait(&printer_kick_sem)))
+			continue;
+		ret = write(printer_efd, &one, sizeof(one));
+		(void)ret;
+	}
+
+	return NULL;
+}
+
+static inline size_t buffer_fill(struct print_buffer *buffer,
+				 off_t write_pos, off_t read_pos)
+{
+	if (write_pos >= read_pos)
+		return write_pos - read_pos;
+
+	return buffer->size - read_pos + write_pos;
+}
+
 /* *** rt_print API *** */
 
 static int 
@@ -98,10 +614,12 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 		 unsigned int mode, size_t sz, const char *format, va_list args)
 {
 	struct print_buffer *buffer = pthread_getspecific(buffer_key);
-	off_t write_pos, read_pos;
+	off_t write_pos, read_pos, start_pos;
 	struct entry_head *head;
-	int len, str_len;
+	int len, room, str_len, truncated = 0;
+	size_t wm, fill, fmt_len = 0;
 	int res = 0;
+	va_list aq;
 
 	if (!buffer) {
 		res = rt_print_init(0, NULL);
@@ -116,6 +634,7 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 	write_pos = buffer->write_pos;
 	read_pos = buffer->read_pos;
 	smp_mb();
+	start_pos = write_pos;
 
 	/* Is our write limit the end of the ring buffer? */
 	if (write_pos >= read_pos) {
@@ -146,9 +665,39 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 	len -= sizeof(struct entry_head);
 	if (len < 0)
 		len = 0;
+	room = len;
 
 	head = buffer->ring + write_pos;
 
+	if (mode == RT_PRINT_MODE_BINARY) {
+		/*
+		 * Fall back to formatting in place if the arguments
+		 * cannot be deferred, or do not fit, either in the
+		 * relay buffer or in the line the printer thread
+		 * renders. Formats without any argument are cheap
+		 * enough to copy as text. The caller may release or
+		 * reuse the format as soon as we return, so it goes
+		 * along with the arguments.
+		 */
+		fmt_len = strlen(format) + 1;
+		res = -1;
+		if (fmt_len < (size_t)len) {
+			va_copy(aq, args);
+			res = pack_args(head->data + fmt_len, len - fmt_len,
+					format, aq);
+			va_end(aq);
+		}
+		if (res > 0) {
+			memcpy(head->data, format, fmt_len);
+			len = fmt_len + res;
+			res = 0;
+		} else {
+			fmt_len = 0;
+			res = 0;
+			mode = RT_PRINT_MODE_FORMAT;
+		}
+	}
+
 	if (mode == RT_PRINT_MODE_FORMAT) {
 		if (stream != RT_PRINT_SYSLOG_STREAM) {
 			/* We do not need the terminating \0 */
@@ -171,6 +720,7 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 			} else {
 				/* Text was truncated */
 				res = len;
+				truncated = 1;
 			}
 		} else {
 			/* We DO need the terminating \0 */
@@ -191,11 +741,17 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 			} else {
 				/* Text was truncated */
 				res = len;
+				truncated = 1;
 			}
 		}
+	} else if (fmt_len) {
+		/* Arguments were packed already. */
 	} else if (len >= 1) {
 		str_len = sz;
-		len = (str_len < len) ? str_len : len;
+		if (str_len > len)
+			truncated = 1;
+		else
+			len = str_len;
 		memcpy(head->data, format, len);
 	} else
 		len = 0;
@@ -206,10 +762,15 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 		head->priority = priority;
 		head->dest = stream;
 		head->len = len;
+		head->fmt_len = fmt_len;
 
 		/* Move forward by text and head length */
 		write_pos += len + sizeof(struct entry_head);
-	}
+
+		if (truncated)
+			buffer->overflows++;
+	} else if (room == 0)
+		buffer->drops++;
 
 	/* Wrap around early if there is more space on the other side */
 	if (write_pos >= buffer->size - RT_PRINT_LINE_BREAK &&
@@ -228,6 +789,13 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 
 	buffer->write_pos = write_pos;
 
+	/* Wake up the printer when crossing the watermark, or if full. */
+	wm = buffer->size * RT_PRINT_WATERMARK / 100;
+	fill = buffer_fill(buffer, write_pos, read_pos);
+	if (room == 0 ||
+	    (fill >= wm && buffer_fill(buffer, start_pos, read_pos) < wm))
+		kick_printer();
+
 	return res;
 }
 
@@ -244,10 +812,16 @@ static int print_to_buffer(FILE *stream, int priority, unsigned int mode,
 	return ret;
 }
 
+static inline unsigned int format_mode(void)
+{
+	return __cobalt_print_binary ?
+		RT_PRINT_MODE_BINARY : RT_PRINT_MODE_FORMAT;
+}
+
 int rt_vfprintf(FILE *stream, const char *format, va_list args)
 {
 	return vprint_to_buffer(stream, 0, 0,
-				RT_PRINT_MODE_FORMAT, 0, format, args);
+				format_mode(), 0, format, args);
 }
 
 #ifdef CONFIG_XENO_FORTIFY
@@ -335,14 +909,14 @@ void rt_syslog(int priority, const char *format, ...)
 
 	va_start(args, format);
 	vprint_to_buffer(RT_PRINT_SYSLOG_STREAM, 0, priority,
-			 RT_PRINT_MODE_FORMAT, 0, format, args);
+			 format_mode(), 0, format, args);
 	va_end(args);
 }
 
 void rt_vsyslog(int priority, const char *format, va_list args)
 {
 	vprint_to_buffer(RT_PRINT_SYSLOG_STREAM, 0, priority,
-			 RT_PRINT_MODE_FORMAT, 0, format, args);
+			 format_mode(), 0, format, args);
 }
 
 #ifdef CONFIG_XENO_FORTIFY
@@ -375,6 +949,8 @@ static void rt_print_init_inner(struct print_buffer *buffer, size_t size)
 
 	buffer->read_pos  = 0;
 	buffer->write_pos = 0;
+	buffer->overflows = 0;
+	buffer->drops = 0;
 
 	buffer->prev = NULL;
 
@@ -478,6 +1054,19 @@ const char *rt_print_buffer_name(void)
 	return buffer->name;
 }
 
+int rt_print_buffer_stats(unsigned long *overflows, unsigned long *drops)
+{
+	struct print_buffer *buffer = pthread_getspecific(buffer_key);
+
+	if (!buffer)
+		return ESRCH;
+
+	*overflows = buffer->overflows;
+	*drops = buffer->drops;
+
+	return 0;
+}
+
 /* *** Deferred Output Management *** */
 void rt_print_flush_buffers(void)
 {
@@ -557,35 +1146,79 @@ static inline uint32_t get_next_seq_no(struct print_buffer *buffer)
 	return head->seq_no;
 }
 
-static struct print_buffer *get_next_buffer(void)
+static inline int heap_before(struct print_heap_node *a,
+			      struct print_heap_node *b)
 {
-	struct print_buffer *pos = first_buffer;
-	struct print_buffer *buffer = NULL;
-	uint32_t next_seq_no = 0; /* silence gcc... */
+	return (int32_t)(a->seq_no - b->seq_no) < 0;
+}
 
-	while (pos) {
-		if (pos->read_pos != pos->write_pos &&
-		    (!buffer || get_next_seq_no(pos) < next_seq_no)) {
-			buffer = pos;
-			next_seq_no = get_next_seq_no(pos);
-		}
-		pos = pos->next;
+static void heap_sift_down(int nr, int pos)
+{
+	struct print_heap_node tmp;
+	int child;
+
+	for (;;) {
+		child = 2 * pos + 1;
+		if (child >= nr)
+			break;
+		if (child + 1 < nr &&
+		    heap_before(&print_heap[child + 1], &print_heap[child]))
+			child++;
+		if (!heap_before(&print_heap[child], &print_heap[pos]))
+			break;
+		tmp = print_heap[pos];
+		print_heap[pos] = print_heap[child];
+		print_heap[child] = tmp;
+		pos = child;
 	}
+}
+
+/*
+ * Collect the non-empty buffers into a min-heap ordered by the
+ * sequence number of their next entry, for merging the output.
+ * Called with buffer_lock held.
+ */
+static int build_heap(void)
+{
+	struct print_buffer *pos;
+	struct print_heap_node *heap;
+	int nr = 0, n;
 
-	return buffer;
+	if (print_heap_size < buffers) {
+		heap = realloc(print_heap, buffers * sizeof(*heap));
+		if (heap == NULL)
+			return 0;
+		print_heap = heap;
+		print_heap_size = buffers;
+	}
+
+	for (pos = first_buffer; pos && nr < print_heap_size; pos = pos->next) {
+		if (pos->read_pos == pos->write_pos)
+			continue;
+		print_heap[nr].buffer = pos;
+		print_heap[nr].seq_no = get_next_seq_no(pos);
+		nr++;
+	}
+
+	for (n = nr / 2 - 1; n >= 0; n--)
+		heap_sift_down(nr, n);
+
+	return nr;
 }
 
 static void print_buffers(void)
 {
+	static char render[RT_PRINT_RENDER_SIZE];
 	struct print_buffer *buffer;
 	struct entry_head *head;
+	const char *data;
 	off_t read_pos;
-	int len, ret;
+	int len, ret, nr;
 
-	while (1) {
-		buffer = get_next_buffer();
-		if (!buffer)
-			break;
+	nr = build_heap();
+
+	while (nr > 0) {
+		buffer = print_heap[0].buffer;
 
 		read_pos = buffer->read_pos;
 		head = buffer->ring + read_pos;
@@ -593,13 +1226,21 @@ static void print_buffers(void)
 
 		if (len) {
 			/* Print out non-empty entry and proceed */
+			if (head->fmt_len) {
+				/* Serialized by buffer_lock. */
+				data = render;
+				ret = render_args(render, sizeof(render),
+						  head->data,
+						  head->data + head->fmt_len);
+			} else {
+				data = head->data;
+				ret = len;
+			}
 			/* Check if output goes to syslog */
 			if (head->dest == RT_PRINT_SYSLOG_STREAM) {
-				syslog(head->priority,
-				       "%s", head->data);
-			} else {
-				ret = fwrite(head->data,
-					     head->len, 1, head->dest);
+				syslog(head->priority, "%s", data);
+			} else if (ret > 0) {
+				ret = fwrite(data, ret, 1, head->dest);
 				(void)ret;
 			}
 
@@ -616,27 +1257,66 @@ static void print_buffers(void)
 
 		/* Enforce the read_pos update before proceeding */
 		smp_wmb();
+
+		if (read_pos != buffer->write_pos)
+			print_heap[0].seq_no = get_next_seq_no(buffer);
+		else {
+			print_heap[0] = print_heap[--nr];
+			if (nr == 0)
+				/* Pick up buffers which were filled meanwhile. */
+				nr = build_heap();
+		}
+		heap_sift_down(nr, 0);
 	}
 }
 
 static void *printer_loop(void *arg)
 {
+	struct pollfd pfd;
+	uint64_t count;
+	ssize_t ret;
+	int timeout;
+
+	timeout = syncdelay.tv_sec * 1000 + syncdelay.tv_nsec / 1000000;
+
 	while (1) {
 		pthread_mutex_lock(&buffer_lock);
 
 		while (buffers == 0)
 			pthread_cond_wait(&printer_wakeup, &buffer_lock);
 
+		/* Allow further kicks as soon as we start draining. */
+		atomic_set(&printer_kicked, 0);
+		smp_mb();
+
 		print_buffers();
 
 		pthread_mutex_unlock(&buffer_lock);
 
-		nanosleep(&syncdelay, NULL);
+		/*
+		 * The sync delay bounds the output latency for
+		 * buffers which never reach the watermark.
+		 */
+		pfd.fd = printer_efd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, timeout) > 0) {
+			ret = read(printer_efd, &count, sizeof(count));
+			(void)ret;
+		}
 	}
 
 	return NULL;
 }
 
+static void open_printer_efd(void)
+{
+	/* A child must not share the wakeup counter of its parent. */
+	if (printer_efd >= 0)
+		close(printer_efd);
+	printer_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	atomic_set(&printer_kicked, 0);
+}
+
 static void spawn_printer_thread(void)
 {
 	pthread_attr_t thattr;
@@ -645,11 +1325,51 @@ static void spawn_printer_thread(void)
 	pthread_create(&printer_thread, &thattr, printer_loop, NULL);
 }
 
+static void spawn_printer_relay(void)
+{
+	struct sched_param param;
+	pthread_attr_t thattr;
+	pthread_t relay;
+
+	/*
+	 * The relay is a Cobalt thread, which processes binding to
+	 * the core for control purposes only don't want. Callers in
+	 * primary mode then rely on the sync delay only.
+	 */
+	printer_relay_ready = 0;
+	if (__cobalt_control_bind || printer_efd < 0)
+		return;
+
+	if (__COBALT(sem_init(&printer_kick_sem, 0, 0)))
+		return;
+
+	param.sched_priority = 0;
+	pthread_attr_init(&thattr);
+	pthread_attr_setinheritsched(&thattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&thattr, SCHED_OTHER);
+	pthread_attr_setschedparam(&thattr, &param);
+	pthread_attr_setdetachstate(&thattr, PTHREAD_CREATE_DETACHED);
+	if (__COBALT(pthread_create(&relay, &thattr, printer_relay, NULL)))
+		__COBALT(sem_destroy(&printer_kick_sem));
+	else
+		printer_relay_ready = 1;
+	pthread_attr_destroy(&thattr);
+}
+
 void cobalt_print_init_atfork(void)
 {
 	struct print_buffer *my_buffer = pthread_getspecific(buffer_key);
 	struct print_buffer **pbuffer = &first_buffer;
 
+	/*
+	 * Neither the relay thread nor the Cobalt semaphore it waits
+	 * on survived the fork, stop posting the latter until
+	 * cobalt_print_init() respawns the relay, once cobalt_init()
+	 * has bound the child to the core.
+	 */
+	printer_relay_ready = 0;
+	open_printer_efd();
+
 	if (my_buffer) {
 		/* Any content of my_buffer should be printed by our parent,
 		   not us. */
@@ -721,7 +1441,10 @@ done:
 	pthread_key_create(&buffer_key, (void (*)(void*))release_buffer);
 	pthread_key_create(&cleanup_key, do_cleanup);
 	pthread_cond_init(&printer_wakeup, NULL);
+	if (printer_efd < 0)
+		open_printer_efd();
 	spawn_printer_thread();
+	spawn_printer_relay();
 	/* We just need a non-zero TSD to trigger the dtor upon unwinding. */
 	pthread_setspecific(cleanup_key, (void *)1);
 
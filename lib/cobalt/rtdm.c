@@ -111,6 +111,9 @@ COBALT_IMPL(int, close, (int fd))
 	int oldtype;
 	int ret;
 
+	/* @fd may be a message queue descriptor. */
+	cobalt_mq_fastunbind(fd);
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	ret = XENOMAI_SYSCALL1(sc_cobalt_close, fd);
@@ -251,6 +254,41 @@ COBALT_IMPL(ssize_t, sendmsg, (int fd, const struct msghdr *msg, int flags))
 	return __STD(sendmsg(fd, msg, flags));
 }
 
+COBALT_IMPL(int, recvmmsg, (int fd, struct mmsghdr *msgvec, unsigned int vlen,
+			   unsigned int flags, struct timespec *timeout))
+{
+	int ret, oldtype;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SYSCALL5(sc_cobalt_recvmmsg,
+			       fd, msgvec, vlen, flags, timeout);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	if (ret != -EBADF && ret != -ENOSYS)
+		return set_errno(ret);
+
+	return __STD(recvmmsg(fd, msgvec, vlen, flags, timeout));
+}
+
+COBALT_IMPL(int, sendmmsg, (int fd, struct mmsghdr *msgvec,
+			   unsigned int vlen, unsigned int flags))
+{
+	int ret, oldtype;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_sendmmsg, fd, msgvec, vlen, flags);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	if (ret != -EBADF && ret != -ENOSYS)
+		return set_errno(ret);
+
+	return __STD(sendmmsg(fd, msgvec, vlen, flags));
+}
+
 COBALT_IMPL(ssize_t, recvfrom, (int fd, void *buf, size_t len, int flags,
 				struct sockaddr *from, socklen_t *fromlen))
 {
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
 #include <asm/xenomai/syscall.h>
 #include "internal.h"
 
@@ -46,3 +47,38 @@ COBALT_IMPL(int, select, (int __nfds, fd_set *__restrict __readfds,
 	errno = -err;
 	return -1;
 }
+
+/*
+ * Epoll-like services. Descriptors are registered once with
+ * cobalt_epoll_ctl(), cobalt_epoll_wait() then only deals with the
+ * ready ones. Only level-triggered EPOLLIN, EPOLLOUT and EPOLLPRI
+ * events are supported for Cobalt descriptors, EPOLLHUP is reported
+ * for descriptors closed while still registered. The timeout is an
+ * absolute date based on CLOCK_MONOTONIC, NULL meaning to wait
+ * indefinitely, and a null date not to wait at all. Errors are
+ * returned as negated error codes, like other cobalt_* services.
+ */
+int cobalt_epoll_create(int flags)
+{
+	return XENOMAI_SYSCALL1(sc_cobalt_epoll_create, flags);
+}
+
+int cobalt_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+	return XENOMAI_SYSCALL4(sc_cobalt_epoll_ctl, epfd, op, fd, event);
+}
+
+int cobalt_epoll_wait(int epfd, struct epoll_event *events,
+		      int maxevents, const struct timespec *timeout)
+{
+	int ret, oldtype;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_epoll_wait,
+			       epfd, events, maxevents, timeout);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	return ret;
+}
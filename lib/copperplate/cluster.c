@@ -403,6 +403,8 @@ const static struct pvhash_operations pvhash_operations = {
 
 const static struct hash_operations hash_operations = {
 	.compare = memcmp,
+	.alloc = xnmalloc,
+	.free = xnfree,
 };
 
 #endif /* !CONFIG_XENO_PSHARED */
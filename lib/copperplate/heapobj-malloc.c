@@ -187,3 +187,8 @@ int heapobj_pkg_init_private(void)
 {
 	return 0;
 }
+
+int heapobj_bind_registry_private(void)
+{
+	return 0;
+}
@@ -19,10 +19,13 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <fcntl.h>
 #include "boilerplate/tlsf/tlsf.h"
+#include "boilerplate/list.h"
 #include "copperplate/heapobj.h"
 #include "copperplate/debug.h"
 #include "copperplate/threadobj.h"
+#include "copperplate/registry-obstack.h"
 #include "xenomai/init.h"
 #include "internal.h"
 
@@ -34,6 +37,337 @@
 
 static int tlsf_pool_overhead;
 
+/*
+ * Small blocks from the main private pool are cached into
+ * per-thread magazines, one per size class, so that the common
+ * pvmalloc/pvfree path runs locklessly. Magazines are refilled from,
+ * and flushed to the TLSF pool in batches, grabbing the pool lock
+ * once per batch. Magazine depth decreases with the block size, which
+ * bounds the amount of memory a thread may keep in its cache.
+ */
+#define PVCACHE_MIN_SHIFT	4
+#define PVCACHE_NR_CLASSES	6	/* 16 -> 512 bytes */
+#define PVCACHE_MAG_BYTES	1024
+#define PVCACHE_MAG_MIN		4
+#define PVCACHE_MAG_MAX		32
+
+struct pvmagazine {
+	int nr;
+	int depth;
+	void *blocks[PVCACHE_MAG_MAX];
+};
+
+struct pvcache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long flushes;
+};
+
+struct pvcache {
+	struct pvmagazine mags[PVCACHE_NR_CLASSES];
+	struct pvcache_stats stats[PVCACHE_NR_CLASSES];
+	struct pvholder next;
+};
+
+static pthread_key_t pvcache_key;
+
+static int pvcache_ready;
+
+static pthread_mutex_t pvcache_lock;
+
+static DEFINE_PRIVATE_LIST(pvcache_list);
+
+/* Stats accumulated from exited threads. */
+static struct pvcache_stats pvcache_stats[PVCACHE_NR_CLASSES];
+
+#ifdef HAVE_TLS
+
+static __thread __attribute__ ((tls_model (CONFIG_XENO_TLS_MODEL)))
+struct pvcache *pvcache_current;
+
+static inline struct pvcache *pvcache_get(void)
+{
+	return pvcache_current;
+}
+
+static inline void pvcache_set(struct pvcache *cache)
+{
+	pvcache_current = cache;
+	pthread_setspecific(pvcache_key, cache);
+}
+
+#else /* !HAVE_TLS */
+
+static inline struct pvcache *pvcache_get(void)
+{
+	return pthread_getspecific(pvcache_key);
+}
+
+static inline void pvcache_set(struct pvcache *cache)
+{
+	pthread_setspecific(pvcache_key, cache);
+}
+
+#endif /* !HAVE_TLS */
+
+static inline size_t pvcache_class_size(int class)
+{
+	return (size_t)1 << (class + PVCACHE_MIN_SHIFT);
+}
+
+static inline int pvcache_alloc_class(size_t size)
+{
+	int class = 0;
+
+	if (size > pvcache_class_size(PVCACHE_NR_CLASSES - 1))
+		return -1;
+
+	while (pvcache_class_size(class) < size)
+		class++;
+
+	return class;
+}
+
+/*
+ * A freed block may go to the magazine of any class it can serve, as
+ * long as it does not waste more than half of its space there.
+ */
+static inline int pvcache_free_class(size_t usable)
+{
+	int class;
+
+	if (usable < pvcache_class_size(0) ||
+	    usable >= pvcache_class_size(PVCACHE_NR_CLASSES - 1) * 2)
+		return -1;
+
+	for (class = PVCACHE_NR_CLASSES - 1;
+	     pvcache_class_size(class) > usable; class--)
+		;
+
+	return class;
+}
+
+static struct pvcache *pvcache_create(void)
+{
+	struct pvcache *cache;
+	int class, depth;
+
+	cache = tlsf_malloc(sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+
+	memset(cache, 0, sizeof(*cache));
+	for (class = 0; class < PVCACHE_NR_CLASSES; class++) {
+		depth = PVCACHE_MAG_BYTES / pvcache_class_size(class);
+		if (depth < PVCACHE_MAG_MIN)
+			depth = PVCACHE_MAG_MIN;
+		else if (depth > PVCACHE_MAG_MAX)
+			depth = PVCACHE_MAG_MAX;
+		cache->mags[class].depth = depth;
+	}
+
+	write_lock_nocancel(&pvcache_lock);
+	pvlist_append(&cache->next, &pvcache_list);
+	write_unlock(&pvcache_lock);
+
+	pvcache_set(cache);
+
+	return cache;
+}
+
+static void pvcache_flush(struct pvcache *cache)
+{
+	struct pvmagazine *mag;
+	int class;
+
+	for (class = 0; class < PVCACHE_NR_CLASSES; class++) {
+		mag = cache->mags + class;
+		if (mag->nr > 0) {
+			tlsf_free_batch(mag->blocks, mag->nr);
+			cache->stats[class].flushes++;
+			mag->nr = 0;
+		}
+	}
+}
+
+/* Runs on thread exit, releasing the cached blocks. */
+static void pvcache_destroy(void *arg)
+{
+	struct pvcache *cache = arg;
+	int class;
+
+	pvcache_flush(cache);
+
+	write_lock_nocancel(&pvcache_lock);
+
+	pvlist_remove(&cache->next);
+	for (class = 0; class < PVCACHE_NR_CLASSES; class++) {
+		pvcache_stats[class].hits += cache->stats[class].hits;
+		pvcache_stats[class].misses += cache->stats[class].misses;
+		pvcache_stats[class].refills += cache->stats[class].refills;
+		pvcache_stats[class].flushes += cache->stats[class].flushes;
+	}
+
+	write_unlock(&pvcache_lock);
+
+#ifdef HAVE_TLS
+	pvcache_current = NULL;
+#endif
+	tlsf_free(cache);
+}
+
+void *pvmalloc(size_t size)
+{
+	struct pvmagazine *mag;
+	struct pvcache *cache;
+	void *ptr;
+	int class;
+
+	class = pvcache_alloc_class(size);
+	if (class < 0)
+		goto nocache;
+
+	cache = pvcache_get();
+	if (cache == NULL) {
+		if (!pvcache_ready)
+			goto nocache;
+		cache = pvcache_create();
+		if (cache == NULL)
+			goto nocache;
+	}
+
+	mag = cache->mags + class;
+	if (mag->nr > 0) {
+		cache->stats[class].hits++;
+		return mag->blocks[--mag->nr];
+	}
+
+	cache->stats[class].misses++;
+	mag->nr = tlsf_malloc_batch(pvcache_class_size(class),
+				    mag->blocks, mag->depth / 2);
+	if (mag->nr > 0) {
+		cache->stats[class].refills++;
+		return mag->blocks[--mag->nr];
+	}
+
+	size = pvcache_class_size(class);
+nocache:
+	ptr = tlsf_malloc(size);
+	if (ptr)
+		return ptr;
+
+	/* Out of memory: give back our cached blocks, then retry. */
+	cache = pvcache_get();
+	if (cache == NULL)
+		return NULL;
+
+	pvcache_flush(cache);
+
+	return tlsf_malloc(size);
+}
+
+void pvfree(void *ptr)
+{
+	struct pvmagazine *mag;
+	struct pvcache *cache;
+	int class;
+
+	if (ptr == NULL)
+		return;
+
+	cache = pvcache_get();
+	if (cache == NULL)
+		goto nocache;
+
+	class = pvcache_free_class(malloc_usable_size_ex(ptr, NULL));
+	if (class < 0)
+		goto nocache;
+
+	mag = cache->mags + class;
+	if (mag->nr >= mag->depth) {
+		/* Give back the older half of the magazine. */
+		tlsf_free_batch(mag->blocks, mag->depth / 2);
+		mag->nr -= mag->depth / 2;
+		memmove(mag->blocks, mag->blocks + mag->depth / 2,
+			mag->nr * sizeof(void *));
+		cache->stats[class].flushes++;
+	}
+
+	mag->blocks[mag->nr++] = ptr;
+
+	return;
+nocache:
+	tlsf_free(ptr);
+}
+
+#ifdef CONFIG_XENO_REGISTRY
+
+static struct fsobj pvcache_fsobj;
+
+static int pvcache_registry_open(struct fsobj *fsobj, void *priv)
+{
+	struct pvcache_stats stats[PVCACHE_NR_CLASSES];
+	struct fsobstack *o = priv;
+	struct pvcache *cache;
+	int class, nr = 0;
+
+	write_lock_nocancel(&pvcache_lock);
+
+	memcpy(stats, pvcache_stats, sizeof(stats));
+	pvlist_for_each_entry(cache, &pvcache_list, next) {
+		for (class = 0; class < PVCACHE_NR_CLASSES; class++) {
+			stats[class].hits += cache->stats[class].hits;
+			stats[class].misses += cache->stats[class].misses;
+			stats[class].refills += cache->stats[class].refills;
+			stats[class].flushes += cache->stats[class].flushes;
+		}
+		nr++;
+	}
+
+	write_unlock(&pvcache_lock);
+
+	fsobstack_init(o);
+
+	fsobstack_grow_format(o, "%d thread cache(s)\n", nr);
+	fsobstack_grow_format(o, "%6s  %10s  %10s  %10s  %10s\n",
+			      "[SIZE]", "[HITS]", "[MISSES]",
+			      "[REFILLS]", "[FLUSHES]");
+
+	for (class = 0; class < PVCACHE_NR_CLASSES; class++)
+		fsobstack_grow_format(o, "%6Zu  %10lu  %10lu  %10lu  %10lu\n",
+				      pvcache_class_size(class),
+				      stats[class].hits, stats[class].misses,
+				      stats[class].refills,
+				      stats[class].flushes);
+
+	fsobstack_finish(o);
+
+	return 0;
+}
+
+static struct registry_operations pvcache_registry_ops = {
+	.open		= pvcache_registry_open,
+	.release	= fsobj_obstack_release,
+	.read		= fsobj_obstack_read
+};
+
+int heapobj_bind_registry_private(void)
+{
+	registry_init_file_obstack(&pvcache_fsobj, &pvcache_registry_ops);
+
+	return __bt(registry_add_file(&pvcache_fsobj, O_RDONLY, "/pvheap"));
+}
+
+#else /* !CONFIG_XENO_REGISTRY */
+
+int heapobj_bind_registry_private(void)
+{
+	return 0;
+}
+
+#endif /* !CONFIG_XENO_REGISTRY */
+
 int __heapobj_init_private(struct heapobj *hobj, const char *name,
 			   size_t size, void *mem)
 {
@@ -76,8 +410,10 @@ int heapobj_init_array_private(struct heapobj *hobj, const char *name,
 
 int heapobj_pkg_init_private(void)
 {
+	pthread_mutexattr_t mattr;
 	size_t size;
 	void *mem;
+	int ret;
 
 	/*
 	 * We want to know how many bytes from a memory pool TLSF will
@@ -99,5 +435,20 @@ int heapobj_pkg_init_private(void)
 	tlsf_pool_overhead = (tlsf_pool_overhead + 1024) & ~15;
 	tlsf_free(mem);
 
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
+	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE);
+	ret = __bt(-__RT(pthread_mutex_init(&pvcache_lock, &mattr)));
+	pthread_mutexattr_destroy(&mattr);
+	if (ret)
+		return ret;
+
+	ret = __bt(-pthread_key_create(&pvcache_key, pvcache_destroy));
+	if (ret)
+		return ret;
+
+	pvcache_ready = 1;
+
 	return 0;
 }
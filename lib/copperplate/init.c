@@ -77,6 +77,13 @@ static const struct option copperplate_options[] = {
 		.flag = &__copperplate_setup_data.shared_registry,
 		.val = 1,
 	},
+	{
+#define percpu_timers_opt	5
+		.name = "per-cpu-timers",
+		.has_arg = no_argument,
+		.flag = &__copperplate_setup_data.percpu_timers,
+		.val = 1,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -220,6 +227,9 @@ static int copperplate_init(void)
 		ret = registry_pkg_init(__base_setup_data.arg0, regflags);
 		if (ret)
 			return ret;
+		ret = heapobj_bind_registry_private();
+		if (ret)
+			return ret;
 	}
 
 	ret = threadobj_pkg_init((regflags & REGISTRY_ANON) != 0);
@@ -269,6 +279,7 @@ static int copperplate_parse_option(int optnum, const char *optarg)
 		break;
 	case shared_registry_opt:
 	case no_registry_opt:
+	case percpu_timers_opt:
 		break;
 	default:
 		/* Paranoid, can't happen. */
@@ -285,6 +296,7 @@ static void copperplate_help(void)
         fprintf(stderr, "--shared-registry		enable public access to registry\n");
         fprintf(stderr, "--registry-root=<path>		root path of registry\n");
         fprintf(stderr, "--session=<label>[/<group>]	enable shared session\n");
+        fprintf(stderr, "--per-cpu-timers		run one timer server per CPU\n");
 }
 
 static struct setup_descriptor copperplate_interface = {
@@ -26,22 +26,49 @@
 #include <limits.h>
 #include <pthread.h>
 #include <semaphore.h>
-#include "boilerplate/list.h"
+#include <sched.h>
+#include <assert.h>
 #include "boilerplate/signal.h"
 #include "boilerplate/lock.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/timerobj.h"
 #include "copperplate/clockobj.h"
 #include "copperplate/debug.h"
+#include "copperplate/tunables.h"
 #include "internal.h"
 
-static pthread_mutex_t svlock;
-
-static pthread_t svthread;
-
-static pid_t svpid;
-
-static DEFINE_PRIVATE_LIST(svtimers);
+/*
+ * Timers are indexed by a binary min-heap ordered by expiry date, so
+ * that queuing/dequeuing a timer costs O(log n) instead of walking a
+ * sorted list, which matters for legacy apps arming dozens or
+ * hundreds of watchdogs. A sequence number breaks ties between
+ * timers elapsing at the same date, so that handlers still run in
+ * FIFO order.
+ *
+ * By default, a single server thread handles all timers. With
+ * --per-cpu-timers, one server is pinned to each CPU the process
+ * may run on, and a timer is served on the CPU which created it, so
+ * that handlers targeting different CPUs don't serialize.
+ */
+struct timersv {
+	pthread_mutex_t lock;
+	/* Serializes the lazy server spawn, sv->lock is not held. */
+	pthread_mutex_t spawn_lock;
+	pthread_t thread;
+	pid_t pid;
+	int cpu;
+	struct timerobj **heap;
+	int nr_queued;
+	int nr_slots;
+	int nr_timers;
+	unsigned long seq;
+};
+
+static struct timersv *servers;
+
+static int nr_servers;
+
+static struct timersv *default_server;
 
 #ifdef CONFIG_XENO_COBALT
 
@@ -60,46 +87,122 @@ static inline void timersv_init_corespec(void)
 
 #endif /* CONFIG_XENO_MERCURY */
 
-/*
- * XXX: at some point, we may consider using a timer wheel instead of
- * a simple linked list to index timers. The latter method is
- * efficient for up to ten outstanding timers or so, which should be
- * enough for most applications. However, there exist poorly designed
- * apps involving dozens of active timers, particularly in the legacy
- * embedded world.
- */
-static void timerobj_enqueue(struct timerobj *tmobj)
+static inline int timer_before(const struct timerobj *l,
+			       const struct timerobj *r)
 {
-	struct timerobj *__tmobj;
+	if (timespec_before(&l->itspec.it_value, &r->itspec.it_value))
+		return 1;
 
-	if (pvlist_empty(&svtimers)) {
-		pvlist_append(&tmobj->next, &svtimers);
-		return;
+	if (timespec_after(&l->itspec.it_value, &r->itspec.it_value))
+		return 0;
+
+	return (long)(l->seq - r->seq) < 0;
+}
+
+static inline void heap_set(struct timersv *sv, int n,
+			    struct timerobj *tmobj)
+{
+	sv->heap[n] = tmobj;
+	tmobj->heapidx = n;
+}
+
+static void heap_sift_up(struct timersv *sv, int n)
+{
+	struct timerobj *tmobj = sv->heap[n];
+	int parent;
+
+	while (n > 0) {
+		parent = (n - 1) / 2;
+		if (!timer_before(tmobj, sv->heap[parent]))
+			break;
+		heap_set(sv, n, sv->heap[parent]);
+		n = parent;
 	}
 
-	pvlist_for_each_entry_reverse(__tmobj, &svtimers, next) {
-		if (timespec_before_or_same(&__tmobj->itspec.it_value,
-					    &tmobj->itspec.it_value))
+	heap_set(sv, n, tmobj);
+}
+
+static void heap_sift_down(struct timersv *sv, int n)
+{
+	struct timerobj *tmobj = sv->heap[n];
+	int child;
+
+	for (;;) {
+		child = n * 2 + 1;
+		if (child >= sv->nr_queued)
+			break;
+		if (child + 1 < sv->nr_queued &&
+		    timer_before(sv->heap[child + 1], sv->heap[child]))
+			child++;
+		if (!timer_before(sv->heap[child], tmobj))
 			break;
+		heap_set(sv, n, sv->heap[child]);
+		n = child;
 	}
 
-	atpvh(&__tmobj->next, &tmobj->next);
+	heap_set(sv, n, tmobj);
+}
+
+/*
+ * Room for every timer attached to a server is reserved by
+ * timerobj_init(), so queuing cannot fail.
+ */
+static void timerobj_enqueue(struct timersv *sv, struct timerobj *tmobj)
+{
+	assert(sv->nr_queued < sv->nr_slots);
+	tmobj->seq = sv->seq++;
+	sv->heap[sv->nr_queued] = tmobj;
+	heap_sift_up(sv, sv->nr_queued++);
+}
+
+static void timerobj_dequeue(struct timersv *sv, struct timerobj *tmobj)
+{
+	struct timerobj *last;
+	int n = tmobj->heapidx;
+
+	tmobj->heapidx = -1;
+	last = sv->heap[--sv->nr_queued];
+	if (last == tmobj)
+		return;
+
+	heap_set(sv, n, last);
+	if (n > 0 && timer_before(last, sv->heap[(n - 1) / 2]))
+		heap_sift_up(sv, n);
+	else
+		heap_sift_down(sv, n);
+}
+
+static inline int timerobj_queued(struct timerobj *tmobj)
+{
+	return tmobj->heapidx >= 0;
 }
 
 static int server_prologue(void *arg)
 {
-	svpid = get_thread_pid();
+	struct timersv *sv = arg;
+	cpu_set_t cpuset;
+
+	sv->pid = get_thread_pid();
 	copperplate_set_current_name("timer-internal");
 	timersv_init_corespec();
 	threadobj_set_current(THREADOBJ_IRQCONTEXT);
 
+	if (sv->cpu >= 0) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(sv->cpu, &cpuset);
+		if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+			warning("failed to pin timer server on CPU%d",
+				sv->cpu);
+	}
+
 	return 0;
 }
 
 static void *timerobj_server(void *arg)
 {
 	struct timespec now, value, interval;
-	struct timerobj *tmobj, *tmp;
+	struct timersv *sv = arg;
+	struct timerobj *tmobj;
 	sigset_t set;
 	int sig, ret;
 
@@ -111,55 +214,130 @@ static void *timerobj_server(void *arg)
 		if (ret && ret != -EINTR)
 			break;
 		/*
-		 * We have a single server thread for now, so handlers
-		 * are fully serialized.
+		 * Handlers of timers attached to this server are
+		 * serialized.
 		 */
-		write_lock_nocancel(&svlock);
+		write_lock_nocancel(&sv->lock);
 
 		__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
 
-		pvlist_for_each_entry_safe(tmobj, tmp, &svtimers, next) {
+		while (sv->nr_queued > 0) {
+			tmobj = sv->heap[0];
 			value = tmobj->itspec.it_value;
 			if (timespec_after(&value, &now))
 				break;
-			pvlist_remove_init(&tmobj->next);
+			timerobj_dequeue(sv, tmobj);
 			interval = tmobj->itspec.it_interval;
 			if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
 				timespec_add(&tmobj->itspec.it_value,
 					     &value, &interval);
-				timerobj_enqueue(tmobj);
+				timerobj_enqueue(sv, tmobj);
 			}
-			write_unlock(&svlock);
+			write_unlock(&sv->lock);
 			tmobj->handler(tmobj);
-			write_lock_nocancel(&svlock);
+			write_lock_nocancel(&sv->lock);
 		}
 
-		write_unlock(&svlock);
+		write_unlock(&sv->lock);
 	}
 
 	return NULL;
 }
 
-static void timerobj_spawn_server(void)
+static int timerobj_spawn_server(struct timersv *sv)
 {
 	struct corethread_attributes cta;
+	int ret;
 
 	cta.policy = SCHED_CORE;
 	cta.param_ex.sched_priority = threadobj_irq_prio;
 	cta.prologue = server_prologue;
 	cta.run = timerobj_server;
-	cta.arg = NULL;
+	cta.arg = sv;
 	cta.stacksize = PTHREAD_STACK_DEFAULT;
 	cta.detachstate = PTHREAD_CREATE_DETACHED;
 
-	__bt(copperplate_create_thread(&cta, &svthread));
+	ret = __bt(copperplate_create_thread(&cta, &sv->thread));
+	if (ret)
+		sv->thread = 0;
+
+	return ret;
+}
+
+static int timerobj_start_server(struct timersv *sv)
+{
+	int ret = 0;
+
+	__STD(pthread_mutex_lock(&sv->spawn_lock));
+
+	if (!sv->thread)
+		ret = timerobj_spawn_server(sv);
+
+	__STD(pthread_mutex_unlock(&sv->spawn_lock));
+
+	return ret;
+}
+
+static struct timersv *get_server(void)
+{
+	int cpu;
+
+	if (nr_servers == 1)
+		return default_server;
+
+	cpu = sched_getcpu();
+	if (cpu < 0 || cpu >= nr_servers || servers[cpu].cpu < 0)
+		return default_server;
+
+	return servers + cpu;
+}
+
+/*
+ * Reserve a heap slot for a new timer. A larger heap is allocated
+ * without holding sv->lock, then we check again under the lock
+ * whether it is still needed, since other timers may have been
+ * attached or released meanwhile.
+ */
+static int reserve_slot(struct timersv *sv)
+{
+	struct timerobj **heap = NULL, **old;
+	int nr_slots = 0;
+
+	write_lock_nocancel(&sv->lock);
+
+	while (sv->nr_timers >= sv->nr_slots) {
+		if (nr_slots > sv->nr_slots) {
+			memcpy(heap, sv->heap, sv->nr_queued * sizeof(*heap));
+			old = sv->heap;
+			sv->heap = heap;
+			sv->nr_slots = nr_slots;
+			heap = old;
+			break;
+		}
+		nr_slots = sv->nr_slots ? sv->nr_slots * 2 : 32;
+		write_unlock(&sv->lock);
+		free(heap);
+		heap = malloc(nr_slots * sizeof(*heap));
+		if (heap == NULL)
+			return -ENOMEM;
+		write_lock_nocancel(&sv->lock);
+	}
+
+	sv->nr_timers++;
+
+	write_unlock(&sv->lock);
+
+	/* Drop the former heap, or the one we did not need. */
+	free(heap);
+
+	return 0;
 }
 
 int timerobj_init(struct timerobj *tmobj)
 {
-	static pthread_once_t spawn_once;
 	pthread_mutexattr_t mattr;
 	struct sigevent sev;
+	struct timersv *sv;
 	int ret;
 
 	/*
@@ -173,21 +351,29 @@ int timerobj_init(struct timerobj *tmobj)
 	 * very least), and spawning a short-lived thread at each
 	 * timeout expiration to run the handler is just overkill.
 	 */
-	pthread_once(&spawn_once, timerobj_spawn_server);
-	if (!svthread)
+	sv = get_server();
+
+	if (timerobj_start_server(sv))
 		return __bt(-EAGAIN);
 
+	ret = reserve_slot(sv);
+	if (ret)
+		return __bt(ret);
+
 	tmobj->handler = NULL;
-	pvholder_init(&tmobj->next); /* so we may use pvholder_linked() */
+	tmobj->server = sv;
+	tmobj->heapidx = -1;
 
 	memset(&sev, 0, sizeof(sev));
 	sev.sigev_notify = SIGEV_THREAD_ID;
 	sev.sigev_signo = SIGALRM;
-	sev.sigev_notify_thread_id = svpid;
+	sev.sigev_notify_thread_id = sv->pid;
 
 	ret = __RT(timer_create(CLOCK_COPPERPLATE, &sev, &tmobj->timer));
-	if (ret)
-		return __bt(-errno);
+	if (ret) {
+		ret = __bt(-errno);
+		goto fail;
+	}
 
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
@@ -196,18 +382,30 @@ int timerobj_init(struct timerobj *tmobj)
 	assert(ret == 0);
 	ret = __bt(-__RT(pthread_mutex_init(&tmobj->lock, &mattr)));
 	pthread_mutexattr_destroy(&mattr);
+	if (ret == 0)
+		return 0;
+
+	__RT(timer_delete(tmobj->timer));
+fail:
+	write_lock_nocancel(&sv->lock);
+	sv->nr_timers--;
+	write_unlock(&sv->lock);
 
 	return ret;
 }
 
 void timerobj_destroy(struct timerobj *tmobj) /* lock held, dropped */
 {
-	write_lock_nocancel(&svlock);
+	struct timersv *sv = tmobj->server;
 
-	if (pvholder_linked(&tmobj->next))
-		pvlist_remove_init(&tmobj->next);
+	write_lock_nocancel(&sv->lock);
 
-	write_unlock(&svlock);
+	if (timerobj_queued(tmobj))
+		timerobj_dequeue(sv, tmobj);
+
+	sv->nr_timers--;
+
+	write_unlock(&sv->lock);
 
 	__RT(timer_delete(tmobj->timer));
 	__RT(pthread_mutex_unlock(&tmobj->lock));
@@ -218,6 +416,8 @@ int timerobj_start(struct timerobj *tmobj,
 		   void (*handler)(struct timerobj *tmobj),
 		   struct itimerspec *it) /* lock held, dropped */
 {
+	struct timersv *sv = tmobj->server;
+
 	tmobj->handler = handler;
 	tmobj->itspec = *it;
 
@@ -230,13 +430,16 @@ int timerobj_start(struct timerobj *tmobj,
 	 * happens to check the return code then drop the timer
 	 * (again).
 	 */
-	write_lock_nocancel(&svlock);
+	write_lock_nocancel(&sv->lock);
+
+	if (timerobj_queued(tmobj))
+		timerobj_dequeue(sv, tmobj);
 
 	if (__RT(timer_settime(tmobj->timer, TIMER_ABSTIME, it, NULL)))
 		return __bt(-errno);
 
-	timerobj_enqueue(tmobj);
-	write_unlock(&svlock);
+	timerobj_enqueue(sv, tmobj);
+	write_unlock(&sv->lock);
 	timerobj_unlock(tmobj);
 
 	return 0;
@@ -245,13 +448,14 @@ int timerobj_start(struct timerobj *tmobj,
 int timerobj_stop(struct timerobj *tmobj) /* lock held, dropped */
 {
 	static const struct itimerspec itimer_stop;
+	struct timersv *sv = tmobj->server;
 
-	write_lock_nocancel(&svlock);
+	write_lock_nocancel(&sv->lock);
 
-	if (pvholder_linked(&tmobj->next))
-		pvlist_remove_init(&tmobj->next);
+	if (timerobj_queued(tmobj))
+		timerobj_dequeue(sv, tmobj);
 
-	write_unlock(&svlock);
+	write_unlock(&sv->lock);
 
 	__RT(timer_settime(tmobj->timer, 0, &itimer_stop, NULL));
 	tmobj->handler = NULL;
@@ -260,17 +464,61 @@ int timerobj_stop(struct timerobj *tmobj) /* lock held, dropped */
 	return 0;
 }
 
-int timerobj_pkg_init(void)
+static int init_server(struct timersv *sv, int cpu)
 {
 	pthread_mutexattr_t mattr;
 	int ret;
 
+	memset(sv, 0, sizeof(*sv));
+	sv->cpu = cpu;
+
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
 	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
 	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE);
-	ret = __bt(-__RT(pthread_mutex_init(&svlock, &mattr)));
+	ret = __bt(-__RT(pthread_mutex_init(&sv->lock, &mattr)));
 	pthread_mutexattr_destroy(&mattr);
+	if (ret)
+		return ret;
 
-	return ret;
+	return __bt(-__STD(pthread_mutex_init(&sv->spawn_lock, NULL)));
+}
+
+int timerobj_pkg_init(void)
+{
+	cpu_set_t cpuset;
+	int cpu, ret;
+
+	if (!__copperplate_setup_data.percpu_timers ||
+	    sched_getaffinity(0, sizeof(cpuset), &cpuset) ||
+	    CPU_COUNT(&cpuset) < 2) {
+		servers = malloc(sizeof(*servers));
+		if (servers == NULL)
+			return -ENOMEM;
+		nr_servers = 1;
+		default_server = servers;
+		return init_server(servers, -1);
+	}
+
+	/* Servers are indexed by CPU number, one per usable CPU. */
+	for (cpu = CPU_SETSIZE - 1; !CPU_ISSET(cpu, &cpuset); cpu--)
+		;
+	nr_servers = cpu + 1;
+	servers = malloc(nr_servers * sizeof(*servers));
+	if (servers == NULL)
+		return -ENOMEM;
+
+	for (cpu = 0; cpu < nr_servers; cpu++) {
+		if (!CPU_ISSET(cpu, &cpuset)) {
+			servers[cpu].cpu = -1;
+			continue;
+		}
+		ret = init_server(servers + cpu, cpu);
+		if (ret)
+			return ret;
+		if (default_server == NULL)
+			default_server = servers + cpu;
+	}
+
+	return 0;
 }
@@ -32,6 +32,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <endian.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/timerfd.h>
@@ -92,6 +93,20 @@ int bucketsize = 1000;		/* default = 1000ns, -B <size> to override */
 
 #define need_histo() (do_histogram || do_stats || do_gnuplot)
 
+#define HDR_JSON	0
+#define HDR_CSV		1
+#define HDR_BIN		2
+
+#define HDR_MAGIC	"XLHD"
+#define HDR_VERSION	1
+
+char *hdr_export = NULL;	/* -e <file>, HDR histograms */
+int hdr_format = HDR_JSON;	/* -E json|csv|bin */
+int hdr_merge = 0;		/* -M, merge binary exports */
+struct rttst_hdr_histogram *hdr_avg, *hdr_max, *hdr_min;
+
+#define need_hdr() (hdr_export != NULL || hdr_merge)
+
 static inline void add_histogram(int32_t *histogram, int32_t addval)
 {
 	/* bucketsize steps */
@@ -198,6 +213,9 @@ static void *latency(void *cookie)
 
 			if (!(finished || warmup) && need_histo())
 				add_histogram(histogram_avg, dt);
+
+			if (!(finished || warmup) && need_hdr())
+				rttst_hdr_add(hdr_avg, dt);
 		}
 
 		if (!warmup) {
@@ -206,6 +224,11 @@ static void *latency(void *cookie)
 				add_histogram(histogram_min, minj);
 			}
 
+			if (!finished && need_hdr()) {
+				rttst_hdr_add(hdr_max, maxj);
+				rttst_hdr_add(hdr_min, minj);
+			}
+
 			minjitter = minj;
 			if (minj < gminjitter)
 				gminjitter = minj;
@@ -260,6 +283,7 @@ static void *display(void *cookie)
 		config.histogram_size = need_histo() ? histogram_size : 0;
 		config.histogram_bucketsize = bucketsize;
 		config.freeze_max = freeze_max;
+		config.histogram_hdr = need_hdr();
 
 		err = ioctl(benchdev, RTTST_RTIOC_TMBENCH_START, &config);
 		if (err)
@@ -477,6 +501,336 @@ static void dump_hist_stats(time_t duration)
 		dump_histo_gnuplot(histogram_avg, duration);
 }
 
+static long long hdr_bucket_low(unsigned int n)
+{
+	unsigned int k, half = RTTST_HDR_SUB_COUNT / 2;
+
+	if (n < RTTST_HDR_SUB_COUNT)
+		return n;
+
+	k = n / half;
+
+	return (long long)(half + n % half) << (k - 1);
+}
+
+static long long hdr_bucket_high(unsigned int n)
+{
+	unsigned int half = RTTST_HDR_SUB_COUNT / 2;
+
+	if (n < RTTST_HDR_SUB_COUNT)
+		return n;
+
+	return hdr_bucket_low(n) + (1LL << (n / half - 1)) - 1;
+}
+
+/*
+ * Report the highest value equivalent to the sample at the
+ * requested percentile, clamped to the observed range.
+ */
+static long long hdr_percentile(struct rttst_hdr_histogram *h, double pct)
+{
+	unsigned long long target, hits = 0;
+	long long value;
+	unsigned int n;
+
+	if (h->samples == 0)
+		return 0;
+
+	target = ceil(pct / 100.0 * h->samples);
+	if (target == 0)
+		target = 1;
+
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++) {
+		hits += h->counts[n];
+		if (hits >= target)
+			break;
+	}
+
+	value = hdr_bucket_high(n);
+	if (value > h->max)
+		value = h->max;
+	if (value < h->min)
+		value = h->min;
+
+	return value;
+}
+
+static double hdr_avg_value(struct rttst_hdr_histogram *h)
+{
+	return h->samples ? (double)h->sum / h->samples : 0;
+}
+
+static void hdr_merge_into(struct rttst_hdr_histogram *to,
+			   const struct rttst_hdr_histogram *from)
+{
+	unsigned int n;
+
+	if (from->samples == 0)
+		return;
+
+	if (to->samples == 0 || from->min < to->min)
+		to->min = from->min;
+	if (to->samples == 0 || from->max > to->max)
+		to->max = from->max;
+
+	to->samples += from->samples;
+	to->sum += from->sum;
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+		to->counts[n] += from->counts[n];
+}
+
+static void dump_hdr_stats(struct rttst_hdr_histogram *h, char *kind)
+{
+	printf("HDS|    %s|%11llu|%11.3f|%11.3f|%11.3f|%11.3f|%11.3f|%11.3f\n",
+	       kind, (unsigned long long)h->samples,
+	       (double)h->min / 1000, hdr_avg_value(h) / 1000,
+	       (double)h->max / 1000,
+	       (double)hdr_percentile(h, 99.0) / 1000,
+	       (double)hdr_percentile(h, 99.9) / 1000,
+	       (double)hdr_percentile(h, 99.999) / 1000);
+}
+
+static void export_hdr_json(FILE *ofp, struct rttst_hdr_histogram *h,
+			    char *kind, int last)
+{
+	unsigned int n;
+	int sep = 0;
+
+	fprintf(ofp, "    \"%s\": {\n", kind);
+	fprintf(ofp, "      \"samples\": %llu,\n",
+		(unsigned long long)h->samples);
+	fprintf(ofp, "      \"min_ns\": %d,\n", h->min);
+	fprintf(ofp, "      \"avg_ns\": %.3f,\n", hdr_avg_value(h));
+	fprintf(ofp, "      \"max_ns\": %d,\n", h->max);
+	fprintf(ofp, "      \"p50_ns\": %lld,\n", hdr_percentile(h, 50.0));
+	fprintf(ofp, "      \"p99_ns\": %lld,\n", hdr_percentile(h, 99.0));
+	fprintf(ofp, "      \"p99.9_ns\": %lld,\n", hdr_percentile(h, 99.9));
+	fprintf(ofp, "      \"p99.999_ns\": %lld,\n",
+		hdr_percentile(h, 99.999));
+	fprintf(ofp, "      \"buckets\": [");
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++) {
+		if (h->counts[n] == 0)
+			continue;
+		fprintf(ofp, "%s\n        [%lld, %lld, %llu]", sep ? "," : "",
+			hdr_bucket_low(n), hdr_bucket_high(n),
+			(unsigned long long)h->counts[n]);
+		sep = 1;
+	}
+	fprintf(ofp, "\n      ]\n    }%s\n", last ? "" : ",");
+}
+
+static void export_hdr_csv(FILE *ofp, struct rttst_hdr_histogram *h,
+			   char *kind)
+{
+	unsigned int n;
+
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+		if (h->counts[n])
+			fprintf(ofp, "%s,%lld,%lld,%llu\n", kind,
+				hdr_bucket_low(n), hdr_bucket_high(n),
+				(unsigned long long)h->counts[n]);
+}
+
+/*
+ * The binary format is the raw histogram contents in little-endian
+ * order, preceded by a header describing the bucket layout, so that
+ * exports from different machines may be merged with -M.
+ */
+struct hdr_file_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t sub_bits;
+	uint32_t buckets;
+	uint32_t test_mode;
+	uint32_t reserved;
+	uint64_t period_ns;
+};
+
+static int write_hdr_bin(FILE *ofp, struct rttst_hdr_histogram *h)
+{
+	struct rttst_hdr_histogram le;
+	unsigned int n;
+
+	le.samples = htole64(h->samples);
+	le.sum = htole64(h->sum);
+	le.min = htole32(h->min);
+	le.max = htole32(h->max);
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+		le.counts[n] = htole64(h->counts[n]);
+
+	return fwrite(&le, sizeof(le), 1, ofp) == 1 ? 0 : -EIO;
+}
+
+static int read_hdr_bin(FILE *ifp, struct rttst_hdr_histogram *h)
+{
+	unsigned int n;
+
+	if (fread(h, sizeof(*h), 1, ifp) != 1)
+		return -EIO;
+
+	h->samples = le64toh(h->samples);
+	h->sum = le64toh(h->sum);
+	h->min = le32toh(h->min);
+	h->max = le32toh(h->max);
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+		h->counts[n] = le64toh(h->counts[n]);
+
+	return 0;
+}
+
+static void export_hdr_bin(FILE *ofp)
+{
+	struct hdr_file_header hdr;
+
+	memcpy(hdr.magic, HDR_MAGIC, sizeof(hdr.magic));
+	hdr.version = htole32(HDR_VERSION);
+	hdr.sub_bits = htole32(RTTST_HDR_SUB_BITS);
+	hdr.buckets = htole32(RTTST_HDR_BUCKETS);
+	hdr.test_mode = htole32(test_mode);
+	hdr.reserved = 0;
+	hdr.period_ns = htole64(period_ns);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, ofp) != 1 ||
+	    write_hdr_bin(ofp, hdr_avg) ||
+	    write_hdr_bin(ofp, hdr_min) ||
+	    write_hdr_bin(ofp, hdr_max))
+		warning("failed writing HDR histograms to %s", hdr_export);
+}
+
+/*
+ * Make sure a histogram read from a file is consistent with the
+ * bucket layout it claims, before trusting it for merging.
+ */
+static int check_hdr_bin(const struct rttst_hdr_histogram *h)
+{
+	unsigned long long total = 0;
+	unsigned int n;
+
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++) {
+		if (total + h->counts[n] < total)
+			return -EINVAL;
+		total += h->counts[n];
+	}
+
+	if (total != h->samples)
+		return -EINVAL;
+
+	if (h->samples == 0)
+		return 0;
+
+	if (h->min > h->max ||
+	    h->counts[rttst_hdr_index(h->min)] == 0 ||
+	    h->counts[rttst_hdr_index(h->max)] == 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void merge_hdr_file(const char *path)
+{
+	struct rttst_hdr_histogram *h;
+	struct hdr_file_header hdr;
+	unsigned int mode;
+	FILE *ifp;
+	int n;
+
+	ifp = fopen(path, "r");
+	if (ifp == NULL)
+		error(1, errno, "fopen(%s)", path);
+
+	if (fread(&hdr, sizeof(hdr), 1, ifp) != 1 ||
+	    memcmp(hdr.magic, HDR_MAGIC, sizeof(hdr.magic)) ||
+	    le32toh(hdr.version) != HDR_VERSION)
+		error(1, EINVAL, "%s: not a latency HDR export", path);
+
+	if (le32toh(hdr.sub_bits) != RTTST_HDR_SUB_BITS ||
+	    le32toh(hdr.buckets) != RTTST_HDR_BUCKETS)
+		error(1, EINVAL, "%s: incompatible bucket layout", path);
+
+	mode = le32toh(hdr.test_mode);
+	if (mode >= sizeof(test_mode_names) / sizeof(test_mode_names[0]))
+		error(1, EINVAL, "%s: invalid test mode %u", path, mode);
+
+	if (period_ns == 0) {
+		period_ns = le64toh(hdr.period_ns);
+		test_mode = mode;
+	} else if (period_ns != (long long)le64toh(hdr.period_ns) ||
+		   test_mode != (int)mode)
+		warning("%s: merging results from a different setup", path);
+
+	/* Validate all histograms before merging any of them. */
+	h = malloc(3 * sizeof(*h));
+	if (h == NULL)
+		error(1, ENOMEM, "malloc");
+
+	for (n = 0; n < 3; n++) {
+		if (read_hdr_bin(ifp, h + n))
+			error(1, EINVAL, "%s: truncated file", path);
+		if (check_hdr_bin(h + n))
+			error(1, EINVAL, "%s: corrupted histogram", path);
+	}
+
+	hdr_merge_into(hdr_avg, h);
+	hdr_merge_into(hdr_min, h + 1);
+	hdr_merge_into(hdr_max, h + 2);
+
+	free(h);
+	fclose(ifp);
+}
+
+static void dump_hdr(time_t duration)
+{
+	FILE *ofp;
+
+	printf("HDH|--param|----samples|----lat min|----lat avg|----lat max"
+	       "|--------p99|------p99.9|----p99.999\n");
+
+	dump_hdr_stats(hdr_min, "min");
+	dump_hdr_stats(hdr_avg, "avg");
+	dump_hdr_stats(hdr_max, "max");
+
+	if (hdr_export == NULL)
+		return;
+
+	if (strcmp(hdr_export, "-") == 0)
+		ofp = stdout;
+	else {
+		ofp = fopen(hdr_export, "w");
+		if (ofp == NULL) {
+			warning("cannot open %s: %s", hdr_export,
+				strerror(errno));
+			return;
+		}
+	}
+
+	switch (hdr_format) {
+	case HDR_JSON:
+		fprintf(ofp, "{\n");
+		fprintf(ofp, "  \"test_mode\": \"%s\",\n",
+			test_mode_names[test_mode]);
+		fprintf(ofp, "  \"period_ns\": %lld,\n", period_ns);
+		fprintf(ofp, "  \"duration_s\": %ld,\n", (long)duration);
+		fprintf(ofp, "  \"overruns\": %d,\n", goverrun);
+		fprintf(ofp, "  \"histograms\": {\n");
+		export_hdr_json(ofp, hdr_min, "min", 0);
+		export_hdr_json(ofp, hdr_avg, "avg", 0);
+		export_hdr_json(ofp, hdr_max, "max", 1);
+		fprintf(ofp, "  }\n}\n");
+		break;
+	case HDR_CSV:
+		fprintf(ofp, "histogram,low_ns,high_ns,count\n");
+		export_hdr_csv(ofp, hdr_min, "min");
+		export_hdr_csv(ofp, hdr_avg, "avg");
+		export_hdr_csv(ofp, hdr_max, "max");
+		break;
+	default:
+		export_hdr_bin(ofp);
+	}
+
+	if (ofp != stdout)
+		fclose(ofp);
+}
+
 static void cleanup(void)
 {
 	struct rttst_overall_bench_res overall;
@@ -504,6 +858,16 @@ static void cleanup(void)
 		gmaxjitter = overall.result.max;
 		gavgjitter = overall.result.avg;
 		goverrun = overall.result.overruns;
+		if (need_hdr()) {
+			struct rttst_hdr_bench_res hdr = {
+				.hdr_avg = hdr_avg,
+				.hdr_min = hdr_min,
+				.hdr_max = hdr_max,
+			};
+			if (ioctl(benchdev, RTTST_RTIOC_TMBENCH_HDR_RES, &hdr))
+				warning("cannot retrieve HDR histograms: %s",
+					strerror(errno));
+		}
 	}
 
 	pthread_join(display_task, NULL);
@@ -514,6 +878,9 @@ static void cleanup(void)
 	if (need_histo())
 		dump_hist_stats(actual_duration);
 
+	if (need_hdr())
+		dump_hdr(actual_duration);
+
 	printf
 	    ("---|-----------|-----------|-----------|--------|------|-------------------------\n"
 	     "RTS|%11.3f|%11.3f|%11.3f|%8d|%6u|    %.2ld:%.2ld:%.2ld/%.2d:%.2d:%.2d\n",
@@ -532,6 +899,9 @@ static void cleanup(void)
 		free(histogram_max);
 	if (histogram_min)
 		free(histogram_min);
+	free(hdr_avg);
+	free(hdr_max);
+	free(hdr_min);
 
 	exit(0);
 }
@@ -611,6 +981,9 @@ void application_usage(void)
 		"-c <cpu>                        pin measuring task down to given CPU\n"
 		"-P <priority>                   task priority (test mode 0 and 1 only)\n"
 		"-b                              break upon mode switch\n"
+		"-e <file>                       export HDR histograms to <file> ('-' for stdout)\n"
+		"-E <format>                     export format: json (default), csv or bin\n"
+		"-M <file>...                    merge binary HDR exports instead of testing\n"
 		);
 }
 
@@ -645,7 +1018,7 @@ int main(int argc, char *const *argv)
 	cpu_set_t cpus;
 	sigset_t mask;
 
-	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:b")) != EOF)
+	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:be:E:M")) != EOF)
 		switch (c) {
 		case 'g':
 			do_gnuplot = strdup(optarg);
@@ -719,6 +1092,26 @@ int main(int argc, char *const *argv)
 			stop_upon_switch = 1;
 			break;
 
+		case 'e':
+			hdr_export = strdup(optarg);
+			break;
+
+		case 'E':
+			if (strcmp(optarg, "json") == 0)
+				hdr_format = HDR_JSON;
+			else if (strcmp(optarg, "csv") == 0)
+				hdr_format = HDR_CSV;
+			else if (strcmp(optarg, "bin") == 0)
+				hdr_format = HDR_BIN;
+			else
+				error(1, EINVAL, "invalid export format %s",
+				      optarg);
+			break;
+
+		case 'M':
+			hdr_merge = 1;
+			break;
+
 		default:
 			xenomai_usage();
 			exit(2);
@@ -737,6 +1130,23 @@ int main(int argc, char *const *argv)
 		error(1, EINVAL, "-t1, -t2 not allowed over Mercury");
 #endif
 	
+	if (need_hdr()) {
+		hdr_avg = calloc(1, sizeof(*hdr_avg));
+		hdr_max = calloc(1, sizeof(*hdr_max));
+		hdr_min = calloc(1, sizeof(*hdr_min));
+		if (!(hdr_avg && hdr_max && hdr_min))
+			error(1, ENOMEM, "calloc");
+	}
+
+	if (hdr_merge) {
+		if (optind >= argc)
+			error(1, EINVAL, "-M requires HDR exports to merge");
+		while (optind < argc)
+			merge_hdr_file(argv[optind++]);
+		dump_hdr(0);
+		return 0;
+	}
+
 	time(&test_start);
 
 	histogram_avg = calloc(histogram_size, sizeof(int32_t));
@@ -0,0 +1,199 @@
+/*
+ * RTIPC/BUFP mapped ring test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(bufp_mmap,
+		   SMOKEY_NOARGS,
+		   "Check RTIPC/BUFP protocol over a mapped ring."
+);
+
+#define BUFP_MMAP_SVPORT 13
+#define BUFP_MMAP_BUFSZ  4096
+#define BUFP_MMAP_COUNT  10000
+#define BUFP_MMAP_BATCH  8
+
+static pthread_t svtid, cltid;
+
+static pthread_barrier_t barrier;
+
+static void fail(const char *reason)
+{
+	perror(reason);
+	exit(EXIT_FAILURE);
+}
+
+static void *server(void *arg)
+{
+	long data[BUFP_MMAP_BATCH], control = 0;
+	struct sockaddr_ipc saddr;
+	struct bufp_map map;
+	struct timespec ts;
+	int ret, s, on = 1;
+	size_t bufsz;
+	ssize_t n, i;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0)
+		fail("socket");
+
+	bufsz = BUFP_MMAP_BUFSZ;
+	ret = setsockopt(s, SOL_BUFP, BUFP_BUFSZ, &bufsz, sizeof(bufsz));
+	if (ret)
+		fail("setsockopt");
+
+	ret = setsockopt(s, SOL_BUFP, BUFP_MMAP, &on, sizeof(on));
+	if (ret)
+		fail("setsockopt");
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = BUFP_MMAP_SVPORT;
+	ret = bind(s, (struct sockaddr *)&saddr, sizeof(saddr));
+	if (ret)
+		fail("bind");
+
+	ret = bufp_map_ring(s, &map);
+	if (ret)
+		fail("bufp_map_ring");
+
+	if (map.ring->bufsz != BUFP_MMAP_BUFSZ)
+		fail("bufsz");
+
+	pthread_barrier_wait(&barrier);
+
+	while (control < BUFP_MMAP_COUNT) {
+		/*
+		 * Have the client fill up the ring on a regular
+		 * basis, so that it has to wait for room.
+		 */
+		if ((control % 1000) == 0) {
+			ts.tv_sec = 0;
+			ts.tv_nsec = 1000000;
+			clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+		}
+		n = bufp_ring_read(&map, data, sizeof(data), 0);
+		if (n <= 0 || n % sizeof(long))
+			fail("bufp_ring_read");
+		for (i = 0; i < n / sizeof(long); i++) {
+			if (data[i] != ++control) {
+				smokey_note("data does not match control value");
+				errno = EINVAL;
+				fail("bufp_ring_read");
+			}
+		}
+	}
+
+	smokey_trace("%s: received %ld values", __func__, control);
+
+	if (atomic_read(&map.ring->rdpos) != atomic_read(&map.ring->wrpos))
+		fail("fillsz");
+
+	bufp_unmap_ring(&map);
+	close(s);
+
+	return NULL;
+}
+
+static void *client(void *arg)
+{
+	struct sockaddr_ipc svsaddr;
+	struct bufp_map map;
+	long data = 0;
+	ssize_t n;
+	int ret, s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0)
+		fail("socket");
+
+	pthread_barrier_wait(&barrier);
+
+	memset(&svsaddr, 0, sizeof(svsaddr));
+	svsaddr.sipc_family = AF_RTIPC;
+	svsaddr.sipc_port = BUFP_MMAP_SVPORT;
+	ret = connect(s, (struct sockaddr *)&svsaddr, sizeof(svsaddr));
+	if (ret)
+		fail("connect");
+
+	/* Map the ring of the server we are connected to. */
+	ret = bufp_map_ring(s, &map);
+	if (ret)
+		fail("bufp_map_ring");
+
+	while (data < BUFP_MMAP_COUNT) {
+		data++;
+		/* Mix regular and mapped transfers over the ring. */
+		if ((data % 100) == 0)
+			n = send(s, &data, sizeof(data), 0);
+		else
+			n = bufp_ring_write(&map, &data, sizeof(data), 0);
+		if (n != sizeof(data))
+			fail("bufp_ring_write");
+	}
+
+	smokey_trace("%s: sent %ld values", __func__, data);
+
+	bufp_unmap_ring(&map);
+	close(s);
+
+	return NULL;
+}
+
+static int run_bufp_mmap(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param svparam = {.sched_priority = 71 };
+	struct sched_param clparam = {.sched_priority = 70 };
+	pthread_attr_t svattr, clattr;
+	int s, on = 1;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0) {
+		if (errno == EAFNOSUPPORT)
+			return -ENOSYS;
+	} else {
+		if (setsockopt(s, SOL_BUFP, BUFP_MMAP, &on, sizeof(on))) {
+			close(s);
+			return -ENOSYS;
+		}
+		close(s);
+	}
+
+	pthread_barrier_init(&barrier, NULL, 2);
+
+	pthread_attr_init(&svattr);
+	pthread_attr_setdetachstate(&svattr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&svattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&svattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&svattr, &svparam);
+
+	errno = pthread_create(&svtid, &svattr, &server, NULL);
+	if (errno)
+		fail("pthread_create");
+
+	pthread_attr_init(&clattr);
+	pthread_attr_setdetachstate(&clattr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&clattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&clattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&clattr, &clparam);
+
+	errno = pthread_create(&cltid, &clattr, &client, NULL);
+	if (errno)
+		fail("pthread_create");
+
+	pthread_join(cltid, NULL);
+	pthread_join(svtid, NULL);
+
+	pthread_barrier_destroy(&barrier);
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * RTIPC/IDDP batched I/O test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(iddp_mmsg,
+		   SMOKEY_NOARGS,
+		   "Check batched I/O over the RTIPC/IDDP protocol."
+);
+
+#define IDDP_MMSG_SVPORT 14
+#define IDDP_MMSG_CLPORT 15
+#define IDDP_MMSG_VLEN   20
+
+static void fail(const char *reason)
+{
+	perror(reason);
+	exit(EXIT_FAILURE);
+}
+
+static void *tester(void *arg)
+{
+	struct sockaddr_ipc svsaddr, clsaddr, from[IDDP_MMSG_VLEN];
+	struct mmsghdr msgvec[IDDP_MMSG_VLEN];
+	struct iovec iov[IDDP_MMSG_VLEN];
+	long data[IDDP_MMSG_VLEN], big[2];
+	int ret, sv, cl, n;
+
+	sv = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (sv < 0)
+		fail("socket");
+
+	svsaddr.sipc_family = AF_RTIPC;
+	svsaddr.sipc_port = IDDP_MMSG_SVPORT;
+	ret = bind(sv, (struct sockaddr *)&svsaddr, sizeof(svsaddr));
+	if (ret)
+		fail("bind");
+
+	cl = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (cl < 0)
+		fail("socket");
+
+	clsaddr.sipc_family = AF_RTIPC;
+	clsaddr.sipc_port = IDDP_MMSG_CLPORT;
+	ret = bind(cl, (struct sockaddr *)&clsaddr, sizeof(clsaddr));
+	if (ret)
+		fail("bind");
+
+	ret = connect(cl, (struct sockaddr *)&svsaddr, sizeof(svsaddr));
+	if (ret)
+		fail("connect");
+
+	/* Nothing queued yet, a non-blocking batch should fail. */
+	iov[0].iov_base = data;
+	iov[0].iov_len = sizeof(data[0]);
+	memset(msgvec, 0, sizeof(msgvec));
+	msgvec[0].msg_hdr.msg_iov = iov;
+	msgvec[0].msg_hdr.msg_iovlen = 1;
+	ret = recvmmsg(sv, msgvec, 1, MSG_DONTWAIT, NULL);
+	if (ret != -1 || errno != EAGAIN)
+		fail("recvmmsg");
+
+	/* Send more messages than a single kernel batch may carry. */
+	memset(msgvec, 0, sizeof(msgvec));
+	for (n = 0; n < IDDP_MMSG_VLEN; n++) {
+		data[n] = n + 1;
+		iov[n].iov_base = &data[n];
+		iov[n].iov_len = sizeof(data[n]);
+		msgvec[n].msg_hdr.msg_iov = &iov[n];
+		msgvec[n].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = sendmmsg(cl, msgvec, IDDP_MMSG_VLEN, 0);
+	if (ret != IDDP_MMSG_VLEN)
+		fail("sendmmsg");
+
+	for (n = 0; n < IDDP_MMSG_VLEN; n++) {
+		if (msgvec[n].msg_len != sizeof(data[n])) {
+			errno = EINVAL;
+			fail("sendmmsg");
+		}
+	}
+
+	memset(msgvec, 0, sizeof(msgvec));
+	for (n = 0; n < IDDP_MMSG_VLEN; n++) {
+		data[n] = 0;
+		iov[n].iov_base = &data[n];
+		iov[n].iov_len = sizeof(data[n]);
+		msgvec[n].msg_hdr.msg_iov = &iov[n];
+		msgvec[n].msg_hdr.msg_iovlen = 1;
+		msgvec[n].msg_hdr.msg_name = &from[n];
+		msgvec[n].msg_hdr.msg_namelen = sizeof(from[n]);
+	}
+
+	ret = recvmmsg(sv, msgvec, IDDP_MMSG_VLEN, MSG_WAITFORONE, NULL);
+	if (ret != IDDP_MMSG_VLEN)
+		fail("recvmmsg");
+
+	for (n = 0; n < IDDP_MMSG_VLEN; n++) {
+		if (msgvec[n].msg_len != sizeof(data[n]) ||
+		    data[n] != n + 1 ||
+		    from[n].sipc_port != IDDP_MMSG_CLPORT) {
+			smokey_note("message #%d does not match", n);
+			errno = EINVAL;
+			fail("recvmmsg");
+		}
+	}
+
+	/*
+	 * Receive a message into a too short buffer: the remainder
+	 * shall be delivered by the next call.
+	 */
+	big[0] = 1;
+	big[1] = 2;
+	ret = send(cl, big, sizeof(big), 0);
+	if (ret != sizeof(big))
+		fail("send");
+
+	big[0] = big[1] = 0;
+	memset(msgvec, 0, sizeof(msgvec));
+	iov[0].iov_base = &big[0];
+	iov[0].iov_len = sizeof(big[0]);
+	msgvec[0].msg_hdr.msg_iov = &iov[0];
+	msgvec[0].msg_hdr.msg_iovlen = 1;
+	iov[1].iov_base = &big[1];
+	iov[1].iov_len = sizeof(big[1]);
+	msgvec[1].msg_hdr.msg_iov = &iov[1];
+	msgvec[1].msg_hdr.msg_iovlen = 1;
+
+	ret = recvmmsg(sv, msgvec, 2, MSG_DONTWAIT, NULL);
+	if (ret != 1 || msgvec[0].msg_len != sizeof(big[0]) || big[0] != 1)
+		fail("recvmmsg");
+
+	ret = recvmmsg(sv, &msgvec[1], 1, MSG_DONTWAIT, NULL);
+	if (ret != 1 || msgvec[1].msg_len != sizeof(big[1]) || big[1] != 2)
+		fail("recvmmsg");
+
+	smokey_trace("%s: %d messages exchanged", __func__, IDDP_MMSG_VLEN + 1);
+
+	close(cl);
+	close(sv);
+
+	return NULL;
+}
+
+static int run_iddp_mmsg(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param param = {.sched_priority = 70 };
+	pthread_attr_t attr;
+	pthread_t tid;
+	int s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (s < 0) {
+		if (errno == EAFNOSUPPORT)
+			return -ENOSYS;
+	} else
+		close(s);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	errno = pthread_create(&tid, &attr, &tester, NULL);
+	if (errno)
+		fail("pthread_create");
+
+	pthread_join(tid, NULL);
+
+	return 0;
+}
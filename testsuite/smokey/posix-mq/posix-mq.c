@@ -0,0 +1,353 @@
+/*
+ * POSIX message queue fast path test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <boilerplate/atomic.h>
+#include <cobalt/sys/cobalt.h>
+#include <cobalt/uapi/syscall.h>
+#include <cobalt/uapi/mq.h>
+#include <asm/xenomai/syscall.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(posix_mq,
+		   SMOKEY_NOARGS,
+		   "Check the user-space fast path of message queues."
+);
+
+#define MQ_NAME		"/smokey-posix-mq"
+#define MQ_MAXMSG	4
+#define MQ_MSGSIZE	32
+#define MQ_ROUNDS	64
+
+extern void *cobalt_umm_private;
+
+static mqd_t mqd;
+
+static struct cobalt_mq_state *state;
+
+static inline struct cobalt_mq_cell *
+get_cells(struct cobalt_mq_ring *ring)
+{
+	return (void *)state + ring->cells_offset;
+}
+
+static inline struct cobalt_mq_msg *get_msg(__u32 index)
+{
+	return (void *)state + state->data_offset + index * state->msgsize;
+}
+
+static int send_msg(const char *text, unsigned int prio)
+{
+	return smokey_check_errno(mq_send(mqd, text, strlen(text) + 1, prio));
+}
+
+static int receive_msg(const char *expected, unsigned int expected_prio)
+{
+	char buf[MQ_MSGSIZE];
+	unsigned int prio;
+	ssize_t len;
+
+	len = mq_receive(mqd, buf, sizeof(buf), &prio);
+	if (len < 0)
+		return -errno;
+
+	if (!smokey_assert(len == (ssize_t)strlen(expected) + 1) ||
+	    !smokey_assert(strcmp(buf, expected) == 0) ||
+	    !smokey_assert(prio == expected_prio)) {
+		smokey_warning("received \"%.*s\" at prio %u, "
+			       "expected \"%s\" at prio %u",
+			       (int)len, buf, prio, expected, expected_prio);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * The queue should accept exactly MQ_MAXMSG messages, then deliver
+ * them in order, i.e. no slot leaked.
+ */
+static int check_slots(void)
+{
+	char text[MQ_MSGSIZE];
+	int n, ret;
+
+	for (n = 0; n < MQ_MAXMSG; n++) {
+		sprintf(text, "slot%d", n);
+		ret = send_msg(text, 0);
+		if (ret)
+			return ret;
+	}
+
+	if (!smokey_assert(mq_send(mqd, text, 1, 0) == -1 && errno == EAGAIN))
+		return -EINVAL;
+
+	for (n = 0; n < MQ_MAXMSG; n++) {
+		sprintf(text, "slot%d", n);
+		ret = receive_msg(text, 0);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Default priority traffic should not enter the kernel. */
+static int check_fastpath(void)
+{
+	struct cobalt_threadstat before, after;
+	char text[MQ_MSGSIZE];
+	int n, ret;
+
+	ret = cobalt_thread_stat(0, &before);
+	if (ret)
+		return ret;
+
+	for (n = 0; n < MQ_ROUNDS; n++) {
+		sprintf(text, "fast%d", n);
+		ret = send_msg(text, 0);
+		if (ret)
+			return ret;
+		ret = receive_msg(text, 0);
+		if (ret)
+			return ret;
+	}
+
+	ret = cobalt_thread_stat(0, &after);
+	if (ret)
+		return ret;
+
+	smokey_trace("%d messages, %llu syscalls", MQ_ROUNDS,
+		     (unsigned long long)(after.xsc - before.xsc));
+
+	if (!smokey_assert(after.xsc - before.xsc < MQ_ROUNDS))
+		return -EINVAL;
+
+	return check_slots();
+}
+
+/*
+ * Messages sent at non-zero priority are held by the kernel, and
+ * must be received before those waiting in the ring.
+ */
+static int check_prio_fallback(void)
+{
+	int ret;
+
+	ret = send_msg("low0", 0);
+	if (ret)
+		return ret;
+
+	ret = send_msg("high", 5);
+	if (ret)
+		return ret;
+
+	ret = send_msg("low1", 0);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(atomic_read(&state->nrprio) == 1))
+		return -EINVAL;
+
+	ret = receive_msg("high", 5);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(atomic_read(&state->nrprio) == 0))
+		return -EINVAL;
+
+	ret = receive_msg("low0", 0);
+	if (ret)
+		return ret;
+
+	ret = receive_msg("low1", 0);
+	if (ret)
+		return ret;
+
+	return check_slots();
+}
+
+/*
+ * Emulate a receiver preempted right after it claimed the head cell
+ * of the queued ring: the cell is not released until we say so.
+ */
+static int hold_queued_cell(__u32 *posp, __u32 *indexp)
+{
+	struct cobalt_mq_cell *cells = get_cells(&state->queued);
+	__u32 pos;
+
+	pos = atomic_read(&state->queued.head);
+	if (!smokey_assert(atomic_read(&cells[pos & state->mask].seq) ==
+			   pos + 1) ||
+	    !smokey_assert(atomic_cmpxchg(&state->queued.head,
+					  pos, pos + 1) == pos))
+		return -EINVAL;
+
+	*indexp = cells[pos & state->mask].index;
+	*posp = pos;
+	atomic_sub_fetch(&state->nrqueued, 1);
+
+	return 0;
+}
+
+static void release_queued_cell(__u32 pos)
+{
+	struct cobalt_mq_cell *cells = get_cells(&state->queued);
+
+	smp_mb();
+	atomic_set(&cells[pos & state->mask].seq, pos + state->mask + 1);
+}
+
+/*
+ * A sender which cannot push to the queued ring because of a cell
+ * still held from the previous lap hands its slot over to the
+ * kernel with COBALT_MQ_SEND, which spills it, and all messages
+ * sent after it until it is received, to its own list. A receiver
+ * in the same situation with the avail ring would hand its slot
+ * back with COBALT_MQ_FREE.
+ */
+static int check_spill(void)
+{
+	char text[MQ_MSGSIZE];
+	__u32 pos, index;
+	int n, ret;
+
+	ret = send_msg("held", 0);
+	if (ret)
+		return ret;
+
+	ret = hold_queued_cell(&pos, &index);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(strcmp(get_msg(index)->data, "held") == 0))
+		return -EINVAL;
+
+	/* Go round the ring, up to the held cell. */
+	for (n = 0; n < (int)state->mask; n++) {
+		sprintf(text, "lap%d", n);
+		ret = send_msg(text, 0);
+		if (ret)
+			return ret;
+		ret = receive_msg(text, 0);
+		if (ret)
+			return ret;
+	}
+
+	ret = send_msg("spill0", 0);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(state->flags & COBALT_MQ_SPILL))
+		return -EINVAL;
+
+	/* FIFO order is kept while the spill list drains. */
+	release_queued_cell(pos);
+
+	ret = send_msg("spill1", 0);
+	if (ret)
+		return ret;
+
+	ret = receive_msg("spill0", 0);
+	if (ret)
+		return ret;
+
+	ret = receive_msg("spill1", 0);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert((state->flags & COBALT_MQ_SPILL) == 0))
+		return -EINVAL;
+
+	/* Hand the slot we consumed back to the kernel. */
+	ret = XENOMAI_SYSCALL3(sc_cobalt_mq_wake, mqd, COBALT_MQ_FREE, index);
+	if (!smokey_assert(ret == 0))
+		return ret ?: -EINVAL;
+
+	return check_slots();
+}
+
+/*
+ * Closing the last descriptor of an unlinked queue frees its pool,
+ * which the fast path must not use anymore, whichever service
+ * closed the descriptor.
+ */
+static int check_close(void)
+{
+	char buf[MQ_MSGSIZE];
+	int ret;
+
+	ret = smokey_check_errno(mq_unlink(MQ_NAME));
+	if (ret)
+		return ret;
+
+	ret = smokey_check_errno(close(mqd));
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(mq_send(mqd, "stale", 6, 0) == -1 &&
+			   errno == EBADF) ||
+	    !smokey_assert(mq_receive(mqd, buf, sizeof(buf), NULL) == -1 &&
+			   errno == EBADF))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int run_posix_mq(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct mq_attr attr;
+	__u32 offset;
+	int ret;
+
+	mq_unlink(MQ_NAME);
+
+	attr.mq_maxmsg = MQ_MAXMSG;
+	attr.mq_msgsize = MQ_MSGSIZE;
+	mqd = mq_open(MQ_NAME, O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK,
+		      0600, &attr);
+	if (mqd == (mqd_t)-1)
+		return -errno;
+
+	ret = XENOMAI_SYSCALL2(sc_cobalt_mq_bind, mqd, &offset);
+	if (ret) {
+		smokey_note("posix_mq: message pool not mapped (%s)",
+			    strerror(-ret));
+		ret = -ENOSYS;
+		goto out;
+	}
+
+	state = cobalt_umm_private + offset;
+	if (!smokey_assert(state->maxmsg == MQ_MAXMSG) ||
+	    !smokey_assert(state->mask + 1 >= MQ_MAXMSG)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = check_fastpath();
+	if (ret)
+		goto out;
+
+	ret = check_prio_fallback();
+	if (ret)
+		goto out;
+
+	ret = check_spill();
+	if (ret)
+		goto out;
+
+	return check_close();
+out:
+	mq_close(mqd);
+	mq_unlink(MQ_NAME);
+
+	return ret;
+}
@@ -0,0 +1,217 @@
+/*
+ * Cobalt epoll services test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/cobalt.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(posix_epoll,
+		   SMOKEY_NOARGS,
+		   "Check Cobalt epoll services"
+);
+
+#define EPOLL_NR_TIMERS  32
+#define EPOLL_MQ_TAG     1000
+
+static int tfds[EPOLL_NR_TIMERS];
+
+static void timeout_in(struct timespec *ts, long ns)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static int arm_timer(int tfd, long ns)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_nsec = ns;
+
+	return smokey_check_errno(timerfd_settime(tfd, 0, &its, NULL));
+}
+
+static int poll_nothing(int epfd)
+{
+	struct timespec zero = { .tv_sec = 0, .tv_nsec = 0 };
+	struct epoll_event ev;
+	int ret;
+
+	ret = cobalt_epoll_wait(epfd, &ev, 1, &zero);
+	if (!smokey_assert(ret == 0))
+		return ret < 0 ? ret : -EINVAL;
+
+	return 0;
+}
+
+static int wait_one(int epfd, __u64 data, __u32 events)
+{
+	struct epoll_event ev[4];
+	struct timespec ts;
+	int ret;
+
+	timeout_in(&ts, 500000000);
+	ret = cobalt_epoll_wait(epfd, ev, 4, &ts);
+	if (!smokey_assert(ret == 1))
+		return ret < 0 ? ret : -EINVAL;
+
+	if (!smokey_assert(ev[0].data.u64 == data) ||
+	    !smokey_assert(ev[0].events == events))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int run_posix_epoll(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct epoll_event ev;
+	struct timespec ts;
+	struct mq_attr qa;
+	int epfd, ret, i;
+	__u64 ticks;
+	char buf[16];
+	mqd_t mq;
+
+	epfd = cobalt_epoll_create(0);
+	if (epfd == -ENOSYS)
+		return -ENOSYS;
+	if (!smokey_assert(epfd >= 0))
+		return epfd;
+
+	for (i = 0; i < EPOLL_NR_TIMERS; i++) {
+		tfds[i] = smokey_check_errno(timerfd_create(CLOCK_MONOTONIC, 0));
+		if (tfds[i] < 0)
+			return tfds[i];
+		/* Timerfds are never writable, EPOLLOUT is ignored. */
+		ev.events = EPOLLIN | EPOLLOUT;
+		ev.data.u64 = i;
+		ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_ADD, tfds[i], &ev);
+		if (!smokey_assert(ret == 0))
+			return ret;
+	}
+
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_ADD, tfds[0], &ev);
+	if (!smokey_assert(ret == -EEXIST))
+		return -EINVAL;
+
+	ev.events = EPOLLIN | EPOLLET;
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_MOD, tfds[0], &ev);
+	if (!smokey_assert(ret == -EINVAL))
+		return -EINVAL;
+
+	mq_unlink("/epoll_test_mq");
+	qa.mq_maxmsg = 4;
+	qa.mq_msgsize = sizeof(buf);
+	mq = smokey_check_errno(mq_open("/epoll_test_mq",
+					O_RDWR | O_CREAT | O_NONBLOCK, 0, &qa));
+	if (mq < 0)
+		return mq;
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = EPOLL_MQ_TAG;
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_ADD, mq, &ev);
+	if (!smokey_assert(ret == 0))
+		return ret;
+
+	ret = poll_nothing(epfd);
+	if (ret)
+		return ret;
+
+	/* A single timer among many fires. */
+	ret = arm_timer(tfds[EPOLL_NR_TIMERS / 2], 10000000);
+	if (ret)
+		return ret;
+
+	ret = wait_one(epfd, EPOLL_NR_TIMERS / 2, EPOLLIN);
+	if (ret)
+		return ret;
+
+	ret = smokey_check_errno(read(tfds[EPOLL_NR_TIMERS / 2],
+				      &ticks, sizeof(ticks)));
+	if (ret < 0)
+		return ret;
+
+	ret = poll_nothing(epfd);
+	if (ret)
+		return ret;
+
+	/* The message queue becomes readable. */
+	ret = smokey_check_errno(mq_send(mq, "epoll", sizeof("epoll"), 0));
+	if (ret < 0)
+		return ret;
+
+	ret = wait_one(epfd, EPOLL_MQ_TAG, EPOLLIN);
+	if (ret)
+		return ret;
+
+	ret = smokey_check_errno(mq_receive(mq, buf, sizeof(buf), NULL));
+	if (ret < 0)
+		return ret;
+
+	ret = poll_nothing(epfd);
+	if (ret)
+		return ret;
+
+	/* Timeout. */
+	timeout_in(&ts, 10000000);
+	ret = cobalt_epoll_wait(epfd, &ev, 1, &ts);
+	if (!smokey_assert(ret == 0))
+		return ret < 0 ? ret : -EINVAL;
+
+	/* Removed descriptors are not reported anymore. */
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_DEL, tfds[1], NULL);
+	if (!smokey_assert(ret == 0))
+		return ret;
+
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_DEL, tfds[1], NULL);
+	if (!smokey_assert(ret == -ENOENT))
+		return -EINVAL;
+
+	ret = arm_timer(tfds[1], 1000000);
+	if (ret)
+		return ret;
+
+	timeout_in(&ts, 10000000);
+	ret = cobalt_epoll_wait(epfd, &ev, 1, &ts);
+	if (!smokey_assert(ret == 0))
+		return ret < 0 ? ret : -EINVAL;
+
+	/* Closing a registered descriptor is reported as a hangup. */
+	close(tfds[2]);
+	ret = wait_one(epfd, 2, EPOLLHUP);
+	if (ret)
+		return ret;
+
+	ret = cobalt_epoll_ctl(epfd, EPOLL_CTL_DEL, tfds[2], NULL);
+	if (!smokey_assert(ret == 0))
+		return ret;
+
+	ret = poll_nothing(epfd);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < EPOLL_NR_TIMERS; i++)
+		if (i != 2)
+			close(tfds[i]);
+
+	mq_close(mq);
+	mq_unlink("/epoll_test_mq");
+	close(epfd);
+
+	return 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * Deferred output benchmark.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/cobalt.h>
+#include <cobalt/tunables.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(rtprintf,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+			   ),
+		   "Check rt_printf() output in binary mode, and compare its caller-side\n"
+		   "\tcost in text and binary modes."
+);
+
+/* Longer than the line the printer thread renders in binary mode. */
+#define LONG_OUTPUT	1500
+
+static off_t check_off;
+
+/*
+ * Compare the output @format produced to @expected, once the printer
+ * thread has flushed it.
+ */
+static int check_output(FILE *out, const char *format, const char *expected)
+{
+	static char output[LONG_OUTPUT * 2];
+	ssize_t len;
+
+	rt_print_flush_buffers();
+	fflush(out);
+
+	len = pread(fileno(out), output, sizeof(output) - 1, check_off);
+	if (len < 0)
+		return -errno;
+	check_off += len;
+	output[len] = '\0';
+
+	if (!smokey_assert(strcmp(output, expected) == 0)) {
+		smokey_warning("format \"%s\": got \"%s\", expected \"%s\"",
+			       format, output, expected);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Print @format both with rt_vfprintf() in binary mode and
+ * vsnprintf(), then compare the outputs. @deferred tells whether the
+ * call is expected to be deferred to the printer thread, or
+ * formatted in place.
+ */
+static int __attribute__((format(printf, 3, 4)))
+check_format(FILE *out, int deferred, const char *format, ...)
+{
+	static char expected[LONG_OUTPUT * 2];
+	va_list ap;
+	int ret;
+
+	va_start(ap, format);
+	ret = vsnprintf(expected, sizeof(expected), format, ap);
+	va_end(ap);
+	if (!smokey_assert(ret < (int)sizeof(expected)))
+		return -EINVAL;
+
+	va_start(ap, format);
+	ret = rt_vfprintf(out, format, ap);
+	va_end(ap);
+	if (!smokey_assert(ret == (deferred ? 0 : (int)strlen(expected)))) {
+		smokey_warning("format \"%s\": returned %d", format, ret);
+		return -EINVAL;
+	}
+
+	return check_output(out, format, expected);
+}
+
+static int check_binary(void)
+{
+	static char longstr[LONG_OUTPUT + 1];
+	char fmt[16] = { 0 };
+	short h = -1234;
+	char hh = -12;
+	FILE *out;
+	int ret;
+
+	out = tmpfile();
+	if (out == NULL)
+		return -errno;
+
+	memset(longstr, 'x', LONG_OUTPUT);
+	check_off = 0;
+	set_config_tunable(print_binary, 1);
+
+	ret = check_format(out, 1, "%d %i %u %x %X %o|\n",
+			   -42, 42, 42U, 0xbeef, 0xbeef, 8);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%hhd %hd %ld %lld %jd %zu %td|\n",
+			   hh, h, -123456789L, -1234567890123LL,
+			   (intmax_t)-42, sizeof(ret), (ptrdiff_t)-7);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%#x %#o %+d % d %-6d| %06d %'d|\n",
+			   255, 8, 1, 1, 12, -12, 1234567);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%c|%5c|%-3c|\n", 'a', 'b', 'c');
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%e %E %f %F %g %G %a %A|\n",
+			   3.14159, -2.5e-10, 1e10, -0.125, 1e-5, 123456789.0,
+			   1.0, -0.5);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%10.3f|%-10.2e|%.0f|%*.*f|\n",
+			   3.14159, 2.5, 0.5, 12, 4, 2.0 / 3);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%Lf %Le %Lg|\n",
+			   (long double)1 / 3, (long double)-1e100,
+			   (long double)2.5);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%p %p|\n", &ret, (void *)0);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "%s|%.3s|%-8s|%8s|%*s|%.*s|\n",
+			   "text", "truncated", "left", "right",
+			   6, "star", 2, "prec");
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 1, "100%%|%5.1f%%|\n", 99.5);
+	if (ret)
+		goto out;
+
+	/* Output the printer thread could not render in full. */
+	ret = check_format(out, 0, "%s|\n", longstr);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 0, "%*d|\n", LONG_OUTPUT, 1);
+	if (ret)
+		goto out;
+
+	ret = check_format(out, 0, "%f|\n", 1e300);
+	if (ret)
+		goto out;
+
+	/* The format may be reused as soon as rt_fprintf() returns. */
+	strcpy(fmt, "%d|%s|\n");
+	ret = rt_fprintf(out, fmt, 42, "stack");
+	memset(fmt, '%', sizeof(fmt) - 1);
+	if (!smokey_assert(ret == 0)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = check_output(out, "%d|%s|\n", "42|stack|\n");
+out:
+	set_config_tunable(print_binary, 0);
+	fclose(out);
+
+	return ret;
+}
+
+/*
+ * Calls are issued by batches small enough for the output of a
+ * whole batch to fit in the default relay buffer, which is flushed
+ * in between, so that no call is measured over a full ring.
+ */
+#define BATCH	32
+
+struct bench_stat {
+	long long min;
+	long long max;
+	long long sum;
+	long long count;
+};
+
+static inline long long diff_ts(const struct timespec *left,
+				const struct timespec *right)
+{
+	return (long long)(left->tv_sec - right->tv_sec) * ONE_BILLION
+		+ left->tv_nsec - right->tv_nsec;
+}
+
+static void bench_mode(FILE *out, int binary, int loops,
+		       struct bench_stat *stat)
+{
+	static const char label[] = "control loop overrun";
+	struct timespec start, end;
+	long long d;
+	int n, b;
+
+	set_config_tunable(print_binary, binary);
+
+	stat->min = -1;
+	stat->max = 0;
+	stat->sum = 0;
+	stat->count = 0;
+
+	for (n = 0; n < loops; n++) {
+		cobalt_thread_harden();
+		for (b = 0; b < BATCH; b++) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			rt_fprintf(out, "[%d] %s: cycle=%lu, lat=%.3f us, ptr=%p\n",
+				   b, label, (unsigned long)n * BATCH + b,
+				   (double)b / 3, stat);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			d = diff_ts(&end, &start);
+			if (stat->min < 0 || d < stat->min)
+				stat->min = d;
+			if (d > stat->max)
+				stat->max = d;
+			stat->sum += d;
+			stat->count++;
+		}
+		rt_print_flush_buffers();
+	}
+
+	set_config_tunable(print_binary, 0);
+}
+
+static int run_rtprintf(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct bench_stat text, binary;
+	struct sched_param param;
+	int ret, loops, oldmode;
+	FILE *out;
+
+	smokey_parse_args(t, argc, argv);
+
+	loops = SMOKEY_ARG_ISSET(rtprintf, loops) ?
+		SMOKEY_ARG_INT(rtprintf, loops) : 100;
+	if (loops <= 0)
+		return -EINVAL;
+
+	out = fopen("/dev/null", "w");
+	if (out == NULL)
+		return -errno;
+
+	param.sched_priority = 50;
+	ret = smokey_check_status(pthread_setschedparam(pthread_self(),
+							SCHED_FIFO, &param));
+	if (ret)
+		goto out;
+
+	oldmode = get_config_tunable(print_binary);
+
+	ret = check_binary();
+	if (ret) {
+		set_config_tunable(print_binary, oldmode);
+		goto out;
+	}
+
+	/* Warm up the relay buffer and the caches. */
+	bench_mode(out, 0, 1, &text);
+
+	bench_mode(out, 0, loops, &text);
+	bench_mode(out, 1, loops, &binary);
+
+	set_config_tunable(print_binary, oldmode);
+
+	smokey_trace("text:   min %Ld ns, avg %Ld ns, max %Ld ns",
+		     text.min, text.sum / text.count, text.max);
+	smokey_trace("binary: min %Ld ns, avg %Ld ns, max %Ld ns",
+		     binary.min, binary.sum / binary.count, binary.max);
+out:
+	fclose(out);
+
+	return ret;
+}
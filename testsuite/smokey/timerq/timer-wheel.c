@@ -0,0 +1,244 @@
+/*
+ * Coarse timer test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(timer_wheel,
+		   SMOKEY_NOARGS,
+		   "Check timeouts, which may go through the timer wheel."
+);
+
+/*
+ * Blocking calls are timed by a coarse timer, which is parked into
+ * the timer wheel if CONFIG_XENO_OPT_TIMER_WHEEL is enabled. The
+ * timeouts below span several levels of the wheel with the default
+ * resolution, so that both expiry and cascading are exercised, along
+ * with timers cancelled before they elapse. Timeouts are based on
+ * CLOCK_MONOTONIC, since CLOCK_REALTIME timers bypass the wheel.
+ */
+#define WHEEL_NR_WAITERS	8
+#define WHEEL_MAX_LATENESS	10000000LL	/* 10 ms */
+
+static const long long timeouts_ns[WHEEL_NR_WAITERS] = {
+	2000000LL, 7000000LL, 30000000LL, 120000000LL,
+	270000000LL, 400000000LL, 750000000LL, 1300000000LL,
+};
+
+struct waiter {
+	pthread_t tid;
+	long long timeout_ns;
+	long long elapsed_ns;
+	int ret;
+};
+
+static struct waiter waiters[WHEEL_NR_WAITERS];
+
+static pthread_mutex_t lock;
+
+static pthread_cond_t cond;
+
+static int posted;
+
+/* -ENOENT if the timer wheel is not built in. */
+static int read_wheel_occupancy(int *nr)
+{
+	char buf[128];
+	int ret = -ENOENT;
+	FILE *fp;
+
+	fp = fopen("/proc/xenomai/clock/coreclk", "r");
+	if (fp == NULL)
+		return -errno;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, " wheel: %d", nr) == 1) {
+			ret = 0;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return ret;
+}
+
+static inline long long diff_ts(const struct timespec *left,
+				const struct timespec *right)
+{
+	return (long long)(left->tv_sec - right->tv_sec) * ONE_BILLION
+		+ left->tv_nsec - right->tv_nsec;
+}
+
+static inline void add_ns(struct timespec *ts, long long ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / ONE_BILLION;
+	ts->tv_nsec = ns % ONE_BILLION;
+}
+
+static void *waiter_thread(void *arg)
+{
+	struct timespec start, end, timeout;
+	struct waiter *w = arg;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	timeout = start;
+	add_ns(&timeout, w->timeout_ns);
+	pthread_mutex_lock(&lock);
+	w->ret = 0;
+	while (!posted && w->ret == 0)
+		w->ret = pthread_cond_timedwait(&cond, &lock, &timeout);
+	pthread_mutex_unlock(&lock);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	w->elapsed_ns = diff_ts(&end, &start);
+
+	return NULL;
+}
+
+static int start_waiters(long long scale)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	int n, ret;
+
+	posted = 0;
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = 50;
+	pthread_attr_setschedparam(&attr, &param);
+
+	for (n = 0; n < WHEEL_NR_WAITERS; n++) {
+		waiters[n].timeout_ns = timeouts_ns[n] * scale;
+		ret = -pthread_create(&waiters[n].tid, &attr,
+				      waiter_thread, &waiters[n]);
+		if (ret)
+			return ret;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	return 0;
+}
+
+static void join_waiters(void)
+{
+	int n;
+
+	for (n = 0; n < WHEEL_NR_WAITERS; n++)
+		pthread_join(waiters[n].tid, NULL);
+}
+
+/* All timeouts elapse on time, neither early nor late. */
+static int check_expiry(void)
+{
+	struct waiter *w;
+	int n, ret;
+
+	ret = start_waiters(1);
+	if (ret)
+		return ret;
+
+	join_waiters();
+
+	for (n = 0; n < WHEEL_NR_WAITERS; n++) {
+		w = waiters + n;
+		smokey_trace("timeout %lld us, elapsed %lld us",
+			     w->timeout_ns / 1000, w->elapsed_ns / 1000);
+		if (!smokey_assert(w->ret == ETIMEDOUT) ||
+		    !smokey_assert(w->elapsed_ns >= w->timeout_ns) ||
+		    !smokey_assert(w->elapsed_ns <
+				   w->timeout_ns + WHEEL_MAX_LATENESS))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Timeouts cancelled before they elapse are dropped from the wheel,
+ * and leave it in a sane state for the next ones. All but the
+ * shortest timeouts are still pending when we look at the wheel,
+ * far enough from expiry to be parked there.
+ */
+static int check_cancel(void)
+{
+	struct timespec delay = { .tv_sec = 0, .tv_nsec = 20000000 };
+	int n, ret, nr_before = 0, nr = 0;
+	struct waiter *w;
+
+	ret = read_wheel_occupancy(&nr_before);
+	if (ret == -ENOENT)
+		smokey_note("timer_wheel: CONFIG_XENO_OPT_TIMER_WHEEL disabled");
+	else if (ret)
+		smokey_note("timer_wheel: cannot read wheel occupancy (%s)",
+			    strerror(-ret));
+
+	ret = start_waiters(10);
+	if (ret)
+		return ret;
+
+	nanosleep(&delay, NULL);
+
+	if (read_wheel_occupancy(&nr) == 0) {
+		smokey_trace("%d timers in the wheel, %d before",
+			     nr, nr_before);
+		if (!smokey_assert(nr - nr_before >= WHEEL_NR_WAITERS - 2))
+			ret = -EINVAL;
+	}
+
+	pthread_mutex_lock(&lock);
+	posted = 1;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+
+	join_waiters();
+
+	if (ret)
+		return ret;
+
+	for (n = 0; n < WHEEL_NR_WAITERS; n++) {
+		w = waiters + n;
+		if (!smokey_assert(w->ret == 0) ||
+		    !smokey_assert(w->elapsed_ns < w->timeout_ns))
+			return -EINVAL;
+	}
+
+	return check_expiry();
+}
+
+static int run_timer_wheel(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param param;
+	pthread_condattr_t cattr;
+	int ret;
+
+	pthread_mutex_init(&lock, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	param.sched_priority = 60;
+	ret = -pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (ret)
+		return ret;
+
+	ret = check_expiry();
+	if (ret == 0)
+		ret = check_cancel();
+
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&lock);
+
+	return ret;
+}
@@ -0,0 +1,261 @@
+/*
+ * Timer queue benchmark.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/cobalt.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(timerq,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(timers),
+			   SMOKEY_INT(loops),
+			   ),
+		   "Measure the insertion and expiry costs of the core timer queue."
+);
+
+/*
+ * The timer queue backend is a build-time option of the Cobalt
+ * core, so comparing the linear, heap and rbtree indexing methods
+ * means running this test over kernels built with each of them in
+ * turn. Figures include the syscall overhead for arming/disarming,
+ * which is constant across backends.
+ *
+ * Timerfds are used, since their count is not bounded by the
+ * per-process limit on POSIX timers. Unless a timer count is given,
+ * a first run loads the queue up to the capacity of the binary heap
+ * (or its default capacity for other backends), then a second run
+ * loads it with several times as many timers, which only the list
+ * and rbtree backends can index.
+ */
+#define TIMERQ_DEFAULT_NR	256
+#define TIMERQ_BEYOND		3
+
+static const char *index_names[] = {
+	[_CC_COBALT_TIMER_LIST] = "list",
+	[_CC_COBALT_TIMER_HEAP] = "heap",
+	[_CC_COBALT_TIMER_RBTREE] = "rbtree",
+};
+
+static int *timers;
+
+static inline long long diff_ts(const struct timespec *left,
+				const struct timespec *right)
+{
+	return (long long)(left->tv_sec - right->tv_sec) * ONE_BILLION
+		+ left->tv_nsec - right->tv_nsec;
+}
+
+static inline void add_ns(struct timespec *ts, long long ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / ONE_BILLION;
+	ts->tv_nsec = ns % ONE_BILLION;
+}
+
+static int arm_timer(int t, const struct timespec *date)
+{
+	struct itimerspec its;
+
+	its.it_value = *date;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+
+	return smokey_check_errno(timerfd_settime(t, TFD_TIMER_ABSTIME,
+						  &its, NULL));
+}
+
+static int disarm_timer(int t)
+{
+	struct itimerspec its;
+
+	its.it_value.tv_sec = 0;
+	its.it_value.tv_nsec = 0;
+	its.it_interval = its.it_value;
+
+	return smokey_check_errno(timerfd_settime(t, 0, &its, NULL));
+}
+
+/*
+ * Arm all timers at random dates far enough in the future, then
+ * disarm them. Returns the average cost of a single insertion and
+ * removal, in nanoseconds.
+ */
+static int bench_insert(int nr, int loops,
+			long long *ins_ns, long long *rem_ns)
+{
+	struct timespec now, start, end, date;
+	long long ins = 0, rem = 0;
+	int n, l, ret;
+
+	for (l = 0; l < loops; l++) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		add_ns(&now, 10LL * ONE_BILLION);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < nr; n++) {
+			date = now;
+			add_ns(&date, lrand48() % ONE_BILLION);
+			ret = arm_timer(timers[n], &date);
+			if (ret)
+				return ret;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ins += diff_ts(&end, &start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < nr; n++) {
+			ret = disarm_timer(timers[n]);
+			if (ret)
+				return ret;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		rem += diff_ts(&end, &start);
+	}
+
+	*ins_ns = ins / ((long long)nr * loops);
+	*rem_ns = rem / ((long long)nr * loops);
+
+	return 0;
+}
+
+/*
+ * Arm all timers to elapse at the same date, and spin on the clock
+ * across that date. The largest gap observed in the time line is
+ * the time spent by the core in the timer interrupt, dequeuing and
+ * firing every expired timer.
+ */
+static int bench_expire(int nr, int loops, long long *exp_ns)
+{
+	struct timespec date, now, prev;
+	long long gap, max_gap, total = 0;
+	int n, l, ret;
+
+	for (l = 0; l < loops; l++) {
+		clock_gettime(CLOCK_MONOTONIC, &date);
+		add_ns(&date, 10000000);
+		for (n = 0; n < nr; n++) {
+			ret = arm_timer(timers[n], &date);
+			if (ret)
+				return ret;
+		}
+
+		max_gap = 0;
+		clock_gettime(CLOCK_MONOTONIC, &prev);
+		for (;;) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			gap = diff_ts(&now, &prev);
+			if (gap > max_gap)
+				max_gap = gap;
+			prev = now;
+			if (diff_ts(&now, &date) > 1000000)
+				break;
+		}
+		total += max_gap;
+	}
+
+	*exp_ns = total / loops;
+
+	return 0;
+}
+
+static int run_bench(int index, int nr, int loops)
+{
+	long long ins_ns, rem_ns, exp_ns;
+	int ret = 0, n;
+
+	timers = malloc(sizeof(int) * nr);
+	if (timers == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < nr; n++) {
+		timers[n] = smokey_check_errno(timerfd_create(CLOCK_MONOTONIC, 0));
+		if (timers[n] < 0) {
+			ret = timers[n];
+			goto out;
+		}
+	}
+
+	smokey_trace("timer queue indexing: %s, %d timers, %d loops",
+		     index < 3 ? index_names[index] : "unknown", nr, loops);
+
+	srand48(nr);
+
+	ret = bench_insert(nr, loops, &ins_ns, &rem_ns);
+	if (ret)
+		goto out;
+
+	ret = bench_expire(nr, loops, &exp_ns);
+	if (ret)
+		goto out;
+
+	smokey_trace("insert: %Ld ns/timer, remove: %Ld ns/timer",
+		     ins_ns, rem_ns);
+	smokey_trace("expire: %Ld ns for %d timers, %Ld ns/timer",
+		     exp_ns, nr, exp_ns / nr);
+out:
+	while (--n >= 0)
+		close(timers[n]);
+
+	free(timers);
+
+	return ret;
+}
+
+static int run_timerq(struct smokey_test *t, int argc, char *const argv[])
+{
+	int ret, index, capacity, nr, loops;
+	struct sched_param param;
+
+	smokey_parse_args(t, argc, argv);
+
+	ret = cobalt_corectl(_CC_COBALT_GET_TIMER_INDEX, &index, sizeof(index));
+	if (ret)
+		return -ENOSYS;
+
+	/* Timers beyond the heap capacity would not be queued. */
+	ret = cobalt_corectl(_CC_COBALT_GET_TIMER_CAPACITY,
+			     &capacity, sizeof(capacity));
+	if (ret)
+		return ret;
+
+	loops = SMOKEY_ARG_ISSET(timerq, loops) ?
+		SMOKEY_ARG_INT(timerq, loops) : 10;
+	if (loops <= 0)
+		return -EINVAL;
+
+	param.sched_priority = 50;
+	ret = smokey_check_status(pthread_setschedparam(pthread_self(),
+							SCHED_FIFO, &param));
+	if (ret)
+		return ret;
+
+	if (SMOKEY_ARG_ISSET(timerq, timers)) {
+		nr = SMOKEY_ARG_INT(timerq, timers);
+		if (nr <= 0 || (capacity > 0 && nr > capacity)) {
+			smokey_warning("timer count out of range [1..%d]",
+				       capacity);
+			return -EINVAL;
+		}
+		return run_bench(index, nr, loops);
+	}
+
+	nr = capacity > 0 ? capacity : TIMERQ_DEFAULT_NR;
+	ret = run_bench(index, nr, loops);
+	if (ret)
+		return ret;
+
+	if (capacity > 0) {
+		smokey_trace("%s indexing is limited to %d timers",
+			     index_names[index], capacity);
+		return 0;
+	}
+
+	return run_bench(index, nr * TIMERQ_BEYOND, loops);
+}
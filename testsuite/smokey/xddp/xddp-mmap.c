@@ -0,0 +1,233 @@
+/*
+ * RTIPC/XDDP mapped ring test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <semaphore.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(xddp_mmap,
+		   SMOKEY_NOARGS,
+		   "Check RTIPC/XDDP protocol over a mapped ring."
+);
+
+#define XDDP_MMAP_RINGSZ  4096
+#define XDDP_MMAP_COUNT   10000
+
+static pthread_t rt, nrt;
+
+static sem_t rtsync, nrtsync;
+
+static int port;
+
+static unsigned int drops;
+
+static void fail(const char *reason)
+{
+	perror(reason);
+	exit(EXIT_FAILURE);
+}
+
+static void sem_sync(sem_t *sem)
+{
+	int ret;
+
+	for (;;) {
+		ret = sem_wait(sem);
+		if (ret == 0)
+			return;
+		if (errno != EINTR)
+			fail("sem_wait");
+	}
+}
+
+static void *realtime_thread(void *arg)
+{
+	struct sockaddr_ipc saddr;
+	socklen_t addrlen, optlen;
+	size_t ringsz, mapsz;
+	struct timespec ts;
+	long data = 0;
+	int ret, s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_XDDP);
+	if (s < 0)
+		fail("socket");
+
+	ringsz = XDDP_MMAP_RINGSZ;
+	ret = setsockopt(s, SOL_XDDP, XDDP_MMAP, &ringsz, sizeof(ringsz));
+	if (ret)
+		fail("setsockopt");
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = -1;
+	ret = bind(s, (struct sockaddr *)&saddr, sizeof(saddr));
+	if (ret)
+		fail("bind");
+
+	optlen = sizeof(mapsz);
+	ret = getsockopt(s, SOL_XDDP, XDDP_MMAP, &mapsz, &optlen);
+	if (ret)
+		fail("getsockopt");
+	if (mapsz <= XDDP_MMAP_RINGSZ) {
+		errno = EINVAL;
+		fail("getsockopt");
+	}
+
+	addrlen = sizeof(saddr);
+	ret = getsockname(s, (struct sockaddr *)&saddr, &addrlen);
+	if (ret || addrlen != sizeof(saddr))
+		fail("getsockname");
+
+	port = saddr.sipc_port;
+	sem_post(&rtsync);	/* Tell the reader which device to map. */
+	sem_sync(&nrtsync);	/* Wait for the ring to be mapped. */
+
+	ret = sendto(s, &data, sizeof(data), MSG_OOB, NULL, 0);
+	if (ret != -1 || errno != EOPNOTSUPP)
+		fail("sendto");
+
+	while (data < XDDP_MMAP_COUNT) {
+		data++;
+		ret = sendto(s, &data, sizeof(data), 0, NULL, 0);
+		if (ret == sizeof(data))
+			continue;
+		if (ret != -1 || errno != ENOMEM)
+			fail("sendto");
+		/* Ring full, give the reader some time to catch up. */
+		drops++;
+		data--;
+		ts.tv_sec = 0;
+		ts.tv_nsec = 1000000;
+		clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+	}
+
+	smokey_trace("%s: sent %ld values, %u retries",
+		     __func__, data, drops);
+
+	sem_sync(&nrtsync);	/* Wait for the output to drain. */
+	close(s);
+
+	return NULL;
+}
+
+static void *regular_thread(void *arg)
+{
+	long control = 0, *data;
+	struct xddp_map map;
+	ssize_t wakeups = 0;
+	char *devname;
+	size_t len;
+	int fd;
+
+	sem_sync(&rtsync);
+
+	if (asprintf(&devname, "/dev/rtp%d", port) < 0)
+		fail("asprintf");
+
+	fd = open(devname, O_RDWR);
+	free(devname);
+	if (fd < 0)
+		fail("open");
+
+	if (xddp_map_ring(fd, &map))
+		fail("xddp_map_ring");
+
+	if (map.ring->bufsz != XDDP_MMAP_RINGSZ) {
+		errno = EINVAL;
+		fail("bufsz");
+	}
+
+	sem_post(&nrtsync);
+
+	while (control < XDDP_MMAP_COUNT) {
+		/* Consume in place until the ring is empty. */
+		while ((data = xddp_ring_peek(&map, &len)) != NULL) {
+			if (len != sizeof(*data) || *data != ++control) {
+				smokey_note("data does not match control value");
+				errno = EINVAL;
+				fail("xddp_ring_peek");
+			}
+			xddp_ring_release(&map);
+		}
+		if (control < XDDP_MMAP_COUNT) {
+			if (xddp_ring_wait(&map) < 0)
+				fail("xddp_ring_wait");
+			wakeups++;
+		}
+	}
+
+	smokey_trace("%s: received %ld values, %zd wakeups",
+		     __func__, control, wakeups);
+
+	if (map.ring->dropped != drops) {
+		smokey_note("drop count does not match");
+		errno = EINVAL;
+		fail("dropped");
+	}
+
+	xddp_unmap_ring(&map);
+	close(fd);
+	sem_post(&nrtsync);
+
+	return NULL;
+}
+
+static int run_xddp_mmap(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param param = { .sched_priority = 42 };
+	pthread_attr_t rtattr, regattr;
+	size_t ringsz = XDDP_MMAP_RINGSZ;
+	int s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_XDDP);
+	if (s < 0) {
+		if (errno == EAFNOSUPPORT)
+			return -ENOSYS;
+	} else {
+		if (setsockopt(s, SOL_XDDP, XDDP_MMAP, &ringsz, sizeof(ringsz))) {
+			close(s);
+			return -ENOSYS;
+		}
+		close(s);
+	}
+
+	sem_init(&rtsync, 0, 0);
+	sem_init(&nrtsync, 0, 0);
+
+	pthread_attr_init(&rtattr);
+	pthread_attr_setdetachstate(&rtattr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&rtattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&rtattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&rtattr, &param);
+
+	errno = pthread_create(&rt, &rtattr, &realtime_thread, NULL);
+	if (errno)
+		fail("pthread_create");
+
+	pthread_attr_init(&regattr);
+	pthread_attr_setdetachstate(&regattr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&regattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&regattr, SCHED_OTHER);
+
+	errno = pthread_create(&nrt, &regattr, &regular_thread, NULL);
+	if (errno)
+		fail("pthread_create");
+
+	pthread_join(nrt, NULL);
+	pthread_join(rt, NULL);
+
+	sem_destroy(&nrtsync);
+	sem_destroy(&rtsync);
+
+	return 0;
+}
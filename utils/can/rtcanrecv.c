@@ -5,6 +5,8 @@
 #include <time.h>
 #include <errno.h>
 #include <getopt.h>
+#include <sys/mman.h>
+#include <sys/select.h>
 
 #include <alchemy/task.h>
 
@@ -22,6 +24,7 @@ static void print_usage(char *prg)
 	    " -R, --timestamp-rel   with relative timestamp\n"
 	    " -v, --verbose         be verbose\n"
 	    " -p, --print=MODULO    print every MODULO message\n"
+	    " -m, --mmap=FRAMES     receive through a mapped ring of FRAMES slots\n"
 	    " -h, --help            this help\n",
 	    prg);
 }
@@ -31,6 +34,8 @@ extern int optind, opterr, optopt;
 
 static int s = -1, verbose = 0, print = 1;
 static nanosecs_rel_t timeout = 0, with_timestamp = 0, timestamp_rel = 0;
+static int ring_frames = 0;
+static struct can_ring_header *ring;
 
 RT_TASK rt_task_desc;
 
@@ -77,15 +82,93 @@ static void cleanup_and_exit(int sig)
     exit(0);
 }
 
+static void print_frame(int count, int ifindex, struct can_frame *frame,
+			int has_timestamp, nanosecs_abs_t timestamp)
+{
+    static nanosecs_abs_t timestamp_prev = 0;
+    int i;
+
+    printf("#%d: (%d) ", count, ifindex);
+    if (has_timestamp) {
+	if (timestamp_rel) {
+	    printf("%lldns ", (long long)(timestamp - timestamp_prev));
+	    timestamp_prev = timestamp;
+	} else
+	    printf("%lldns ", (long long)timestamp);
+    }
+    if (frame->can_id & CAN_ERR_FLAG)
+	printf("!0x%08x!", frame->can_id & CAN_ERR_MASK);
+    else if (frame->can_id & CAN_EFF_FLAG)
+	printf("<0x%08x>", frame->can_id & CAN_EFF_MASK);
+    else
+	printf("<0x%03x>", frame->can_id & CAN_SFF_MASK);
+
+    printf(" [%d]", frame->can_dlc);
+    if (!(frame->can_id & CAN_RTR_FLAG))
+	for (i = 0; i < frame->can_dlc; i++) {
+	    printf(" %02x", frame->data[i]);
+	}
+    if (frame->can_id & CAN_ERR_FLAG) {
+	printf(" ERROR ");
+	if (frame->can_id & CAN_ERR_BUSOFF)
+	    printf("bus-off");
+	if (frame->can_id & CAN_ERR_CRTL)
+	    printf("controller problem");
+    } else if (frame->can_id & CAN_RTR_FLAG)
+	printf(" remote request");
+    printf("\n");
+}
+
+static void rt_task_ring(void)
+{
+    struct can_ring_frame *slot;
+    struct timeval tv, *ptv;
+    uint32_t head = ring->head;
+    int ret, count = 0;
+    fd_set rfds;
+
+    while (1) {
+	/* Consume all frames available, then publish our position */
+	while (head != ring->tail) {
+	    __sync_synchronize();
+	    slot = CAN_RING_FRAME(ring, head);
+	    if (print && (count % print) == 0)
+		print_frame(count, slot->can_ifindex, &slot->frame,
+			    with_timestamp, slot->timestamp);
+	    count++;
+	    head++;
+	}
+	ring->head = head;
+
+	FD_ZERO(&rfds);
+	FD_SET(s, &rfds);
+	ptv = NULL;
+	if (timeout) {
+	    tv.tv_sec = timeout / 1000000000;
+	    tv.tv_usec = (timeout % 1000000000) / 1000;
+	    ptv = &tv;
+	}
+	ret = select(s + 1, &rfds, NULL, NULL, ptv);
+	if (ret < 0) {
+	    fprintf(stderr, "select: %s\n", strerror(errno));
+	    break;
+	}
+	if (ret == 0 && verbose)
+	    printf("select: timed out\n");
+	if (ring->dropped && verbose)
+	    printf("ring: %u frames dropped\n", ring->dropped);
+    }
+}
+
 static void rt_task(void)
 {
-    int i, ret, count = 0;
+    int ret, count = 0;
     struct can_frame frame;
     struct sockaddr_can addr;
     socklen_t addrlen = sizeof(addr);
     struct msghdr msg;
     struct iovec iov;
-    nanosecs_abs_t timestamp, timestamp_prev = 0;
+    nanosecs_abs_t timestamp;
 
     if (with_timestamp) {
 	msg.msg_iov = &iov;
@@ -120,37 +203,9 @@ static void rt_task(void)
 	    break;
 	}
 
-	if (print && (count % print) == 0) {
-	    printf("#%d: (%d) ", count, addr.can_ifindex);
-	    if (with_timestamp && msg.msg_controllen) {
-		if (timestamp_rel) {
-		printf("%lldns ", (long long)(timestamp - timestamp_prev));
-		    timestamp_prev = timestamp;
-		} else
-		    printf("%lldns ", (long long)timestamp);
-	    }
-	    if (frame.can_id & CAN_ERR_FLAG)
-		printf("!0x%08x!", frame.can_id & CAN_ERR_MASK);
-	    else if (frame.can_id & CAN_EFF_FLAG)
-		printf("<0x%08x>", frame.can_id & CAN_EFF_MASK);
-	    else
-		printf("<0x%03x>", frame.can_id & CAN_SFF_MASK);
-
-	    printf(" [%d]", frame.can_dlc);
-	    if (!(frame.can_id & CAN_RTR_FLAG))
-		for (i = 0; i < frame.can_dlc; i++) {
-		    printf(" %02x", frame.data[i]);
-		}
-	    if (frame.can_id & CAN_ERR_FLAG) {
-		printf(" ERROR ");
-		if (frame.can_id & CAN_ERR_BUSOFF)
-		    printf("bus-off");
-		if (frame.can_id & CAN_ERR_CRTL)
-		    printf("controller problem");
-	    } else if (frame.can_id & CAN_RTR_FLAG)
-		printf(" remote request");
-	    printf("\n");
-	}
+	if (print && (count % print) == 0)
+	    print_frame(count, addr.can_ifindex, &frame,
+			with_timestamp && msg.msg_controllen, timestamp);
 	count++;
     }
 }
@@ -172,13 +227,14 @@ int main(int argc, char **argv)
 	{ "timeout", required_argument, 0, 't'},
 	{ "timestamp", no_argument, 0, 'T'},
 	{ "timestamp-rel", no_argument, 0, 'R'},
+	{ "mmap", required_argument, 0, 'm'},
 	{ 0, 0, 0, 0},
     };
 
     signal(SIGTERM, cleanup_and_exit);
     signal(SIGINT, cleanup_and_exit);
 
-    while ((opt = getopt_long(argc, argv, "hve:f:t:p:RT",
+    while ((opt = getopt_long(argc, argv, "hve:f:t:p:m:RT",
 			      long_options, NULL)) != -1) {
 	switch (opt) {
 	case 'h':
@@ -189,6 +245,10 @@ int main(int argc, char **argv)
 	    print = strtoul(optarg, NULL, 0);
 	    break;
 
+	case 'm':
+	    ring_frames = strtoul(optarg, NULL, 0);
+	    break;
+
 	case 'v':
 	    verbose = 1;
 	    break;
@@ -280,6 +340,23 @@ int main(int argc, char **argv)
 	}
     }
 
+    if (ring_frames) {
+	ret = setsockopt(s, SOL_CAN_RAW, CAN_RAW_RX_RING,
+			 &ring_frames, sizeof(ring_frames));
+	if (ret < 0) {
+	    fprintf(stderr, "setsockopt: %s\n", strerror(-ret));
+	    goto failure;
+	}
+	ring = mmap(NULL, CAN_RING_SIZE(ring_frames), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, s, 0);
+	if (ring == MAP_FAILED) {
+	    fprintf(stderr, "mmap: %s\n", strerror(errno));
+	    goto failure;
+	}
+	if (verbose)
+	    printf("Using a receive ring of %d frames\n", ring_frames);
+    }
+
     recv_addr.can_family = AF_CAN;
     recv_addr.can_ifindex = ifr.ifr_ifindex;
     ret = bind(s, (struct sockaddr *)&recv_addr,
@@ -299,7 +376,7 @@ int main(int argc, char **argv)
 	}
     }
 
-    if (with_timestamp) {
+    if (with_timestamp && !ring_frames) {
 	ret = ioctl(s, RTCAN_RTIOC_TAKE_TIMESTAMP, RTCAN_TAKE_TIMESTAMPS);
 	if (ret) {
 	    fprintf(stderr, "ioctl TAKE_TIMESTAMP: %s\n", strerror(-ret));
@@ -314,7 +391,10 @@ int main(int argc, char **argv)
 	goto failure;
     }
 
-    rt_task();
+    if (ring_frames)
+	rt_task_ring();
+    else
+	rt_task();
     /* never returns */
 
  failure:
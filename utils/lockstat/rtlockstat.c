@@ -0,0 +1,353 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * This utility parses the output of the /proc/xenomai/synch vfile,
+ * to list the most contended synchronization objects.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <errno.h>
+#include <getopt.h>
+
+#define PROC_SYNCH  "/proc/xenomai/synch"
+
+#define SYNCH_BUCKETS  16
+
+#define SYNCH_FMT   "%u %d %1s %lu %lu %lu %lu %llu %llu %llu %llu %llu %llu %255s %255s %63[^\n]"
+#define SYNCH_NFMT  16
+
+static const struct option base_options[] = {
+	{
+#define help_opt	0
+		.name = "help",
+		.has_arg = no_argument,
+	},
+#define file_opt	1
+	{
+		.name = "file",
+		.has_arg = required_argument,
+	},
+#define top_opt		2
+	{
+		.name = "top",
+		.has_arg = required_argument,
+	},
+#define sort_opt	3
+	{
+		.name = "sort",
+		.has_arg = required_argument,
+	},
+#define histo_opt	4
+	{
+		.name = "histogram",
+		.has_arg = no_argument,
+	},
+#define all_opt		5
+	{
+		.name = "all",
+		.has_arg = no_argument,
+	},
+#define reset_opt	6
+	{
+		.name = "reset",
+		.has_arg = no_argument,
+	},
+	{ /* Sentinel */ }
+};
+
+struct synch_stat {
+	unsigned int id;
+	int pid;
+	int live;
+	unsigned long acquired;
+	unsigned long contended;
+	unsigned long failed;
+	unsigned long boosts;
+	unsigned long long wait_total;
+	unsigned long long wait_max;
+	unsigned long long hold_total;
+	unsigned long long hold_max;
+	unsigned long long boost_total;
+	unsigned long long boost_max;
+	unsigned long wait_histo[SYNCH_BUCKETS];
+	unsigned long hold_histo[SYNCH_BUCKETS];
+	char name[64];
+};
+
+static struct synch_stat *stat_table;
+
+static int stat_count;
+
+static int (*sort_fn)(const void *l, const void *r);
+
+static int parse_histo(const char *s, unsigned long *histo)
+{
+	char *end;
+	int n;
+
+	for (n = 0; n < SYNCH_BUCKETS; n++) {
+		histo[n] = strtoul(s, &end, 10);
+		if (end == s)
+			return -EINVAL;
+		if (*end == ',')
+			end++;
+		s = end;
+	}
+
+	return 0;
+}
+
+static void read_stats(FILE *fp, int all)
+{
+	char buf[BUFSIZ], live[2], wait[256], hold[256];
+	struct synch_stat *p, *table;
+	int ret;
+
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (stat_count % 64 == 0) {
+			table = realloc(stat_table,
+					(stat_count + 64) * sizeof(*p));
+			if (table == NULL)
+				error(1, ENOMEM, "realloc");
+			stat_table = table;
+		}
+		p = stat_table + stat_count;
+		memset(p, 0, sizeof(*p));
+		ret = sscanf(buf, SYNCH_FMT, &p->id, &p->pid, live,
+			     &p->acquired, &p->contended, &p->failed,
+			     &p->boosts, &p->wait_total, &p->wait_max,
+			     &p->hold_total, &p->hold_max,
+			     &p->boost_total, &p->boost_max,
+			     wait, hold, p->name);
+		if (ret != SYNCH_NFMT)
+			continue; /* Header or comment line. */
+		if (parse_histo(wait, p->wait_histo) ||
+		    parse_histo(hold, p->hold_histo))
+			continue;
+		p->live = *live == 'L';
+		if (!p->live && !all)
+			continue;
+		stat_count++;
+	}
+}
+
+static unsigned long histo_sum(unsigned long *histo)
+{
+	unsigned long sum = 0;
+	int n;
+
+	for (n = 0; n < SYNCH_BUCKETS; n++)
+		sum += histo[n];
+
+	return sum;
+}
+
+#define cmp_field(__l, __r, __field)					\
+	({								\
+		const struct synch_stat *__ls = (__l), *__rs = (__r);	\
+		__ls->__field < __rs->__field ? 1 :			\
+			__ls->__field > __rs->__field ? -1 : 0;		\
+	})
+
+static int cmp_wait(const void *l, const void *r)
+{
+	return cmp_field(l, r, wait_total);
+}
+
+static int cmp_hold(const void *l, const void *r)
+{
+	return cmp_field(l, r, hold_total);
+}
+
+static int cmp_contended(const void *l, const void *r)
+{
+	return cmp_field(l, r, contended);
+}
+
+static int cmp_boost(const void *l, const void *r)
+{
+	return cmp_field(l, r, boost_total);
+}
+
+static int cmp_max(const void *l, const void *r)
+{
+	return cmp_field(l, r, wait_max);
+}
+
+static const struct {
+	const char *name;
+	int (*fn)(const void *l, const void *r);
+} sort_keys[] = {
+	{ "wait", cmp_wait },
+	{ "hold", cmp_hold },
+	{ "contended", cmp_contended },
+	{ "boost", cmp_boost },
+	{ "max", cmp_max },
+	{ NULL, NULL },
+};
+
+static double avg_us(unsigned long long total, unsigned long count)
+{
+	return count ? (double)total / count / 1000.0 : 0.0;
+}
+
+static void put_histo(const char *label, unsigned long *histo)
+{
+	unsigned long long lo;
+	int n;
+
+	printf("    %s:", label);
+	for (n = 0; n < SYNCH_BUCKETS; n++) {
+		if (histo[n] == 0)
+			continue;
+		lo = n ? 1024ULL << (n - 1) : 0;
+		if (n == SYNCH_BUCKETS - 1)
+			printf(" >=%llu.%03llu=%lu", lo / 1000, lo % 1000,
+			       histo[n]);
+		else
+			printf(" <%llu.%03llu=%lu", (1024ULL << n) / 1000,
+			       (1024ULL << n) % 1000, histo[n]);
+	}
+	printf(" (us)\n");
+}
+
+static void display_stats(int top, int histo)
+{
+	struct synch_stat *p;
+	unsigned long holds;
+	int n;
+
+	qsort(stat_table, stat_count, sizeof(*p), sort_fn);
+
+	printf("%-6s %-6s %10s %10s %6s %6s %10s %10s %10s %10s %10s  %s\n",
+	       "ID", "PID", "ACQUIRED", "CONTENDED", "FAILED", "BOOSTS",
+	       "WAIT-AVG", "WAIT-MAX", "HOLD-AVG", "HOLD-MAX", "BOOST-MAX",
+	       "CREATOR");
+
+	for (n = 0; n < stat_count && n < top; n++) {
+		p = stat_table + n;
+		holds = histo_sum(p->hold_histo);
+		printf("%-6u %-6d %10lu %10lu %6lu %6lu "
+		       "%10.3f %10.3f %10.3f %10.3f %10.3f  %s%s\n",
+		       p->id, p->pid, p->acquired, p->contended,
+		       p->failed, p->boosts,
+		       avg_us(p->wait_total, p->contended),
+		       (double)p->wait_max / 1000.0,
+		       avg_us(p->hold_total, holds),
+		       (double)p->hold_max / 1000.0,
+		       (double)p->boost_max / 1000.0,
+		       p->name, p->live ? "" : " (deleted)");
+		if (histo) {
+			put_histo("wait", p->wait_histo);
+			put_histo("hold", p->hold_histo);
+		}
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: rtlockstat [options]\n");
+	fprintf(stderr, "   --file <file>				read statistics from file ('-' for stdin)\n");
+	fprintf(stderr, "   --top <count>				list <count> objects at most (default 10)\n");
+	fprintf(stderr, "   --sort wait|hold|contended|boost|max	sort key (default: total wait time)\n");
+	fprintf(stderr, "   --histogram					print wait and hold time histograms\n");
+	fprintf(stderr, "   --all					include deleted objects\n");
+	fprintf(stderr, "   --reset					clear the statistics\n");
+	fprintf(stderr, "   --help					print this help\n");
+	fprintf(stderr, "times are given in microseconds\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	int c, lindex, n, top = 10, histo = 0, all = 0, reset = 0;
+	const char *file = PROC_SYNCH;
+	FILE *fp;
+
+	sort_fn = cmp_wait;
+
+	for (;;) {
+		c = getopt_long_only(argc, argv, "", base_options, &lindex);
+		if (c == EOF)
+			break;
+		if (c == '?') {
+			usage();
+			return EINVAL;
+		}
+		if (c > 0)
+			continue;
+
+		switch (lindex) {
+		case help_opt:
+			usage();
+			exit(0);
+		case file_opt:
+			file = optarg;
+			break;
+		case top_opt:
+			top = atoi(optarg);
+			if (top <= 0)
+				error(1, EINVAL, "invalid count: %s", optarg);
+			break;
+		case sort_opt:
+			for (n = 0; sort_keys[n].name; n++)
+				if (strcmp(sort_keys[n].name, optarg) == 0)
+					break;
+			if (sort_keys[n].name == NULL)
+				error(1, EINVAL, "invalid sort key: %s", optarg);
+			sort_fn = sort_keys[n].fn;
+			break;
+		case histo_opt:
+			histo = 1;
+			break;
+		case all_opt:
+			all = 1;
+			break;
+		case reset_opt:
+			reset = 1;
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+
+	if (reset) {
+		fp = fopen(PROC_SYNCH, "w");
+		if (fp == NULL || fputs("0\n", fp) == EOF || fclose(fp))
+			error(1, errno, "cannot reset %s", PROC_SYNCH);
+		return 0;
+	}
+
+	if (strcmp(file, "-") == 0)
+		fp = stdin;
+	else {
+		fp = fopen(file, "r");
+		if (fp == NULL)
+			error(1, errno, "cannot open %s", file);
+	}
+
+	read_stats(fp, all);
+
+	if (stat_count == 0) {
+		fputs("no contention data\n", stderr);
+		return 0;	/* This is not an error. */
+	}
+
+	display_stats(top, histo);
+
+	return 0;
+}